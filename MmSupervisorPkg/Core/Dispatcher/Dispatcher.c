@@ -37,6 +37,9 @@
 
 #include <PiMm.h>
 
+#include <Library/TimerLib.h>
+#include <Library/PeCoffExtraActionLib.h>
+
 #include "MmSupervisorCore.h"
 #include "PrivilegeMgmt/PrivilegeMgmt.h"
 
@@ -93,6 +96,12 @@ BOOLEAN  gDispatcherRunning = FALSE;
 //
 BOOLEAN  gRequestDispatch = FALSE;
 
+//
+// Number of SMIs the MM Dispatcher has run in, including the ones that ran out of
+// budget and asked the IPL to restart it.
+//
+STATIC UINT32  mDispatchPassCount = 0;
+
 //
 // The global variable is defined for Loading modules at fixed address feature to track the MM code
 // memory range usage. It is a bit mapped array in which every bit indicates the correspoding
@@ -100,6 +109,15 @@ BOOLEAN  gRequestDispatch = FALSE;
 //
 GLOBAL_REMOVE_IF_UNREFERENCED    UINT64  *mMmCodeMemoryRangeUsageBitMap = NULL;
 
+//
+// Load statistics of the Loading modules at fixed address feature: images loaded at the
+// address assigned by the build tool, images already linked at their load address that
+// skipped relocation, and images that fell back to a dynamically allocated buffer.
+//
+STATIC UINTN  mFixedAddressLoadCount     = 0;
+STATIC UINTN  mFixedAddressNoRelocCount  = 0;
+STATIC UINTN  mFixedAddressFallbackCount = 0;
+
 /**
   To check memory usage bit map array to figure out if the memory range in which the image will be loaded
   is available or not. If memory range is avaliable, the function will mark the corresponding bits to 1
@@ -126,9 +144,9 @@ CheckAndMarkFixLoadingMemoryUsageBitMap (
   UINTN                 Index;
 
   //
-  // Build tool will calculate the smm code size and then patch the PcdLoadFixAddressMmCodePageNumber
+  // Build tool will calculate the smm code size and then patch the PcdLoadFixAddressSmmCodePageNumber
   //
-  MmCodePageNumber = 0;
+  MmCodePageNumber = PcdGet32 (PcdLoadFixAddressSmmCodePageNumber);
   MmCodeSize       = EFI_PAGES_TO_SIZE (MmCodePageNumber);
   MmCodeBase       = gLoadModuleAtFixAddressMmramBase;
 
@@ -276,6 +294,82 @@ GetPeCoffImageFixLoadingAssignedAddress (
   return Status;
 }
 
+/**
+  Locate the MMRAM range reserved by the IPL for the code of all MM images when the
+  Loading Module At Fixed Address feature is enabled, and cache its base in
+  gLoadModuleAtFixAddressMmramBase. Nothing is done if the feature is disabled.
+
+  The IPL carves this range out of the start of the largest MMRAM range, marks it
+  allocated and puts it second to last in the MMRAM ranges, before the range of the
+  MM core. The latter is dropped when the MM core itself is loaded at its fixed
+  address, so both of the last two ranges are checked.
+
+**/
+VOID
+MmInitializeLoadFixedAddress (
+  VOID
+  )
+{
+  UINT64                MmCodeSize;
+  UINTN                 Index;
+  EFI_MMRAM_DESCRIPTOR  *Range;
+
+  if (PcdGet64 (PcdLoadModuleAtFixAddressEnable) == 0) {
+    return;
+  }
+
+  MmCodeSize = EFI_PAGES_TO_SIZE ((UINTN)PcdGet32 (PcdLoadFixAddressSmmCodePageNumber));
+  for (Index = 1; (MmCodeSize != 0) && (Index <= MIN (mMmramRangeCount, 2)); Index++) {
+    Range = &mMmramRanges[mMmramRangeCount - Index];
+    if (((Range->RegionState & EFI_ALLOCATED) != 0) && (Range->PhysicalSize == MmCodeSize)) {
+      gLoadModuleAtFixAddressMmramBase = Range->CpuStart;
+      break;
+    }
+  }
+
+  if (gLoadModuleAtFixAddressMmramBase == 0) {
+    DEBUG ((DEBUG_WARN, "LOADING MODULE FIXED ERROR: No MMRAM range reserved for MM code, images load at dynamic addresses\n"));
+    return;
+  }
+
+  DEBUG ((DEBUG_INFO, "LOADING MODULE FIXED INFO: MM code range 0x%lx - 0x%lx\n", gLoadModuleAtFixAddressMmramBase, MmCodeSize));
+
+  //
+  // The MM core may sit in the same range, keep drivers with conflicting assignments off it
+  //
+  if ((gMmCorePrivate->MmCoreImageBase >= gLoadModuleAtFixAddressMmramBase) &&
+      (gMmCorePrivate->MmCoreImageBase < gLoadModuleAtFixAddressMmramBase + MmCodeSize))
+  {
+    CheckAndMarkFixLoadingMemoryUsageBitMap (gMmCorePrivate->MmCoreImageBase, (UINTN)gMmCorePrivate->MmCoreImageSize);
+  }
+}
+
+/**
+  Release the pages of an image that failed to load or to start.
+
+  The pages of an image loaded at fixed address belong to the MMRAM range reserved for MM code,
+  they are handed back to supervisor there instead of going to the free page list.
+
+  @param[in]  ImageBuffer           The base of the image pages.
+  @param[in]  NumberOfPages         The number of image pages.
+  @param[in]  LoadedAtFixedAddress  If the image is loaded at the address assigned by build tool.
+
+**/
+STATIC
+VOID
+MmReleaseImagePages (
+  IN EFI_PHYSICAL_ADDRESS  ImageBuffer,
+  IN UINTN                 NumberOfPages,
+  IN BOOLEAN               LoadedAtFixedAddress
+  )
+{
+  if (LoadedAtFixedAddress) {
+    MmConvertAllocatedPages (ImageBuffer, NumberOfPages, EfiRuntimeServicesData, TRUE);
+  } else {
+    MmFreePages (ImageBuffer, NumberOfPages);
+  }
+}
+
 /**
   Loads an EFI image into SMRAM.
 
@@ -293,6 +387,7 @@ MmLoadImage (
   UINTN                         PageCount;
   EFI_STATUS                    Status;
   EFI_PHYSICAL_ADDRESS          DstBuffer;
+  EFI_PHYSICAL_ADDRESS          LinkedBase;
   PE_COFF_LOADER_IMAGE_CONTEXT  ImageContext;
 
   DEBUG ((DEBUG_INFO, "MmLoadImage - %g\n", &DriverEntry->FileName));
@@ -314,28 +409,55 @@ MmLoadImage (
     return Status;
   }
 
-  PageCount = (UINTN)EFI_SIZE_TO_PAGES ((UINTN)ImageContext.ImageSize + ImageContext.SectionAlignment);
-  DstBuffer = (UINTN)(-1);
+  PageCount  = (UINTN)EFI_SIZE_TO_PAGES ((UINTN)ImageContext.ImageSize + ImageContext.SectionAlignment);
+  DstBuffer  = (UINTN)(-1);
+  LinkedBase = ImageContext.ImageAddress;
 
-  // Note that the buffer will be protected after analyzing the PE/Coff data.
-  Status = MmAllocatePages (
-             AllocateMaxAddress,
-             EfiRuntimeServicesCode,
-             PageCount,
-             &DstBuffer
-             );
-  if (EFI_ERROR (Status)) {
-    DEBUG ((DEBUG_ERROR, "%a Failed to allocate 0x%x pages for loading image %r\n", __FUNCTION__, PageCount, Status));
-    return Status;
-  }
-
-  ImageContext.ImageAddress = (EFI_PHYSICAL_ADDRESS)DstBuffer;
+  DriverEntry->LoadedAtFixedAddress = FALSE;
 
   //
-  // Align buffer on section boundary
+  // If Loading module at Fixed Address feature is enabled, the MM driver is loaded at the address
+  // assigned by build tool. That address is inside the MMRAM range the IPL reserved for all MM code,
+  // so no allocation is needed. The range is registered as supervisor data though, so the image
+  // pages are handed over to users the same way MmAllocatePages does for a dynamic address.
   //
-  ImageContext.ImageAddress += ImageContext.SectionAlignment - 1;
-  ImageContext.ImageAddress &= ~((EFI_PHYSICAL_ADDRESS)(ImageContext.SectionAlignment - 1));
+  if (gLoadModuleAtFixAddressMmramBase != 0) {
+    Status = GetPeCoffImageFixLoadingAssignedAddress (&ImageContext);
+    if (!EFI_ERROR (Status)) {
+      Status = MmConvertAllocatedPages (ImageContext.ImageAddress, PageCount, EfiRuntimeServicesCode, FALSE);
+    }
+
+    if (!EFI_ERROR (Status)) {
+      DstBuffer                         = ImageContext.ImageAddress;
+      DriverEntry->LoadedAtFixedAddress = TRUE;
+      mFixedAddressLoadCount++;
+    } else {
+      DEBUG ((DEBUG_INFO, "LOADING MODULE FIXED ERROR: Loading module at fixed address failed, using a dynamic address\n"));
+      mFixedAddressFallbackCount++;
+    }
+  }
+
+  if (DstBuffer == (UINTN)(-1)) {
+    // Note that the buffer will be protected after analyzing the PE/Coff data.
+    Status = MmAllocatePages (
+               AllocateMaxAddress,
+               EfiRuntimeServicesCode,
+               PageCount,
+               &DstBuffer
+               );
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_ERROR, "%a Failed to allocate 0x%x pages for loading image %r\n", __FUNCTION__, PageCount, Status));
+      return Status;
+    }
+
+    ImageContext.ImageAddress = (EFI_PHYSICAL_ADDRESS)DstBuffer;
+
+    //
+    // Align buffer on section boundary
+    //
+    ImageContext.ImageAddress += ImageContext.SectionAlignment - 1;
+    ImageContext.ImageAddress &= ~((EFI_PHYSICAL_ADDRESS)(ImageContext.SectionAlignment - 1));
+  }
 
   //
   // Load the image to our new buffer
@@ -343,18 +465,23 @@ MmLoadImage (
   Status = PeCoffLoaderLoadImage (&ImageContext);
   if (EFI_ERROR (Status)) {
     DEBUG ((DEBUG_ERROR, "%a Failed to load image into our allocated buffer %r\n", __FUNCTION__, Status));
-    MmFreePages (DstBuffer, PageCount);
+    MmReleaseImagePages (DstBuffer, PageCount, DriverEntry->LoadedAtFixedAddress);
     return Status;
   }
 
   //
-  // Relocate the image in our new buffer
+  // Relocate the image in our new buffer, unless the build tool already linked it at this address
   //
-  Status = PeCoffLoaderRelocateImage (&ImageContext);
-  if (EFI_ERROR (Status)) {
-    DEBUG ((DEBUG_ERROR, "%a Failed to relocate image %r\n", __FUNCTION__, Status));
-    MmFreePages (DstBuffer, PageCount);
-    return Status;
+  if (ImageContext.ImageAddress != LinkedBase) {
+    Status = PeCoffLoaderRelocateImage (&ImageContext);
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_ERROR, "%a Failed to relocate image %r\n", __FUNCTION__, Status));
+      MmReleaseImagePages (DstBuffer, PageCount, DriverEntry->LoadedAtFixedAddress);
+      return Status;
+    }
+  } else {
+    PeCoffLoaderRelocateImageExtraAction (&ImageContext);
+    mFixedAddressNoRelocCount++;
   }
 
   //
@@ -378,7 +505,7 @@ MmLoadImage (
              );
   if (EFI_ERROR (Status)) {
     DEBUG ((DEBUG_ERROR, "%a Failed to allocate pool for loaded image protocol %r\n", __FUNCTION__, Status));
-    MmFreePages (DstBuffer, PageCount);
+    MmReleaseImagePages (DstBuffer, PageCount, DriverEntry->LoadedAtFixedAddress);
     return Status;
   }
 
@@ -416,10 +543,19 @@ MmLoadImage (
   Status = SmmSetImagePageAttributes (DriverEntry, FALSE);
   if (EFI_ERROR (Status)) {
     DEBUG ((DEBUG_ERROR, "%a Failed to set image attribute for loaded image %r\n", __FUNCTION__, Status));
-    MmFreePages (DstBuffer, PageCount);
+    // The image pages are writable again, the free page list can be kept in them
+    MmReleaseImagePages (DstBuffer, PageCount, DriverEntry->LoadedAtFixedAddress);
     return Status;
   }
 
+  //
+  // Index the image so that faults and handlers can be attributed to it. Failing to do so only
+  // degrades the diagnostics, the image is still usable.
+  //
+  if (EFI_ERROR (MmImageIndexInsert (DriverEntry, ImageContext.PdbPointer))) {
+    DEBUG ((DEBUG_WARN, "%a Image %g at 0x%p is not indexed\n", __FUNCTION__, &DriverEntry->FileName, DriverEntry->ImageBuffer));
+  }
+
   //
   // Print the load address and the PDB file name if it is available
   //
@@ -569,6 +705,40 @@ MmGetDepexSectionAndPreProccess (
   return Status;
 }
 
+/**
+  Check whether the current dispatch pass has used up the time or driver budget
+  of a single SMI.
+
+  @param[in]  StartTicker   The performance counter at the start of the pass.
+  @param[in]  DriverCount   The number of drivers taken off mScheduledQueue so far.
+
+  @retval TRUE    The pass should stop and let the IPL restart the dispatcher.
+  @retval FALSE   The pass may take another driver.
+
+**/
+STATIC
+BOOLEAN
+IsDispatchBudgetExhausted (
+  IN UINT64  StartTicker,
+  IN UINT32  DriverCount
+  )
+{
+  if ((FixedPcdGet32 (PcdMmSupervisorDispatchDriverBudget) != 0) &&
+      (DriverCount >= FixedPcdGet32 (PcdMmSupervisorDispatchDriverBudget)))
+  {
+    return TRUE;
+  }
+
+  if ((FixedPcdGet32 (PcdMmSupervisorDispatchTimeBudget) != 0) &&
+      (GetTimeInNanoSecond (GetPerformanceCounter () - StartTicker) >=
+       MultU64x32 (FixedPcdGet32 (PcdMmSupervisorDispatchTimeBudget), 1000)))
+  {
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
 /**
   This is the main Dispatcher for MM and it exits when there are no more
   drivers to run. Drain the mScheduledQueue and load and start a PE
@@ -576,11 +746,16 @@ MmGetDepexSectionAndPreProccess (
   be placed on the mScheduledQueue. If no drivers are placed on the
   mScheduledQueue exit the function.
 
+  When a time or driver budget is configured, the dispatcher stops once the
+  budget of the current SMI is used up, with at least one driver dispatched.
+  The remaining drivers stay on mScheduledQueue and mDiscoveredList, so the
+  next call resumes from the same point.
+
   @retval EFI_SUCCESS           All of the MM Drivers that could be dispatched
                                 have been run and the MM Entry Point has been
                                 registered.
-  @retval EFI_NOT_READY         The MM Driver that registered the MM Entry Point
-                                was just dispatched.
+  @retval EFI_NOT_READY         The budget of this SMI is used up and there are
+                                MM Drivers left to dispatch.
   @retval EFI_NOT_FOUND         There are no MM Drivers available to be dispatched.
   @retval EFI_ALREADY_STARTED   The MM Dispatcher is already running
 
@@ -594,6 +769,9 @@ MmDispatcher (
   LIST_ENTRY           *Link;
   EFI_MM_DRIVER_ENTRY  *DriverEntry;
   BOOLEAN              ReadyToRun;
+  BOOLEAN              Yield;
+  UINT32               DriverCount;
+  UINT64               StartTicker;
 
   DEBUG ((DEBUG_INFO, "MmDispatcher\n"));
 
@@ -611,6 +789,10 @@ MmDispatcher (
   }
 
   gDispatcherRunning = TRUE;
+  mDispatchPassCount++;
+  StartTicker = GetPerformanceCounter ();
+  DriverCount = 0;
+  Yield       = FALSE;
 
   do {
     //
@@ -618,6 +800,12 @@ MmDispatcher (
     //
     DEBUG ((DEBUG_INFO, "  Drain the Scheduled Queue\n"));
     while (!IsListEmpty (&mScheduledQueue)) {
+      if ((DriverCount != 0) && IsDispatchBudgetExhausted (StartTicker, DriverCount)) {
+        Yield = TRUE;
+        break;
+      }
+
+      DriverCount++;
       DriverEntry = CR (
                       mScheduledQueue.ForwardLink,
                       EFI_MM_DRIVER_ENTRY,
@@ -668,7 +856,8 @@ MmDispatcher (
                  );
       if (EFI_ERROR (Status)) {
         DEBUG ((DEBUG_INFO, "StartImage Status - %r\n", Status));
-        MmFreePages (DriverEntry->ImageBuffer, DriverEntry->NumberOfPage);
+        MmImageIndexRemove (DriverEntry);
+        MmReleaseImagePages (DriverEntry->ImageBuffer, DriverEntry->NumberOfPage, DriverEntry->LoadedAtFixedAddress);
         Status = gMmCoreMmst.MmUninstallProtocolInterface (DriverEntry->ImageHandle, &gEfiLoadedImageProtocolGuid, DriverEntry->LoadedImage);
         if (!EFI_ERROR (Status)) {
           MmFreeSupervisorPool (DriverEntry->LoadedImage);
@@ -677,6 +866,10 @@ MmDispatcher (
       }
     }
 
+    if (Yield) {
+      break;
+    }
+
     //
     // Search DriverList for items to place on Scheduled Queue
     //
@@ -702,6 +895,23 @@ MmDispatcher (
     }
   } while (ReadyToRun);
 
+  DEBUG ((
+    DEBUG_INFO,
+    "MmDispatcher pass %d - 0x%x drivers in %ldus%a\n",
+    mDispatchPassCount,
+    DriverCount,
+    DivU64x32 (GetTimeInNanoSecond (GetPerformanceCounter () - StartTicker), 1000),
+    Yield ? ", budget used up" : ""
+    ));
+
+  if (Yield) {
+    //
+    // Leave gRequestDispatch set, the IPL calls back in to resume the dispatch
+    //
+    gDispatcherRunning = FALSE;
+    return EFI_NOT_READY;
+  }
+
   //
   // If there is no more MM driver to dispatch, stop the dispatch request
   //
@@ -720,6 +930,16 @@ MmDispatcher (
     }
   }
 
+  if (gLoadModuleAtFixAddressMmramBase != 0) {
+    DEBUG ((
+      DEBUG_INFO,
+      "LOADING MODULE FIXED INFO: 0x%x images at fixed address, 0x%x without relocation, 0x%x at dynamic address\n",
+      mFixedAddressLoadCount,
+      mFixedAddressNoRelocCount,
+      mFixedAddressFallbackCount
+      ));
+  }
+
   gDispatcherRunning = FALSE;
 
   return EFI_SUCCESS;
@@ -1026,7 +1246,7 @@ PrepareCommonBuffer:
     if (*CommBufferSize > 0) {
       if (Status == EFI_NOT_READY) {
         //
-        // If a the SMM Core Entry Point was just registered, then set flag to
+        // If the SMM Dispatcher used up the budget of this SMI, then set flag to
         // request the SMM Dispatcher to be restarted.
         //
         *(UINT8 *)CommBuffer = COMM_BUFFER_MM_DISPATCH_RESTART;
@@ -1070,7 +1290,7 @@ MmDisplayDiscoveredNotDispatched (
 }
 
 /**
-  Helper function that will look up the driver GUID from discovered list using loaded image address.
+  Helper function that will look up the driver GUID from the image index using loaded image address.
 
   @param  DriverAddr      The address of loaded image that is of interest.
   @param  Guid            The pointer to hold returned driver GUID.
@@ -1086,9 +1306,8 @@ FindFileNameFromDiscoveredList (
   OUT EFI_GUID              *Guid
   )
 {
-  LIST_ENTRY           *Link;
-  EFI_MM_DRIVER_ENTRY  *DriverEntry;
-  EFI_STATUS           Status;
+  CONST MM_IMAGE_INDEX_ENTRY  *ImageEntry;
+  EFI_STATUS                  Status;
 
   if (Guid == NULL) {
     Status = EFI_INVALID_PARAMETER;
@@ -1097,22 +1316,11 @@ FindFileNameFromDiscoveredList (
 
   Status = EFI_NOT_FOUND;
 
-  // First check if this is the core itself
-  if ((EFI_PHYSICAL_ADDRESS)(UINTN)mMmCoreDriverEntry->LoadedImage->ImageBase == DriverAddress) {
-    CopyMem (Guid, &gEfiCallerIdGuid, sizeof (EFI_GUID));
+  // The core is indexed as well, under its own file name
+  ImageEntry = MmImageIndexLookup (DriverAddress);
+  if ((ImageEntry != NULL) && (ImageEntry->ImageBase == DriverAddress)) {
+    CopyMem (Guid, &ImageEntry->DriverEntry->FileName, sizeof (EFI_GUID));
     Status = EFI_SUCCESS;
-    goto Exit;
-  }
-
-  for (Link = mDiscoveredList.ForwardLink; Link != &mDiscoveredList; Link = Link->ForwardLink) {
-    DriverEntry = CR (Link, EFI_MM_DRIVER_ENTRY, Link, EFI_MM_DRIVER_ENTRY_SIGNATURE);
-    if ((DriverEntry->LoadedImage != NULL) &&
-        ((UINTN)DriverEntry->LoadedImage->ImageBase == DriverAddress))
-    {
-      CopyMem (Guid, &DriverEntry->FileName, sizeof (EFI_GUID));
-      Status = EFI_SUCCESS;
-      break;
-    }
   }
 
 Exit:
@@ -18,6 +18,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Library/DevicePathLib.h>
 #include <Library/PeCoffGetEntryPointLib.h>
 #include <Library/SysCallLib.h>
+#include <Library/SortLib.h>
 #include <Protocol/LoadedImage.h>
 #include <Protocol/SmmAccess2.h>
 #include <Protocol/SmmReadyToLock.h>
@@ -240,9 +241,42 @@ AddImageStruct (
   mImageStructCount++;
 }
 
+/**
+  Sort callback ordering image structures by image base.
+
+  @param[in]  Buffer1   Pointer to the first IMAGE_STRUCT.
+  @param[in]  Buffer2   Pointer to the second IMAGE_STRUCT.
+
+  @retval <0            Buffer1 is ordered before Buffer2.
+  @retval 0             The images start at the same address.
+  @retval >0            Buffer1 is ordered after Buffer2.
+
+**/
+STATIC
+INTN
+EFIAPI
+CompareImageStructBase (
+  IN CONST VOID  *Buffer1,
+  IN CONST VOID  *Buffer2
+  )
+{
+  CONST IMAGE_STRUCT  *Image1;
+  CONST IMAGE_STRUCT  *Image2;
+
+  Image1 = (CONST IMAGE_STRUCT *)Buffer1;
+  Image2 = (CONST IMAGE_STRUCT *)Buffer2;
+  if (Image1->ImageBase == Image2->ImageBase) {
+    return 0;
+  }
+
+  return (Image1->ImageBase < Image2->ImageBase) ? -1 : 1;
+}
+
 /**
   return an image structure based upon image address.
 
+  Note: mImageStruct is ordered by image base once collected, see GetSmmLoadedImage.
+
   @param  Address  image address
 
   @return image structure
@@ -252,16 +286,25 @@ AddressToImageStruct (
   IN UINTN  Address
   )
 {
-  UINTN  Index;
-
-  for (Index = 0; Index < mImageStructCount; Index++) {
-    if ((Address >= mImageStruct[Index].ImageBase) &&
-        (Address < mImageStruct[Index].ImageBase + mImageStruct[Index].ImageSize))
-    {
-      return &mImageStruct[Index];
+  UINTN  Low;
+  UINTN  High;
+  UINTN  Middle;
+
+  Low  = 0;
+  High = mImageStructCount;
+  while (Low < High) {
+    Middle = Low + (High - Low) / 2;
+    if (mImageStruct[Middle].ImageBase <= Address) {
+      Low = Middle + 1;
+    } else {
+      High = Middle;
     }
   }
 
+  if ((Low > 0) && (Address - mImageStruct[Low - 1].ImageBase < mImageStruct[Low - 1].ImageSize)) {
+    return &mImageStruct[Low - 1];
+  }
+
   return NULL;
 }
 
@@ -352,19 +395,20 @@ GetSmmLoadedImage (
   VOID
   )
 {
-  EFI_STATUS                 Status;
-  UINTN                      NoHandles;
-  UINTN                      HandleBufferSize;
-  EFI_HANDLE                 *HandleBuffer;
-  UINTN                      Index;
-  EFI_LOADED_IMAGE_PROTOCOL  *LoadedImage;
-  CHAR16                     *PathStr;
-  EFI_MM_DRIVER_ENTRY        *LoadedImagePrivate;
-  PHYSICAL_ADDRESS           EntryPoint;
-  VOID                       *EntryPointInImage;
-  EFI_GUID                   Guid;
-  CHAR8                      *PdbString;
-  PHYSICAL_ADDRESS           RealImageBase;
+  EFI_STATUS                  Status;
+  UINTN                       NoHandles;
+  UINTN                       HandleBufferSize;
+  EFI_HANDLE                  *HandleBuffer;
+  UINTN                       Index;
+  EFI_LOADED_IMAGE_PROTOCOL   *LoadedImage;
+  CHAR16                      *PathStr;
+  EFI_MM_DRIVER_ENTRY         *LoadedImagePrivate;
+  PHYSICAL_ADDRESS            EntryPoint;
+  VOID                        *EntryPointInImage;
+  EFI_GUID                    Guid;
+  CHAR8                       *PdbString;
+  PHYSICAL_ADDRESS            RealImageBase;
+  CONST MM_IMAGE_INDEX_ENTRY  *ImageEntry;
 
   HandleBufferSize = 0;
   HandleBuffer     = NULL;
@@ -412,8 +456,14 @@ GetSmmLoadedImage (
       continue;
     }
 
-    PathStr = ConvertDevicePathToText (LoadedImage->FilePath, TRUE, TRUE);
-    FindFileNameFromDiscoveredList ((EFI_PHYSICAL_ADDRESS)LoadedImage->ImageBase, &Guid);
+    PathStr    = ConvertDevicePathToText (LoadedImage->FilePath, TRUE, TRUE);
+    ImageEntry = MmImageIndexLookup ((EFI_PHYSICAL_ADDRESS)(UINTN)LoadedImage->ImageBase);
+    if (ImageEntry != NULL) {
+      CopyGuid (&Guid, &ImageEntry->DriverEntry->FileName);
+    } else {
+      ZeroMem (&Guid, sizeof (Guid));
+    }
+
     DEBUG ((DEBUG_INFO, "Image: %g ", &Guid));
 
     EntryPoint         = 0;
@@ -440,7 +490,12 @@ GetSmmLoadedImage (
     DEBUG ((DEBUG_INFO, ")\n"));
 
     if (RealImageBase != 0) {
-      PdbString = PeCoffLoaderGetPdbPointer ((VOID *)(UINTN)RealImageBase);
+      if ((ImageEntry != NULL) && (RealImageBase == ImageEntry->ImageBase)) {
+        PdbString = (CHAR8 *)ImageEntry->PdbString;
+      } else {
+        PdbString = PeCoffLoaderGetPdbPointer ((VOID *)(UINTN)RealImageBase);
+      }
+
       if (PdbString == NULL) {
         DEBUG ((DEBUG_WARN, "       pdb has NULL string\n"));
       } else {
@@ -455,6 +510,12 @@ GetSmmLoadedImage (
     AddImageStruct (RealImageBase, LoadedImage->ImageSize, EntryPoint, &Guid, PdbString);
   }
 
+  //
+  // Handlers are attributed to images by address, keep the images ordered for AddressToImageStruct.
+  // ImageRef is assigned above and does not change.
+  //
+  PerformQuickSort (mImageStruct, mImageStructCount, sizeof (IMAGE_STRUCT), CompareImageStructBase);
+
 Done:
   FreePool (HandleBuffer);
   return;
@@ -0,0 +1,137 @@
+/** @file
+  Dispatch of vectored MM communicate messages, which carry several ordinary MM communicate
+  messages in a single MMI.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "MmSupervisorCore.h"
+
+/**
+  Dispatch the messages embedded in a vectored MM communicate message, in order, to the MMI
+  handlers of their HeaderGuid.
+
+  The layout of the whole vectored message is validated before any handler runs, and the offset
+  and size of every entry are kept aside, so that a handler rewriting the communicate buffer can
+  neither move nor grow the entries after its own. Each message is then handled the same way as
+  one sent on its own: CommBufferSize is used as the size cell of every message, so that it stays
+  accessible to user handlers when the buffer comes from the user channel.
+
+  @param[in, out] CommBuffer      Points to the payload of the vectored message, starting with
+                                  MM_VECTORED_COMMUNICATE_HEADER.
+  @param[in, out] CommBufferSize  Points to the size of CommBuffer. It is used as the size cell of
+                                  each embedded message and holds the size of CommBuffer again
+                                  upon return.
+
+  @retval EFI_SUCCESS             All embedded messages are dispatched, their results are in
+                                  their entries.
+  @retval EFI_INVALID_PARAMETER   The vectored message is malformed, no message is dispatched.
+
+**/
+EFI_STATUS
+MmVectoredCommunicateManage (
+  IN OUT VOID   *CommBuffer,
+  IN OUT UINTN  *CommBufferSize
+  )
+{
+  MM_VECTORED_COMMUNICATE_HEADER  *VectorHeader;
+  MM_VECTORED_COMMUNICATE_ENTRY   *Entry;
+  UINT32                          EntryOffset[MM_VECTORED_COMMUNICATE_MAX_MESSAGES];
+  UINT32                          EntrySize[MM_VECTORED_COMMUNICATE_MAX_MESSAGES];
+  UINTN                           TotalSize;
+  UINTN                           Offset;
+  UINTN                           MessageLength;
+  UINT32                          MessageCount;
+  UINT32                          Index;
+  EFI_GUID                        HandlerType;
+  EFI_STATUS                      Status;
+
+  if ((CommBuffer == NULL) || (CommBufferSize == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  TotalSize = *CommBufferSize;
+  if ((TotalSize < sizeof (MM_VECTORED_COMMUNICATE_HEADER)) || (TotalSize > MAX_UINT32)) {
+    DEBUG ((DEBUG_ERROR, "%a - Invalid vectored message size 0x%lx\n", __FUNCTION__, (UINT64)TotalSize));
+    return EFI_INVALID_PARAMETER;
+  }
+
+  VectorHeader = (MM_VECTORED_COMMUNICATE_HEADER *)CommBuffer;
+  MessageCount = VectorHeader->MessageCount;
+  if ((VectorHeader->Signature != MM_VECTORED_COMMUNICATE_SIGNATURE) ||
+      (MessageCount == 0) ||
+      (MessageCount > MM_VECTORED_COMMUNICATE_MAX_MESSAGES))
+  {
+    DEBUG ((DEBUG_ERROR, "%a - Invalid vectored header, signature 0x%x, 0x%x messages\n", __FUNCTION__, VectorHeader->Signature, MessageCount));
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // Validate the whole layout before dispatching anything. TotalSize fits in 32 bits, so none of
+  // the sums below can overflow.
+  //
+  Offset = ALIGN_VALUE (sizeof (MM_VECTORED_COMMUNICATE_HEADER), 8);
+  for (Index = 0; Index < MessageCount; Index++) {
+    if ((Offset > TotalSize) || (TotalSize - Offset < MM_VECTORED_COMMUNICATE_ENTRY_OVERHEAD)) {
+      DEBUG ((DEBUG_ERROR, "%a - Entry %d starts beyond the buffer\n", __FUNCTION__, Index));
+      return EFI_INVALID_PARAMETER;
+    }
+
+    Entry = (MM_VECTORED_COMMUNICATE_ENTRY *)((UINT8 *)CommBuffer + Offset);
+    if ((Entry->EntrySize < MM_VECTORED_COMMUNICATE_ENTRY_OVERHEAD) ||
+        ((Entry->EntrySize & 0x7) != 0) ||
+        (Entry->EntrySize > TotalSize - Offset) ||
+        (Entry->Message.MessageLength > Entry->EntrySize - MM_VECTORED_COMMUNICATE_ENTRY_OVERHEAD))
+    {
+      DEBUG ((DEBUG_ERROR, "%a - Entry %d has an invalid size\n", __FUNCTION__, Index));
+      return EFI_INVALID_PARAMETER;
+    }
+
+    if (CompareGuid (&Entry->Message.HeaderGuid, &gMmVectoredCommunicateGuid)) {
+      DEBUG ((DEBUG_ERROR, "%a - Entry %d nests a vectored message\n", __FUNCTION__, Index));
+      return EFI_INVALID_PARAMETER;
+    }
+
+    EntryOffset[Index] = (UINT32)Offset;
+    EntrySize[Index]   = Entry->EntrySize;
+    Offset            += Entry->EntrySize;
+  }
+
+  for (Index = 0; Index < MessageCount; Index++) {
+    Entry = (MM_VECTORED_COMMUNICATE_ENTRY *)((UINT8 *)CommBuffer + EntryOffset[Index]);
+
+    //
+    // A handler of an earlier message may have rewritten this entry, read its header only once
+    // and check it again against the size validated above.
+    //
+    CopyGuid (&HandlerType, &Entry->Message.HeaderGuid);
+    MessageLength = Entry->Message.MessageLength;
+    if ((MessageLength > EntrySize[Index] - MM_VECTORED_COMMUNICATE_ENTRY_OVERHEAD) ||
+        CompareGuid (&HandlerType, &gMmVectoredCommunicateGuid))
+    {
+      Entry->ReturnStatus = EFI_INVALID_PARAMETER;
+      continue;
+    }
+
+    *CommBufferSize = MessageLength;
+    Status          = MmiManage (&HandlerType, NULL, Entry->Message.Data, CommBufferSize);
+
+    MessageLength = *CommBufferSize;
+    if (MessageLength > EntrySize[Index] - MM_VECTORED_COMMUNICATE_ENTRY_OVERHEAD) {
+      //
+      // Same as a single message, a handler must not return more data than it was given.
+      //
+      DEBUG ((DEBUG_ERROR, "%a - Handler of %g returned 0x%lx bytes, more than its entry holds\n", __FUNCTION__, &HandlerType, (UINT64)MessageLength));
+      ASSERT (FALSE);
+      MessageLength = EntrySize[Index] - MM_VECTORED_COMMUNICATE_ENTRY_OVERHEAD;
+    }
+
+    Entry->Message.MessageLength = MessageLength;
+    Entry->ReturnStatus          = (Status == EFI_SUCCESS) ? EFI_SUCCESS : EFI_NOT_FOUND;
+  }
+
+  *CommBufferSize = TotalSize;
+  return EFI_SUCCESS;
+}
@@ -13,6 +13,8 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Library/BaseLib.h>
 #include <Library/DebugLib.h>
 #include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/TimerLib.h>
 
 #include "MmSupervisorCore.h"
 #include "Mem.h"
@@ -48,6 +50,14 @@ GLOBAL_REMOVE_IF_UNREFERENCED UINTN  mLevelShift[GUARDED_HEAP_MAP_TABLE_DEPTH]
 GLOBAL_REMOVE_IF_UNREFERENCED UINTN  mLevelMask[GUARDED_HEAP_MAP_TABLE_DEPTH]
   = GUARDED_HEAP_MAP_TABLE_DEPTH_MASKS;
 
+//
+// The L4 table found by the last lookup, and the address bits above the L4
+// table it covers. Map tables are never freed, so the pointer stays valid once
+// the table is allocated, even after the map grows more levels on top of it.
+//
+GLOBAL_REMOVE_IF_UNREFERENCED UINT64  *mLastGuardedMapUnit    = NULL;
+GLOBAL_REMOVE_IF_UNREFERENCED UINT64  mLastGuardedMapUnitBase = 0;
+
 //
 // SMM memory attribute protocol
 //
@@ -269,6 +279,18 @@ FindGuardedMemoryMap (
   UINTN   Size;
   UINTN   BitsToUnitEnd;
 
+  BitsToUnitEnd = GUARDED_HEAP_MAP_BITS - GUARDED_HEAP_MAP_BIT_INDEX (Address);
+
+  //
+  // Consecutive lookups mostly hit the same L4 table, skip the walk for them
+  //
+  if ((mLastGuardedMapUnit != NULL) &&
+      (RShiftU64 (Address, GUARDED_HEAP_MAP_TABLE_SHIFT) == mLastGuardedMapUnitBase))
+  {
+    *BitMap = mLastGuardedMapUnit + GUARDED_HEAP_MAP_ENTRY_INDEX (Address);
+    return BitsToUnitEnd;
+  }
+
   //
   // Adjust current map table depth according to the address to access
   //
@@ -318,8 +340,12 @@ FindGuardedMemoryMap (
     GuardMap = (UINT64 *)(UINTN)((*GuardMap) + Index * sizeof (UINT64));
   }
 
-  BitsToUnitEnd = GUARDED_HEAP_MAP_BITS - GUARDED_HEAP_MAP_BIT_INDEX (Address);
-  *BitMap       = GuardMap;
+  if (GuardMap != NULL) {
+    mLastGuardedMapUnit     = GuardMap - GUARDED_HEAP_MAP_ENTRY_INDEX (Address);
+    mLastGuardedMapUnitBase = RShiftU64 (Address, GUARDED_HEAP_MAP_TABLE_SHIFT);
+  }
+
+  *BitMap = GuardMap;
 
   return BitsToUnitEnd;
 }
@@ -1194,32 +1220,135 @@ MmInternalFreePagesExWithGuard (
 }
 
 /**
-  Set all Guard pages which cannot be set during the non-MM mode time.
+  Close the current run of Guard pages of the batch. The run is recorded in the
+  range list if there is one, or applied to the page table right away if asked
+  to, otherwise it is only counted.
+
+  @param[in, out] Batch   The Guard page batch.
 **/
+STATIC
 VOID
-SetAllGuardPages (
-  VOID
+CloseGuardPageRun (
+  IN OUT GUARD_PAGE_BATCH  *Batch
   )
 {
-  UINTN    Entries[GUARDED_HEAP_MAP_TABLE_DEPTH];
-  UINTN    Shifts[GUARDED_HEAP_MAP_TABLE_DEPTH];
-  UINTN    Indices[GUARDED_HEAP_MAP_TABLE_DEPTH];
-  UINT64   Tables[GUARDED_HEAP_MAP_TABLE_DEPTH];
-  UINT64   Addresses[GUARDED_HEAP_MAP_TABLE_DEPTH];
-  UINT64   TableEntry;
-  UINT64   Address;
-  UINT64   GuardPage;
-  INTN     Level;
-  UINTN    Index;
-  BOOLEAN  OnGuarding;
+  EFI_STATUS  Status;
 
-  if ((mGuardedMemoryMap == 0) ||
-      (mMapLevel == 0) ||
-      (mMapLevel > GUARDED_HEAP_MAP_TABLE_DEPTH))
-  {
+  if (Batch->RunPages == 0) {
     return;
   }
 
+  if ((Batch->RangeList != NULL) && (Batch->RangeCount < Batch->RangeCapacity)) {
+    Batch->RangeList[Batch->RangeCount].Type          = EfiRuntimeServicesData;
+    Batch->RangeList[Batch->RangeCount].PhysicalStart = Batch->RunStart;
+    Batch->RangeList[Batch->RangeCount].NumberOfPages = Batch->RunPages;
+    Batch->RangeList[Batch->RangeCount].Attribute     = EFI_MEMORY_RP | EFI_MEMORY_SP;
+  } else if (Batch->ApplyRuns) {
+    Status = SmmSetMemoryAttributes (
+               Batch->RunStart,
+               EFI_PAGES_TO_SIZE (Batch->RunPages),
+               EFI_MEMORY_RP | EFI_MEMORY_SP
+               );
+    ASSERT_EFI_ERROR (Status);
+  }
+
+  Batch->RangeCount += 1;
+  Batch->GuardPages += Batch->RunPages;
+  Batch->RunPages    = 0;
+}
+
+/**
+  Add one Guard page to the batch. Pages must be added in ascending order, a
+  page adjacent to the current run extends it and a page already in the run is
+  ignored.
+
+  @param[in, out] Batch     The Guard page batch.
+  @param[in]      Address   Address of the Guard page.
+**/
+STATIC
+VOID
+AddGuardPageToBatch (
+  IN OUT GUARD_PAGE_BATCH      *Batch,
+  IN     EFI_PHYSICAL_ADDRESS  Address
+  )
+{
+  EFI_PHYSICAL_ADDRESS  RunEnd;
+
+  if (Batch->RunPages != 0) {
+    RunEnd = Batch->RunStart + EFI_PAGES_TO_SIZE (Batch->RunPages);
+    if (Address < RunEnd) {
+      return;
+    }
+
+    if (Address == RunEnd) {
+      Batch->RunPages += 1;
+      return;
+    }
+  }
+
+  CloseGuardPageRun (Batch);
+  Batch->RunStart = Address;
+  Batch->RunPages = 1;
+}
+
+/**
+  Add the Guard pages around the guarded memory tracked by one bitmap entry.
+
+  A Guard page is a page not guarded itself but next to a guarded one. The
+  Guard pages of a whole entry are derived with a few word operations, and
+  only the set bits of the result are visited.
+
+  @param[in, out] Batch       The Guard page batch.
+  @param[in]      TableEntry  The bitmap entry.
+  @param[in]      Address     Address of the page tracked by bit 0 of TableEntry.
+**/
+STATIC
+VOID
+AddGuardPagesOfEntry (
+  IN OUT GUARD_PAGE_BATCH      *Batch,
+  IN     UINT64                TableEntry,
+  IN     EFI_PHYSICAL_ADDRESS  Address
+  )
+{
+  UINT64  Guards;
+
+  //
+  // Head Guard of a block starting at bit 0 is the last page of the previous entry
+  //
+  if (((TableEntry & BIT0) != 0) && (Batch->PreviousBit == 0) && (Address != 0)) {
+    AddGuardPageToBatch (Batch, Address - EFI_PAGE_SIZE);
+  }
+
+  Guards = ~TableEntry & (LShiftU64 (TableEntry, 1) | RShiftU64 (TableEntry, 1) | Batch->PreviousBit);
+  while (Guards != 0) {
+    AddGuardPageToBatch (Batch, Address + EFI_PAGES_TO_SIZE ((UINTN)LowBitSet64 (Guards)));
+    Guards &= Guards - 1;
+  }
+
+  Batch->PreviousBit = RShiftU64 (TableEntry, GUARDED_HEAP_MAP_ENTRY_BITS - 1);
+}
+
+/**
+  Walk the guarded memory bitmap in ascending address order and add all Guard
+  pages it implies to the batch.
+
+  @param[in, out] Batch   The Guard page batch.
+**/
+STATIC
+VOID
+CollectAllGuardPages (
+  IN OUT GUARD_PAGE_BATCH  *Batch
+  )
+{
+  UINTN   Entries[GUARDED_HEAP_MAP_TABLE_DEPTH];
+  UINTN   Shifts[GUARDED_HEAP_MAP_TABLE_DEPTH];
+  UINTN   Indices[GUARDED_HEAP_MAP_TABLE_DEPTH];
+  UINT64  Tables[GUARDED_HEAP_MAP_TABLE_DEPTH];
+  UINT64  Addresses[GUARDED_HEAP_MAP_TABLE_DEPTH];
+  UINT64  TableEntry;
+  UINT64  Address;
+  INTN    Level;
+
   CopyMem (Entries, mLevelMask, sizeof (Entries));
   CopyMem (Shifts, mLevelShift, sizeof (Shifts));
 
@@ -1227,14 +1356,10 @@ SetAllGuardPages (
   SetMem (Addresses, sizeof (Addresses), 0);
   SetMem (Indices, sizeof (Indices), 0);
 
-  Level         = GUARDED_HEAP_MAP_TABLE_DEPTH - mMapLevel;
-  Tables[Level] = mGuardedMemoryMap;
-  Address       = 0;
-  OnGuarding    = FALSE;
-
-  DEBUG_CODE (
-    DumpGuardedMemoryBitmap ();
-    );
+  Level              = GUARDED_HEAP_MAP_TABLE_DEPTH - mMapLevel;
+  Tables[Level]      = mGuardedMemoryMap;
+  Address            = 0;
+  Batch->PreviousBit = 0;
 
   while (TRUE) {
     if (Indices[Level] > Entries[Level]) {
@@ -1245,7 +1370,15 @@ SetAllGuardPages (
       Address    = Addresses[Level];
 
       if (TableEntry == 0) {
-        OnGuarding = FALSE;
+        //
+        // Nothing guarded in this range, but its first page can still be the
+        // tail Guard of a block ending right before it
+        //
+        if (Batch->PreviousBit != 0) {
+          AddGuardPageToBatch (Batch, Address);
+        }
+
+        Batch->PreviousBit = 0;
       } else if (Level < GUARDED_HEAP_MAP_TABLE_DEPTH - 1) {
         Level           += 1;
         Tables[Level]    = TableEntry;
@@ -1254,38 +1387,7 @@ SetAllGuardPages (
 
         continue;
       } else {
-        Index = 0;
-        while (Index < GUARDED_HEAP_MAP_ENTRY_BITS) {
-          if ((TableEntry & 1) == 1) {
-            if (OnGuarding) {
-              GuardPage = 0;
-            } else {
-              GuardPage = Address - EFI_PAGE_SIZE;
-            }
-
-            OnGuarding = TRUE;
-          } else {
-            if (OnGuarding) {
-              GuardPage = Address;
-            } else {
-              GuardPage = 0;
-            }
-
-            OnGuarding = FALSE;
-          }
-
-          if (GuardPage != 0) {
-            SetGuardPage (GuardPage);
-          }
-
-          if (TableEntry == 0) {
-            break;
-          }
-
-          TableEntry = RShiftU64 (TableEntry, 1);
-          Address   += EFI_PAGE_SIZE;
-          Index     += 1;
-        }
+        AddGuardPagesOfEntry (Batch, TableEntry, Address);
       }
     }
 
@@ -1297,6 +1399,117 @@ SetAllGuardPages (
     Address          = (Level == 0) ? 0 : Addresses[Level - 1];
     Addresses[Level] = Address | LShiftU64 (Indices[Level], Shifts[Level]);
   }
+
+  CloseGuardPageRun (Batch);
+}
+
+/**
+  Set all Guard pages which cannot be set during the non-MM mode time.
+
+  Adjacent Guard pages are merged into runs and all runs are applied through
+  one page table pass, with a single TLB flush at the end. If that pass fails,
+  or the runs do not match the sized range list, every run of the batch is
+  applied on its own instead.
+
+  @param[out] GuardPages  Number of Guard pages set.
+  @param[out] GuardRuns   Number of runs the Guard pages were merged into.
+**/
+VOID
+SetAllGuardPages (
+  OUT UINTN  *GuardPages,
+  OUT UINTN  *GuardRuns
+  )
+{
+  GUARD_PAGE_BATCH  Batch;
+  UINTN             PageTableBase;
+  BOOLEAN           Enable5LevelPaging;
+  EFI_STATUS        Status;
+
+  *GuardPages = 0;
+  *GuardRuns  = 0;
+
+  if ((mGuardedMemoryMap == 0) ||
+      (mMapLevel == 0) ||
+      (mMapLevel > GUARDED_HEAP_MAP_TABLE_DEPTH))
+  {
+    return;
+  }
+
+  DEBUG_CODE (
+    DumpGuardedMemoryBitmap ();
+    );
+
+  //
+  // The range list itself must not be guarded, it would change the bitmap
+  // between the two passes
+  //
+  mOnGuarding = TRUE;
+
+  //
+  // First pass only sizes the range list
+  //
+  ZeroMem (&Batch, sizeof (Batch));
+  CollectAllGuardPages (&Batch);
+  if (Batch.RangeCount == 0) {
+    mOnGuarding = FALSE;
+    return;
+  }
+
+  Batch.RangeCapacity = Batch.RangeCount;
+  Batch.RangeList     = AllocatePool (Batch.RangeCapacity * sizeof (EFI_MEMORY_DESCRIPTOR));
+  Batch.RangeCount    = 0;
+  Batch.GuardPages    = 0;
+  if (Batch.RangeList == NULL) {
+    //
+    // Still merged into runs, but every run is applied on its own
+    //
+    DEBUG ((DEBUG_WARN, "%a - No room for 0x%x Guard runs, applying them one by one\n", __FUNCTION__, Batch.RangeCapacity));
+    Batch.ApplyRuns = TRUE;
+  }
+
+  CollectAllGuardPages (&Batch);
+
+  if (Batch.RangeList != NULL) {
+    if (Batch.RangeCount != Batch.RangeCapacity) {
+      //
+      // Runs beyond the capacity were neither recorded nor applied, and missing
+      // runs leave entries of the range list unset
+      //
+      DEBUG ((
+        DEBUG_ERROR,
+        "%a - Guard bitmap changed between passes, 0x%x runs found for 0x%x sized\n",
+        __FUNCTION__,
+        Batch.RangeCount,
+        Batch.RangeCapacity
+        ));
+      ASSERT (FALSE);
+      Status = EFI_BAD_BUFFER_SIZE;
+    } else {
+      GetPageTable (&PageTableBase, &Enable5LevelPaging);
+      Status = SmmSetMemoryAttributesBulk (PageTableBase, Enable5LevelPaging, Batch.RangeList, Batch.RangeCount, NULL);
+      if (EFI_ERROR (Status)) {
+        DEBUG ((DEBUG_ERROR, "%a - Failed to apply 0x%x Guard runs in one pass - %r\n", __FUNCTION__, Batch.RangeCount, Status));
+      }
+    }
+
+    FreePool (Batch.RangeList);
+
+    if (EFI_ERROR (Status)) {
+      //
+      // Fall back to setting every run on its own, the runs already set are
+      // left as they are
+      //
+      DEBUG ((DEBUG_WARN, "%a - Applying the Guard runs one by one\n", __FUNCTION__));
+      ZeroMem (&Batch, sizeof (Batch));
+      Batch.ApplyRuns = TRUE;
+      CollectAllGuardPages (&Batch);
+    }
+  }
+
+  mOnGuarding = FALSE;
+
+  *GuardPages = Batch.GuardPages;
+  *GuardRuns  = Batch.RangeCount;
 }
 
 /**
@@ -1307,8 +1520,24 @@ MmEntryPointMemoryManagementHook (
   VOID
   )
 {
+  UINT64  StartTicker;
+  UINT64  EndTicker;
+  UINTN   GuardPages;
+  UINTN   GuardRuns;
+
   // MU_CHANGE: MM_SUPV: Directly set guard pages without locating gEdkiiSmmMemoryAttributeProtocolGuid
-  SetAllGuardPages ();
+  StartTicker = GetPerformanceCounter ();
+  SetAllGuardPages (&GuardPages, &GuardRuns);
+  EndTicker = GetPerformanceCounter ();
+
+  DEBUG ((
+    DEBUG_INFO,
+    "%a - 0x%x Guard pages in 0x%x runs set in %ldus\n",
+    __FUNCTION__,
+    GuardPages,
+    GuardRuns,
+    DivU64x32 (GetTimeInNanoSecond (EndTicker - StartTicker), 1000)
+    ));
 }
 
 /**
@@ -170,6 +170,21 @@ typedef struct {
   LIST_ENTRY              Link;
 } HEAP_GUARD_NODE;
 
+//
+// Guard pages collected from the guarded memory bitmap, merged into runs of
+// adjacent pages before they are applied to the page table
+//
+typedef struct {
+  EFI_MEMORY_DESCRIPTOR    *RangeList;
+  UINTN                    RangeCapacity;
+  UINTN                    RangeCount;
+  UINTN                    GuardPages;
+  EFI_PHYSICAL_ADDRESS     RunStart;
+  UINTN                    RunPages;
+  UINT64                   PreviousBit;
+  BOOLEAN                  ApplyRuns;
+} GUARD_PAGE_BATCH;
+
 /**
   Set head Guard and tail Guard for the given memory range.
 
@@ -145,7 +145,21 @@ typedef struct {
   UINTN    FreePages;
 } PAGE_TABLE_POOL;
 
-extern PAGE_TABLE_POOL  mPageTablePoolEx;
+//
+// Page table pool usage, reported through MM_SUPERVISOR_REQUEST_PAGE_TABLE_USAGE.
+//
+typedef struct {
+  UINTN    EstimatedPages;     // Pages estimated for the page tables built at initialization
+  UINTN    ReservedPages;      // Pages of all page table pools, including their headers
+  UINTN    UsedPages;          // Pages handed out from the page table pools
+  UINTN    PoolCount;          // Number of page table pools, more than 1 when the estimate fell short
+  UINTN    ExEstimatedPages;   // Pages estimated for splitting large pages into 4KB pages
+  UINTN    ExReservedPages;    // Pages of the extended page table pool
+  UINTN    ExFailedRequests;   // Allocations the extended page table pool could not satisfy
+} PAGE_TABLE_POOL_USAGE;
+
+extern PAGE_TABLE_POOL        mPageTablePoolEx;
+extern PAGE_TABLE_POOL_USAGE  mPageTablePoolUsage;
 
 //
 // Copy of the PcdPteMemoryEncryptionAddressOrMask
@@ -331,6 +345,92 @@ SmmClearMemoryAttributesEx (
   OUT BOOLEAN               *IsSplitted  OPTIONAL
   );
 
+/**
+  This function converts the attributes of all memory regions in a sorted range list, building the
+  final page table in one top-down pass instead of walking it from the root for each region.
+
+  Each entry of RangeList describes one region by PhysicalStart and NumberOfPages, and carries the
+  bit mask of attributes to set for this region in Attribute. The attributes in AttributeMask that
+  are not in Attribute are cleared for this region, so that a caller can describe the final state
+  of several attributes at once. The Type field is ignored. Entries must be sorted by PhysicalStart
+  and must not overlap.
+
+  The resulting page table is identical to the one produced by calling SmmSetMemoryAttributesEx
+  and then SmmClearMemoryAttributesEx for each range in order. TLB is flushed once at the end if
+  the page table is modified, also when the conversion fails part way.
+
+  @param[in]   PageTableBase    The page table base.
+  @param[in]   EnablePML5Paging If PML5 paging is enabled.
+  @param[in]   RangeList        The list of memory regions and their attributes.
+  @param[in]   RangeCount       The number of entries in RangeList.
+  @param[in]   AttributeMask    The bit mask of attributes whose final state is described by the
+                                Attribute of each region. 0 to only set attributes.
+  @param[out]  IsSplitted       TRUE means page table splitted. FALSE means page table not splitted.
+
+  @retval EFI_SUCCESS           The attributes were converted for all memory regions.
+  @retval EFI_INVALID_PARAMETER RangeList is NULL while RangeCount is not zero.
+                                One of the regions has zero length, is not page aligned, or
+                                overlaps with the previous region.
+                                Attributes specified an illegal combination of attributes, or
+                                attributes outside of a non zero AttributeMask.
+  @retval EFI_OUT_OF_RESOURCES  There are not enough system resources to modify the attributes of
+                                the memory regions.
+  @retval EFI_UNSUPPORTED       The processor does not support one or more bytes of the memory
+                                regions in the list.
+  @retval EFI_SECURITY_VIOLATION The bulk page table does not match the per range page table. Only
+                                 returned when PcdMmSupervisorBulkPageTableVerify is enabled.
+
+**/
+EFI_STATUS
+SmmConvertMemoryAttributesBulk (
+  IN  UINTN                        PageTableBase,
+  IN  BOOLEAN                      EnablePML5Paging,
+  IN  CONST EFI_MEMORY_DESCRIPTOR  *RangeList,
+  IN  UINTN                        RangeCount,
+  IN  UINT64                       AttributeMask,
+  OUT BOOLEAN                      *IsSplitted  OPTIONAL
+  );
+
+/**
+  This function sets the attributes for all memory regions in a sorted range list, building the
+  final page table in one top-down pass instead of walking it from the root for each region.
+
+  Each entry of RangeList describes one region by PhysicalStart and NumberOfPages, and carries the
+  bit mask of attributes to set for this region in Attribute. The Type field is ignored. Entries
+  must be sorted by PhysicalStart and must not overlap.
+
+  The resulting page table is identical to the one produced by calling SmmSetMemoryAttributesEx
+  for each range in order. TLB is flushed once at the end if the page table is modified, also
+  when the conversion fails part way.
+
+  @param[in]   PageTableBase    The page table base.
+  @param[in]   EnablePML5Paging If PML5 paging is enabled.
+  @param[in]   RangeList        The list of memory regions and their attributes.
+  @param[in]   RangeCount       The number of entries in RangeList.
+  @param[out]  IsSplitted       TRUE means page table splitted. FALSE means page table not splitted.
+
+  @retval EFI_SUCCESS           The attributes were set for all memory regions.
+  @retval EFI_INVALID_PARAMETER RangeList is NULL while RangeCount is not zero.
+                                One of the regions has zero length, is not page aligned, or
+                                overlaps with the previous region.
+                                Attributes specified an illegal combination of attributes.
+  @retval EFI_OUT_OF_RESOURCES  There are not enough system resources to modify the attributes of
+                                the memory regions.
+  @retval EFI_UNSUPPORTED       The processor does not support one or more bytes of the memory
+                                regions in the list.
+  @retval EFI_SECURITY_VIOLATION The bulk page table does not match the per range page table. Only
+                                 returned when PcdMmSupervisorBulkPageTableVerify is enabled.
+
+**/
+EFI_STATUS
+SmmSetMemoryAttributesBulk (
+  IN  UINTN                        PageTableBase,
+  IN  BOOLEAN                      EnablePML5Paging,
+  IN  CONST EFI_MEMORY_DESCRIPTOR  *RangeList,
+  IN  UINTN                        RangeCount,
+  OUT BOOLEAN                      *IsSplitted  OPTIONAL
+  );
+
 /**
   This function sets the attributes for the memory region specified by BaseAddress and
   Length from their current attributes to the attributes specified by Attributes.
@@ -464,6 +564,20 @@ SmmGetMemoryAttributes (
   IN  UINT64                *Attributes
   );
 
+/**
+  Initialize a buffer pool for page table use only.
+
+  @param PoolPages  The least page number of the pool to be created.
+
+  @retval TRUE    The pool is initialized successfully.
+  @retval FALSE   The memory is out of resource.
+
+**/
+BOOLEAN
+InitializePageTablePool (
+  IN UINTN  PoolPages
+  );
+
 /**
   This API provides a way to allocate memory for page table.
 
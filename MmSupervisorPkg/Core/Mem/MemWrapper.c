@@ -43,6 +43,7 @@ AllocateExtendedPageTableMemory (
     return Buffer;
   }
 
+  mPageTablePoolUsage.ExFailedRequests++;
   return NULL;
 }
 
@@ -588,6 +588,46 @@ InternalAllocAddress (
   return ~Address;
 }
 
+/**
+  Apply the page attributes of freshly allocated pages once the page table is in place.
+
+  @param[in]  Memory          The base of the pages.
+  @param[in]  NumberOfPages   The number of pages.
+  @param[in]  MemoryType      EfiRuntimeServicesCode or EfiRuntimeServicesData.
+  @param[in]  SupervisorPage  If the pages are owned by supervisor.
+
+**/
+STATIC
+VOID
+ApplyAllocatedPageAttributes (
+  IN EFI_PHYSICAL_ADDRESS  Memory,
+  IN UINTN                 NumberOfPages,
+  IN EFI_MEMORY_TYPE       MemoryType,
+  IN BOOLEAN               SupervisorPage
+  )
+{
+  if (!mCoreInitializationComplete) {
+    return;
+  }
+
+  if (MemoryType == EfiRuntimeServicesCode) {
+    SmmClearMemoryAttributes (Memory, EFI_PAGES_TO_SIZE (NumberOfPages), EFI_MEMORY_XP);
+    // We should only allow supervisor initiated request propagate through here
+    SmmClearMemoryAttributes (Memory, EFI_PAGES_TO_SIZE (NumberOfPages), EFI_MEMORY_RO);
+  } else {
+    // EfiRuntimeServicesData
+    SmmClearMemoryAttributes (Memory, EFI_PAGES_TO_SIZE (NumberOfPages), EFI_MEMORY_RO);
+    SmmSetMemoryAttributes (Memory, EFI_PAGES_TO_SIZE (NumberOfPages), EFI_MEMORY_XP);
+  }
+
+  if (SupervisorPage) {
+    SmmSetMemoryAttributes (Memory, EFI_PAGES_TO_SIZE (NumberOfPages), EFI_MEMORY_SP);
+  } else {
+    // EfiRuntimeServicesData
+    SmmClearMemoryAttributes (Memory, EFI_PAGES_TO_SIZE (NumberOfPages), EFI_MEMORY_SP);
+  }
+}
+
 /**
   Allocates pages from the memory map.
 
@@ -689,24 +729,7 @@ MmInternalAllocatePagesEx (
   }
 
 ApplyPageAttributes:
-  if (mCoreInitializationComplete) {
-    if (MemoryType == EfiRuntimeServicesCode) {
-      SmmClearMemoryAttributes (*Memory, EFI_PAGES_TO_SIZE (NumberOfPages), EFI_MEMORY_XP);
-      // We should only allow supervisor initiated request propagate through here
-      SmmClearMemoryAttributes (*Memory, EFI_PAGES_TO_SIZE (NumberOfPages), EFI_MEMORY_RO);
-    } else {
-      // EfiRuntimeServicesData
-      SmmClearMemoryAttributes (*Memory, EFI_PAGES_TO_SIZE (NumberOfPages), EFI_MEMORY_RO);
-      SmmSetMemoryAttributes (*Memory, EFI_PAGES_TO_SIZE (NumberOfPages), EFI_MEMORY_XP);
-    }
-
-    if (SupervisorPage) {
-      SmmSetMemoryAttributes (*Memory, EFI_PAGES_TO_SIZE (NumberOfPages), EFI_MEMORY_SP);
-    } else {
-      // EfiRuntimeServicesData
-      SmmClearMemoryAttributes (*Memory, EFI_PAGES_TO_SIZE (NumberOfPages), EFI_MEMORY_SP);
-    }
-  }
+  ApplyAllocatedPageAttributes (*Memory, NumberOfPages, MemoryType, SupervisorPage);
 
   return EFI_SUCCESS;
 }
@@ -1151,6 +1174,44 @@ MmAddMemoryRegion (
   CoreFreeMemoryMapStack ();
 }
 
+/**
+  Change the type and the owner of pages in an MMRAM region that was already allocated when it
+  was added, such as the range reserved by the IPL for the code of images loaded at fixed address.
+  These pages never go through the free page list, so only their memory map entries and their
+  page attributes are updated, the same way as if they were allocated.
+
+  @param[in]  Memory          The base of the pages.
+  @param[in]  NumberOfPages   The number of pages.
+  @param[in]  MemoryType      EfiRuntimeServicesCode or EfiRuntimeServicesData.
+  @param[in]  SupervisorPage  TRUE to hand the pages to supervisor, FALSE to hand them to users.
+
+  @retval EFI_SUCCESS             The pages are converted.
+  @retval EFI_INVALID_PARAMETER   The memory type is not supported, Memory is not page aligned
+                                  or NumberOfPages is zero.
+
+**/
+EFI_STATUS
+MmConvertAllocatedPages (
+  IN EFI_PHYSICAL_ADDRESS  Memory,
+  IN UINTN                 NumberOfPages,
+  IN EFI_MEMORY_TYPE       MemoryType,
+  IN BOOLEAN               SupervisorPage
+  )
+{
+  if (((MemoryType != EfiRuntimeServicesCode) && (MemoryType != EfiRuntimeServicesData)) ||
+      ((Memory & EFI_PAGE_MASK) != 0) || (NumberOfPages == 0))
+  {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  ConvertMmMemoryMapEntry (MemoryType, Memory, NumberOfPages, FALSE, SupervisorPage);
+  CoreFreeMemoryMapStack ();
+
+  ApplyAllocatedPageAttributes (Memory, NumberOfPages, MemoryType, SupervisorPage);
+
+  return EFI_SUCCESS;
+}
+
 /**
   This function returns a copy of the current memory map. The map is an array of
   memory descriptors, each of which describes a contiguous block of memory.
@@ -12,6 +12,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Register/Cpuid.h>
 #include <Protocol/MpService.h>
 #include <Protocol/SmmConfiguration.h>
+#include <Guid/MmSupervisorRequestData.h>
 
 #include <Library/BaseLib.h>
 #include <Library/SmmCpuPlatformHookLib.h>
@@ -425,6 +426,155 @@ Done:
   return Status;
 }
 
+/**
+  Estimate the number of pages used by the page tables SmmInitPageTable builds, mirroring the
+  allocations of Gen4GPageTable and SetStaticPageTable.
+
+  @return The estimated number of pages.
+
+**/
+STATIC
+UINTN
+EstimateInitialPageTablePages (
+  VOID
+  )
+{
+  UINTN  Pages;
+  UINTN  AddressBits;
+  UINTN  NumberOfPml5EntriesNeeded;
+  UINTN  NumberOfPml4EntriesNeeded;
+  UINTN  NumberOfPdpEntriesNeeded;
+  UINTN  NumberOfPml4Entries;
+
+  //
+  // Gen4GPageTable: one PDPT and four page directories for the first 4GB, the page tables of the
+  // stack guard pages and the page table hiding page 0. Then the PML4, and the PML5 if needed.
+  //
+  Pages = 5 + 1;
+  if (FeaturePcdGet (PcdCpuSmmStackGuard)) {
+    Pages += (mSmmStackArrayEnd - mSmmStackArrayBase) / SIZE_2MB + 2;
+  }
+
+  Pages += m5LevelPagingNeeded ? 2 : 1;
+
+  if (!mCpuSmmRestrictedMemoryAccess) {
+    return Pages + PAGE_TABLE_PAGES;
+  }
+
+  AddressBits = mPhysicalAddressBits;
+  if (!m5LevelPagingNeeded && (AddressBits > 48)) {
+    AddressBits = 48;
+  }
+
+  NumberOfPml5EntriesNeeded = 1;
+  if (AddressBits > 48) {
+    NumberOfPml5EntriesNeeded = (UINTN)LShiftU64 (1, AddressBits - 48);
+    AddressBits               = 48;
+  }
+
+  NumberOfPml4EntriesNeeded = 1;
+  if (AddressBits > 39) {
+    NumberOfPml4EntriesNeeded = (UINTN)LShiftU64 (1, AddressBits - 39);
+    AddressBits               = 39;
+  }
+
+  if (AddressBits <= 30) {
+    return Pages;
+  }
+
+  NumberOfPdpEntriesNeeded = (UINTN)LShiftU64 (1, AddressBits - 30);
+
+  //
+  // SetStaticPageTable: the first PML4 and the first PDPT are already allocated above.
+  //
+  NumberOfPml4Entries = (NumberOfPml5EntriesNeeded == 1) ? NumberOfPml4EntriesNeeded : NumberOfPml5EntriesNeeded * 512;
+  Pages              += (NumberOfPml5EntriesNeeded - 1) + (NumberOfPml4Entries - 1);
+  if (!m1GPageTableSupport) {
+    //
+    // One page directory per 1GB above 4GB.
+    //
+    Pages += NumberOfPml4Entries * ((NumberOfPml4EntriesNeeded == 1) ? NumberOfPdpEntriesNeeded : 512) - 4;
+  }
+
+  return Pages;
+}
+
+/**
+  Estimate the number of page tables needed to map a range with 4KB pages.
+
+  @param[in]  Base        Base address of the range.
+  @param[in]  Length      Length of the range in bytes.
+  @param[in]  EdgesOnly   TRUE if only the 2MB and 1GB pages at both ends of the range get
+                          split, FALSE if every large page of the range may get split.
+
+  @return The estimated number of pages.
+
+**/
+STATIC
+UINTN
+EstimateRangeSplitPages (
+  IN EFI_PHYSICAL_ADDRESS  Base,
+  IN UINT64                Length,
+  IN BOOLEAN               EdgesOnly
+  )
+{
+  UINT64  Count2M;
+  UINT64  Count1G;
+
+  if ((Length == 0) || (Base + Length < Base)) {
+    return 0;
+  }
+
+  Count2M = RShiftU64 (ALIGN_VALUE (Base + Length, SIZE_2MB) - (Base & ~((UINT64)SIZE_2MB - 1)), 21);
+  Count1G = RShiftU64 (ALIGN_VALUE (Base + Length, SIZE_1GB) - (Base & ~((UINT64)SIZE_1GB - 1)), 30);
+  if (EdgesOnly) {
+    Count2M = MIN (Count2M, 2);
+    Count1G = MIN (Count1G, 2);
+  }
+
+  return (UINTN)(Count2M + Count1G);
+}
+
+/**
+  Estimate the number of pages the extended page table pool needs to split large pages, from
+  the MMRAM ranges and the unblock region HOBs. All of MMRAM may end up with 4KB pages, while
+  the unblocked regions only split the large pages at their edges.
+
+  @return The estimated number of pages.
+
+**/
+STATIC
+UINTN
+EstimateSplitPageTablePages (
+  VOID
+  )
+{
+  UINTN                                Pages;
+  UINTN                                Index;
+  EFI_PEI_HOB_POINTERS                 GuidHob;
+  MM_SUPERVISOR_UNBLOCK_MEMORY_PARAMS  *UnblockRegionHob;
+
+  Pages = 0;
+  for (Index = 0; Index < mMmramRangeCount; Index++) {
+    Pages += EstimateRangeSplitPages (mMmramRanges[Index].CpuStart, mMmramRanges[Index].PhysicalSize, FALSE);
+  }
+
+  GuidHob.Guid = GetFirstGuidHob (&gMmUnblockRegionHobGuid);
+  while (GuidHob.Guid != NULL) {
+    UnblockRegionHob = GET_GUID_HOB_DATA (GuidHob.Guid);
+    Pages           += EstimateRangeSplitPages (
+                         UnblockRegionHob->MemoryDescriptor.PhysicalStart,
+                         EFI_PAGES_TO_SIZE (UnblockRegionHob->MemoryDescriptor.NumberOfPages),
+                         TRUE
+                         );
+
+    GuidHob.Guid = GET_NEXT_HOB (GuidHob);
+    GuidHob.Guid = GetNextGuidHob (&gMmUnblockRegionHobGuid, GuidHob.Guid);
+  }
+
+  return Pages;
+}
+
 /**
   Create PageTable for SMM use.
 
@@ -451,29 +601,51 @@ SmmInitPageTable (
   //
   InitializeSpinLock (mPFLock);
 
+  mCpuSmmRestrictedMemoryAccess = PcdGetBool (PcdCpuSmmRestrictedMemoryAccess);
+  m1GPageTableSupport           = Is1GPageSupport ();
+  m5LevelPagingNeeded           = Is5LevelPagingNeeded ();
+  mPhysicalAddressBits          = CalculateMaximumSupportAddress ();
+  PatchInstructionX86 (gPatch5LevelPagingNeeded, m5LevelPagingNeeded, 1);
+  DEBUG ((DEBUG_INFO, "5LevelPaging Needed             - %d\n", m5LevelPagingNeeded));
+  DEBUG ((DEBUG_INFO, "1GPageTable Support             - %d\n", m1GPageTableSupport));
+  DEBUG ((DEBUG_INFO, "PcdCpuSmmRestrictedMemoryAccess - %d\n", mCpuSmmRestrictedMemoryAccess));
+  DEBUG ((DEBUG_INFO, "PhysicalAddressBits             - %d\n", mPhysicalAddressBits));
+
+  //
+  // Reserve a single pool for all the page tables built below, so that they do not spread
+  // over several pools that each need their own protection later on. The pool still grows
+  // if the estimate falls short.
+  //
+  mPageTablePoolUsage.EstimatedPages = EstimateInitialPageTablePages ();
+  if (!InitializePageTablePool (mPageTablePoolUsage.EstimatedPages)) {
+    DEBUG ((DEBUG_ERROR, "%a Failed to reserve 0x%x pages for page tables!!!\n", __FUNCTION__, mPageTablePoolUsage.EstimatedPages));
+    ASSERT (FALSE);
+  }
+
   //
   // Allocate extension page table for split usage just in case, this data will have
-  // supervisor page and xp attribute when MAT is applied
+  // supervisor page and xp attribute when MAT is applied. The previous fixed size stays
+  // as the floor, for the splits at the edges of the non-MMRAM memory map found later on.
   //
+  mPageTablePoolUsage.ExEstimatedPages = EstimateSplitPageTablePages ();
+  mPageTablePoolUsage.ExReservedPages  = MAX (mPageTablePoolUsage.ExEstimatedPages, PAGE_TABLE_POOL_EX_UNIT_PAGES);
   ZeroMem (&mPageTablePoolEx, sizeof (mPageTablePoolEx));
-  mPageTablePoolEx.NextPool = AllocateAlignedPages (PAGE_TABLE_POOL_EX_UNIT_PAGES, EFI_PAGE_SIZE);
+  mPageTablePoolEx.NextPool = AllocateAlignedPages (mPageTablePoolUsage.ExReservedPages, EFI_PAGE_SIZE);
   if (mPageTablePoolEx.NextPool == NULL) {
     DEBUG ((DEBUG_ERROR, "Failed to initialize page table pool!\n"));
+    mPageTablePoolUsage.ExReservedPages = 0;
     ASSERT (FALSE);
   }
 
   DEBUG ((DEBUG_INFO, "Allcoated page table pool at %p\n", mPageTablePoolEx.NextPool));
-  mPageTablePoolEx.FreePages = PAGE_TABLE_POOL_EX_UNIT_PAGES;
-
-  mCpuSmmRestrictedMemoryAccess = PcdGetBool (PcdCpuSmmRestrictedMemoryAccess);
-  m1GPageTableSupport           = Is1GPageSupport ();
-  m5LevelPagingNeeded           = Is5LevelPagingNeeded ();
-  mPhysicalAddressBits          = CalculateMaximumSupportAddress ();
-  PatchInstructionX86 (gPatch5LevelPagingNeeded, m5LevelPagingNeeded, 1);
-  DEBUG ((DEBUG_INFO, "5LevelPaging Needed             - %d\n", m5LevelPagingNeeded));
-  DEBUG ((DEBUG_INFO, "1GPageTable Support             - %d\n", m1GPageTableSupport));
-  DEBUG ((DEBUG_INFO, "PcdCpuSmmRestrictedMemoryAccess - %d\n", mCpuSmmRestrictedMemoryAccess));
-  DEBUG ((DEBUG_INFO, "PhysicalAddressBits             - %d\n", mPhysicalAddressBits));
+  mPageTablePoolEx.FreePages = mPageTablePoolUsage.ExReservedPages;
+  DEBUG ((
+    DEBUG_INFO,
+    "Page table pools - 0x%x pages estimated, 0x%x pages reserved for splits (0x%x estimated)\n",
+    mPageTablePoolUsage.EstimatedPages,
+    mPageTablePoolUsage.ExReservedPages,
+    mPageTablePoolUsage.ExEstimatedPages
+    ));
   //
   // Generate PAE page table for the first 4GB memory space
   //
@@ -35,6 +35,13 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #define EFI_MEMORY_INITIALIZED  0x0200000000000000ULL
 #define EFI_MEMORY_TESTED       0x0400000000000000ULL
 
+//
+// Pages probed around each range when verifying a bulk conversion: the page before the range,
+// the first and the last page of the range, and the page after the range.
+//
+#define BULK_VERIFY_PROBE_COUNT  4
+#define BULK_VERIFY_UNMAPPED     MAX_UINT64
+
 #define PREVIOUS_MEMORY_DESCRIPTOR(MemoryDescriptor, Size) \
   ((EFI_MEMORY_DESCRIPTOR *)((UINT8 *)(MemoryDescriptor) - (Size)))
 
@@ -73,6 +80,11 @@ UINTN                  mInitMemoryMapSize  = 0;
 //
 PAGE_TABLE_POOL  *mPageTablePool = NULL;
 
+//
+// Usage of the page table pools, see PAGE_TABLE_POOL_USAGE.
+//
+PAGE_TABLE_POOL_USAGE  mPageTablePoolUsage;
+
 //
 // If memory used by SMM page table has been mareked as ReadOnly.
 //
@@ -86,9 +98,10 @@ BOOLEAN  mIsReadOnlyPageTable = FALSE;
   at the boundary of PAGE_TABLE_POOL_ALIGNMENT. So the page pool is always
   initialized with number of pages greater than or equal to the given PoolPages.
 
-  Once the pages in the pool are used up, this method should be called again to
-  reserve at least another PAGE_TABLE_POOL_UNIT_PAGES. But usually this won't
-  happen in practice.
+  SmmInitPageTable reserves the first pool for the estimated demand of all the
+  page tables built during initialization. Once the pages in the pool are used
+  up, this method should be called again to reserve at least another
+  PAGE_TABLE_POOL_UNIT_PAGES. But usually this won't happen in practice.
 
   @param PoolPages  The least page number of the pool to be created.
 
@@ -137,6 +150,19 @@ InitializePageTablePool (
   mPageTablePool->FreePages = PoolPages - 1;
   mPageTablePool->Offset    = EFI_PAGES_TO_SIZE (1);
 
+  mPageTablePoolUsage.ReservedPages += PoolPages;
+  mPageTablePoolUsage.PoolCount++;
+  if (mPageTablePoolUsage.PoolCount > 1) {
+    DEBUG ((
+      DEBUG_WARN,
+      "%a Page table pool %d added, 0x%x pages reserved against 0x%x estimated\n",
+      __FUNCTION__,
+      mPageTablePoolUsage.PoolCount,
+      mPageTablePoolUsage.ReservedPages,
+      mPageTablePoolUsage.EstimatedPages
+      ));
+  }
+
   //
   // If page table memory has been marked as RO, mark the new pool pages as read-only.
   //
@@ -223,6 +249,8 @@ AllocatePageTableMemory (
   mPageTablePool->Offset    += EFI_PAGES_TO_SIZE (Pages);
   mPageTablePool->FreePages -= Pages;
 
+  mPageTablePoolUsage.UsedPages += Pages;
+
   return Buffer;
 }
 
@@ -947,6 +975,587 @@ SmmClearMemoryAttributes (
   return SmmClearMemoryAttributesEx (PageTableBase, Enable5LevelPaging, BaseAddress, Length, Attributes, NULL);
 }
 
+/**
+  Convert the attributes of all page entries in one page table that overlap with the sorted
+  range list, starting from the range pointed by RangeIndex.
+
+  An entry fully covered by the current range is converted in place, no matter whether it is
+  a 4K, 2M or 1G page. A leaf entry that is only partially covered is split one level down and
+  the new table is processed recursively. This produces the same page table structure as applying
+  ConvertMemoryPageAttributes to each range in order, but every table is visited only once.
+
+  @param[in]      PageTable        The page table to be converted.
+  @param[in]      Level            Paging level of PageTable, 1 for 4K page table, up to 5 for PML5.
+  @param[in]      TableBase        The address mapped by the first entry of PageTable.
+  @param[in]      RangeList        The range list sorted by PhysicalStart, ranges do not overlap.
+  @param[in]      RangeCount       The number of entries in RangeList.
+  @param[in]      AttributeMask    The attributes in this mask that are not in the Attribute of a
+                                   range are cleared for the range. 0 to only set attributes.
+  @param[in, out] RangeIndex       On input, the first range that is not fully converted. On output,
+                                   the first range that is not fully converted within PageTable.
+  @param[in, out] IsSplitted       Set to TRUE if any page entry is splitted.
+  @param[in, out] IsModified       Set to TRUE if the page table is modified.
+
+  @retval RETURN_SUCCESS           The ranges overlapping with PageTable were converted.
+  @retval RETURN_UNSUPPORTED       One of the ranges is not mapped in the page table, or the page
+                                   entry does not support to be splitted.
+  @retval RETURN_OUT_OF_RESOURCES  No resource to split page entry.
+**/
+STATIC
+RETURN_STATUS
+ConvertPageTableRanges (
+  IN     UINT64                       *PageTable,
+  IN     UINTN                        Level,
+  IN     PHYSICAL_ADDRESS             TableBase,
+  IN     CONST EFI_MEMORY_DESCRIPTOR  *RangeList,
+  IN     UINTN                        RangeCount,
+  IN     UINT64                       AttributeMask,
+  IN OUT UINTN                        *RangeIndex,
+  IN OUT BOOLEAN                      *IsSplitted,
+  IN OUT BOOLEAN                      *IsModified
+  )
+{
+  UINTN             Shift;
+  UINT64            EntrySize;
+  PHYSICAL_ADDRESS  TableEnd;
+  PHYSICAL_ADDRESS  Address;
+  PHYSICAL_ADDRESS  RangeStart;
+  PHYSICAL_ADDRESS  RangeEnd;
+  PHYSICAL_ADDRESS  EntryBase;
+  UINTN             Index;
+  UINT64            *PageEntry;
+  UINT64            ClearAttributes;
+  BOOLEAN           IsLeaf;
+  BOOLEAN           IsEntryModified;
+  RETURN_STATUS     Status;
+
+  Shift     = EFI_PAGE_SHIFT + 9 * (Level - 1);
+  EntrySize = LShiftU64 (1, Shift);
+  TableEnd  = TableBase + LShiftU64 (EntrySize, 9);
+  Address   = TableBase;
+
+  while (Address < TableEnd) {
+    //
+    // Skip the ranges that have been fully converted
+    //
+    while ((*RangeIndex < RangeCount) &&
+           (RangeList[*RangeIndex].PhysicalStart + EFI_PAGES_TO_SIZE (RangeList[*RangeIndex].NumberOfPages) <= Address))
+    {
+      (*RangeIndex)++;
+    }
+
+    if (*RangeIndex >= RangeCount) {
+      break;
+    }
+
+    RangeStart = RangeList[*RangeIndex].PhysicalStart;
+    RangeEnd   = RangeStart + EFI_PAGES_TO_SIZE (RangeList[*RangeIndex].NumberOfPages);
+    if (RangeStart >= TableEnd) {
+      break;
+    }
+
+    //
+    // Jump to the entry covering the next address to be converted
+    //
+    Index     = (UINTN)RShiftU64 (MAX (RangeStart, Address) - TableBase, Shift) & PAGING_PAE_INDEX_MASK;
+    EntryBase = TableBase + LShiftU64 (Index, Shift);
+    PageEntry = &PageTable[Index];
+
+    //
+    // Same as GetPageTableEntry, a zero 4K entry is only legitimate for address 0
+    //
+    if ((*PageEntry == 0) && ((Level != 1) || (EntryBase != 0))) {
+      return RETURN_UNSUPPORTED;
+    }
+
+    IsLeaf = (BOOLEAN)((Level == 1) || (((Level == 2) || (Level == 3)) && ((*PageEntry & IA32_PG_PS) != 0)));
+    if (IsLeaf) {
+      if ((RangeStart <= EntryBase) && (RangeEnd >= EntryBase + EntrySize)) {
+        if (RangeList[*RangeIndex].Attribute != 0) {
+          ConvertPageEntryAttribute (PageEntry, RangeList[*RangeIndex].Attribute, TRUE, &IsEntryModified);
+          if (IsEntryModified) {
+            *IsModified = TRUE;
+          }
+        }
+
+        ClearAttributes = AttributeMask & ~RangeList[*RangeIndex].Attribute;
+        if (ClearAttributes != 0) {
+          ConvertPageEntryAttribute (PageEntry, ClearAttributes, FALSE, &IsEntryModified);
+          if (IsEntryModified) {
+            *IsModified = TRUE;
+          }
+        }
+
+        Address = EntryBase + EntrySize;
+        continue;
+      }
+
+      //
+      // Only partially covered, split it and convert the new table below
+      //
+      if (Level == 1) {
+        return RETURN_UNSUPPORTED;
+      }
+
+      Status = SplitPage (PageEntry, (Level == 3) ? Page1G : Page2M, (Level == 3) ? Page2M : Page4K);
+      if (RETURN_ERROR (Status)) {
+        return Status;
+      }
+
+      *IsSplitted = TRUE;
+      *IsModified = TRUE;
+    }
+
+    Status = ConvertPageTableRanges (
+               (UINT64 *)(UINTN)(*PageEntry & ~mAddressEncMask & PAGING_4K_ADDRESS_MASK_64),
+               Level - 1,
+               EntryBase,
+               RangeList,
+               RangeCount,
+               AttributeMask,
+               RangeIndex,
+               IsSplitted,
+               IsModified
+               );
+    if (RETURN_ERROR (Status)) {
+      return Status;
+    }
+
+    Address = EntryBase + EntrySize;
+  }
+
+  return RETURN_SUCCESS;
+}
+
+/**
+  Get the address of one of the pages probed around a range when verifying a bulk conversion.
+
+  @param[in]   Range            The range to probe around.
+  @param[in]   Probe            The probe, less than BULK_VERIFY_PROBE_COUNT.
+  @param[out]  Address          The address of the probed page.
+
+  @retval TRUE    Address is returned.
+  @retval FALSE   The probed page is beyond the supported address space.
+**/
+STATIC
+BOOLEAN
+GetBulkProbeAddress (
+  IN  CONST EFI_MEMORY_DESCRIPTOR  *Range,
+  IN  UINTN                        Probe,
+  OUT PHYSICAL_ADDRESS             *Address
+  )
+{
+  PHYSICAL_ADDRESS  RangeEnd;
+
+  RangeEnd = Range->PhysicalStart + EFI_PAGES_TO_SIZE (Range->NumberOfPages);
+  switch (Probe) {
+    case 0:
+      if (Range->PhysicalStart == 0) {
+        return FALSE;
+      }
+
+      *Address = Range->PhysicalStart - SIZE_4KB;
+      break;
+    case 1:
+      *Address = Range->PhysicalStart;
+      break;
+    case 2:
+      *Address = RangeEnd - SIZE_4KB;
+      break;
+    default:
+      if (RangeEnd > (EFI_PHYSICAL_ADDRESS)(UINTN)(LShiftU64 (1, mPhysicalAddressBits) - 1)) {
+        return FALSE;
+      }
+
+      *Address = RangeEnd;
+      break;
+  }
+
+  return TRUE;
+}
+
+/**
+  Read the attributes of the pages probed around each range of a bulk conversion.
+
+  @param[in]   PageTableBase    The page table base.
+  @param[in]   EnablePML5Paging If PML5 paging is enabled.
+  @param[in]   RangeList        The range list sorted by PhysicalStart.
+  @param[in]   RangeCount       The number of entries in RangeList.
+  @param[out]  Probes           BULK_VERIFY_PROBE_COUNT attributes for each range, or
+                                BULK_VERIFY_UNMAPPED if the probed page is not mapped.
+**/
+STATIC
+VOID
+ReadBulkProbes (
+  IN  UINTN                        PageTableBase,
+  IN  BOOLEAN                      EnablePML5Paging,
+  IN  CONST EFI_MEMORY_DESCRIPTOR  *RangeList,
+  IN  UINTN                        RangeCount,
+  OUT UINT64                       *Probes
+  )
+{
+  UINTN             Index;
+  UINTN             Probe;
+  PHYSICAL_ADDRESS  Address;
+  UINT64            *PageEntry;
+  PAGE_ATTRIBUTE    PageAttribute;
+
+  for (Index = 0; Index < RangeCount; Index++) {
+    for (Probe = 0; Probe < BULK_VERIFY_PROBE_COUNT; Probe++) {
+      *Probes = BULK_VERIFY_UNMAPPED;
+      if (GetBulkProbeAddress (&RangeList[Index], Probe, &Address)) {
+        PageEntry = GetPageTableEntry (PageTableBase, EnablePML5Paging, Address, &PageAttribute);
+        if ((PageEntry != NULL) && (PageAttribute != PageNone)) {
+          *Probes = GetAttributesFromPageEntry (PageEntry);
+        }
+      }
+
+      Probes++;
+    }
+  }
+}
+
+/**
+  Compare the pages probed around each range after a bulk conversion with the ones read before it.
+
+  A probed page inside one of the ranges must have the attributes of that range set, the ones in
+  AttributeMask that are not in the range cleared, and all other attributes unchanged. A probed
+  page outside of the ranges must be left as it was. This does not rely on either the bulk or the
+  per range conversion, so it catches neighboring entries that both would leave alone.
+
+  @param[in]   PageTableBase    The page table base.
+  @param[in]   EnablePML5Paging If PML5 paging is enabled.
+  @param[in]   RangeList        The range list sorted by PhysicalStart, ranges do not overlap.
+  @param[in]   RangeCount       The number of entries in RangeList.
+  @param[in]   AttributeMask    The AttributeMask of the bulk conversion.
+  @param[in]   Probes           The probes read by ReadBulkProbes before the conversion.
+
+  @retval EFI_SUCCESS             All probed pages have the expected attributes.
+  @retval EFI_SECURITY_VIOLATION  One of the probed pages does not.
+**/
+STATIC
+EFI_STATUS
+VerifyBulkProbes (
+  IN  UINTN                        PageTableBase,
+  IN  BOOLEAN                      EnablePML5Paging,
+  IN  CONST EFI_MEMORY_DESCRIPTOR  *RangeList,
+  IN  UINTN                        RangeCount,
+  IN  UINT64                       AttributeMask,
+  IN  CONST UINT64                 *Probes
+  )
+{
+  UINTN             Index;
+  UINTN             Probe;
+  UINTN             Candidate;
+  PHYSICAL_ADDRESS  Address;
+  UINT64            Expected;
+  UINT64            *PageEntry;
+  PAGE_ATTRIBUTE    PageAttribute;
+  UINT64            Current;
+
+  for (Index = 0; Index < RangeCount; Index++) {
+    for (Probe = 0; Probe < BULK_VERIFY_PROBE_COUNT; Probe++, Probes++) {
+      if (!GetBulkProbeAddress (&RangeList[Index], Probe, &Address)) {
+        continue;
+      }
+
+      //
+      // Only the range itself and its direct neighbors in the sorted list can hold a probed page
+      //
+      Expected = *Probes;
+      if (Expected != BULK_VERIFY_UNMAPPED) {
+        for (Candidate = (Index == 0) ? 0 : Index - 1; (Candidate <= Index + 1) && (Candidate < RangeCount); Candidate++) {
+          if ((Address >= RangeList[Candidate].PhysicalStart) &&
+              (Address < RangeList[Candidate].PhysicalStart + EFI_PAGES_TO_SIZE (RangeList[Candidate].NumberOfPages)))
+          {
+            Expected = (Expected & ~AttributeMask) | RangeList[Candidate].Attribute;
+            break;
+          }
+        }
+      }
+
+      Current   = BULK_VERIFY_UNMAPPED;
+      PageEntry = GetPageTableEntry (PageTableBase, EnablePML5Paging, Address, &PageAttribute);
+      if ((PageEntry != NULL) && (PageAttribute != PageNone)) {
+        Current = GetAttributesFromPageEntry (PageEntry);
+      }
+
+      if (Current != Expected) {
+        DEBUG ((
+          DEBUG_ERROR,
+          "%a - Page 0x%lx around range 0x%lx has attributes 0x%lx, expected 0x%lx\n",
+          __FUNCTION__,
+          Address,
+          RangeList[Index].PhysicalStart,
+          Current,
+          Expected
+          ));
+        return EFI_SECURITY_VIOLATION;
+      }
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  This function converts the attributes of all memory regions in a sorted range list, building the
+  final page table in one top-down pass instead of walking it from the root for each region.
+
+  Each entry of RangeList describes one region by PhysicalStart and NumberOfPages, and carries the
+  bit mask of attributes to set for this region in Attribute. The attributes in AttributeMask that
+  are not in Attribute are cleared for this region, so that a caller can describe the final state
+  of several attributes at once. The Type field is ignored. Entries must be sorted by PhysicalStart
+  and must not overlap.
+
+  The resulting page table is identical to the one produced by calling SmmSetMemoryAttributesEx
+  and then SmmClearMemoryAttributesEx for each range in order. TLB is flushed once at the end if
+  the page table is modified, also when the conversion fails part way.
+
+  @param[in]   PageTableBase    The page table base.
+  @param[in]   EnablePML5Paging If PML5 paging is enabled.
+  @param[in]   RangeList        The list of memory regions and their attributes.
+  @param[in]   RangeCount       The number of entries in RangeList.
+  @param[in]   AttributeMask    The bit mask of attributes whose final state is described by the
+                                Attribute of each region. 0 to only set attributes.
+  @param[out]  IsSplitted       TRUE means page table splitted. FALSE means page table not splitted.
+
+  @retval EFI_SUCCESS           The attributes were converted for all memory regions.
+  @retval EFI_INVALID_PARAMETER RangeList is NULL while RangeCount is not zero.
+                                One of the regions has zero length, is not page aligned, or
+                                overlaps with the previous region.
+                                Attributes specified an illegal combination of attributes, or
+                                attributes outside of a non zero AttributeMask.
+  @retval EFI_OUT_OF_RESOURCES  There are not enough system resources to modify the attributes of
+                                the memory regions.
+  @retval EFI_UNSUPPORTED       The processor does not support one or more bytes of the memory
+                                regions in the list.
+  @retval EFI_SECURITY_VIOLATION The bulk page table does not match the per range page table. Only
+                                 returned when PcdMmSupervisorBulkPageTableVerify is enabled.
+
+**/
+EFI_STATUS
+SmmConvertMemoryAttributesBulk (
+  IN  UINTN                        PageTableBase,
+  IN  BOOLEAN                      EnablePML5Paging,
+  IN  CONST EFI_MEMORY_DESCRIPTOR  *RangeList,
+  IN  UINTN                        RangeCount,
+  IN  UINT64                       AttributeMask,
+  OUT BOOLEAN                      *IsSplitted  OPTIONAL
+  )
+{
+  EFI_STATUS            Status;
+  UINTN                 Index;
+  UINTN                 RangeIndex;
+  UINT64                ClearAttributes;
+  BOOLEAN               Splitted;
+  BOOLEAN               Modified;
+  EFI_PHYSICAL_ADDRESS  MaximumSupportMemAddress;
+  EFI_PHYSICAL_ADDRESS  PreviousEnd;
+  UINT64                *Probes;
+
+  ASSERT (
+    (mCoreInitializationComplete && mInternalCr3 == 0) ||
+    (!mCoreInitializationComplete && mInternalCr3 != 0)
+    );
+
+  if (IsSplitted != NULL) {
+    *IsSplitted = FALSE;
+  }
+
+  if (RangeCount == 0) {
+    return EFI_SUCCESS;
+  }
+
+  if ((RangeList == NULL) || ((AttributeMask & ~EFI_MEMORY_ATTRIBUTE_MASK) != 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // Validate the whole list upfront, so that nothing is converted for a malformed list
+  //
+  MaximumSupportMemAddress = (EFI_PHYSICAL_ADDRESS)(UINTN)(LShiftU64 (1, mPhysicalAddressBits) - 1);
+  PreviousEnd              = 0;
+  for (Index = 0; Index < RangeCount; Index++) {
+    if (((RangeList[Index].Attribute | AttributeMask) == 0) ||
+        ((RangeList[Index].Attribute & ~EFI_MEMORY_ATTRIBUTE_MASK) != 0) ||
+        ((AttributeMask != 0) && ((RangeList[Index].Attribute & ~AttributeMask) != 0)) ||
+        (RangeList[Index].NumberOfPages == 0) ||
+        ((RangeList[Index].PhysicalStart & (SIZE_4KB - 1)) != 0) ||
+        ((Index != 0) && (RangeList[Index].PhysicalStart < PreviousEnd)))
+    {
+      DEBUG ((DEBUG_ERROR, "%a - Invalid range 0x%lx of 0x%lx pages at index 0x%x\n", __FUNCTION__, RangeList[Index].PhysicalStart, RangeList[Index].NumberOfPages, Index));
+      return EFI_INVALID_PARAMETER;
+    }
+
+    if ((RangeList[Index].PhysicalStart > MaximumSupportMemAddress) ||
+        (RangeList[Index].NumberOfPages > EFI_SIZE_TO_PAGES (MaximumSupportMemAddress - RangeList[Index].PhysicalStart + 1)))
+    {
+      return EFI_UNSUPPORTED;
+    }
+
+    PreviousEnd = RangeList[Index].PhysicalStart + EFI_PAGES_TO_SIZE (RangeList[Index].NumberOfPages);
+  }
+
+  Probes = NULL;
+  if (FeaturePcdGet (PcdMmSupervisorBulkPageTableVerify)) {
+    //
+    // The per range replay below only proves that the ranges reached their final state. Record
+    // the pages at both ends of every range and next to them, so that attributes outside of
+    // AttributeMask and entries outside of the ranges are checked against the original as well.
+    //
+    Probes = AllocatePool (RangeCount * BULK_VERIFY_PROBE_COUNT * sizeof (UINT64));
+    if (Probes == NULL) {
+      DEBUG ((DEBUG_WARN, "%a - No resource to probe the range boundaries, they are not verified\n", __FUNCTION__));
+    } else {
+      ReadBulkProbes (PageTableBase, EnablePML5Paging, RangeList, RangeCount, Probes);
+    }
+  }
+
+  Splitted   = FALSE;
+  Modified   = FALSE;
+  RangeIndex = 0;
+  Status     = (EFI_STATUS)ConvertPageTableRanges (
+                             (UINT64 *)PageTableBase,
+                             EnablePML5Paging ? 5 : 4,
+                             0,
+                             RangeList,
+                             RangeCount,
+                             AttributeMask,
+                             &RangeIndex,
+                             &Splitted,
+                             &Modified
+                             );
+
+  if (IsSplitted != NULL) {
+    *IsSplitted = Splitted;
+  }
+
+  if (Modified) {
+    //
+    // Flush TLB as last step, the entries converted before a failure are live as well
+    //
+    FlushTlbForAll ();
+  }
+
+  if (EFI_ERROR (Status)) {
+    goto Exit;
+  }
+
+  if (FeaturePcdGet (PcdMmSupervisorBulkPageTableVerify)) {
+    //
+    // Replay the per range path on top of the bulk result. If the bulk builder produced the
+    // same page table, the per range path has nothing left to split or convert.
+    //
+    for (Index = 0; Index < RangeCount; Index++) {
+      Status   = EFI_SUCCESS;
+      Splitted = FALSE;
+      Modified = FALSE;
+      if (RangeList[Index].Attribute != 0) {
+        Status = (EFI_STATUS)ConvertMemoryPageAttributes (
+                               PageTableBase,
+                               EnablePML5Paging,
+                               RangeList[Index].PhysicalStart,
+                               EFI_PAGES_TO_SIZE (RangeList[Index].NumberOfPages),
+                               RangeList[Index].Attribute,
+                               TRUE,
+                               &Splitted,
+                               &Modified
+                               );
+      }
+
+      ClearAttributes = AttributeMask & ~RangeList[Index].Attribute;
+      if (!EFI_ERROR (Status) && !Splitted && !Modified && (ClearAttributes != 0)) {
+        Status = (EFI_STATUS)ConvertMemoryPageAttributes (
+                               PageTableBase,
+                               EnablePML5Paging,
+                               RangeList[Index].PhysicalStart,
+                               EFI_PAGES_TO_SIZE (RangeList[Index].NumberOfPages),
+                               ClearAttributes,
+                               FALSE,
+                               &Splitted,
+                               &Modified
+                               );
+      }
+
+      if (EFI_ERROR (Status) || Splitted || Modified) {
+        DEBUG ((
+          DEBUG_ERROR,
+          "%a - Bulk page table mismatch for range 0x%lx of 0x%lx pages - %r, Splitted %d, Modified %d\n",
+          __FUNCTION__,
+          RangeList[Index].PhysicalStart,
+          RangeList[Index].NumberOfPages,
+          Status,
+          Splitted,
+          Modified
+          ));
+        ASSERT (FALSE);
+        if (Modified) {
+          FlushTlbForAll ();
+        }
+
+        Status = EFI_SECURITY_VIOLATION;
+        goto Exit;
+      }
+    }
+
+    if (Probes != NULL) {
+      Status = VerifyBulkProbes (PageTableBase, EnablePML5Paging, RangeList, RangeCount, AttributeMask, Probes);
+      ASSERT_EFI_ERROR (Status);
+    }
+  }
+
+Exit:
+  if (Probes != NULL) {
+    FreePool (Probes);
+  }
+
+  return Status;
+}
+
+/**
+  This function sets the attributes for all memory regions in a sorted range list, building the
+  final page table in one top-down pass instead of walking it from the root for each region.
+
+  Each entry of RangeList describes one region by PhysicalStart and NumberOfPages, and carries the
+  bit mask of attributes to set for this region in Attribute. The Type field is ignored. Entries
+  must be sorted by PhysicalStart and must not overlap.
+
+  The resulting page table is identical to the one produced by calling SmmSetMemoryAttributesEx
+  for each range in order. TLB is flushed once at the end if the page table is modified, also
+  when the conversion fails part way.
+
+  @param[in]   PageTableBase    The page table base.
+  @param[in]   EnablePML5Paging If PML5 paging is enabled.
+  @param[in]   RangeList        The list of memory regions and their attributes.
+  @param[in]   RangeCount       The number of entries in RangeList.
+  @param[out]  IsSplitted       TRUE means page table splitted. FALSE means page table not splitted.
+
+  @retval EFI_SUCCESS           The attributes were set for all memory regions.
+  @retval EFI_INVALID_PARAMETER RangeList is NULL while RangeCount is not zero.
+                                One of the regions has zero length, is not page aligned, or
+                                overlaps with the previous region.
+                                Attributes specified an illegal combination of attributes.
+  @retval EFI_OUT_OF_RESOURCES  There are not enough system resources to modify the attributes of
+                                the memory regions.
+  @retval EFI_UNSUPPORTED       The processor does not support one or more bytes of the memory
+                                regions in the list.
+  @retval EFI_SECURITY_VIOLATION The bulk page table does not match the per range page table. Only
+                                 returned when PcdMmSupervisorBulkPageTableVerify is enabled.
+
+**/
+EFI_STATUS
+SmmSetMemoryAttributesBulk (
+  IN  UINTN                        PageTableBase,
+  IN  BOOLEAN                      EnablePML5Paging,
+  IN  CONST EFI_MEMORY_DESCRIPTOR  *RangeList,
+  IN  UINTN                        RangeCount,
+  OUT BOOLEAN                      *IsSplitted  OPTIONAL
+  )
+{
+  return SmmConvertMemoryAttributesBulk (PageTableBase, EnablePML5Paging, RangeList, RangeCount, 0, IsSplitted);
+}
+
 /**
   This function sets the read only attributes of GDT pages of currently executing CPU.
 
@@ -1364,6 +1973,16 @@ PatchMmUserSpecialPurposeRegion (
              );
   ASSERT_EFI_ERROR (Status);
 
+  // HOB index is optional, but has to be as protected as the HOB list it describes
+  if (mMmHobIndex != NULL) {
+    Status = SmmSetMemoryAttributes (
+               (EFI_PHYSICAL_ADDRESS)(UINTN)mMmHobIndex,
+               (mMmHobIndexSize + EFI_PAGE_MASK) & ~EFI_PAGE_MASK,
+               (EFI_MEMORY_RO | EFI_MEMORY_XP)
+               );
+    ASSERT_EFI_ERROR (Status);
+  }
+
   DEBUG ((DEBUG_INFO, "%a - Exit - %r\n", __FUNCTION__, Status));
 }
 
@@ -1829,6 +2448,42 @@ CoalesceHobMemory (
   return EFI_SUCCESS;
 }
 
+/**
+  Helper function to append a region to the list of non-MM memory regions to be marked as not present.
+
+  @param[in, out] RangeList           The list of regions, sorted by start address.
+  @param[in, out] RangeCount          The number of regions in RangeList.
+  @param[in]      Start               The start address of the region.
+  @param[in]      Length              The length of the region in bytes.
+  @param[in]      Type                EfiMemoryMappedIO if the region should be unblocked after being marked
+                                      as not present, EfiReservedMemoryType otherwise.
+
+  @retval EFI_SUCCESS                 The region is added to the list.
+  @retval EFI_INVALID_PARAMETER       The region has zero length or the length is not EFI_PAGE_SIZE aligned.
+**/
+STATIC
+EFI_STATUS
+AddNonSmmRange (
+  IN OUT EFI_MEMORY_DESCRIPTOR  *RangeList,
+  IN OUT UINTN                  *RangeCount,
+  IN     EFI_PHYSICAL_ADDRESS   Start,
+  IN     UINT64                 Length,
+  IN     EFI_MEMORY_TYPE        Type
+  )
+{
+  if ((Length == 0) || ((Length & EFI_PAGE_MASK) != 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  RangeList[*RangeCount].Type          = Type;
+  RangeList[*RangeCount].PhysicalStart = Start;
+  RangeList[*RangeCount].NumberOfPages = EFI_SIZE_TO_PAGES (Length);
+  RangeList[*RangeCount].Attribute     = EFI_MEMORY_RP;
+  (*RangeCount)++;
+
+  return EFI_SUCCESS;
+}
+
 /*
 Helper function to mark all non SMM memory ranges reported through hobs as non present
 */
@@ -1844,8 +2499,15 @@ SetNonSmmMemMapAttributes (
   EFI_STATUS                           Status;
   MM_SUPERVISOR_UNBLOCK_MEMORY_PARAMS  UnblockRegionParams;
   EFI_PHYSICAL_ADDRESS                 MaximumSupportMemAddress;
+  EFI_MEMORY_DESCRIPTOR                *RangeList;
+  UINTN                                RangeCount;
+  UINTN                                RangeIndex;
+  UINTN                                PageTableBase;
+  BOOLEAN                              Enable5LevelPaging;
 
   TempBuffer = NULL;
+  RangeList  = NULL;
+  RangeCount = 0;
   Status     = CoalesceHobMemory (&TempBuffer, &MemIdx);
   if (EFI_ERROR (Status)) {
     DEBUG ((DEBUG_ERROR, "%a - Coalesce hob memory overlap failed, unable to proceed - %r\n", __FUNCTION__, Status));
@@ -1869,9 +2531,17 @@ SetNonSmmMemMapAttributes (
     goto Exit;
   }
 
+  // All non-MM regions are collected during the scanning and marked as not present in one pass afterwards,
+  // each address point contributes at most one region, plus the one below the first address point.
+  RangeList = AllocateZeroPool (sizeof (EFI_MEMORY_DESCRIPTOR) * (MemIdx + 1));
+  if (RangeList == NULL) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Exit;
+  }
+
   // Brute force coverage extension, this portion covers range from 0 to first published hob
   if (TempBuffer[0].Address != 0) {
-    Status = SmmSetMemoryAttributes (0, TempBuffer[0].Address, EFI_MEMORY_RP);
+    Status = AddNonSmmRange (RangeList, &RangeCount, 0, TempBuffer[0].Address, EfiReservedMemoryType);
     if (EFI_ERROR (Status)) {
       DEBUG ((DEBUG_ERROR, "%a - Marking memory region 0 - 0x%x failed - %r\n", __FUNCTION__, TempBuffer[0].Address, Status));
       goto Exit;
@@ -1914,10 +2584,12 @@ SetNonSmmMemMapAttributes (
             TempBuffer[Index-1].Address,
             TempBuffer[Index].Address - TempBuffer[Index-1].Address
             ));
-          Status = SmmSetMemoryAttributes (
+          Status = AddNonSmmRange (
+                     RangeList,
+                     &RangeCount,
                      TempBuffer[Index-1].Address,
                      TempBuffer[Index].Address - TempBuffer[Index-1].Address,
-                     EFI_MEMORY_RP
+                     EfiReservedMemoryType
                      );
           if (EFI_ERROR (Status)) {
             goto Exit;
@@ -1952,10 +2624,12 @@ SetNonSmmMemMapAttributes (
             TempBuffer[Index-1].Address,
             TempBuffer[Index].Address - TempBuffer[Index-1].Address
             ));
-          Status = SmmSetMemoryAttributes (
+          Status = AddNonSmmRange (
+                     RangeList,
+                     &RangeCount,
                      TempBuffer[Index-1].Address,
                      TempBuffer[Index].Address - TempBuffer[Index-1].Address,
-                     EFI_MEMORY_RP
+                     EfiReservedMemoryType
                      );
           if (EFI_ERROR (Status)) {
             goto Exit;
@@ -2023,10 +2697,12 @@ SetNonSmmMemMapAttributes (
             TempBuffer[Index-1].Address,
             TempBuffer[Index].Address - TempBuffer[Index-1].Address
             ));
-          Status = SmmSetMemoryAttributes (
+          Status = AddNonSmmRange (
+                     RangeList,
+                     &RangeCount,
                      TempBuffer[Index-1].Address,
                      TempBuffer[Index].Address - TempBuffer[Index-1].Address,
-                     EFI_MEMORY_RP
+                     EfiReservedMemoryType
                      );
         }
 
@@ -2067,10 +2743,12 @@ SetNonSmmMemMapAttributes (
             TempBuffer[Index-1].Address,
             TempBuffer[Index].Address - TempBuffer[Index-1].Address
             ));
-          Status = SmmSetMemoryAttributes (
+          Status = AddNonSmmRange (
+                     RangeList,
+                     &RangeCount,
                      (TempBuffer[Index-1].Address + EFI_PAGE_SIZE - 1) & ~(EFI_PAGE_SIZE -1),
                      TempBuffer[Index].Address - ((TempBuffer[Index-1].Address + EFI_PAGE_SIZE - 1) & ~(EFI_PAGE_SIZE -1)),
-                     EFI_MEMORY_RP
+                     EfiReservedMemoryType
                      );
           if (EFI_ERROR (Status)) {
             goto Exit;
@@ -2103,25 +2781,17 @@ SetNonSmmMemMapAttributes (
           TempBuffer[Index-1].Address,
           TempBuffer[Index].Address - TempBuffer[Index-1].Address
           ));
-        Status = SmmSetMemoryAttributes (
+        Status = AddNonSmmRange (
+                   RangeList,
+                   &RangeCount,
                    TempBuffer[Index-1].Address,
                    (TempBuffer[Index].Address - TempBuffer[Index-1].Address + EFI_PAGE_SIZE - 1) & ~(EFI_PAGE_SIZE -1),
-                   EFI_MEMORY_RP
+                   EfiMemoryMappedIO
                    );
         if (EFI_ERROR (Status)) {
           goto Exit;
         }
 
-        ZeroMem (&UnblockRegionParams, sizeof (UnblockRegionParams));
-        CopyMem (&UnblockRegionParams.IdentifierGuid, &gEfiCallerIdGuid, sizeof (EFI_GUID));
-        UnblockRegionParams.MemoryDescriptor.PhysicalStart = TempBuffer[Index-1].Address;
-        UnblockRegionParams.MemoryDescriptor.NumberOfPages = EFI_SIZE_TO_PAGES ((TempBuffer[Index].Address - TempBuffer[Index-1].Address + EFI_PAGE_SIZE - 1) & ~(EFI_PAGE_SIZE -1));
-        Status                                             = ProcessUnblockPages (&UnblockRegionParams);
-        if (EFI_ERROR (Status)) {
-          DEBUG ((DEBUG_ERROR, "%a - Failed to mark Supervisor common buffer as unblocked - %r\n", __FUNCTION__, Status));
-          ASSERT (FALSE);
-        }
-
         break;
       default:
         // Should not happen...
@@ -2135,18 +2805,49 @@ SetNonSmmMemMapAttributes (
   MaximumSupportMemAddress = (EFI_PHYSICAL_ADDRESS)(UINTN)(LShiftU64 (1, mPhysicalAddressBits) - 1);
   if (MaximumSupportMemAddress >= TempBuffer[MemIdx - 1].Address) {
     DEBUG ((DEBUG_INFO, "%a - Marking top of memory region 0x%lx - 0x%lx\n", __FUNCTION__, TempBuffer[MemIdx - 1].Address, MaximumSupportMemAddress + 1));
-    Status = SmmSetMemoryAttributes (TempBuffer[MemIdx - 1].Address, MaximumSupportMemAddress - TempBuffer[MemIdx - 1].Address + 1, EFI_MEMORY_RP);
+    Status = AddNonSmmRange (RangeList, &RangeCount, TempBuffer[MemIdx - 1].Address, MaximumSupportMemAddress - TempBuffer[MemIdx - 1].Address + 1, EfiReservedMemoryType);
     if (EFI_ERROR (Status)) {
       DEBUG ((DEBUG_ERROR, "%a - Marking top of memory region 0x%lx - MaximumSupportMemAddress failed - %r\n", __FUNCTION__, TempBuffer[MemIdx - 1].Address, Status));
       goto Exit;
     }
   }
 
+  // Now mark all the collected regions as not present in one pass through the page table
+  GetPageTable (&PageTableBase, &Enable5LevelPaging);
+  Status = SmmSetMemoryAttributesBulk (PageTableBase, Enable5LevelPaging, RangeList, RangeCount, NULL);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a - Marking 0x%x non-MM regions as not present failed - %r\n", __FUNCTION__, RangeCount, Status));
+    goto Exit;
+  }
+
+  // Only after the special regions are blocked, they can be unblocked as data pages
+  for (RangeIndex = 0; RangeIndex < RangeCount; RangeIndex++) {
+    if (RangeList[RangeIndex].Type != EfiMemoryMappedIO) {
+      continue;
+    }
+
+    ZeroMem (&UnblockRegionParams, sizeof (UnblockRegionParams));
+    CopyMem (&UnblockRegionParams.IdentifierGuid, &gEfiCallerIdGuid, sizeof (EFI_GUID));
+    UnblockRegionParams.MemoryDescriptor.PhysicalStart = RangeList[RangeIndex].PhysicalStart;
+    UnblockRegionParams.MemoryDescriptor.NumberOfPages = RangeList[RangeIndex].NumberOfPages;
+    Status                                             = ProcessUnblockPages (&UnblockRegionParams);
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_ERROR, "%a - Failed to mark Supervisor common buffer as unblocked - %r\n", __FUNCTION__, Status));
+      ASSERT (FALSE);
+    }
+  }
+
+  Status = EFI_SUCCESS;
+
 Exit:
   if (TempBuffer != NULL) {
     FreePool (TempBuffer);
   }
 
+  if (RangeList != NULL) {
+    FreePool (RangeList);
+  }
+
   if (EFI_ERROR (Status)) {
     DEBUG ((DEBUG_ERROR, "%a - Some step in setting the non MMRAM memory has gone wrong - %r!!!\n", __FUNCTION__, Status));
     ASSERT_EFI_ERROR (Status);
@@ -2311,6 +3012,9 @@ SetUnblockRegionAttribute (
 
 /**
   Prevent the memory pages used for SMM page table from being overwritten.
+
+  The pools are normally a single reservation, so this is a single attribute update. Pools
+  added after the estimate fell short are merged with their neighbors when they are adjacent.
 **/
 VOID
 EnablePageTableProtection (
@@ -2321,6 +3025,8 @@ EnablePageTableProtection (
   PAGE_TABLE_POOL       *Pool;
   UINT64                PoolSize;
   EFI_PHYSICAL_ADDRESS  Address;
+  EFI_PHYSICAL_ADDRESS  RangeStart;
+  EFI_PHYSICAL_ADDRESS  RangeEnd;
   UINTN                 PageTableBase;
   BOOLEAN               LockPageTableToReadOnly;
   UINTN                 PageTableAttr;
@@ -2343,17 +3049,30 @@ EnablePageTableProtection (
   // ConvertMemoryPageAttributes might update mPageTablePool. It's safer to
   // remember original one in advance.
   //
-  HeadPool = mPageTablePool;
-  Pool     = HeadPool;
+  HeadPool   = mPageTablePool;
+  Pool       = HeadPool;
+  RangeStart = (EFI_PHYSICAL_ADDRESS)(UINTN)Pool;
+  RangeEnd   = RangeStart;
   do {
     Address  = (EFI_PHYSICAL_ADDRESS)(UINTN)Pool;
     PoolSize = Pool->Offset + EFI_PAGES_TO_SIZE (Pool->FreePages);
-    //
-    // Set entire pool including header, used-memory and left free-memory as ReadOnly in SMM page table.
-    //
-    ConvertMemoryPageAttributes (PageTableBase, m5LevelPagingNeeded, Address, PoolSize, PageTableAttr, TRUE, NULL, NULL);
+    if (Address == RangeEnd) {
+      RangeEnd += PoolSize;
+    } else if (Address + PoolSize == RangeStart) {
+      RangeStart = Address;
+    } else {
+      //
+      // Set entire pool including header, used-memory and left free-memory as ReadOnly in SMM page table.
+      //
+      ConvertMemoryPageAttributes (PageTableBase, m5LevelPagingNeeded, RangeStart, RangeEnd - RangeStart, PageTableAttr, TRUE, NULL, NULL);
+      RangeStart = Address;
+      RangeEnd   = Address + PoolSize;
+    }
+
     Pool = Pool->NextPool;
   } while (Pool != HeadPool);
+
+  ConvertMemoryPageAttributes (PageTableBase, m5LevelPagingNeeded, RangeStart, RangeEnd - RangeStart, PageTableAttr, TRUE, NULL, NULL);
 }
 
 /**
@@ -158,19 +158,14 @@ GetCpuIndex (
   VOID
   )
 {
-  UINTN   Index;
-  UINT32  ApicId;
-
-  ApicId = GetApicId ();
+  UINTN  Index;
 
-  for (Index = 0; Index < mMaxNumberOfCpus; Index++) {
-    if (gSmmCpuPrivate->ProcessorInfo[Index].ProcessorId == ApicId) {
-      return Index;
-    }
+  if (EFI_ERROR (SmmWhoAmI (NULL, &Index))) {
+    ASSERT (FALSE);
+    return 0;
   }
 
-  ASSERT (FALSE);
-  return 0;
+  return Index;
 }
 
 /**
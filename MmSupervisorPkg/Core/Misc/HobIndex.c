@@ -0,0 +1,102 @@
+/** @file
+  Build the read-only HOB index over the HOB list published to MM environment.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <PiMm.h>
+
+#include <Library/SortLib.h>
+#include <Library/MmHobIndexLib.h>
+
+#include "MmSupervisorCore.h"
+
+MM_HOB_INDEX  *mMmHobIndex    = NULL;
+UINTN         mMmHobIndexSize = 0;
+
+/**
+  Build the HOB index over the HOB list published to MM environment. The index is
+  allocated as code pages so that it will be read only in MM, same as the HOB list.
+
+  @param[in]  HobStart      Start of the published HOB list.
+  @param[in]  HobSize       Size of the published HOB list, including the end of list HOB.
+
+  @retval EFI_SUCCESS             The HOB index is successfully built.
+  @retval EFI_ALREADY_STARTED     The HOB index has already been built.
+  @retval EFI_INVALID_PARAMETER   HobStart is NULL or HobSize cannot be indexed.
+  @retval EFI_OUT_OF_RESOURCES    Cannot allocate enough resource for the HOB index.
+
+**/
+EFI_STATUS
+BuildHobIndex (
+  IN VOID   *HobStart,
+  IN UINTN  HobSize
+  )
+{
+  EFI_STATUS               Status;
+  EFI_PEI_HOB_POINTERS     Hob;
+  MM_HOB_INDEX             *HobIndex;
+  MM_HOB_INDEX_GUID_ENTRY  *GuidEntries;
+  UINTN                    GuidCount;
+  UINTN                    IndexSize;
+  UINTN                    Index;
+
+  if (mMmHobIndex != NULL) {
+    return EFI_ALREADY_STARTED;
+  }
+
+  // Offsets are recorded as UINT32 in the per type table
+  if ((HobStart == NULL) || (HobSize == 0) || (HobSize > MAX_UINT32)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  GuidCount = 0;
+  for (Hob.Raw = HobStart; !END_OF_HOB_LIST (Hob); Hob.Raw = GET_NEXT_HOB (Hob)) {
+    if (Hob.Header->HobType == EFI_HOB_TYPE_GUID_EXTENSION) {
+      GuidCount++;
+    }
+  }
+
+  IndexSize = sizeof (MM_HOB_INDEX) + GuidCount * sizeof (MM_HOB_INDEX_GUID_ENTRY);
+  Status    = MmAllocatePages (AllocateAnyPages, EfiRuntimeServicesCode, EFI_SIZE_TO_PAGES (IndexSize), (EFI_PHYSICAL_ADDRESS *)&HobIndex);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a Failed to allocate HOB index of 0x%x bytes - %r\n", __FUNCTION__, IndexSize, Status));
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  ZeroMem (HobIndex, IndexSize);
+  HobIndex->Signature      = MM_HOB_INDEX_SIGNATURE;
+  HobIndex->GuidEntryCount = (UINT32)GuidCount;
+  HobIndex->HobListStart   = (EFI_PHYSICAL_ADDRESS)(UINTN)HobStart;
+  HobIndex->HobListSize    = HobSize;
+  for (Index = 0; Index < MM_HOB_INDEX_TYPE_COUNT; Index++) {
+    HobIndex->FirstHobOffset[Index] = MM_HOB_INDEX_NO_HOB;
+  }
+
+  GuidEntries = (MM_HOB_INDEX_GUID_ENTRY *)(HobIndex + 1);
+  Index       = 0;
+  for (Hob.Raw = HobStart; !END_OF_HOB_LIST (Hob); Hob.Raw = GET_NEXT_HOB (Hob)) {
+    if ((Hob.Header->HobType < MM_HOB_INDEX_TYPE_COUNT) &&
+        (HobIndex->FirstHobOffset[Hob.Header->HobType] == MM_HOB_INDEX_NO_HOB))
+    {
+      HobIndex->FirstHobOffset[Hob.Header->HobType] = (UINT32)(Hob.Raw - (UINT8 *)HobStart);
+    }
+
+    if (Hob.Header->HobType == EFI_HOB_TYPE_GUID_EXTENSION) {
+      CopyGuid (&GuidEntries[Index].Name, &Hob.Guid->Name);
+      GuidEntries[Index].HobOffset = (UINT64)(Hob.Raw - (UINT8 *)HobStart);
+      Index++;
+    }
+  }
+
+  PerformQuickSort (GuidEntries, GuidCount, sizeof (MM_HOB_INDEX_GUID_ENTRY), MmHobIndexCompareGuidEntry);
+
+  mMmHobIndex     = HobIndex;
+  mMmHobIndexSize = IndexSize;
+
+  DEBUG ((DEBUG_INFO, "%a Indexed %d GUID HOBs at 0x%p\n", __FUNCTION__, GuidCount, HobIndex));
+
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,180 @@
+/** @file
+  Address ordered index of the images loaded in MMRAM, so that an address can be attributed
+  to its image without scanning the image pages or the driver lists.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <PiMm.h>
+
+#include "MmSupervisorCore.h"
+
+#define MM_IMAGE_INDEX_INITIAL_CAPACITY  32
+
+STATIC MM_IMAGE_INDEX_ENTRY  *mMmImageIndex        = NULL;
+STATIC UINTN                 mMmImageIndexCount    = 0;
+STATIC UINTN                 mMmImageIndexCapacity = 0;
+
+/**
+  Find the position of the first index entry whose image starts above Address.
+
+  @param[in]  Address   The address of interest.
+
+  @return The number of index entries whose image starts at or below Address.
+
+**/
+STATIC
+UINTN
+MmImageIndexUpperBound (
+  IN EFI_PHYSICAL_ADDRESS  Address
+  )
+{
+  UINTN  Low;
+  UINTN  High;
+  UINTN  Middle;
+
+  Low  = 0;
+  High = mMmImageIndexCount;
+  while (Low < High) {
+    Middle = Low + (High - Low) / 2;
+    if (mMmImageIndex[Middle].ImageBase <= Address) {
+      Low = Middle + 1;
+    } else {
+      High = Middle;
+    }
+  }
+
+  return Low;
+}
+
+/**
+  Add a loaded image to the image index.
+
+  @param[in]  DriverEntry   The driver entry of the loaded image, its LoadedImage has to
+                            describe the image in MMRAM.
+  @param[in]  PdbString     The PDB file name of the image, NULL if it has none. It has to
+                            stay valid as long as the image is loaded.
+
+  @retval EFI_SUCCESS             The image is added to the index.
+  @retval EFI_INVALID_PARAMETER   DriverEntry does not describe a loaded image.
+  @retval EFI_ALREADY_STARTED     The image overlaps one that is already indexed.
+  @retval EFI_OUT_OF_RESOURCES    Cannot grow the index.
+
+**/
+EFI_STATUS
+MmImageIndexInsert (
+  IN EFI_MM_DRIVER_ENTRY  *DriverEntry,
+  IN CONST CHAR8          *PdbString OPTIONAL
+  )
+{
+  EFI_STATUS            Status;
+  MM_IMAGE_INDEX_ENTRY  *NewIndex;
+  UINTN                 NewCapacity;
+  UINTN                 Position;
+  PHYSICAL_ADDRESS      ImageBase;
+  UINT64                ImageSize;
+
+  if ((DriverEntry == NULL) || (DriverEntry->LoadedImage == NULL) || (DriverEntry->LoadedImage->ImageSize == 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  ImageBase = (PHYSICAL_ADDRESS)(UINTN)DriverEntry->LoadedImage->ImageBase;
+  ImageSize = DriverEntry->LoadedImage->ImageSize;
+
+  Position = MmImageIndexUpperBound (ImageBase);
+  if (((Position > 0) &&
+       (mMmImageIndex[Position - 1].ImageBase + mMmImageIndex[Position - 1].ImageSize > ImageBase)) ||
+      ((Position < mMmImageIndexCount) && (ImageBase + ImageSize > mMmImageIndex[Position].ImageBase)))
+  {
+    DEBUG ((DEBUG_ERROR, "%a Image at 0x%lx of 0x%lx bytes overlaps an indexed image\n", __FUNCTION__, ImageBase, ImageSize));
+    return EFI_ALREADY_STARTED;
+  }
+
+  if (mMmImageIndexCount == mMmImageIndexCapacity) {
+    NewCapacity = (mMmImageIndexCapacity == 0) ? MM_IMAGE_INDEX_INITIAL_CAPACITY : mMmImageIndexCapacity * 2;
+    Status      = MmAllocateSupervisorPool (EfiRuntimeServicesData, NewCapacity * sizeof (MM_IMAGE_INDEX_ENTRY), (VOID **)&NewIndex);
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_ERROR, "%a Failed to grow the image index to %d entries - %r\n", __FUNCTION__, NewCapacity, Status));
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    if (mMmImageIndex != NULL) {
+      CopyMem (NewIndex, mMmImageIndex, mMmImageIndexCount * sizeof (MM_IMAGE_INDEX_ENTRY));
+      MmFreeSupervisorPool (mMmImageIndex);
+    }
+
+    mMmImageIndex         = NewIndex;
+    mMmImageIndexCapacity = NewCapacity;
+  }
+
+  CopyMem (
+    &mMmImageIndex[Position + 1],
+    &mMmImageIndex[Position],
+    (mMmImageIndexCount - Position) * sizeof (MM_IMAGE_INDEX_ENTRY)
+    );
+  mMmImageIndex[Position].ImageBase   = ImageBase;
+  mMmImageIndex[Position].ImageSize   = ImageSize;
+  mMmImageIndex[Position].DriverEntry = DriverEntry;
+  mMmImageIndex[Position].PdbString   = PdbString;
+  mMmImageIndexCount++;
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Remove an image from the image index, before its pages are freed.
+
+  @param[in]  DriverEntry   The driver entry of the image to remove.
+
+**/
+VOID
+MmImageIndexRemove (
+  IN EFI_MM_DRIVER_ENTRY  *DriverEntry
+  )
+{
+  UINTN  Position;
+
+  if ((DriverEntry == NULL) || (DriverEntry->LoadedImage == NULL)) {
+    return;
+  }
+
+  Position = MmImageIndexUpperBound ((PHYSICAL_ADDRESS)(UINTN)DriverEntry->LoadedImage->ImageBase);
+  if ((Position == 0) || (mMmImageIndex[Position - 1].DriverEntry != DriverEntry)) {
+    return;
+  }
+
+  CopyMem (
+    &mMmImageIndex[Position - 1],
+    &mMmImageIndex[Position],
+    (mMmImageIndexCount - Position) * sizeof (MM_IMAGE_INDEX_ENTRY)
+    );
+  mMmImageIndexCount--;
+}
+
+/**
+  Look up the loaded image holding an address.
+
+  @param[in]  Address   The address of interest, e.g. an instruction pointer.
+
+  @return The index entry of the image holding Address, NULL if Address is not inside any
+          loaded image.
+
+**/
+CONST MM_IMAGE_INDEX_ENTRY *
+MmImageIndexLookup (
+  IN EFI_PHYSICAL_ADDRESS  Address
+  )
+{
+  UINTN  Position;
+
+  Position = MmImageIndexUpperBound (Address);
+  if ((Position == 0) ||
+      (Address - mMmImageIndex[Position - 1].ImageBase >= mMmImageIndex[Position - 1].ImageSize))
+  {
+    return NULL;
+  }
+
+  return &mMmImageIndex[Position - 1];
+}
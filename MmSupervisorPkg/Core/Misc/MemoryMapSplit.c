@@ -0,0 +1,867 @@
+/** @file
+  Image record database and memory map split routines used to build the memory
+  attributes table of MM environment.
+
+  The routines in this file only operate on the data passed in and do not allocate
+  memory while a memory map is being split, so that they can be used in the middle
+  of a GetMemoryMap request and be exercised by host based unit tests.
+
+Copyright (c) 2016, Intel Corporation. All rights reserved.<BR>
+Copyright (c) Microsoft Corporation.
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/DebugLib.h>
+
+#include "MemoryMapSplit.h"
+
+#define MEMORY_DESCRIPTOR_AT(MemoryMap, Index, Size) \
+  ((EFI_MEMORY_DESCRIPTOR *)((UINT8 *)(MemoryMap) + (Index) * (Size)))
+
+#define PREVIOUS_MEMORY_DESCRIPTOR(MemoryDescriptor, Size) \
+  ((EFI_MEMORY_DESCRIPTOR *)((UINT8 *)(MemoryDescriptor) - (Size)))
+
+//
+// Initial number of entries of the sorted image record array, doubled whenever it is full.
+//
+#define SORTED_IMAGE_RECORD_INITIAL_CAPACITY  32
+
+/**
+  Converts a number of EFI_PAGEs to a size in bytes.
+
+  NOTE: Do not use EFI_PAGES_TO_SIZE because it handles UINTN only.
+
+  @param[in]  Pages     The number of EFI_PAGES.
+
+  @return  The number of bytes associated with the number of EFI_PAGEs specified
+           by Pages.
+**/
+UINT64
+EfiPagesToSize (
+  IN UINT64  Pages
+  )
+{
+  return LShiftU64 (Pages, EFI_PAGE_SHIFT);
+}
+
+/**
+  Converts a size, in bytes, to a number of EFI_PAGESs.
+
+  NOTE: Do not use EFI_SIZE_TO_PAGES because it handles UINTN only.
+
+  @param[in]  Size      A size in bytes.
+
+  @return  The number of EFI_PAGESs associated with the number of bytes specified
+           by Size.
+
+**/
+UINT64
+EfiSizeToPages (
+  IN UINT64  Size
+  )
+{
+  return RShiftU64 (Size, EFI_PAGE_SHIFT) + ((((UINTN)Size) & EFI_PAGE_MASK) ? 1 : 0);
+}
+
+//
+// Below functions are for MemoryMap
+//
+
+/**
+  Swap the content of two memory map entries.
+
+  @param[in, out]  FirstEntry     first memory map entry
+  @param[in, out]  SecondEntry    second memory map entry
+**/
+STATIC
+VOID
+SwapMemoryMapEntry (
+  IN OUT EFI_MEMORY_DESCRIPTOR  *FirstEntry,
+  IN OUT EFI_MEMORY_DESCRIPTOR  *SecondEntry
+  )
+{
+  EFI_MEMORY_DESCRIPTOR  TempMemoryMap;
+
+  CopyMem (&TempMemoryMap, FirstEntry, sizeof (EFI_MEMORY_DESCRIPTOR));
+  CopyMem (FirstEntry, SecondEntry, sizeof (EFI_MEMORY_DESCRIPTOR));
+  CopyMem (SecondEntry, &TempMemoryMap, sizeof (EFI_MEMORY_DESCRIPTOR));
+}
+
+/**
+  Restore the max-heap property of the memory map entries [0, Count), ordered
+  by PhysicalStart, for the subtree rooted at entry Root.
+
+  @param[in, out]  MemoryMap         A pointer to the memory map entries.
+  @param[in]       Root              Index of the entry to sift down.
+  @param[in]       Count             Number of entries in the heap.
+  @param[in]       DescriptorSize    Size, in bytes, of an individual EFI_MEMORY_DESCRIPTOR.
+**/
+STATIC
+VOID
+SiftDownMemoryMap (
+  IN OUT EFI_MEMORY_DESCRIPTOR  *MemoryMap,
+  IN UINTN                      Root,
+  IN UINTN                      Count,
+  IN UINTN                      DescriptorSize
+  )
+{
+  EFI_MEMORY_DESCRIPTOR  *RootEntry;
+  EFI_MEMORY_DESCRIPTOR  *ChildEntry;
+  UINTN                  Child;
+
+  while (Root < Count / 2) {
+    Child      = 2 * Root + 1;
+    ChildEntry = MEMORY_DESCRIPTOR_AT (MemoryMap, Child, DescriptorSize);
+    if ((Child + 1 < Count) &&
+        (MEMORY_DESCRIPTOR_AT (MemoryMap, Child + 1, DescriptorSize)->PhysicalStart > ChildEntry->PhysicalStart))
+    {
+      Child++;
+      ChildEntry = NEXT_MEMORY_DESCRIPTOR (ChildEntry, DescriptorSize);
+    }
+
+    RootEntry = MEMORY_DESCRIPTOR_AT (MemoryMap, Root, DescriptorSize);
+    if (RootEntry->PhysicalStart >= ChildEntry->PhysicalStart) {
+      break;
+    }
+
+    SwapMemoryMapEntry (RootEntry, ChildEntry);
+    Root = Child;
+  }
+}
+
+/**
+  Sort memory map entries based upon PhysicalStart, from low to high.
+
+  The memory map is usually sorted already, which is detected in a single pass. Otherwise
+  it is heap sorted in place, as no memory can be allocated while the memory map is built.
+
+  @param[in,out]  MemoryMap         A pointer to the buffer in which firmware places
+                                    the current memory map.
+  @param[in]      MemoryMapSize     Size, in bytes, of the MemoryMap buffer.
+  @param[in]      DescriptorSize    Size, in bytes, of an individual EFI_MEMORY_DESCRIPTOR.
+**/
+STATIC
+VOID
+SortMemoryMap (
+  IN OUT EFI_MEMORY_DESCRIPTOR  *MemoryMap,
+  IN UINTN                      MemoryMapSize,
+  IN UINTN                      DescriptorSize
+  )
+{
+  UINTN  Count;
+  UINTN  Index;
+
+  Count = MemoryMapSize / DescriptorSize;
+  for (Index = 1; Index < Count; Index++) {
+    if (MEMORY_DESCRIPTOR_AT (MemoryMap, Index - 1, DescriptorSize)->PhysicalStart >
+        MEMORY_DESCRIPTOR_AT (MemoryMap, Index, DescriptorSize)->PhysicalStart)
+    {
+      break;
+    }
+  }
+
+  if (Index >= Count) {
+    return;
+  }
+
+  for (Index = Count / 2; Index > 0; Index--) {
+    SiftDownMemoryMap (MemoryMap, Index - 1, Count, DescriptorSize);
+  }
+
+  for (Index = Count - 1; Index > 0; Index--) {
+    SwapMemoryMapEntry (MemoryMap, MEMORY_DESCRIPTOR_AT (MemoryMap, Index, DescriptorSize));
+    SiftDownMemoryMap (MemoryMap, 0, Index, DescriptorSize);
+  }
+}
+
+/**
+  Enforce memory map attributes of one entry.
+  This function will set EfiRuntimeServicesData/EfiMemoryMappedIO/EfiMemoryMappedIOPortSpace to be EFI_MEMORY_XP.
+
+  @param[in, out]  MemoryMapEntry         A pointer to the memory map entry.
+**/
+STATIC
+VOID
+EnforceMemoryMapEntryAttribute (
+  IN OUT EFI_MEMORY_DESCRIPTOR  *MemoryMapEntry
+  )
+{
+  if (MemoryMapEntry->Attribute != 0) {
+    // It is PE image, the attribute is already set.
+  } else {
+    switch (MemoryMapEntry->Type) {
+      case EfiRuntimeServicesCode:
+        MemoryMapEntry->Attribute = EFI_MEMORY_RO;
+        break;
+      case EfiRuntimeServicesData:
+      default:
+        MemoryMapEntry->Attribute |= EFI_MEMORY_XP;
+        break;
+    }
+  }
+}
+
+/**
+  Enforce memory map attributes, and merge continuous memory map entries whose have
+  same attributes, in a single pass over the sorted memory map.
+
+  @param[in, out]  MemoryMap              A pointer to the buffer in which firmware places
+                                          the current memory map.
+  @param[in, out]  MemoryMapSize          A pointer to the size, in bytes, of the
+                                          MemoryMap buffer. On input, this is the size of
+                                          the current memory map.  On output,
+                                          it is the size of new memory map after merge.
+  @param[in]       DescriptorSize         Size, in bytes, of an individual EFI_MEMORY_DESCRIPTOR.
+**/
+STATIC
+VOID
+EnforceAndMergeMemoryMap (
+  IN OUT EFI_MEMORY_DESCRIPTOR  *MemoryMap,
+  IN OUT UINTN                  *MemoryMapSize,
+  IN UINTN                      DescriptorSize
+  )
+{
+  EFI_MEMORY_DESCRIPTOR  *MemoryMapEntry;
+  EFI_MEMORY_DESCRIPTOR  *MemoryMapEnd;
+  EFI_MEMORY_DESCRIPTOR  *NewMemoryMapEntry;
+  EFI_MEMORY_DESCRIPTOR  *LastMemoryMapEntry;
+
+  MemoryMapEntry    = MemoryMap;
+  NewMemoryMapEntry = MemoryMap;
+  MemoryMapEnd      = (EFI_MEMORY_DESCRIPTOR *)((UINT8 *)MemoryMap + *MemoryMapSize);
+  while ((UINTN)MemoryMapEntry < (UINTN)MemoryMapEnd) {
+    EnforceMemoryMapEntryAttribute (MemoryMapEntry);
+
+    if (NewMemoryMapEntry != MemoryMap) {
+      LastMemoryMapEntry = PREVIOUS_MEMORY_DESCRIPTOR (NewMemoryMapEntry, DescriptorSize);
+      if ((LastMemoryMapEntry->Type == MemoryMapEntry->Type) &&
+          (LastMemoryMapEntry->Attribute == MemoryMapEntry->Attribute) &&
+          ((LastMemoryMapEntry->PhysicalStart + EfiPagesToSize (LastMemoryMapEntry->NumberOfPages)) == MemoryMapEntry->PhysicalStart))
+      {
+        LastMemoryMapEntry->NumberOfPages += MemoryMapEntry->NumberOfPages;
+        MemoryMapEntry                     = NEXT_MEMORY_DESCRIPTOR (MemoryMapEntry, DescriptorSize);
+        continue;
+      }
+    }
+
+    if (NewMemoryMapEntry != MemoryMapEntry) {
+      CopyMem (NewMemoryMapEntry, MemoryMapEntry, sizeof (EFI_MEMORY_DESCRIPTOR));
+    }
+
+    MemoryMapEntry    = NEXT_MEMORY_DESCRIPTOR (MemoryMapEntry, DescriptorSize);
+    NewMemoryMapEntry = NEXT_MEMORY_DESCRIPTOR (NewMemoryMapEntry, DescriptorSize);
+  }
+
+  *MemoryMapSize = (UINTN)NewMemoryMapEntry - (UINTN)MemoryMap;
+
+  return;
+}
+
+//
+// Below functions are for ImageRecord
+//
+
+/**
+  Insert an image record into the image record database, both to the tail of
+  ImageRecordList and to its sorted position in SortedImageRecords.
+
+  @param[in, out]  PrivateData    The image record database.
+  @param[in]       ImageRecord    The image record to be inserted.
+
+  @retval EFI_SUCCESS             The image record is inserted.
+  @retval EFI_OUT_OF_RESOURCES    Failed to grow the sorted image record array, the
+                                  database is left unchanged.
+**/
+EFI_STATUS
+InsertImageRecord (
+  IN OUT IMAGE_PROPERTIES_PRIVATE_DATA  *PrivateData,
+  IN IMAGE_PROPERTIES_RECORD            *ImageRecord
+  )
+{
+  IMAGE_PROPERTIES_RECORD  **SortedImageRecords;
+  UINTN                    NewCapacity;
+  UINTN                    Low;
+  UINTN                    High;
+  UINTN                    Middle;
+
+  if (PrivateData->ImageRecordCount == PrivateData->SortedImageRecordCapacity) {
+    NewCapacity = MAX (2 * PrivateData->SortedImageRecordCapacity, SORTED_IMAGE_RECORD_INITIAL_CAPACITY);
+    SortedImageRecords = ReallocatePool (
+                           PrivateData->SortedImageRecordCapacity * sizeof (IMAGE_PROPERTIES_RECORD *),
+                           NewCapacity * sizeof (IMAGE_PROPERTIES_RECORD *),
+                           PrivateData->SortedImageRecords
+                           );
+    if (SortedImageRecords == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    PrivateData->SortedImageRecords        = SortedImageRecords;
+    PrivateData->SortedImageRecordCapacity = NewCapacity;
+  }
+
+  //
+  // Find the first record above the new one, records of the same ImageBase stay in insertion order.
+  //
+  Low  = 0;
+  High = PrivateData->ImageRecordCount;
+  while (Low < High) {
+    Middle = Low + (High - Low) / 2;
+    if (PrivateData->SortedImageRecords[Middle]->ImageBase <= ImageRecord->ImageBase) {
+      Low = Middle + 1;
+    } else {
+      High = Middle;
+    }
+  }
+
+  CopyMem (
+    &PrivateData->SortedImageRecords[Low + 1],
+    &PrivateData->SortedImageRecords[Low],
+    (PrivateData->ImageRecordCount - Low) * sizeof (IMAGE_PROPERTIES_RECORD *)
+    );
+  PrivateData->SortedImageRecords[Low] = ImageRecord;
+
+  InsertTailList (&PrivateData->ImageRecordList, &ImageRecord->Link);
+  PrivateData->ImageRecordCount++;
+
+  if (PrivateData->CodeSegmentCountMax < ImageRecord->CodeSegmentCount) {
+    PrivateData->CodeSegmentCountMax = ImageRecord->CodeSegmentCount;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Return the lowest image record, whose [ImageBase, ImageSize] covered by [Buffer, Length].
+
+  @param[in] PrivateData  The image record database.
+  @param[in] Buffer       Start Address
+  @param[in] Length       Address length
+
+  @return lowest image record covered by [buffer, length], NULL if there is none.
+**/
+IMAGE_PROPERTIES_RECORD *
+GetImageRecordByAddress (
+  IN CONST IMAGE_PROPERTIES_PRIVATE_DATA  *PrivateData,
+  IN EFI_PHYSICAL_ADDRESS                 Buffer,
+  IN UINT64                               Length
+  )
+{
+  IMAGE_PROPERTIES_RECORD  *ImageRecord;
+  UINTN                    Low;
+  UINTN                    High;
+  UINTN                    Middle;
+
+  //
+  // Find the first record starting at or above Buffer.
+  //
+  Low  = 0;
+  High = PrivateData->ImageRecordCount;
+  while (Low < High) {
+    Middle = Low + (High - Low) / 2;
+    if (PrivateData->SortedImageRecords[Middle]->ImageBase < Buffer) {
+      Low = Middle + 1;
+    } else {
+      High = Middle;
+    }
+  }
+
+  //
+  // Images do not overlap, so this loop normally ends at the first record. It keeps
+  // looking only to stay correct with records that do.
+  //
+  for ( ; Low < PrivateData->ImageRecordCount; Low++) {
+    ImageRecord = PrivateData->SortedImageRecords[Low];
+    if (ImageRecord->ImageBase > Buffer + Length) {
+      break;
+    }
+
+    if (Buffer + Length >= ImageRecord->ImageBase + ImageRecord->ImageSize) {
+      return ImageRecord;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  Merge sort a list of code sections, based upon CodeSegmentBase from low to high.
+
+  @param[in, out]  CodeSegmentList     Head of the code section list.
+  @param[in]       CodeSegmentCount    Number of code sections in the list.
+**/
+STATIC
+VOID
+MergeSortCodeSectionList (
+  IN OUT LIST_ENTRY  *CodeSegmentList,
+  IN UINTN           CodeSegmentCount
+  )
+{
+  IMAGE_PROPERTIES_RECORD_CODE_SECTION  *LeftCodeSection;
+  IMAGE_PROPERTIES_RECORD_CODE_SECTION  *RightCodeSection;
+  LIST_ENTRY                            RightList;
+  LIST_ENTRY                            *LeftLink;
+  LIST_ENTRY                            *RightLink;
+  UINTN                                 LeftCount;
+  UINTN                                 Index;
+
+  if (CodeSegmentCount < 2) {
+    return;
+  }
+
+  //
+  // Detach the second half of the list to RightList.
+  //
+  LeftCount = CodeSegmentCount / 2;
+  RightLink = CodeSegmentList->ForwardLink;
+  for (Index = 0; Index < LeftCount; Index++) {
+    RightLink = RightLink->ForwardLink;
+  }
+
+  RightList.ForwardLink                  = RightLink;
+  RightList.BackLink                     = CodeSegmentList->BackLink;
+  CodeSegmentList->BackLink->ForwardLink = &RightList;
+  CodeSegmentList->BackLink              = RightLink->BackLink;
+  RightLink->BackLink->ForwardLink       = CodeSegmentList;
+  RightLink->BackLink                    = &RightList;
+
+  MergeSortCodeSectionList (CodeSegmentList, LeftCount);
+  MergeSortCodeSectionList (&RightList, CodeSegmentCount - LeftCount);
+
+  //
+  // Move each section of RightList in front of the first left section above it.
+  //
+  LeftLink = CodeSegmentList->ForwardLink;
+  while (!IsListEmpty (&RightList)) {
+    RightLink        = RightList.ForwardLink;
+    RightCodeSection = CR (
+                         RightLink,
+                         IMAGE_PROPERTIES_RECORD_CODE_SECTION,
+                         Link,
+                         IMAGE_PROPERTIES_RECORD_CODE_SECTION_SIGNATURE
+                         );
+    while (LeftLink != CodeSegmentList) {
+      LeftCodeSection = CR (
+                          LeftLink,
+                          IMAGE_PROPERTIES_RECORD_CODE_SECTION,
+                          Link,
+                          IMAGE_PROPERTIES_RECORD_CODE_SECTION_SIGNATURE
+                          );
+      if (LeftCodeSection->CodeSegmentBase > RightCodeSection->CodeSegmentBase) {
+        break;
+      }
+
+      LeftLink = LeftLink->ForwardLink;
+    }
+
+    RemoveEntryList (RightLink);
+    InsertTailList (LeftLink, RightLink);
+  }
+}
+
+/**
+  Sort code section in image record, based upon CodeSegmentBase from low to high.
+
+  @param[in]  ImageRecord    image record to be sorted
+**/
+VOID
+SortImageRecordCodeSection (
+  IN IMAGE_PROPERTIES_RECORD  *ImageRecord
+  )
+{
+  MergeSortCodeSectionList (&ImageRecord->CodeSegmentList, ImageRecord->CodeSegmentCount);
+}
+
+//
+// Below functions are for splitting MemoryMap
+//
+
+/**
+  Set the memory map to new entries, according to one old entry,
+  based upon PE code section and data section in image record
+
+  @param[in]       ImageRecord            An image record whose [ImageBase, ImageSize] covered
+                                          by old memory map entry.
+  @param[in, out]  NewRecord              A pointer to several new memory map entries.
+                                          The caller guarantee the buffer size be 1 +
+                                          (SplitRecordCount * DescriptorSize) calculated
+                                          below.
+  @param[in]       OldRecord              A pointer to one old memory map entry.
+  @param[in]       DescriptorSize         Size, in bytes, of an individual EFI_MEMORY_DESCRIPTOR.
+**/
+STATIC
+UINTN
+SetNewRecord (
+  IN IMAGE_PROPERTIES_RECORD    *ImageRecord,
+  IN OUT EFI_MEMORY_DESCRIPTOR  *NewRecord,
+  IN EFI_MEMORY_DESCRIPTOR      *OldRecord,
+  IN UINTN                      DescriptorSize
+  )
+{
+  EFI_MEMORY_DESCRIPTOR                 TempRecord;
+  IMAGE_PROPERTIES_RECORD_CODE_SECTION  *ImageRecordCodeSection;
+  LIST_ENTRY                            *ImageRecordCodeSectionLink;
+  LIST_ENTRY                            *ImageRecordCodeSectionEndLink;
+  LIST_ENTRY                            *ImageRecordCodeSectionList;
+  UINTN                                 NewRecordCount;
+  UINT64                                PhysicalEnd;
+  UINT64                                ImageEnd;
+
+  CopyMem (&TempRecord, OldRecord, sizeof (EFI_MEMORY_DESCRIPTOR));
+  PhysicalEnd    = TempRecord.PhysicalStart + EfiPagesToSize (TempRecord.NumberOfPages);
+  NewRecordCount = 0;
+
+  //
+  // Always create a new entry for non-PE image record
+  //
+  if (ImageRecord->ImageBase > TempRecord.PhysicalStart) {
+    NewRecord->Type          = TempRecord.Type;
+    NewRecord->PhysicalStart = TempRecord.PhysicalStart;
+    NewRecord->VirtualStart  = 0;
+    NewRecord->NumberOfPages = EfiSizeToPages (ImageRecord->ImageBase - TempRecord.PhysicalStart);
+    NewRecord->Attribute     = TempRecord.Attribute;
+    NewRecord                = NEXT_MEMORY_DESCRIPTOR (NewRecord, DescriptorSize);
+    NewRecordCount++;
+    TempRecord.PhysicalStart = ImageRecord->ImageBase;
+    TempRecord.NumberOfPages = EfiSizeToPages (PhysicalEnd - TempRecord.PhysicalStart);
+  }
+
+  ImageRecordCodeSectionList = &ImageRecord->CodeSegmentList;
+
+  ImageRecordCodeSectionLink    = ImageRecordCodeSectionList->ForwardLink;
+  ImageRecordCodeSectionEndLink = ImageRecordCodeSectionList;
+  while (ImageRecordCodeSectionLink != ImageRecordCodeSectionEndLink) {
+    ImageRecordCodeSection = CR (
+                               ImageRecordCodeSectionLink,
+                               IMAGE_PROPERTIES_RECORD_CODE_SECTION,
+                               Link,
+                               IMAGE_PROPERTIES_RECORD_CODE_SECTION_SIGNATURE
+                               );
+    ImageRecordCodeSectionLink = ImageRecordCodeSectionLink->ForwardLink;
+
+    if (TempRecord.PhysicalStart <= ImageRecordCodeSection->CodeSegmentBase) {
+      //
+      // DATA
+      //
+      NewRecord->Type          = EfiRuntimeServicesData;
+      NewRecord->PhysicalStart = TempRecord.PhysicalStart;
+      NewRecord->VirtualStart  = 0;
+      NewRecord->NumberOfPages = EfiSizeToPages (ImageRecordCodeSection->CodeSegmentBase - NewRecord->PhysicalStart);
+      NewRecord->Attribute     = TempRecord.Attribute | EFI_MEMORY_XP;
+      if (NewRecord->NumberOfPages != 0) {
+        NewRecord = NEXT_MEMORY_DESCRIPTOR (NewRecord, DescriptorSize);
+        NewRecordCount++;
+      }
+
+      //
+      // CODE
+      //
+      NewRecord->Type          = EfiRuntimeServicesCode;
+      NewRecord->PhysicalStart = ImageRecordCodeSection->CodeSegmentBase;
+      NewRecord->VirtualStart  = 0;
+      NewRecord->NumberOfPages = EfiSizeToPages (ImageRecordCodeSection->CodeSegmentSize);
+      NewRecord->Attribute     = (TempRecord.Attribute & (~EFI_MEMORY_XP)) | EFI_MEMORY_RO;
+      if (NewRecord->NumberOfPages != 0) {
+        NewRecord = NEXT_MEMORY_DESCRIPTOR (NewRecord, DescriptorSize);
+        NewRecordCount++;
+      }
+
+      TempRecord.PhysicalStart = ImageRecordCodeSection->CodeSegmentBase + EfiPagesToSize (EfiSizeToPages (ImageRecordCodeSection->CodeSegmentSize));
+      TempRecord.NumberOfPages = EfiSizeToPages (PhysicalEnd - TempRecord.PhysicalStart);
+      if (TempRecord.NumberOfPages == 0) {
+        break;
+      }
+    }
+  }
+
+  ImageEnd = ImageRecord->ImageBase + ImageRecord->ImageSize;
+
+  //
+  // Final DATA
+  //
+  if (TempRecord.PhysicalStart < ImageEnd) {
+    NewRecord->Type          = EfiRuntimeServicesData;
+    NewRecord->PhysicalStart = TempRecord.PhysicalStart;
+    NewRecord->VirtualStart  = 0;
+    NewRecord->NumberOfPages = EfiSizeToPages (ImageEnd - TempRecord.PhysicalStart);
+    NewRecord->Attribute     = TempRecord.Attribute | EFI_MEMORY_XP;
+    NewRecordCount++;
+  }
+
+  return NewRecordCount;
+}
+
+/**
+  Return the max number of new splitted entries, according to one old entry,
+  based upon PE code section and data section.
+
+  @param[in]  PrivateData            The image record database.
+  @param[in]  OldRecord              A pointer to one old memory map entry.
+
+  @retval  0 no entry need to be splitted.
+  @return  the max number of new splitted entries
+**/
+STATIC
+UINTN
+GetMaxSplitRecordCount (
+  IN CONST IMAGE_PROPERTIES_PRIVATE_DATA  *PrivateData,
+  IN EFI_MEMORY_DESCRIPTOR                *OldRecord
+  )
+{
+  IMAGE_PROPERTIES_RECORD  *ImageRecord;
+  UINTN                    SplitRecordCount;
+  UINT64                   PhysicalStart;
+  UINT64                   PhysicalEnd;
+
+  SplitRecordCount = 0;
+  PhysicalStart    = OldRecord->PhysicalStart;
+  PhysicalEnd      = OldRecord->PhysicalStart + EfiPagesToSize (OldRecord->NumberOfPages);
+
+  do {
+    ImageRecord = GetImageRecordByAddress (PrivateData, PhysicalStart, PhysicalEnd - PhysicalStart);
+    if (ImageRecord == NULL) {
+      break;
+    }
+
+    SplitRecordCount += (2 * ImageRecord->CodeSegmentCount + 2);
+    PhysicalStart     = ImageRecord->ImageBase + ImageRecord->ImageSize;
+  } while ((ImageRecord != NULL) && (PhysicalStart < PhysicalEnd));
+
+  return SplitRecordCount;
+}
+
+/**
+  Split the memory map to new entries, according to one old entry,
+  based upon PE code section and data section.
+
+  @param[in]       PrivateData            The image record database.
+  @param[in]       OldRecord              A pointer to one old memory map entry.
+  @param[in, out]  NewRecord              A pointer to several new memory map entries.
+                                          The caller guarantee the buffer size be 1 +
+                                          (SplitRecordCount * DescriptorSize) calculated
+                                          below.
+  @param[in]       MaxSplitRecordCount    The max number of splitted entries
+  @param[in]       DescriptorSize         Size, in bytes, of an individual EFI_MEMORY_DESCRIPTOR.
+
+  @retval  0 no entry is splitted.
+  @return  the real number of splitted record.
+**/
+STATIC
+UINTN
+SplitRecord (
+  IN CONST IMAGE_PROPERTIES_PRIVATE_DATA  *PrivateData,
+  IN EFI_MEMORY_DESCRIPTOR                *OldRecord,
+  IN OUT EFI_MEMORY_DESCRIPTOR            *NewRecord,
+  IN UINTN                                MaxSplitRecordCount,
+  IN UINTN                                DescriptorSize
+  )
+{
+  EFI_MEMORY_DESCRIPTOR    TempRecord;
+  IMAGE_PROPERTIES_RECORD  *ImageRecord;
+  IMAGE_PROPERTIES_RECORD  *NewImageRecord;
+  UINT64                   PhysicalStart;
+  UINT64                   PhysicalEnd;
+  UINTN                    NewRecordCount;
+  UINTN                    TotalNewRecordCount;
+
+  if (MaxSplitRecordCount == 0) {
+    CopyMem (NewRecord, OldRecord, DescriptorSize);
+    return 0;
+  }
+
+  TotalNewRecordCount = 0;
+
+  //
+  // Override previous record
+  //
+  CopyMem (&TempRecord, OldRecord, sizeof (EFI_MEMORY_DESCRIPTOR));
+  PhysicalStart = TempRecord.PhysicalStart;
+  PhysicalEnd   = TempRecord.PhysicalStart + EfiPagesToSize (TempRecord.NumberOfPages);
+
+  ImageRecord = NULL;
+  do {
+    NewImageRecord = GetImageRecordByAddress (PrivateData, PhysicalStart, PhysicalEnd - PhysicalStart);
+    if (NewImageRecord == NULL) {
+      //
+      // No more image covered by this range, stop
+      //
+      if (PhysicalEnd > PhysicalStart) {
+        //
+        // Always create a new entry for non-PE image record
+        //
+        NewRecord->Type          = TempRecord.Type;
+        NewRecord->PhysicalStart = TempRecord.PhysicalStart;
+        NewRecord->VirtualStart  = 0;
+        NewRecord->NumberOfPages = TempRecord.NumberOfPages;
+        NewRecord->Attribute     = TempRecord.Attribute;
+        TotalNewRecordCount++;
+      }
+
+      break;
+    }
+
+    ImageRecord = NewImageRecord;
+
+    //
+    // Set new record
+    //
+    NewRecordCount       = SetNewRecord (ImageRecord, NewRecord, &TempRecord, DescriptorSize);
+    TotalNewRecordCount += NewRecordCount;
+    NewRecord            = (EFI_MEMORY_DESCRIPTOR *)((UINT8 *)NewRecord + NewRecordCount * DescriptorSize);
+
+    //
+    // Update PhysicalStart, in order to exclude the image buffer already splitted.
+    //
+    PhysicalStart            = ImageRecord->ImageBase + ImageRecord->ImageSize;
+    TempRecord.PhysicalStart = PhysicalStart;
+    TempRecord.NumberOfPages = EfiSizeToPages (PhysicalEnd - PhysicalStart);
+  } while ((ImageRecord != NULL) && (PhysicalStart < PhysicalEnd));
+
+  return TotalNewRecordCount - 1;
+}
+
+/**
+  Split the original memory map, and add more entries to describe PE code section and data section.
+  This function will set EfiRuntimeServicesData to be EFI_MEMORY_XP.
+  This function will merge entries with same attributes finally.
+
+  NOTE: It assumes PE code/data section are page aligned.
+  NOTE: It assumes enough entry is prepared for new memory map.
+
+  Split table:
+   +---------------+
+   | Record X      |
+   +---------------+
+   | Record RtCode |
+   +---------------+
+   | Record Y      |
+   +---------------+
+   ==>
+   +---------------+
+   | Record X      |
+   +---------------+
+   | Record RtCode |
+   +---------------+ ----
+   | Record RtData |     |
+   +---------------+     |
+   | Record RtCode |     |-> PE/COFF1
+   +---------------+     |
+   | Record RtData |     |
+   +---------------+ ----
+   | Record RtCode |
+   +---------------+ ----
+   | Record RtData |     |
+   +---------------+     |
+   | Record RtCode |     |-> PE/COFF2
+   +---------------+     |
+   | Record RtData |     |
+   +---------------+ ----
+   | Record RtCode |
+   +---------------+
+   | Record Y      |
+   +---------------+
+
+  The old memory map is sorted first. Since the entries split from one old entry are
+  in ascending order, the new memory map comes out sorted, and attribute enforcement
+  and merging are done in one more pass over it.
+
+  @param[in]       PrivateData            The image record database.
+  @param[in, out]  MemoryMapSize          A pointer to the size, in bytes, of the
+                                          MemoryMap buffer. On input, this is the size of
+                                          old MemoryMap before split. The actual buffer
+                                          size of MemoryMap is MemoryMapSize +
+                                          (AdditionalRecordCount * DescriptorSize) calculated
+                                          below. On output, it is the size of new MemoryMap
+                                          after split.
+  @param[in, out]  MemoryMap              A pointer to the buffer in which firmware places
+                                          the current memory map.
+  @param[in]       DescriptorSize         Size, in bytes, of an individual EFI_MEMORY_DESCRIPTOR.
+**/
+VOID
+SplitTable (
+  IN CONST IMAGE_PROPERTIES_PRIVATE_DATA  *PrivateData,
+  IN OUT UINTN                            *MemoryMapSize,
+  IN OUT EFI_MEMORY_DESCRIPTOR            *MemoryMap,
+  IN UINTN                                DescriptorSize
+  )
+{
+  INTN   IndexOld;
+  INTN   IndexNew;
+  UINTN  MaxSplitRecordCount;
+  UINTN  RealSplitRecordCount;
+  UINTN  TotalSplitRecordCount;
+  UINTN  AdditionalRecordCount;
+
+  AdditionalRecordCount = (2 * PrivateData->CodeSegmentCountMax + 2) * PrivateData->ImageRecordCount;
+
+  //
+  // Sort from low to high, so that the split entries come out in order
+  //
+  SortMemoryMap (MemoryMap, *MemoryMapSize, DescriptorSize);
+
+  TotalSplitRecordCount = 0;
+  //
+  // Let old record point to end of valid MemoryMap buffer.
+  //
+  IndexOld = ((*MemoryMapSize) / DescriptorSize) - 1;
+  //
+  // Let new record point to end of full MemoryMap buffer.
+  //
+  IndexNew = ((*MemoryMapSize) / DescriptorSize) - 1 + AdditionalRecordCount;
+  for ( ; IndexOld >= 0; IndexOld--) {
+    MaxSplitRecordCount = GetMaxSplitRecordCount (PrivateData, MEMORY_DESCRIPTOR_AT (MemoryMap, IndexOld, DescriptorSize));
+    //
+    // Split this MemoryMap record
+    //
+    IndexNew            -= MaxSplitRecordCount;
+    RealSplitRecordCount = SplitRecord (
+                             PrivateData,
+                             MEMORY_DESCRIPTOR_AT (MemoryMap, IndexOld, DescriptorSize),
+                             MEMORY_DESCRIPTOR_AT (MemoryMap, IndexNew, DescriptorSize),
+                             MaxSplitRecordCount,
+                             DescriptorSize
+                             );
+    //
+    // Adjust IndexNew according to real split.
+    //
+    if (MaxSplitRecordCount != RealSplitRecordCount) {
+      CopyMem (
+        ((UINT8 *)MemoryMap + (IndexNew + MaxSplitRecordCount - RealSplitRecordCount) * DescriptorSize),
+        ((UINT8 *)MemoryMap + IndexNew * DescriptorSize),
+        (RealSplitRecordCount + 1) * DescriptorSize
+        );
+    }
+
+    IndexNew               = IndexNew + MaxSplitRecordCount - RealSplitRecordCount;
+    TotalSplitRecordCount += RealSplitRecordCount;
+    IndexNew--;
+  }
+
+  //
+  // Move all records to the beginning.
+  //
+  CopyMem (
+    MemoryMap,
+    (UINT8 *)MemoryMap + (AdditionalRecordCount - TotalSplitRecordCount) * DescriptorSize,
+    (*MemoryMapSize) + TotalSplitRecordCount * DescriptorSize
+    );
+
+  *MemoryMapSize = (*MemoryMapSize) + DescriptorSize * TotalSplitRecordCount;
+
+  //
+  // Only overlapping images could leave the new memory map out of order, this is a single pass otherwise
+  //
+  SortMemoryMap (MemoryMap, *MemoryMapSize, DescriptorSize);
+
+  //
+  // Set RuntimeData to XP and merge same type to save entry size
+  //
+  EnforceAndMergeMemoryMap (MemoryMap, MemoryMapSize, DescriptorSize);
+
+  return;
+}
@@ -0,0 +1,155 @@
+/** @file
+  Image record database and memory map split routines used to build the memory
+  attributes table of MM environment.
+
+  Image records are kept in a list in the order of creation, as well as in an array
+  sorted by ImageBase, so that the image covering an address range can be found by
+  binary search while the memory map is split.
+
+Copyright (c) 2016, Intel Corporation. All rights reserved.<BR>
+Copyright (c) Microsoft Corporation.
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef _MEMORY_MAP_SPLIT_H_
+#define _MEMORY_MAP_SPLIT_H_
+
+#define IMAGE_PROPERTIES_RECORD_CODE_SECTION_SIGNATURE  SIGNATURE_32 ('I','P','R','C')
+
+typedef struct {
+  UINT32                  Signature;
+  LIST_ENTRY              Link;
+  EFI_PHYSICAL_ADDRESS    CodeSegmentBase;
+  UINT64                  CodeSegmentSize;
+} IMAGE_PROPERTIES_RECORD_CODE_SECTION;
+
+#define IMAGE_PROPERTIES_RECORD_SIGNATURE  SIGNATURE_32 ('I','P','R','D')
+
+typedef struct {
+  UINT32                  Signature;
+  LIST_ENTRY              Link;
+  EFI_PHYSICAL_ADDRESS    ImageBase;
+  UINT64                  ImageSize;
+  UINTN                   CodeSegmentCount;
+  LIST_ENTRY              CodeSegmentList;
+} IMAGE_PROPERTIES_RECORD;
+
+#define IMAGE_PROPERTIES_PRIVATE_DATA_SIGNATURE  SIGNATURE_32 ('I','P','P','D')
+
+typedef struct {
+  UINT32                     Signature;
+  UINTN                      ImageRecordCount;
+  UINTN                      CodeSegmentCountMax;
+  LIST_ENTRY                 ImageRecordList;
+  //
+  // ImageRecordCount entries of ImageRecordList, sorted by ImageBase from low to high.
+  //
+  IMAGE_PROPERTIES_RECORD    **SortedImageRecords;
+  UINTN                      SortedImageRecordCapacity;
+} IMAGE_PROPERTIES_PRIVATE_DATA;
+
+/**
+  Converts a number of EFI_PAGEs to a size in bytes.
+
+  NOTE: Do not use EFI_PAGES_TO_SIZE because it handles UINTN only.
+
+  @param[in]  Pages     The number of EFI_PAGES.
+
+  @return  The number of bytes associated with the number of EFI_PAGEs specified
+           by Pages.
+**/
+UINT64
+EfiPagesToSize (
+  IN UINT64  Pages
+  );
+
+/**
+  Converts a size, in bytes, to a number of EFI_PAGESs.
+
+  NOTE: Do not use EFI_SIZE_TO_PAGES because it handles UINTN only.
+
+  @param[in]  Size      A size in bytes.
+
+  @return  The number of EFI_PAGESs associated with the number of bytes specified
+           by Size.
+
+**/
+UINT64
+EfiSizeToPages (
+  IN UINT64  Size
+  );
+
+/**
+  Insert an image record into the image record database, both to the tail of
+  ImageRecordList and to its sorted position in SortedImageRecords.
+
+  @param[in, out]  PrivateData    The image record database.
+  @param[in]       ImageRecord    The image record to be inserted.
+
+  @retval EFI_SUCCESS             The image record is inserted.
+  @retval EFI_OUT_OF_RESOURCES    Failed to grow the sorted image record array, the
+                                  database is left unchanged.
+**/
+EFI_STATUS
+InsertImageRecord (
+  IN OUT IMAGE_PROPERTIES_PRIVATE_DATA  *PrivateData,
+  IN IMAGE_PROPERTIES_RECORD            *ImageRecord
+  );
+
+/**
+  Return the lowest image record, whose [ImageBase, ImageSize] covered by [Buffer, Length].
+
+  @param[in] PrivateData  The image record database.
+  @param[in] Buffer       Start Address
+  @param[in] Length       Address length
+
+  @return lowest image record covered by [buffer, length], NULL if there is none.
+**/
+IMAGE_PROPERTIES_RECORD *
+GetImageRecordByAddress (
+  IN CONST IMAGE_PROPERTIES_PRIVATE_DATA  *PrivateData,
+  IN EFI_PHYSICAL_ADDRESS                 Buffer,
+  IN UINT64                               Length
+  );
+
+/**
+  Sort code section in image record, based upon CodeSegmentBase from low to high.
+
+  @param[in]  ImageRecord    image record to be sorted
+**/
+VOID
+SortImageRecordCodeSection (
+  IN IMAGE_PROPERTIES_RECORD  *ImageRecord
+  );
+
+/**
+  Split the original memory map, and add more entries to describe PE code section and data section.
+  This function will set EfiRuntimeServicesData to be EFI_MEMORY_XP.
+  This function will merge entries with same attributes finally.
+
+  NOTE: It assumes PE code/data section are page aligned.
+  NOTE: It assumes enough entry is prepared for new memory map.
+
+  @param[in]       PrivateData            The image record database.
+  @param[in, out]  MemoryMapSize          A pointer to the size, in bytes, of the
+                                          MemoryMap buffer. On input, this is the size of
+                                          old MemoryMap before split. The actual buffer
+                                          size of MemoryMap is MemoryMapSize +
+                                          (AdditionalRecordCount * DescriptorSize), where
+                                          AdditionalRecordCount is (2 * CodeSegmentCountMax + 2)
+                                          * ImageRecordCount. On output, it is the size of
+                                          new MemoryMap after split.
+  @param[in, out]  MemoryMap              A pointer to the buffer in which firmware places
+                                          the current memory map.
+  @param[in]       DescriptorSize         Size, in bytes, of an individual EFI_MEMORY_DESCRIPTOR.
+**/
+VOID
+SplitTable (
+  IN CONST IMAGE_PROPERTIES_PRIVATE_DATA  *PrivateData,
+  IN OUT UINTN                            *MemoryMapSize,
+  IN OUT EFI_MEMORY_DESCRIPTOR            *MemoryMap,
+  IN UINTN                                DescriptorSize
+  );
+
+#endif // _MEMORY_MAP_SPLIT_H_
@@ -0,0 +1,1133 @@
+/** @file
+  Host based unit tests of the memory map split routines used to build the memory
+  attributes table of MM environment.
+
+  Random memory maps and image records are split through SplitTable and through a
+  copy of the previous list based implementation, and the resulting memory maps are
+  compared byte for byte. The previous implementation looks up image records in the
+  order of insertion, so the reference model is given the image records in ascending
+  ImageBase order, which is the order it was designed for.
+
+  The random seed can be supplied as the first command line argument to reproduce
+  a reported failure.
+
+  Copyright (C) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#include <Library/UnitTestLib.h>
+
+#include "../MemoryMapSplit.h"
+
+#define UNIT_TEST_APP_NAME     "MM Memory Map Split Tests"
+#define UNIT_TEST_APP_VERSION  "1.0"
+
+#define SPLIT_TEST_DEFAULT_SEED           0x3A7B1E5D9C0F2468ULL
+#define SPLIT_TEST_MAP_COUNT              1024
+#define SPLIT_TEST_MAX_DESCRIPTOR_COUNT   64
+#define SPLIT_TEST_MAX_DESCRIPTOR_PAGES   64
+#define SPLIT_TEST_MAX_IMAGE_COUNT        48
+#define SPLIT_TEST_MAX_IMAGE_PAGES        24
+#define SPLIT_TEST_MAX_CODE_SECTIONS      8
+#define SPLIT_TEST_SORT_ROUNDS            256
+#define SPLIT_TEST_MAX_SORTED_SECTIONS    512
+#define SPLIT_TEST_MEMORY_MAP_BASE        0x7F000000ULL
+// MmCoreGetMemoryMap pads every descriptor by 8 bytes
+#define SPLIT_TEST_DESCRIPTOR_SIZE        (sizeof (EFI_MEMORY_DESCRIPTOR) + sizeof (UINT64))
+
+#define REFERENCE_PREVIOUS_MEMORY_DESCRIPTOR(MemoryDescriptor, Size) \
+  ((EFI_MEMORY_DESCRIPTOR *)((UINT8 *)(MemoryDescriptor) - (Size)))
+
+typedef struct {
+  EFI_PHYSICAL_ADDRESS    Base;
+  UINT64                  Size;
+} SPLIT_TEST_SECTION;
+
+typedef struct {
+  EFI_PHYSICAL_ADDRESS    ImageBase;
+  UINT64                  ImageSize;
+  UINTN                   SectionCount;
+  SPLIT_TEST_SECTION      Sections[SPLIT_TEST_MAX_CODE_SECTIONS];
+} SPLIT_TEST_IMAGE;
+
+typedef struct {
+  EFI_MEMORY_DESCRIPTOR            *Descriptors;
+  UINTN                            DescriptorCount;
+  SPLIT_TEST_IMAGE                 *Images;
+  UINTN                            ImageCount;
+  IMAGE_PROPERTIES_PRIVATE_DATA    PrivateData;
+} TEST_CONTEXT_SPLIT;
+
+STATIC UINT64  mSplitTestSeed = SPLIT_TEST_DEFAULT_SEED;
+STATIC UINT64  mRandomState;
+
+STATIC CONST EFI_MEMORY_TYPE  mSplitTestMemoryTypes[] = {
+  EfiRuntimeServicesCode,
+  EfiRuntimeServicesCode,
+  EfiRuntimeServicesCode,
+  EfiRuntimeServicesData,
+  EfiRuntimeServicesData,
+  EfiConventionalMemory,
+  EfiBootServicesData,
+  EfiReservedMemoryType
+};
+
+//
+// Image record database of the reference model, only the list is used.
+//
+STATIC IMAGE_PROPERTIES_PRIVATE_DATA  mReferencePrivateData;
+
+/**
+  Get the next pseudo random number, the sequence only depends on the seed.
+
+  @return 64-bit pseudo random number.
+**/
+STATIC
+UINT64
+NextRandom (
+  VOID
+  )
+{
+  mRandomState ^= mRandomState >> 12;
+  mRandomState ^= mRandomState << 25;
+  mRandomState ^= mRandomState >> 27;
+  return mRandomState * 0x2545F4914F6CDD1DULL;
+}
+
+/**
+  Get a pseudo random number in [0, Bound).
+
+  @param[in]  Bound   Exclusive upper bound, must not be 0.
+
+  @return Pseudo random number below Bound.
+**/
+STATIC
+UINT32
+RandomBelow (
+  IN UINT32  Bound
+  )
+{
+  return (UINT32)(NextRandom () % Bound);
+}
+
+//
+// Reference model: the list based memory map split routines as they were before
+// the image record array was introduced.
+//
+
+/**
+  Sort memory map entries based upon PhysicalStart, from low to high.
+**/
+STATIC
+VOID
+ReferenceSortMemoryMap (
+  IN OUT EFI_MEMORY_DESCRIPTOR  *MemoryMap,
+  IN UINTN                      MemoryMapSize,
+  IN UINTN                      DescriptorSize
+  )
+{
+  EFI_MEMORY_DESCRIPTOR  *MemoryMapEntry;
+  EFI_MEMORY_DESCRIPTOR  *NextMemoryMapEntry;
+  EFI_MEMORY_DESCRIPTOR  *MemoryMapEnd;
+  EFI_MEMORY_DESCRIPTOR  TempMemoryMap;
+
+  MemoryMapEntry     = MemoryMap;
+  NextMemoryMapEntry = NEXT_MEMORY_DESCRIPTOR (MemoryMapEntry, DescriptorSize);
+  MemoryMapEnd       = (EFI_MEMORY_DESCRIPTOR *)((UINT8 *)MemoryMap + MemoryMapSize);
+  while (MemoryMapEntry < MemoryMapEnd) {
+    while (NextMemoryMapEntry < MemoryMapEnd) {
+      if (MemoryMapEntry->PhysicalStart > NextMemoryMapEntry->PhysicalStart) {
+        CopyMem (&TempMemoryMap, MemoryMapEntry, sizeof (EFI_MEMORY_DESCRIPTOR));
+        CopyMem (MemoryMapEntry, NextMemoryMapEntry, sizeof (EFI_MEMORY_DESCRIPTOR));
+        CopyMem (NextMemoryMapEntry, &TempMemoryMap, sizeof (EFI_MEMORY_DESCRIPTOR));
+      }
+
+      NextMemoryMapEntry = NEXT_MEMORY_DESCRIPTOR (NextMemoryMapEntry, DescriptorSize);
+    }
+
+    MemoryMapEntry     = NEXT_MEMORY_DESCRIPTOR (MemoryMapEntry, DescriptorSize);
+    NextMemoryMapEntry = NEXT_MEMORY_DESCRIPTOR (MemoryMapEntry, DescriptorSize);
+  }
+}
+
+/**
+  Merge continuous memory map entries whose have same attributes.
+**/
+STATIC
+VOID
+ReferenceMergeMemoryMap (
+  IN OUT EFI_MEMORY_DESCRIPTOR  *MemoryMap,
+  IN OUT UINTN                  *MemoryMapSize,
+  IN UINTN                      DescriptorSize
+  )
+{
+  EFI_MEMORY_DESCRIPTOR  *MemoryMapEntry;
+  EFI_MEMORY_DESCRIPTOR  *MemoryMapEnd;
+  UINT64                 MemoryBlockLength;
+  EFI_MEMORY_DESCRIPTOR  *NewMemoryMapEntry;
+  EFI_MEMORY_DESCRIPTOR  *NextMemoryMapEntry;
+
+  MemoryMapEntry    = MemoryMap;
+  NewMemoryMapEntry = MemoryMap;
+  MemoryMapEnd      = (EFI_MEMORY_DESCRIPTOR *)((UINT8 *)MemoryMap + *MemoryMapSize);
+  while ((UINTN)MemoryMapEntry < (UINTN)MemoryMapEnd) {
+    CopyMem (NewMemoryMapEntry, MemoryMapEntry, sizeof (EFI_MEMORY_DESCRIPTOR));
+    NextMemoryMapEntry = NEXT_MEMORY_DESCRIPTOR (MemoryMapEntry, DescriptorSize);
+
+    do {
+      MemoryBlockLength = (UINT64)(EfiPagesToSize (MemoryMapEntry->NumberOfPages));
+      if (((UINTN)NextMemoryMapEntry < (UINTN)MemoryMapEnd) &&
+          (MemoryMapEntry->Type == NextMemoryMapEntry->Type) &&
+          (MemoryMapEntry->Attribute == NextMemoryMapEntry->Attribute) &&
+          ((MemoryMapEntry->PhysicalStart + MemoryBlockLength) == NextMemoryMapEntry->PhysicalStart))
+      {
+        MemoryMapEntry->NumberOfPages += NextMemoryMapEntry->NumberOfPages;
+        if (NewMemoryMapEntry != MemoryMapEntry) {
+          NewMemoryMapEntry->NumberOfPages += NextMemoryMapEntry->NumberOfPages;
+        }
+
+        NextMemoryMapEntry = NEXT_MEMORY_DESCRIPTOR (NextMemoryMapEntry, DescriptorSize);
+        continue;
+      } else {
+        MemoryMapEntry = REFERENCE_PREVIOUS_MEMORY_DESCRIPTOR (NextMemoryMapEntry, DescriptorSize);
+        break;
+      }
+    } while (TRUE);
+
+    MemoryMapEntry    = NEXT_MEMORY_DESCRIPTOR (MemoryMapEntry, DescriptorSize);
+    NewMemoryMapEntry = NEXT_MEMORY_DESCRIPTOR (NewMemoryMapEntry, DescriptorSize);
+  }
+
+  *MemoryMapSize = (UINTN)NewMemoryMapEntry - (UINTN)MemoryMap;
+}
+
+/**
+  Enforce memory map attributes.
+**/
+STATIC
+VOID
+ReferenceEnforceMemoryMapAttribute (
+  IN OUT EFI_MEMORY_DESCRIPTOR  *MemoryMap,
+  IN UINTN                      MemoryMapSize,
+  IN UINTN                      DescriptorSize
+  )
+{
+  EFI_MEMORY_DESCRIPTOR  *MemoryMapEntry;
+  EFI_MEMORY_DESCRIPTOR  *MemoryMapEnd;
+
+  MemoryMapEntry = MemoryMap;
+  MemoryMapEnd   = (EFI_MEMORY_DESCRIPTOR *)((UINT8 *)MemoryMap + MemoryMapSize);
+  while ((UINTN)MemoryMapEntry < (UINTN)MemoryMapEnd) {
+    if (MemoryMapEntry->Attribute != 0) {
+      // It is PE image, the attribute is already set.
+    } else {
+      switch (MemoryMapEntry->Type) {
+        case EfiRuntimeServicesCode:
+          MemoryMapEntry->Attribute = EFI_MEMORY_RO;
+          break;
+        case EfiRuntimeServicesData:
+        default:
+          MemoryMapEntry->Attribute |= EFI_MEMORY_XP;
+          break;
+      }
+    }
+
+    MemoryMapEntry = NEXT_MEMORY_DESCRIPTOR (MemoryMapEntry, DescriptorSize);
+  }
+}
+
+/**
+  Return the first image record, whose [ImageBase, ImageSize] covered by [Buffer, Length].
+**/
+STATIC
+IMAGE_PROPERTIES_RECORD *
+ReferenceGetImageRecordByAddress (
+  IN EFI_PHYSICAL_ADDRESS  Buffer,
+  IN UINT64                Length
+  )
+{
+  IMAGE_PROPERTIES_RECORD  *ImageRecord;
+  LIST_ENTRY               *ImageRecordLink;
+  LIST_ENTRY               *ImageRecordList;
+
+  ImageRecordList = &mReferencePrivateData.ImageRecordList;
+
+  for (ImageRecordLink = ImageRecordList->ForwardLink;
+       ImageRecordLink != ImageRecordList;
+       ImageRecordLink = ImageRecordLink->ForwardLink)
+  {
+    ImageRecord = CR (
+                    ImageRecordLink,
+                    IMAGE_PROPERTIES_RECORD,
+                    Link,
+                    IMAGE_PROPERTIES_RECORD_SIGNATURE
+                    );
+
+    if ((Buffer <= ImageRecord->ImageBase) &&
+        (Buffer + Length >= ImageRecord->ImageBase + ImageRecord->ImageSize))
+    {
+      return ImageRecord;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  Set the memory map to new entries, according to one old entry,
+  based upon PE code section and data section in image record
+**/
+STATIC
+UINTN
+ReferenceSetNewRecord (
+  IN IMAGE_PROPERTIES_RECORD    *ImageRecord,
+  IN OUT EFI_MEMORY_DESCRIPTOR  *NewRecord,
+  IN EFI_MEMORY_DESCRIPTOR      *OldRecord,
+  IN UINTN                      DescriptorSize
+  )
+{
+  EFI_MEMORY_DESCRIPTOR                 TempRecord;
+  IMAGE_PROPERTIES_RECORD_CODE_SECTION  *ImageRecordCodeSection;
+  LIST_ENTRY                            *ImageRecordCodeSectionLink;
+  LIST_ENTRY                            *ImageRecordCodeSectionEndLink;
+  LIST_ENTRY                            *ImageRecordCodeSectionList;
+  UINTN                                 NewRecordCount;
+  UINT64                                PhysicalEnd;
+  UINT64                                ImageEnd;
+
+  CopyMem (&TempRecord, OldRecord, sizeof (EFI_MEMORY_DESCRIPTOR));
+  PhysicalEnd    = TempRecord.PhysicalStart + EfiPagesToSize (TempRecord.NumberOfPages);
+  NewRecordCount = 0;
+
+  if (ImageRecord->ImageBase > TempRecord.PhysicalStart) {
+    NewRecord->Type          = TempRecord.Type;
+    NewRecord->PhysicalStart = TempRecord.PhysicalStart;
+    NewRecord->VirtualStart  = 0;
+    NewRecord->NumberOfPages = EfiSizeToPages (ImageRecord->ImageBase - TempRecord.PhysicalStart);
+    NewRecord->Attribute     = TempRecord.Attribute;
+    NewRecord                = NEXT_MEMORY_DESCRIPTOR (NewRecord, DescriptorSize);
+    NewRecordCount++;
+    TempRecord.PhysicalStart = ImageRecord->ImageBase;
+    TempRecord.NumberOfPages = EfiSizeToPages (PhysicalEnd - TempRecord.PhysicalStart);
+  }
+
+  ImageRecordCodeSectionList = &ImageRecord->CodeSegmentList;
+
+  ImageRecordCodeSectionLink    = ImageRecordCodeSectionList->ForwardLink;
+  ImageRecordCodeSectionEndLink = ImageRecordCodeSectionList;
+  while (ImageRecordCodeSectionLink != ImageRecordCodeSectionEndLink) {
+    ImageRecordCodeSection = CR (
+                               ImageRecordCodeSectionLink,
+                               IMAGE_PROPERTIES_RECORD_CODE_SECTION,
+                               Link,
+                               IMAGE_PROPERTIES_RECORD_CODE_SECTION_SIGNATURE
+                               );
+    ImageRecordCodeSectionLink = ImageRecordCodeSectionLink->ForwardLink;
+
+    if (TempRecord.PhysicalStart <= ImageRecordCodeSection->CodeSegmentBase) {
+      NewRecord->Type          = EfiRuntimeServicesData;
+      NewRecord->PhysicalStart = TempRecord.PhysicalStart;
+      NewRecord->VirtualStart  = 0;
+      NewRecord->NumberOfPages = EfiSizeToPages (ImageRecordCodeSection->CodeSegmentBase - NewRecord->PhysicalStart);
+      NewRecord->Attribute     = TempRecord.Attribute | EFI_MEMORY_XP;
+      if (NewRecord->NumberOfPages != 0) {
+        NewRecord = NEXT_MEMORY_DESCRIPTOR (NewRecord, DescriptorSize);
+        NewRecordCount++;
+      }
+
+      NewRecord->Type          = EfiRuntimeServicesCode;
+      NewRecord->PhysicalStart = ImageRecordCodeSection->CodeSegmentBase;
+      NewRecord->VirtualStart  = 0;
+      NewRecord->NumberOfPages = EfiSizeToPages (ImageRecordCodeSection->CodeSegmentSize);
+      NewRecord->Attribute     = (TempRecord.Attribute & (~EFI_MEMORY_XP)) | EFI_MEMORY_RO;
+      if (NewRecord->NumberOfPages != 0) {
+        NewRecord = NEXT_MEMORY_DESCRIPTOR (NewRecord, DescriptorSize);
+        NewRecordCount++;
+      }
+
+      TempRecord.PhysicalStart = ImageRecordCodeSection->CodeSegmentBase + EfiPagesToSize (EfiSizeToPages (ImageRecordCodeSection->CodeSegmentSize));
+      TempRecord.NumberOfPages = EfiSizeToPages (PhysicalEnd - TempRecord.PhysicalStart);
+      if (TempRecord.NumberOfPages == 0) {
+        break;
+      }
+    }
+  }
+
+  ImageEnd = ImageRecord->ImageBase + ImageRecord->ImageSize;
+
+  if (TempRecord.PhysicalStart < ImageEnd) {
+    NewRecord->Type          = EfiRuntimeServicesData;
+    NewRecord->PhysicalStart = TempRecord.PhysicalStart;
+    NewRecord->VirtualStart  = 0;
+    NewRecord->NumberOfPages = EfiSizeToPages (ImageEnd - TempRecord.PhysicalStart);
+    NewRecord->Attribute     = TempRecord.Attribute | EFI_MEMORY_XP;
+    NewRecordCount++;
+  }
+
+  return NewRecordCount;
+}
+
+/**
+  Return the max number of new splitted entries, according to one old entry.
+**/
+STATIC
+UINTN
+ReferenceGetMaxSplitRecordCount (
+  IN EFI_MEMORY_DESCRIPTOR  *OldRecord
+  )
+{
+  IMAGE_PROPERTIES_RECORD  *ImageRecord;
+  UINTN                    SplitRecordCount;
+  UINT64                   PhysicalStart;
+  UINT64                   PhysicalEnd;
+
+  SplitRecordCount = 0;
+  PhysicalStart    = OldRecord->PhysicalStart;
+  PhysicalEnd      = OldRecord->PhysicalStart + EfiPagesToSize (OldRecord->NumberOfPages);
+
+  do {
+    ImageRecord = ReferenceGetImageRecordByAddress (PhysicalStart, PhysicalEnd - PhysicalStart);
+    if (ImageRecord == NULL) {
+      break;
+    }
+
+    SplitRecordCount += (2 * ImageRecord->CodeSegmentCount + 2);
+    PhysicalStart     = ImageRecord->ImageBase + ImageRecord->ImageSize;
+  } while ((ImageRecord != NULL) && (PhysicalStart < PhysicalEnd));
+
+  return SplitRecordCount;
+}
+
+/**
+  Split the memory map to new entries, according to one old entry.
+**/
+STATIC
+UINTN
+ReferenceSplitRecord (
+  IN EFI_MEMORY_DESCRIPTOR      *OldRecord,
+  IN OUT EFI_MEMORY_DESCRIPTOR  *NewRecord,
+  IN UINTN                      MaxSplitRecordCount,
+  IN UINTN                      DescriptorSize
+  )
+{
+  EFI_MEMORY_DESCRIPTOR    TempRecord;
+  IMAGE_PROPERTIES_RECORD  *ImageRecord;
+  IMAGE_PROPERTIES_RECORD  *NewImageRecord;
+  UINT64                   PhysicalStart;
+  UINT64                   PhysicalEnd;
+  UINTN                    NewRecordCount;
+  UINTN                    TotalNewRecordCount;
+
+  if (MaxSplitRecordCount == 0) {
+    CopyMem (NewRecord, OldRecord, DescriptorSize);
+    return 0;
+  }
+
+  TotalNewRecordCount = 0;
+
+  CopyMem (&TempRecord, OldRecord, sizeof (EFI_MEMORY_DESCRIPTOR));
+  PhysicalStart = TempRecord.PhysicalStart;
+  PhysicalEnd   = TempRecord.PhysicalStart + EfiPagesToSize (TempRecord.NumberOfPages);
+
+  ImageRecord = NULL;
+  do {
+    NewImageRecord = ReferenceGetImageRecordByAddress (PhysicalStart, PhysicalEnd - PhysicalStart);
+    if (NewImageRecord == NULL) {
+      if (PhysicalEnd > PhysicalStart) {
+        NewRecord->Type          = TempRecord.Type;
+        NewRecord->PhysicalStart = TempRecord.PhysicalStart;
+        NewRecord->VirtualStart  = 0;
+        NewRecord->NumberOfPages = TempRecord.NumberOfPages;
+        NewRecord->Attribute     = TempRecord.Attribute;
+        TotalNewRecordCount++;
+      }
+
+      break;
+    }
+
+    ImageRecord = NewImageRecord;
+
+    NewRecordCount       = ReferenceSetNewRecord (ImageRecord, NewRecord, &TempRecord, DescriptorSize);
+    TotalNewRecordCount += NewRecordCount;
+    NewRecord            = (EFI_MEMORY_DESCRIPTOR *)((UINT8 *)NewRecord + NewRecordCount * DescriptorSize);
+
+    PhysicalStart            = ImageRecord->ImageBase + ImageRecord->ImageSize;
+    TempRecord.PhysicalStart = PhysicalStart;
+    TempRecord.NumberOfPages = EfiSizeToPages (PhysicalEnd - PhysicalStart);
+  } while ((ImageRecord != NULL) && (PhysicalStart < PhysicalEnd));
+
+  return TotalNewRecordCount - 1;
+}
+
+/**
+  Split the original memory map, and add more entries to describe PE code section and data section.
+**/
+STATIC
+VOID
+ReferenceSplitTable (
+  IN OUT UINTN                  *MemoryMapSize,
+  IN OUT EFI_MEMORY_DESCRIPTOR  *MemoryMap,
+  IN UINTN                      DescriptorSize
+  )
+{
+  INTN   IndexOld;
+  INTN   IndexNew;
+  UINTN  MaxSplitRecordCount;
+  UINTN  RealSplitRecordCount;
+  UINTN  TotalSplitRecordCount;
+  UINTN  AdditionalRecordCount;
+
+  AdditionalRecordCount = (2 * mReferencePrivateData.CodeSegmentCountMax + 2) * mReferencePrivateData.ImageRecordCount;
+
+  TotalSplitRecordCount = 0;
+  IndexOld              = ((*MemoryMapSize) / DescriptorSize) - 1;
+  IndexNew              = ((*MemoryMapSize) / DescriptorSize) - 1 + AdditionalRecordCount;
+  for ( ; IndexOld >= 0; IndexOld--) {
+    MaxSplitRecordCount  = ReferenceGetMaxSplitRecordCount ((EFI_MEMORY_DESCRIPTOR *)((UINT8 *)MemoryMap + IndexOld * DescriptorSize));
+    IndexNew            -= MaxSplitRecordCount;
+    RealSplitRecordCount = ReferenceSplitRecord (
+                             (EFI_MEMORY_DESCRIPTOR *)((UINT8 *)MemoryMap + IndexOld * DescriptorSize),
+                             (EFI_MEMORY_DESCRIPTOR *)((UINT8 *)MemoryMap + IndexNew * DescriptorSize),
+                             MaxSplitRecordCount,
+                             DescriptorSize
+                             );
+    if (MaxSplitRecordCount != RealSplitRecordCount) {
+      CopyMem (
+        ((UINT8 *)MemoryMap + (IndexNew + MaxSplitRecordCount - RealSplitRecordCount) * DescriptorSize),
+        ((UINT8 *)MemoryMap + IndexNew * DescriptorSize),
+        (RealSplitRecordCount + 1) * DescriptorSize
+        );
+    }
+
+    IndexNew               = IndexNew + MaxSplitRecordCount - RealSplitRecordCount;
+    TotalSplitRecordCount += RealSplitRecordCount;
+    IndexNew--;
+  }
+
+  CopyMem (
+    MemoryMap,
+    (UINT8 *)MemoryMap + (AdditionalRecordCount - TotalSplitRecordCount) * DescriptorSize,
+    (*MemoryMapSize) + TotalSplitRecordCount * DescriptorSize
+    );
+
+  *MemoryMapSize = (*MemoryMapSize) + DescriptorSize * TotalSplitRecordCount;
+
+  ReferenceSortMemoryMap (MemoryMap, *MemoryMapSize, DescriptorSize);
+  ReferenceEnforceMemoryMapAttribute (MemoryMap, *MemoryMapSize, DescriptorSize);
+  ReferenceMergeMemoryMap (MemoryMap, MemoryMapSize, DescriptorSize);
+}
+
+/**
+  Sort code section in image record, based upon CodeSegmentBase from low to high.
+**/
+STATIC
+VOID
+ReferenceSortImageRecordCodeSection (
+  IN IMAGE_PROPERTIES_RECORD  *ImageRecord
+  )
+{
+  IMAGE_PROPERTIES_RECORD_CODE_SECTION  *ImageRecordCodeSection;
+  IMAGE_PROPERTIES_RECORD_CODE_SECTION  *NextImageRecordCodeSection;
+  LIST_ENTRY                            *ImageRecordCodeSectionLink;
+  LIST_ENTRY                            *NextImageRecordCodeSectionLink;
+  LIST_ENTRY                            *ImageRecordCodeSectionEndLink;
+  EFI_PHYSICAL_ADDRESS                  TempBase;
+  UINT64                                TempSize;
+
+  ImageRecordCodeSectionLink     = ImageRecord->CodeSegmentList.ForwardLink;
+  NextImageRecordCodeSectionLink = ImageRecordCodeSectionLink->ForwardLink;
+  ImageRecordCodeSectionEndLink  = &ImageRecord->CodeSegmentList;
+  while (ImageRecordCodeSectionLink != ImageRecordCodeSectionEndLink) {
+    ImageRecordCodeSection = CR (
+                               ImageRecordCodeSectionLink,
+                               IMAGE_PROPERTIES_RECORD_CODE_SECTION,
+                               Link,
+                               IMAGE_PROPERTIES_RECORD_CODE_SECTION_SIGNATURE
+                               );
+    while (NextImageRecordCodeSectionLink != ImageRecordCodeSectionEndLink) {
+      NextImageRecordCodeSection = CR (
+                                     NextImageRecordCodeSectionLink,
+                                     IMAGE_PROPERTIES_RECORD_CODE_SECTION,
+                                     Link,
+                                     IMAGE_PROPERTIES_RECORD_CODE_SECTION_SIGNATURE
+                                     );
+      if (ImageRecordCodeSection->CodeSegmentBase > NextImageRecordCodeSection->CodeSegmentBase) {
+        TempBase                                    = ImageRecordCodeSection->CodeSegmentBase;
+        TempSize                                    = ImageRecordCodeSection->CodeSegmentSize;
+        ImageRecordCodeSection->CodeSegmentBase     = NextImageRecordCodeSection->CodeSegmentBase;
+        ImageRecordCodeSection->CodeSegmentSize     = NextImageRecordCodeSection->CodeSegmentSize;
+        NextImageRecordCodeSection->CodeSegmentBase = TempBase;
+        NextImageRecordCodeSection->CodeSegmentSize = TempSize;
+      }
+
+      NextImageRecordCodeSectionLink = NextImageRecordCodeSectionLink->ForwardLink;
+    }
+
+    ImageRecordCodeSectionLink     = ImageRecordCodeSectionLink->ForwardLink;
+    NextImageRecordCodeSectionLink = ImageRecordCodeSectionLink->ForwardLink;
+  }
+}
+
+//
+// Test helpers
+//
+
+/**
+  Create an image record out of a generated image, with its code sections inserted
+  in a shuffled order.
+
+  @param[in]  Image    The generated image.
+
+  @return The allocated image record, NULL if out of resources.
+**/
+STATIC
+IMAGE_PROPERTIES_RECORD *
+CreateTestImageRecord (
+  IN CONST SPLIT_TEST_IMAGE  *Image
+  )
+{
+  IMAGE_PROPERTIES_RECORD               *ImageRecord;
+  IMAGE_PROPERTIES_RECORD_CODE_SECTION  *CodeSection;
+  UINTN                                 Order[SPLIT_TEST_MAX_CODE_SECTIONS];
+  UINTN                                 Index;
+  UINTN                                 Other;
+  UINTN                                 Swap;
+
+  ImageRecord = AllocateZeroPool (sizeof (*ImageRecord));
+  if (ImageRecord == NULL) {
+    return NULL;
+  }
+
+  ImageRecord->Signature        = IMAGE_PROPERTIES_RECORD_SIGNATURE;
+  ImageRecord->ImageBase        = Image->ImageBase;
+  ImageRecord->ImageSize        = Image->ImageSize;
+  ImageRecord->CodeSegmentCount = Image->SectionCount;
+  InitializeListHead (&ImageRecord->CodeSegmentList);
+
+  for (Index = 0; Index < Image->SectionCount; Index++) {
+    Order[Index] = Index;
+  }
+
+  for (Index = Image->SectionCount; Index > 1; Index--) {
+    Other            = RandomBelow ((UINT32)Index);
+    Swap             = Order[Index - 1];
+    Order[Index - 1] = Order[Other];
+    Order[Other]     = Swap;
+  }
+
+  for (Index = 0; Index < Image->SectionCount; Index++) {
+    CodeSection = AllocateZeroPool (sizeof (*CodeSection));
+    if (CodeSection == NULL) {
+      break;
+    }
+
+    CodeSection->Signature       = IMAGE_PROPERTIES_RECORD_CODE_SECTION_SIGNATURE;
+    CodeSection->CodeSegmentBase = Image->Sections[Order[Index]].Base;
+    CodeSection->CodeSegmentSize = Image->Sections[Order[Index]].Size;
+    InsertTailList (&ImageRecord->CodeSegmentList, &CodeSection->Link);
+  }
+
+  return ImageRecord;
+}
+
+/**
+  Free all image records of an image record database.
+
+  @param[in, out]  PrivateData    The image record database.
+**/
+STATIC
+VOID
+FreeTestImageRecords (
+  IN OUT IMAGE_PROPERTIES_PRIVATE_DATA  *PrivateData
+  )
+{
+  IMAGE_PROPERTIES_RECORD               *ImageRecord;
+  IMAGE_PROPERTIES_RECORD_CODE_SECTION  *CodeSection;
+
+  while (!IsListEmpty (&PrivateData->ImageRecordList)) {
+    ImageRecord = CR (
+                    PrivateData->ImageRecordList.ForwardLink,
+                    IMAGE_PROPERTIES_RECORD,
+                    Link,
+                    IMAGE_PROPERTIES_RECORD_SIGNATURE
+                    );
+    while (!IsListEmpty (&ImageRecord->CodeSegmentList)) {
+      CodeSection = CR (
+                      ImageRecord->CodeSegmentList.ForwardLink,
+                      IMAGE_PROPERTIES_RECORD_CODE_SECTION,
+                      Link,
+                      IMAGE_PROPERTIES_RECORD_CODE_SECTION_SIGNATURE
+                      );
+      RemoveEntryList (&CodeSection->Link);
+      FreePool (CodeSection);
+    }
+
+    RemoveEntryList (&ImageRecord->Link);
+    FreePool (ImageRecord);
+  }
+
+  PrivateData->ImageRecordCount    = 0;
+  PrivateData->CodeSegmentCountMax = 0;
+}
+
+/**
+  Generate the code sections of an image, page aligned and not overlapping, like
+  the ones accepted by SmmCreateImageRecordInternal.
+
+  @param[in, out]  Image    The generated image, ImageBase and ImageSize are set.
+**/
+STATIC
+VOID
+GenerateTestSections (
+  IN OUT SPLIT_TEST_IMAGE  *Image
+  )
+{
+  UINT32  ImagePages;
+  UINT32  Page;
+  UINT32  Pages;
+
+  ImagePages          = (UINT32)EfiSizeToPages (Image->ImageSize);
+  Image->SectionCount = 0;
+  Page                = (ImagePages > 1) ? RandomBelow (2) : 0;
+  while ((Page < ImagePages) && (Image->SectionCount < SPLIT_TEST_MAX_CODE_SECTIONS)) {
+    Pages                                     = 1 + RandomBelow (MIN (3, ImagePages - Page));
+    Image->Sections[Image->SectionCount].Base = Image->ImageBase + EfiPagesToSize (Page);
+    // The raw data size of a section is not necessarily page aligned
+    Image->Sections[Image->SectionCount].Size = EfiPagesToSize (Pages) - RandomBelow (EFI_PAGE_SIZE);
+    Image->SectionCount++;
+    Page += Pages + RandomBelow (3);
+  }
+}
+
+/**
+  Generate a random memory map and images inside of it. The descriptors are not
+  overlapping, and are shuffled like the ones returned by MmCoreGetMemoryMap. The
+  images are not overlapping and are sorted by ImageBase.
+
+  @param[in, out]  SplitCntx    The test context to populate.
+**/
+STATIC
+VOID
+GenerateTestMemoryMap (
+  IN OUT TEST_CONTEXT_SPLIT  *SplitCntx
+  )
+{
+  EFI_MEMORY_DESCRIPTOR  Swap;
+  EFI_PHYSICAL_ADDRESS   Cursor;
+  EFI_PHYSICAL_ADDRESS   ImageCursor;
+  EFI_PHYSICAL_ADDRESS   DescriptorEnd;
+  SPLIT_TEST_IMAGE       *Image;
+  UINT64                 Pages;
+  UINTN                  Index;
+  UINTN                  Other;
+
+  SplitCntx->DescriptorCount = 1 + RandomBelow (SPLIT_TEST_MAX_DESCRIPTOR_COUNT);
+  SplitCntx->ImageCount      = 0;
+  Cursor                     = SPLIT_TEST_MEMORY_MAP_BASE;
+  ImageCursor                = Cursor;
+  for (Index = 0; Index < SplitCntx->DescriptorCount; Index++) {
+    // Leave holes now and then, adjacent descriptors of the same type are left for merging
+    if (RandomBelow (4) == 0) {
+      Cursor += EfiPagesToSize (1 + RandomBelow (4));
+    }
+
+    ZeroMem (&SplitCntx->Descriptors[Index], sizeof (EFI_MEMORY_DESCRIPTOR));
+    SplitCntx->Descriptors[Index].Type          = mSplitTestMemoryTypes[RandomBelow (ARRAY_SIZE (mSplitTestMemoryTypes))];
+    SplitCntx->Descriptors[Index].PhysicalStart = Cursor;
+    SplitCntx->Descriptors[Index].NumberOfPages = 1 + RandomBelow (SPLIT_TEST_MAX_DESCRIPTOR_PAGES);
+    SplitCntx->Descriptors[Index].Attribute     = (RandomBelow (4) == 0) ? EFI_MEMORY_SP : 0;
+    DescriptorEnd                               = Cursor + EfiPagesToSize (SplitCntx->Descriptors[Index].NumberOfPages);
+
+    //
+    // Load images into runtime code, an image rarely crosses into the next descriptor.
+    //
+    if (SplitCntx->Descriptors[Index].Type == EfiRuntimeServicesCode) {
+      ImageCursor = MAX (ImageCursor, Cursor);
+      while ((ImageCursor < DescriptorEnd) && (SplitCntx->ImageCount < SPLIT_TEST_MAX_IMAGE_COUNT)) {
+        ImageCursor += EfiPagesToSize (RandomBelow (3));
+        Pages        = 1 + RandomBelow (SPLIT_TEST_MAX_IMAGE_PAGES);
+        if ((ImageCursor + EfiPagesToSize (Pages) > DescriptorEnd) && (RandomBelow (16) != 0)) {
+          break;
+        }
+
+        Image            = &SplitCntx->Images[SplitCntx->ImageCount++];
+        Image->ImageBase = ImageCursor;
+        Image->ImageSize = EfiPagesToSize (Pages);
+        GenerateTestSections (Image);
+        ImageCursor += Image->ImageSize;
+      }
+    }
+
+    Cursor = DescriptorEnd;
+  }
+
+  for (Index = SplitCntx->DescriptorCount; Index > 1; Index--) {
+    Other = RandomBelow ((UINT32)Index);
+    CopyMem (&Swap, &SplitCntx->Descriptors[Index - 1], sizeof (Swap));
+    CopyMem (&SplitCntx->Descriptors[Index - 1], &SplitCntx->Descriptors[Other], sizeof (Swap));
+    CopyMem (&SplitCntx->Descriptors[Other], &Swap, sizeof (Swap));
+  }
+}
+
+/*
+  Helper function to seed the random generator and prepare the generated map buffers.
+*/
+UNIT_TEST_STATUS
+EFIAPI
+PrepareSplitTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  TEST_CONTEXT_SPLIT  *SplitCntx;
+
+  SplitCntx = (TEST_CONTEXT_SPLIT *)Context;
+  ZeroMem (SplitCntx, sizeof (*SplitCntx));
+  SplitCntx->PrivateData.Signature = IMAGE_PROPERTIES_PRIVATE_DATA_SIGNATURE;
+  InitializeListHead (&SplitCntx->PrivateData.ImageRecordList);
+  ZeroMem (&mReferencePrivateData, sizeof (mReferencePrivateData));
+  mReferencePrivateData.Signature = IMAGE_PROPERTIES_PRIVATE_DATA_SIGNATURE;
+  InitializeListHead (&mReferencePrivateData.ImageRecordList);
+
+  // The generator cannot leave the all zero state
+  mRandomState = (mSplitTestSeed != 0) ? mSplitTestSeed : SPLIT_TEST_DEFAULT_SEED;
+
+  SplitCntx->Descriptors = AllocatePool (SPLIT_TEST_MAX_DESCRIPTOR_COUNT * sizeof (EFI_MEMORY_DESCRIPTOR));
+  SplitCntx->Images      = AllocatePool (SPLIT_TEST_MAX_IMAGE_COUNT * sizeof (SPLIT_TEST_IMAGE));
+  UT_ASSERT_NOT_NULL (SplitCntx->Descriptors);
+  UT_ASSERT_NOT_NULL (SplitCntx->Images);
+
+  return UNIT_TEST_PASSED;
+}
+
+/*
+  Helper function to clean up the image records and generated map buffers, if needed.
+*/
+VOID
+EFIAPI
+CleanUpSplitTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  TEST_CONTEXT_SPLIT  *SplitCntx;
+
+  SplitCntx = (TEST_CONTEXT_SPLIT *)Context;
+  FreeTestImageRecords (&SplitCntx->PrivateData);
+  FreeTestImageRecords (&mReferencePrivateData);
+  if (SplitCntx->PrivateData.SortedImageRecords != NULL) {
+    FreePool (SplitCntx->PrivateData.SortedImageRecords);
+    SplitCntx->PrivateData.SortedImageRecords = NULL;
+  }
+
+  if (SplitCntx->Descriptors != NULL) {
+    FreePool (SplitCntx->Descriptors);
+    SplitCntx->Descriptors = NULL;
+  }
+
+  if (SplitCntx->Images != NULL) {
+    FreePool (SplitCntx->Images);
+    SplitCntx->Images = NULL;
+  }
+}
+
+/**
+  Split random memory maps through SplitTable and through the reference model, and
+  compare the resulting memory maps byte for byte.
+
+  @param[in]  Context    [Optional] An optional parameter that enables:
+                         1) test-case reuse with varied parameters and
+                         2) test-case re-entry for Target tests that need a
+                         reboot.  This parameter is a VOID* and it is the
+                         responsibility of the test author to ensure that the
+                         contents are well understood by all test cases that may
+                         consume it.
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+SplitTableMatchesReference (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  TEST_CONTEXT_SPLIT       *SplitCntx;
+  IMAGE_PROPERTIES_RECORD  *ImageRecord;
+  UINT8                    *ExpectedMap;
+  UINT8                    *ActualMap;
+  UINTN                    ExpectedMapSize;
+  UINTN                    ActualMapSize;
+  UINTN                    BufferSize;
+  UINTN                    AdditionalRecordCount;
+  UINTN                    Order[SPLIT_TEST_MAX_IMAGE_COUNT];
+  UINTN                    MapIndex;
+  UINTN                    Index;
+  UINTN                    Other;
+  UINTN                    Swap;
+
+  SplitCntx = (TEST_CONTEXT_SPLIT *)Context;
+
+  for (MapIndex = 0; MapIndex < SPLIT_TEST_MAP_COUNT; MapIndex++) {
+    GenerateTestMemoryMap (SplitCntx);
+
+    //
+    // The reference model gets images in ascending order, the database under test in a random one.
+    //
+    for (Index = 0; Index < SplitCntx->ImageCount; Index++) {
+      ImageRecord = CreateTestImageRecord (&SplitCntx->Images[Index]);
+      UT_ASSERT_NOT_NULL (ImageRecord);
+      ReferenceSortImageRecordCodeSection (ImageRecord);
+      InsertTailList (&mReferencePrivateData.ImageRecordList, &ImageRecord->Link);
+      mReferencePrivateData.ImageRecordCount++;
+      mReferencePrivateData.CodeSegmentCountMax = MAX (mReferencePrivateData.CodeSegmentCountMax, ImageRecord->CodeSegmentCount);
+      Order[Index]                              = Index;
+    }
+
+    for (Index = SplitCntx->ImageCount; Index > 1; Index--) {
+      Other            = RandomBelow ((UINT32)Index);
+      Swap             = Order[Index - 1];
+      Order[Index - 1] = Order[Other];
+      Order[Other]     = Swap;
+    }
+
+    for (Index = 0; Index < SplitCntx->ImageCount; Index++) {
+      ImageRecord = CreateTestImageRecord (&SplitCntx->Images[Order[Index]]);
+      UT_ASSERT_NOT_NULL (ImageRecord);
+      SortImageRecordCodeSection (ImageRecord);
+      UT_ASSERT_NOT_EFI_ERROR (InsertImageRecord (&SplitCntx->PrivateData, ImageRecord));
+    }
+
+    UT_ASSERT_EQUAL (SplitCntx->PrivateData.CodeSegmentCountMax, mReferencePrivateData.CodeSegmentCountMax);
+
+    AdditionalRecordCount = (2 * SplitCntx->PrivateData.CodeSegmentCountMax + 2) * SplitCntx->PrivateData.ImageRecordCount;
+    BufferSize            = (SplitCntx->DescriptorCount + AdditionalRecordCount) * SPLIT_TEST_DESCRIPTOR_SIZE;
+    ExpectedMap           = AllocateZeroPool (BufferSize);
+    ActualMap             = AllocateZeroPool (BufferSize);
+    UT_ASSERT_NOT_NULL (ExpectedMap);
+    UT_ASSERT_NOT_NULL (ActualMap);
+
+    for (Index = 0; Index < SplitCntx->DescriptorCount; Index++) {
+      CopyMem (ExpectedMap + Index * SPLIT_TEST_DESCRIPTOR_SIZE, &SplitCntx->Descriptors[Index], sizeof (EFI_MEMORY_DESCRIPTOR));
+    }
+
+    CopyMem (ActualMap, ExpectedMap, BufferSize);
+    ExpectedMapSize = SplitCntx->DescriptorCount * SPLIT_TEST_DESCRIPTOR_SIZE;
+    ActualMapSize   = ExpectedMapSize;
+
+    ReferenceSplitTable (&ExpectedMapSize, (EFI_MEMORY_DESCRIPTOR *)ExpectedMap, SPLIT_TEST_DESCRIPTOR_SIZE);
+    SplitTable (&SplitCntx->PrivateData, &ActualMapSize, (EFI_MEMORY_DESCRIPTOR *)ActualMap, SPLIT_TEST_DESCRIPTOR_SIZE);
+
+    if (ActualMapSize != ExpectedMapSize) {
+      UT_LOG_ERROR (
+        "Seed 0x%lx map %d: %d entries, reference %d\n",
+        mSplitTestSeed,
+        (UINT32)MapIndex,
+        (UINT32)(ActualMapSize / SPLIT_TEST_DESCRIPTOR_SIZE),
+        (UINT32)(ExpectedMapSize / SPLIT_TEST_DESCRIPTOR_SIZE)
+        );
+    }
+
+    UT_ASSERT_EQUAL (ActualMapSize, ExpectedMapSize);
+    for (Index = 0; Index < ActualMapSize / SPLIT_TEST_DESCRIPTOR_SIZE; Index++) {
+      if (CompareMem (
+            ActualMap + Index * SPLIT_TEST_DESCRIPTOR_SIZE,
+            ExpectedMap + Index * SPLIT_TEST_DESCRIPTOR_SIZE,
+            sizeof (EFI_MEMORY_DESCRIPTOR)
+            ) != 0)
+      {
+        UT_LOG_ERROR ("Seed 0x%lx map %d: entry %d differs from reference\n", mSplitTestSeed, (UINT32)MapIndex, (UINT32)Index);
+      }
+
+      UT_ASSERT_MEM_EQUAL (
+        ActualMap + Index * SPLIT_TEST_DESCRIPTOR_SIZE,
+        ExpectedMap + Index * SPLIT_TEST_DESCRIPTOR_SIZE,
+        sizeof (EFI_MEMORY_DESCRIPTOR)
+        );
+    }
+
+    FreePool (ExpectedMap);
+    FreePool (ActualMap);
+    FreeTestImageRecords (&SplitCntx->PrivateData);
+    FreeTestImageRecords (&mReferencePrivateData);
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Sort large random code section lists and check that they come out in ascending
+  order with every section kept.
+
+  @param[in]  Context    [Optional] An optional parameter that enables:
+                         1) test-case reuse with varied parameters and
+                         2) test-case re-entry for Target tests that need a
+                         reboot.  This parameter is a VOID* and it is the
+                         responsibility of the test author to ensure that the
+                         contents are well understood by all test cases that may
+                         consume it.
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+SortCodeSectionOrdersSections (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  IMAGE_PROPERTIES_RECORD               ImageRecord;
+  IMAGE_PROPERTIES_RECORD_CODE_SECTION  *CodeSections;
+  IMAGE_PROPERTIES_RECORD_CODE_SECTION  *CodeSection;
+  LIST_ENTRY                            *Link;
+  EFI_PHYSICAL_ADDRESS                  LastBase;
+  UINT64                                BaseSum;
+  UINT64                                SortedBaseSum;
+  UINTN                                 Round;
+  UINTN                                 Count;
+  UINTN                                 Index;
+
+  CodeSections = AllocatePool (SPLIT_TEST_MAX_SORTED_SECTIONS * sizeof (*CodeSections));
+  UT_ASSERT_NOT_NULL (CodeSections);
+
+  for (Round = 0; Round < SPLIT_TEST_SORT_ROUNDS; Round++) {
+    Count                        = RandomBelow (SPLIT_TEST_MAX_SORTED_SECTIONS + 1);
+    ImageRecord.Signature        = IMAGE_PROPERTIES_RECORD_SIGNATURE;
+    ImageRecord.CodeSegmentCount = Count;
+    InitializeListHead (&ImageRecord.CodeSegmentList);
+
+    BaseSum = 0;
+    for (Index = 0; Index < Count; Index++) {
+      CodeSections[Index].Signature = IMAGE_PROPERTIES_RECORD_CODE_SECTION_SIGNATURE;
+      // Keep a few duplicates and presorted runs in the mix
+      if ((Index > 0) && (RandomBelow (4) == 0)) {
+        CodeSections[Index].CodeSegmentBase = CodeSections[Index - 1].CodeSegmentBase + EfiPagesToSize (RandomBelow (2));
+      } else {
+        CodeSections[Index].CodeSegmentBase = EfiPagesToSize (RandomBelow (0x10000));
+      }
+
+      CodeSections[Index].CodeSegmentSize = EFI_PAGE_SIZE;
+      BaseSum                            += CodeSections[Index].CodeSegmentBase;
+      InsertTailList (&ImageRecord.CodeSegmentList, &CodeSections[Index].Link);
+    }
+
+    SortImageRecordCodeSection (&ImageRecord);
+
+    LastBase      = 0;
+    SortedBaseSum = 0;
+    Index         = 0;
+    for (Link = ImageRecord.CodeSegmentList.ForwardLink; Link != &ImageRecord.CodeSegmentList; Link = Link->ForwardLink) {
+      UT_ASSERT_EQUAL (Link->ForwardLink->BackLink, Link);
+      CodeSection = CR (Link, IMAGE_PROPERTIES_RECORD_CODE_SECTION, Link, IMAGE_PROPERTIES_RECORD_CODE_SECTION_SIGNATURE);
+      UT_ASSERT_TRUE (CodeSection->CodeSegmentBase >= LastBase);
+      LastBase       = CodeSection->CodeSegmentBase;
+      SortedBaseSum += CodeSection->CodeSegmentBase;
+      Index++;
+    }
+
+    UT_ASSERT_EQUAL (Index, Count);
+    UT_ASSERT_EQUAL (SortedBaseSum, BaseSum);
+  }
+
+  FreePool (CodeSections);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Initialize the unit test framework, suite, and unit tests for the memory map
+  split routines and run the tests.
+
+  @retval  EFI_SUCCESS           All test cases were dispatched.
+  @retval  EFI_OUT_OF_RESOURCES  There are not enough resources available to
+                                 initialize the unit tests.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+UnitTestingEntry (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      SplitTests;
+  TEST_CONTEXT_SPLIT          SplitContext;
+
+  Framework = NULL;
+  ZeroMem (&SplitContext, sizeof (SplitContext));
+  InitializeListHead (&SplitContext.PrivateData.ImageRecordList);
+  InitializeListHead (&mReferencePrivateData.ImageRecordList);
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_APP_NAME, UNIT_TEST_APP_VERSION));
+  DEBUG ((DEBUG_INFO, "Random seed 0x%lx\n", mSplitTestSeed));
+
+  //
+  // Start setting up the test framework for running the tests.
+  //
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_APP_NAME, gEfiCallerBaseName, UNIT_TEST_APP_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  //
+  // Populate the Memory Map Split Test Suite.
+  //
+  Status = CreateUnitTestSuite (&SplitTests, Framework, "MM Memory Map Split Tests", "MemoryMapSplit.Split", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for SplitTests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  //
+  // --------------Suite-----------Description--------------Name----------Function--------Pre---Post-------------------Context-----------
+  //
+  AddTestCase (SplitTests, "SplitTable should match reference on random maps", "DiffRandom", SplitTableMatchesReference, PrepareSplitTest, CleanUpSplitTest, &SplitContext);
+  AddTestCase (SplitTests, "Code sections should be sorted by base", "SortSections", SortCodeSectionOrdersSections, PrepareSplitTest, CleanUpSplitTest, &SplitContext);
+
+  //
+  // Execute the tests.
+  //
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+/**
+  Standard POSIX C entry point for host based unit test execution. An optional
+  first argument overrides the random seed.
+**/
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  if (argc > 1) {
+    mSplitTestSeed = strtoull (argv[1], NULL, 0);
+  }
+
+  return UnitTestingEntry ();
+}
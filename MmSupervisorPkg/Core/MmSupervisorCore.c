@@ -485,12 +485,20 @@ MmEntryPoint (
       }
 
       SupervisorToUserDataBuffer->gMmCorePrivateDummy.BufferSize = BufferSize;
-      Status                                                     = MmiManage (
-                                                                     &CommunicateHeader->HeaderGuid,
-                                                                     NULL,
-                                                                     CommunicateHeader->Data,
-                                                                     (UINTN *)&(SupervisorToUserDataBuffer->gMmCorePrivateDummy.BufferSize)
-                                                                     );
+      if (CompareGuid (&CommunicateHeader->HeaderGuid, &gMmVectoredCommunicateGuid)) {
+        Status = MmVectoredCommunicateManage (
+                   CommunicateHeader->Data,
+                   (UINTN *)&(SupervisorToUserDataBuffer->gMmCorePrivateDummy.BufferSize)
+                   );
+      } else {
+        Status = MmiManage (
+                   &CommunicateHeader->HeaderGuid,
+                   NULL,
+                   CommunicateHeader->Data,
+                   (UINTN *)&(SupervisorToUserDataBuffer->gMmCorePrivateDummy.BufferSize)
+                   );
+      }
+
       //
       // Update CommunicationBuffer, BufferSize and ReturnStatus
       // Communicate service finished, reset the pointer to CommBuffer to NULL
@@ -525,12 +533,17 @@ MmEntryPoint (
         goto Cleanup;
       }
 
-      Status = MmiManage (
-                 &CommunicateHeader->HeaderGuid,
-                 NULL,
-                 CommunicateHeader->Data,
-                 (UINTN *)&BufferSize
-                 );
+      if (CompareGuid (&CommunicateHeader->HeaderGuid, &gMmVectoredCommunicateGuid)) {
+        Status = MmVectoredCommunicateManage (CommunicateHeader->Data, (UINTN *)&BufferSize);
+      } else {
+        Status = MmiManage (
+                   &CommunicateHeader->HeaderGuid,
+                   NULL,
+                   CommunicateHeader->Data,
+                   (UINTN *)&BufferSize
+                   );
+      }
+
       //
       // Update CommunicationBuffer, BufferSize and ReturnStatus
       // Communicate service finished, reset the pointer to CommBuffer to NULL
@@ -677,6 +690,10 @@ MmCoreInstallLoadedImage (
   mMmCoreDriverEntry->ImageEntryPoint = gMmCorePrivate->MmCoreEntryPoint;
   mMmCoreDriverEntry->ImageBuffer     = gMmCorePrivate->MmCoreImageBase;
   mMmCoreDriverEntry->NumberOfPage    = EFI_SIZE_TO_PAGES ((UINTN)gMmCorePrivate->MmCoreImageSize);
+  CopyGuid (&mMmCoreDriverEntry->FileName, &gEfiCallerIdGuid);
+
+  Status = MmImageIndexInsert (mMmCoreDriverEntry, PeCoffLoaderGetPdbPointer (mMmCoreDriverEntry->LoadedImage->ImageBase));
+  ASSERT_EFI_ERROR (Status);
 
   //
   // Create a new image handle in the MM handle database for the MM Driver
@@ -908,6 +925,11 @@ MmSupervisorMain (
   ASSERT (mMmramRanges != NULL);
   CopyMem (mMmramRanges, (VOID *)(UINTN)MmramRanges, mMmramRangeCount * sizeof (EFI_MMRAM_DESCRIPTOR));
 
+  //
+  // Cache the MMRAM base the build tool assigned MM images their fixed addresses against
+  //
+  MmInitializeLoadFixedAddress ();
+
   //
   // Discover Standalone MM drivers for dispatch
   //
@@ -945,6 +967,12 @@ MmSupervisorMain (
   Status = MmInstallConfigurationTable (&gMmCoreMmst, &gEfiHobListGuid, mMmHobStart, mMmHobSize);
   ASSERT_EFI_ERROR (Status);
 
+  // The index only accelerates HOB lookups, user HOB library falls back to list walk without it
+  Status = BuildHobIndex (mMmHobStart, mMmHobSize);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_WARN, "Failed to build HOB index - %r\n", Status));
+  }
+
   //
   // Register notification for EFI_MM_CONFIGURATION_PROTOCOL registration and
   // use it to register the MM Foundation entrypoint
@@ -33,6 +33,7 @@
 #include <Guid/MmCommonRegion.h>
 #include <Guid/MmCoreProfileData.h>
 #include <Guid/MmCoreData.h>
+#include <Guid/MmVectoredCommunicate.h>
 
 #include <Library/StandaloneMmCoreEntryPoint.h>
 #include <Library/BaseLib.h>
@@ -51,6 +52,8 @@
 #include <Library/SafeIntLib.h>
 #include <Library/ResetSystemLib.h>
 
+#include <MmHobIndex.h>
+
 //
 // Used to build a table of MMI Handlers that the MM Core registers
 //
@@ -103,8 +106,23 @@ typedef struct {
   // Image Page Number
   //
   UINTN                         NumberOfPage;
+  //
+  // The image is loaded at the address assigned by build tool, its pages belong to the
+  // MMRAM range reserved for MM code and never go back to the free page list
+  //
+  BOOLEAN                       LoadedAtFixedAddress;
 } EFI_MM_DRIVER_ENTRY;
 
+//
+// Entry of the image index, which keeps the loaded images ordered by address
+//
+typedef struct {
+  PHYSICAL_ADDRESS       ImageBase;
+  UINT64                 ImageSize;
+  EFI_MM_DRIVER_ENTRY    *DriverEntry;
+  CONST CHAR8            *PdbString;    // Points into the image, NULL if the image has none
+} MM_IMAGE_INDEX_ENTRY;
+
 #define EFI_HANDLE_SIGNATURE  SIGNATURE_32('h','n','d','l')
 
 ///
@@ -246,8 +264,29 @@ extern EFI_MEMORY_DESCRIPTOR       mMmSupervisorAccessBuffer[MM_OPEN_BUFFER_CNT]
 extern LIST_ENTRY                  mFfsDriverCacheList;
 extern VOID                        *mMmHobStart;
 extern UINTN                       mMmHobSize;
+extern MM_HOB_INDEX                *mMmHobIndex;
+extern UINTN                       mMmHobIndexSize;
 extern VOID                        *mInternalCommBufferCopy[MM_OPEN_BUFFER_CNT];
 
+/**
+  Build the HOB index over the HOB list published to MM environment. The index is
+  allocated as code pages so that it will be read only in MM, same as the HOB list.
+
+  @param[in]  HobStart      Start of the published HOB list.
+  @param[in]  HobSize       Size of the published HOB list, including the end of list HOB.
+
+  @retval EFI_SUCCESS             The HOB index is successfully built.
+  @retval EFI_ALREADY_STARTED     The HOB index has already been built.
+  @retval EFI_INVALID_PARAMETER   HobStart is NULL or HobSize cannot be indexed.
+  @retval EFI_OUT_OF_RESOURCES    Cannot allocate enough resource for the HOB index.
+
+**/
+EFI_STATUS
+BuildHobIndex (
+  IN VOID   *HobStart,
+  IN UINTN  HobSize
+  );
+
 /**
   Called to initialize the memory service.
 
@@ -646,6 +685,27 @@ MmiManage (
   IN OUT UINTN           *CommBufferSize  OPTIONAL
   );
 
+/**
+  Dispatch the messages embedded in a vectored MM communicate message, in order, to the MMI
+  handlers of their HeaderGuid.
+
+  @param[in, out] CommBuffer      Points to the payload of the vectored message, starting with
+                                  MM_VECTORED_COMMUNICATE_HEADER.
+  @param[in, out] CommBufferSize  Points to the size of CommBuffer. It is used as the size cell of
+                                  each embedded message and holds the size of CommBuffer again
+                                  upon return.
+
+  @retval EFI_SUCCESS             All embedded messages are dispatched, their results are in
+                                  their entries.
+  @retval EFI_INVALID_PARAMETER   The vectored message is malformed, no message is dispatched.
+
+**/
+EFI_STATUS
+MmVectoredCommunicateManage (
+  IN OUT VOID   *CommBuffer,
+  IN OUT UINTN  *CommBufferSize
+  );
+
 /**
   Registers a supervisor handler to execute within MM. This handler will not be demoted when dispatched.
 
@@ -715,7 +775,7 @@ MmiHandlerUserUnRegister (
   );
 
 /**
-  Helper function that will look up the driver GUID from discovered list using loaded image address.
+  Helper function that will look up the driver GUID from the image index using loaded image address.
 
   @param  DriverAddr      The address of loaded image that is of interest.
   @param  Guid            The pointer to hold returned driver GUID.
@@ -731,6 +791,51 @@ FindFileNameFromDiscoveredList (
   OUT EFI_GUID              *Guid
   );
 
+/**
+  Add a loaded image to the image index.
+
+  @param[in]  DriverEntry   The driver entry of the loaded image, its LoadedImage has to
+                            describe the image in MMRAM.
+  @param[in]  PdbString     The PDB file name of the image, NULL if it has none. It has to
+                            stay valid as long as the image is loaded.
+
+  @retval EFI_SUCCESS             The image is added to the index.
+  @retval EFI_INVALID_PARAMETER   DriverEntry does not describe a loaded image.
+  @retval EFI_ALREADY_STARTED     The image overlaps one that is already indexed.
+  @retval EFI_OUT_OF_RESOURCES    Cannot grow the index.
+
+**/
+EFI_STATUS
+MmImageIndexInsert (
+  IN EFI_MM_DRIVER_ENTRY  *DriverEntry,
+  IN CONST CHAR8          *PdbString OPTIONAL
+  );
+
+/**
+  Remove an image from the image index, before its pages are freed.
+
+  @param[in]  DriverEntry   The driver entry of the image to remove.
+
+**/
+VOID
+MmImageIndexRemove (
+  IN EFI_MM_DRIVER_ENTRY  *DriverEntry
+  );
+
+/**
+  Look up the loaded image holding an address.
+
+  @param[in]  Address   The address of interest, e.g. an instruction pointer.
+
+  @return The index entry of the image holding Address, NULL if Address is not inside any
+          loaded image.
+
+**/
+CONST MM_IMAGE_INDEX_ENTRY *
+MmImageIndexLookup (
+  IN EFI_PHYSICAL_ADDRESS  Address
+  );
+
 /**
   Helper function to protect temporarily allocated buffer for ffs. They should not be changed before ready to lock.
 
@@ -775,6 +880,17 @@ MmDriverDispatchHandler (
   IN OUT UINTN       *CommBufferSize  OPTIONAL
   );
 
+/**
+  Locate the MMRAM range reserved by the IPL for the code of all MM images when the
+  Loading Module At Fixed Address feature is enabled, and cache its base in
+  gLoadModuleAtFixAddressMmramBase. Nothing is done if the feature is disabled.
+
+**/
+VOID
+MmInitializeLoadFixedAddress (
+  VOID
+  );
+
 /**
   This function is the main entry point for an MM handler dispatch
   or communicate-based callback.
@@ -850,6 +966,28 @@ MmAddMemoryRegion (
   IN      UINT64                Attributes
   );
 
+/**
+  Change the type and the owner of pages in an MMRAM region that was already allocated when it
+  was added, such as the range reserved by the IPL for the code of images loaded at fixed address.
+
+  @param[in]  Memory          The base of the pages.
+  @param[in]  NumberOfPages   The number of pages.
+  @param[in]  MemoryType      EfiRuntimeServicesCode or EfiRuntimeServicesData.
+  @param[in]  SupervisorPage  TRUE to hand the pages to supervisor, FALSE to hand them to users.
+
+  @retval EFI_SUCCESS             The pages are converted.
+  @retval EFI_INVALID_PARAMETER   The memory type is not supported, Memory is not page aligned
+                                  or NumberOfPages is zero.
+
+**/
+EFI_STATUS
+MmConvertAllocatedPages (
+  IN EFI_PHYSICAL_ADDRESS  Memory,
+  IN UINTN                 NumberOfPages,
+  IN EFI_MEMORY_TYPE       MemoryType,
+  IN BOOLEAN               SupervisorPage
+  );
+
 /**
   Finds the protocol entry for the requested protocol.
 
@@ -1013,6 +1151,8 @@ PublishMemoryAttributesTable (
   @retval   EFI_INVALID_PARAMETER   DriverEntry is NULL pointer.
   @retval   EFI_SECURITY_VIOLATION  Internal routines, such as SmmCreateImageRecordInternal,
                                     returned error codes.
+  @retval   Others                  The page table could not be updated, the image pages are XP and
+                                    writable again.
 **/
 EFI_STATUS
 EFIAPI
@@ -13,59 +13,10 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 
 #include "MmSupervisorCore.h"
 #include "Policy/Policy.h"
+#include "Policy/PolicyOverlap.h"
 
 SMM_SUPV_SECURE_POLICY_DATA_V1_0  *FirmwarePolicy;
 
-/**
-  Check overlap status between two region.
-
-  @param  Address1         The start address of region 1.
-  @param  Size1            The size of region 1.
-  @param  Address2         The start address of region 2.
-  @param  Size2            The offset of region 2.
-  @param  IsOverlapping    Boolean to return if it's overlap.
-
-  @retval EFI_SUCCESS      There aren't any overflow occurred and overlap status have checked.
-  @retval EFI_SECURITY_VIOLATION   There is a overflow occurred.
-
-**/
-STATIC
-EFI_STATUS
-OverlapStatus (
-  IN  UINTN    Address1,
-  IN  UINTN    Size1,
-  IN  UINTN    Address2,
-  IN  UINTN    Size2,
-  OUT BOOLEAN  *IsOverlapping
-  )
-{
-  UINTN  End1 = Address1 + Size1 - 1;
-  UINTN  End2 = Address2 + Size2 - 1;
-
-  // Potential underflow
-  if ((Size1 == 0) || (Size2 == 0)) {
-    return EFI_SECURITY_VIOLATION;
-  }
-
-  // Overflow
-  if (End1 < Address1) {
-    return EFI_SECURITY_VIOLATION;
-  }
-
-  // Overflow
-  if (End2 < Address2) {
-    return EFI_SECURITY_VIOLATION;
-  }
-
-  if ((Address1 <= End2) && (Address2 <= End1)) {
-    *IsOverlapping = TRUE;
-  } else {
-    *IsOverlapping = FALSE;
-  }
-
-  return EFI_SUCCESS;
-}
-
 /**
   Policy validity check for a given security policy. Check covers policy range
   overlap, policy entry header type mismatch, etc.
@@ -93,11 +44,7 @@ SecurityPolicyCheck (
   UINT64                                              TypeDuplicationFlag = 0;
   UINTN                                               Index0;
   UINTN                                               Index1;
-  UINTN                                               Index2;
-  UINTN                                               TempAddress;
-  UINTN                                               TempSize;
   UINTN                                               TotalScannedSize;
-  BOOLEAN                                             IsOverlapping;
 
   DEBUG ((DEBUG_INFO, "%a - Policy overlap check entry ...\n", __FUNCTION__));
 
@@ -130,38 +77,13 @@ SecurityPolicyCheck (
 
       TypeDuplicationFlag |= (BIT0 << SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_IO);
       IoDescriptors        = (SMM_SUPV_SECURE_POLICY_IO_DESCRIPTOR_V1_0 *)((UINTN)SmmSecurityPolicy + PolicyRoot[Index0].Offset);
-      for (Index1 = 0; Index1 < PolicyRoot[Index0].Count; Index1++) {
-        for (Index2 = 0; Index2 < Index1; Index2++) {
-          TempAddress = IoDescriptors[Index1].IoAddress;
-          TempSize    = IoDescriptors[Index1].LengthOrWidth;
-
-          // Naively iterate through all entries to check overlap
-          if (IoDescriptors[Index2].Attributes & SECURE_POLICY_RESOURCE_ATTR_STRICT_WIDTH) {
-            // Strict width entry will only be shadowed by its superset
-            if ((TempAddress <= IoDescriptors[Index2].IoAddress) &&
-                (TempAddress + TempSize >= (UINT32)IoDescriptors[Index2].IoAddress + IoDescriptors[Index2].LengthOrWidth))
-            {
-              DEBUG ((DEBUG_ERROR, "%a - IO policy strict width overlap check failed\n", __FUNCTION__));
-              Status = EFI_SECURITY_VIOLATION;
-              goto Exit;
-            }
-          } else {
-            // Otherwise, any overlap will count as policy check failure
-            Status = OverlapStatus (
-                       (UINTN)IoDescriptors[Index2].IoAddress,
-                       (UINTN)IoDescriptors[Index2].LengthOrWidth,
-                       TempAddress,
-                       TempSize,
-                       &IsOverlapping
-                       );
-            if (EFI_ERROR (Status) || IsOverlapping) {
-              DEBUG ((DEBUG_ERROR, "%a - IO policy overlap check failed - %r\n", __FUNCTION__, Status));
-              Status = EFI_SECURITY_VIOLATION;
-              goto Exit;
-            }
-          }
-        }
+      Status = CheckIoPolicyOverlap (IoDescriptors, PolicyRoot[Index0].Count);
+      if (EFI_ERROR (Status)) {
+        DEBUG ((DEBUG_ERROR, "%a - IO policy overlap check failed - %r\n", __FUNCTION__, Status));
+        goto Exit;
+      }
 
+      for (Index1 = 0; Index1 < PolicyRoot[Index0].Count; Index1++) {
         if (IoDescriptors[Index1].Reserved != 0) {
           DEBUG ((DEBUG_ERROR, "%a - IO policy has non zero reserved field.\n", __FUNCTION__));
           Status = EFI_SECURITY_VIOLATION;
@@ -182,26 +104,13 @@ SecurityPolicyCheck (
 
       TypeDuplicationFlag |= (BIT0 << SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_MEM);
       MemDescriptors       = (SMM_SUPV_SECURE_POLICY_MEM_DESCRIPTOR_V1_0 *)((UINTN)SmmSecurityPolicy + PolicyRoot[Index0].Offset);
-      for (Index1 = 0; Index1 < PolicyRoot[Index0].Count; Index1++) {
-        for (Index2 = 0; Index2 < Index1; Index2++) {
-          TempAddress = MemDescriptors[Index1].BaseAddress;
-          TempSize    = MemDescriptors[Index1].Size;
-
-          // Naively iterate through all entries to check overlap
-          Status = OverlapStatus (
-                     (UINTN)MemDescriptors[Index2].BaseAddress,
-                     (UINTN)MemDescriptors[Index2].Size,
-                     TempAddress,
-                     TempSize,
-                     &IsOverlapping
-                     );
-          if (EFI_ERROR (Status) || IsOverlapping) {
-            DEBUG ((DEBUG_ERROR, "%a - Memory policy overlap check failed - %r\n", __FUNCTION__, Status));
-            Status = EFI_SECURITY_VIOLATION;
-            goto Exit;
-          }
-        }
+      Status = CheckMemPolicyOverlap (MemDescriptors, PolicyRoot[Index0].Count);
+      if (EFI_ERROR (Status)) {
+        DEBUG ((DEBUG_ERROR, "%a - Memory policy overlap check failed - %r\n", __FUNCTION__, Status));
+        goto Exit;
+      }
 
+      for (Index1 = 0; Index1 < PolicyRoot[Index0].Count; Index1++) {
         if (MemDescriptors[Index1].Reserved != 0) {
           DEBUG ((DEBUG_ERROR, "%a - Mem policy has non zero reserved field.\n", __FUNCTION__));
           Status = EFI_SECURITY_VIOLATION;
@@ -222,26 +131,13 @@ SecurityPolicyCheck (
 
       TypeDuplicationFlag |= (BIT0 << SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_MSR);
       MsrDescriptors       = (SMM_SUPV_SECURE_POLICY_MSR_DESCRIPTOR_V1_0 *)((UINTN)SmmSecurityPolicy + PolicyRoot[Index0].Offset);
-      for (Index1 = 0; Index1 < PolicyRoot[Index0].Count; Index1++) {
-        for (Index2 = 0; Index2 < Index1; Index2++) {
-          TempAddress = MsrDescriptors[Index1].MsrAddress;
-          TempSize    = MsrDescriptors[Index1].Length;
-
-          // Naively iterate through all entries to check overlap
-          Status = OverlapStatus (
-                     (UINTN)MsrDescriptors[Index2].MsrAddress,
-                     (UINTN)MsrDescriptors[Index2].Length,
-                     TempAddress,
-                     TempSize,
-                     &IsOverlapping
-                     );
-          if (EFI_ERROR (Status) || IsOverlapping) {
-            DEBUG ((DEBUG_ERROR, "%a - MSR policy overlap check failed - %r\n", __FUNCTION__, Status));
-            Status = EFI_SECURITY_VIOLATION;
-            goto Exit;
-          }
-        }
+      Status = CheckMsrPolicyOverlap (MsrDescriptors, PolicyRoot[Index0].Count);
+      if (EFI_ERROR (Status)) {
+        DEBUG ((DEBUG_ERROR, "%a - MSR policy overlap check failed - %r\n", __FUNCTION__, Status));
+        goto Exit;
+      }
 
+      for (Index1 = 0; Index1 < PolicyRoot[Index0].Count; Index1++) {
         TotalScannedSize += sizeof (SMM_SUPV_SECURE_POLICY_MSR_DESCRIPTOR_V1_0);
       }
 
@@ -256,16 +152,13 @@ SecurityPolicyCheck (
 
       TypeDuplicationFlag |= (BIT0 << SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_INSTRUCTION);
       InstrDescriptors     = (SMM_SUPV_SECURE_POLICY_INSTRUCTION_DESCRIPTOR_V1_0 *)((UINTN)SmmSecurityPolicy + PolicyRoot[Index0].Offset);
-      for (Index1 = 0; Index1 < PolicyRoot[Index0].Count; Index1++) {
-        for (Index2 = 0; Index2 < Index1; Index2++) {
-          // Naively iterate through all entries to check duplication
-          if (InstrDescriptors[Index1].InstructionIndex == InstrDescriptors[Index2].InstructionIndex) {
-            DEBUG ((DEBUG_ERROR, "%a - Instruction policy duplication check failed - %r\n", __FUNCTION__, Status));
-            Status = EFI_SECURITY_VIOLATION;
-            goto Exit;
-          }
-        }
+      Status = CheckInstructionPolicyDuplication (InstrDescriptors, PolicyRoot[Index0].Count);
+      if (EFI_ERROR (Status)) {
+        DEBUG ((DEBUG_ERROR, "%a - Instruction policy duplication check failed - %r\n", __FUNCTION__, Status));
+        goto Exit;
+      }
 
+      for (Index1 = 0; Index1 < PolicyRoot[Index0].Count; Index1++) {
         if (InstrDescriptors[Index1].Reserved != 0) {
           DEBUG ((DEBUG_ERROR, "%a - Instruction policy has non zero reserved field.\n", __FUNCTION__));
           Status = EFI_SECURITY_VIOLATION;
@@ -286,17 +179,13 @@ SecurityPolicyCheck (
 
       TypeDuplicationFlag |= (BIT0 << SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_SAVE_STATE);
       SvstDescriptors      = (SMM_SUPV_SECURE_POLICY_SAVE_STATE_DESCRIPTOR_V1_0 *)((UINTN)SmmSecurityPolicy + PolicyRoot[Index0].Offset);
-      for (Index1 = 0; Index1 < PolicyRoot[Index0].Count; Index1++) {
-        for (Index2 = 0; Index2 < Index1; Index2++) {
-          // Naively iterate through all entries to check duplication
-          // Two policy entries with the same map field, regardless of their attributes, will not be allowed
-          if (SvstDescriptors[Index1].MapField == SvstDescriptors[Index2].MapField) {
-            DEBUG ((DEBUG_ERROR, "%a - Save state policy duplication check failed - %r\n", __FUNCTION__, Status));
-            Status = EFI_SECURITY_VIOLATION;
-            goto Exit;
-          }
-        }
+      Status = CheckSaveStatePolicyDuplication (SvstDescriptors, PolicyRoot[Index0].Count);
+      if (EFI_ERROR (Status)) {
+        DEBUG ((DEBUG_ERROR, "%a - Save state policy duplication check failed - %r\n", __FUNCTION__, Status));
+        goto Exit;
+      }
 
+      for (Index1 = 0; Index1 < PolicyRoot[Index0].Count; Index1++) {
         // Make sure no write-access related attribute is reported in the policy. This supervisor does not support it.
         // Although SMM level 30 specification permits RAX to be written on a trapped IO read, no
         // existing implementations require this feature, so it is blocked as well
@@ -594,6 +483,15 @@ InitializePolicy (
     goto Done;
   }
 
+  if (FeaturePcdGet (PcdMmSupervisorPolicyProfileEnable)) {
+    // Profiling is a diagnostic aid, do not fail the policy initialization over it
+    Status = PolicyProfileInit ();
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_ERROR, "%a Policy hit counters are not available - %r\n", __FUNCTION__, Status));
+      Status = EFI_SUCCESS;
+    }
+  }
+
 Done:
   return Status;
 }
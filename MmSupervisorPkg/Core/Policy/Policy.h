@@ -15,6 +15,10 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 
 extern SMM_SUPV_SECURE_POLICY_DATA_V1_0  *FirmwarePolicy;
 extern SMM_SUPV_SECURE_POLICY_DATA_V1_0  *MemPolicySnapshot;
+extern UINT32                            *mIoPolicyHitCounts;
+extern UINT32                            mIoPolicyHitSlotCount;
+extern UINT32                            *mMsrPolicyHitCounts;
+extern UINT32                            mMsrPolicyHitSlotCount;
 
 /**
   Dump a single memory policy data.
@@ -114,4 +118,35 @@ InitializePolicy (
   VOID
   );
 
+/**
+  Allocate the hit counters for the IO and MSR descriptors of the firmware policy.
+  Each policy root gets one counter per descriptor, plus a trailing one for the
+  walks that did not match any descriptor.
+
+  @retval EFI_SUCCESS             The hit counters are successfully allocated.
+  @retval EFI_NOT_READY           The firmware policy is not initialized yet.
+  @retval EFI_ALREADY_STARTED     The hit counters have already been allocated.
+  @retval EFI_OUT_OF_RESOURCES    Cannot allocate enough resource for the hit counters.
+
+**/
+EFI_STATUS
+PolicyProfileInit (
+  VOID
+  );
+
+/**
+  Count one policy walk against the descriptor that decided it.
+
+  @param[in]  DescriptorType    SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_IO or
+                                SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_MSR.
+  @param[in]  DescriptorIndex   Index of the deciding descriptor in its policy root,
+                                the descriptor count if none matched.
+
+**/
+VOID
+RecordPolicyHit (
+  IN UINT32  DescriptorType,
+  IN UINT32  DescriptorIndex
+  );
+
 #endif // _MM_SUPV_POLICY_H_
@@ -0,0 +1,693 @@
+/** @file
+  Overlap, shadowing and duplication checks of the descriptors of a secure policy.
+
+  Each check sorts a scratch copy of the descriptors of one policy root by start
+  address, or by key, and sweeps it once, so that policies with thousands of
+  descriptors are validated in O(n log n) instead of comparing every pair. The sort
+  is an in place heap sort, which neither recurses on the small MM stack nor degrades
+  on the already sorted memory descriptors produced from the page tables.
+
+  The verdicts are identical to the pairwise comparison they replace, including the
+  order sensitive strict width rule of IO descriptors: a descriptor following a
+  strict width descriptor is only rejected when it covers the whole strict width
+  range, while the attributes of the following descriptor do not matter.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/DebugLib.h>
+
+#include "PolicyOverlap.h"
+
+//
+// Scratch copy of an IO descriptor, End is exclusive.
+//
+typedef struct {
+  UINTN      Start;
+  UINTN      End;
+  UINTN      Index;
+  BOOLEAN    StrictWidth;
+} POLICY_IO_RANGE;
+
+//
+// Scratch copy of a memory or MSR descriptor, Last is inclusive.
+//
+typedef struct {
+  UINTN    Start;
+  UINTN    Last;
+} POLICY_RANGE;
+
+/**
+  Prototype of the callbacks ordering the entries of a scratch copy.
+
+  @param[in]  Buffer1   Pointer to the first entry.
+  @param[in]  Buffer2   Pointer to the second entry.
+
+  @retval <0            Buffer1 is ordered before Buffer2.
+  @retval 0             Buffer1 and Buffer2 are equivalent.
+  @retval >0            Buffer1 is ordered after Buffer2.
+
+**/
+typedef
+INTN
+(EFIAPI *POLICY_COMPARE)(
+  IN CONST VOID  *Buffer1,
+  IN CONST VOID  *Buffer2
+  );
+
+/**
+  Sort callback ordering IO ranges by start address and then by policy order.
+
+  @param[in]  Buffer1   Pointer to the first POLICY_IO_RANGE.
+  @param[in]  Buffer2   Pointer to the second POLICY_IO_RANGE.
+
+  @retval <0            Buffer1 is ordered before Buffer2.
+  @retval 0             The entries are identical.
+  @retval >0            Buffer1 is ordered after Buffer2.
+
+**/
+STATIC
+INTN
+EFIAPI
+CompareIoRange (
+  IN CONST VOID  *Buffer1,
+  IN CONST VOID  *Buffer2
+  )
+{
+  CONST POLICY_IO_RANGE  *Range1;
+  CONST POLICY_IO_RANGE  *Range2;
+
+  Range1 = (CONST POLICY_IO_RANGE *)Buffer1;
+  Range2 = (CONST POLICY_IO_RANGE *)Buffer2;
+
+  if (Range1->Start != Range2->Start) {
+    return (Range1->Start < Range2->Start) ? -1 : 1;
+  }
+
+  if (Range1->Index == Range2->Index) {
+    return 0;
+  }
+
+  return (Range1->Index < Range2->Index) ? -1 : 1;
+}
+
+/**
+  Sort callback ordering memory or MSR ranges by start address.
+
+  @param[in]  Buffer1   Pointer to the first POLICY_RANGE.
+  @param[in]  Buffer2   Pointer to the second POLICY_RANGE.
+
+  @retval <0            Buffer1 is ordered before Buffer2.
+  @retval 0             Both ranges start at the same address.
+  @retval >0            Buffer1 is ordered after Buffer2.
+
+**/
+STATIC
+INTN
+EFIAPI
+CompareRange (
+  IN CONST VOID  *Buffer1,
+  IN CONST VOID  *Buffer2
+  )
+{
+  UINTN  Start1;
+  UINTN  Start2;
+
+  Start1 = ((CONST POLICY_RANGE *)Buffer1)->Start;
+  Start2 = ((CONST POLICY_RANGE *)Buffer2)->Start;
+  if (Start1 == Start2) {
+    return 0;
+  }
+
+  return (Start1 < Start2) ? -1 : 1;
+}
+
+/**
+  Sort callback ordering 32-bit keys.
+
+  @param[in]  Buffer1   Pointer to the first UINT32 key.
+  @param[in]  Buffer2   Pointer to the second UINT32 key.
+
+  @retval <0            Buffer1 is ordered before Buffer2.
+  @retval 0             The keys are identical.
+  @retval >0            Buffer1 is ordered after Buffer2.
+
+**/
+STATIC
+INTN
+EFIAPI
+CompareKey (
+  IN CONST VOID  *Buffer1,
+  IN CONST VOID  *Buffer2
+  )
+{
+  UINT32  Key1;
+  UINT32  Key2;
+
+  Key1 = *(CONST UINT32 *)Buffer1;
+  Key2 = *(CONST UINT32 *)Buffer2;
+  if (Key1 == Key2) {
+    return 0;
+  }
+
+  return (Key1 < Key2) ? -1 : 1;
+}
+
+/**
+  Set a leaf of a bottom-up maximum segment tree over policy order and update its
+  ancestors. Empty leaves hold 0.
+
+  @param[in, out] Tree    The tree, 2 * Count entries.
+  @param[in]      Count   The number of leaves.
+  @param[in]      Index   The leaf to set.
+  @param[in]      Value   The value of the leaf.
+
+**/
+STATIC
+VOID
+MaxTreeSet (
+  IN OUT UINTN  *Tree,
+  IN     UINTN  Count,
+  IN     UINTN  Index,
+  IN     UINTN  Value
+  )
+{
+  Index      += Count;
+  Tree[Index] = Value;
+  for (Index >>= 1; Index > 0; Index >>= 1) {
+    Tree[Index] = MAX (Tree[2 * Index], Tree[2 * Index + 1]);
+  }
+}
+
+/**
+  Query the maximum of the leaves [First, Last) of a bottom-up maximum segment tree.
+
+  @param[in]  Tree    The tree, 2 * Count entries.
+  @param[in]  Count   The number of leaves.
+  @param[in]  First   The first leaf of the query.
+  @param[in]  Last    The leaf past the end of the query.
+
+  @return The maximum of the leaves, 0 if the range is empty.
+
+**/
+STATIC
+UINTN
+MaxTreeQuery (
+  IN CONST UINTN  *Tree,
+  IN UINTN        Count,
+  IN UINTN        First,
+  IN UINTN        Last
+  )
+{
+  UINTN  Result;
+
+  Result = 0;
+  for (First += Count, Last += Count; First < Last; First >>= 1, Last >>= 1) {
+    if ((First & 1) != 0) {
+      Result = MAX (Result, Tree[First]);
+      First++;
+    }
+
+    if ((Last & 1) != 0) {
+      Last--;
+      Result = MAX (Result, Tree[Last]);
+    }
+  }
+
+  return Result;
+}
+
+/**
+  Swap two entries of a scratch copy.
+
+  @param[in, out] Entry1      The first entry.
+  @param[in, out] Entry2      The second entry.
+  @param[in]      EntrySize   The size of an entry.
+
+**/
+STATIC
+VOID
+SwapEntries (
+  IN OUT UINT8  *Entry1,
+  IN OUT UINT8  *Entry2,
+  IN     UINTN  EntrySize
+  )
+{
+  UINT8  Byte;
+
+  while (EntrySize-- > 0) {
+    Byte      = *Entry1;
+    *Entry1++ = *Entry2;
+    *Entry2++ = Byte;
+  }
+}
+
+/**
+  Sort the entries of a scratch copy in place.
+
+  Policies are often built in ascending order already, so a single pass detects that
+  and skips the sort. Otherwise a heap sort keeps the worst case at O(n log n) without
+  recursion and without any additional buffer.
+
+  @param[in, out] Entries     The entries, sorted on return.
+  @param[in]      Count       The number of entries.
+  @param[in]      EntrySize   The size of an entry.
+  @param[in]      Compare     The callback ordering two entries.
+
+**/
+STATIC
+VOID
+SortEntries (
+  IN OUT VOID            *Entries,
+  IN     UINTN           Count,
+  IN     UINTN           EntrySize,
+  IN     POLICY_COMPARE  Compare
+  )
+{
+  UINT8  *Base;
+  UINTN  Index;
+  UINTN  Root;
+  UINTN  Child;
+  UINTN  Size;
+
+  Base = (UINT8 *)Entries;
+  for (Index = 1; Index < Count; Index++) {
+    if (Compare (Base + (Index - 1) * EntrySize, Base + Index * EntrySize) > 0) {
+      break;
+    }
+  }
+
+  if (Index >= Count) {
+    return;
+  }
+
+  //
+  // Build a max heap, then move its root past the end of the shrinking heap. Index
+  // walks the roots to sift down, first the parents when building, then the root.
+  //
+  for (Size = Count, Index = Count / 2; Size > 1;) {
+    if (Index > 0) {
+      Index--;
+    } else {
+      Size--;
+      SwapEntries (Base, Base + Size * EntrySize, EntrySize);
+    }
+
+    for (Root = Index; (Child = 2 * Root + 1) < Size; Root = Child) {
+      if ((Child + 1 < Size) && (Compare (Base + Child * EntrySize, Base + (Child + 1) * EntrySize) < 0)) {
+        Child++;
+      }
+
+      if (Compare (Base + Root * EntrySize, Base + Child * EntrySize) >= 0) {
+        break;
+      }
+
+      SwapEntries (Base + Root * EntrySize, Base + Child * EntrySize, EntrySize);
+    }
+  }
+}
+
+/**
+  Check the IO descriptors of a policy root against each other.
+
+  A descriptor following a strict width descriptor may only overlap it as long as it
+  does not cover the whole range of the strict width descriptor. Any other overlap
+  between two descriptors, or a zero sized descriptor paired with a preceding non
+  strict width descriptor, fails the check.
+
+  @param[in]  Descriptors   The IO descriptors, in policy order.
+  @param[in]  Count         The number of entries of Descriptors.
+
+  @retval EFI_SUCCESS             The descriptors do not conflict.
+  @retval EFI_SECURITY_VIOLATION  Two descriptors conflict.
+  @retval EFI_OUT_OF_RESOURCES    The scratch copy could not be allocated.
+
+**/
+EFI_STATUS
+CheckIoPolicyOverlap (
+  IN CONST SMM_SUPV_SECURE_POLICY_IO_DESCRIPTOR_V1_0  *Descriptors,
+  IN UINTN                                            Count
+  )
+{
+  EFI_STATUS       Status;
+  POLICY_IO_RANGE  *Ranges;
+  POLICY_IO_RANGE  *Range;
+  UINTN            *Trees;
+  UINTN            *NonStrictTree;
+  UINTN            *StrictTree;
+  UINTN            *AnyTree;
+  UINTN            FirstNonStrict;
+  UINTN            GroupStart;
+  UINTN            GroupEnd;
+  UINTN            Index;
+  BOOLEAN          StrictWidth;
+
+  if (Count < 2) {
+    return EFI_SUCCESS;
+  }
+
+  //
+  // A zero sized descriptor fails against any preceding non strict width descriptor,
+  // and a zero sized non strict width descriptor fails against any following one.
+  //
+  FirstNonStrict = Count;
+  for (Index = 0; Index < Count; Index++) {
+    StrictWidth = ((Descriptors[Index].Attributes & SECURE_POLICY_RESOURCE_ATTR_STRICT_WIDTH) != 0);
+    if ((Descriptors[Index].LengthOrWidth == 0) &&
+        ((FirstNonStrict < Index) || (!StrictWidth && (Index < Count - 1))))
+    {
+      DEBUG ((DEBUG_ERROR, "%a - IO policy %d has zero size\n", __FUNCTION__, Index));
+      return EFI_SECURITY_VIOLATION;
+    }
+
+    if (!StrictWidth && (FirstNonStrict == Count)) {
+      FirstNonStrict = Index;
+    }
+  }
+
+  Ranges = AllocatePool (Count * sizeof (POLICY_IO_RANGE));
+  Trees  = AllocateZeroPool (3 * 2 * Count * sizeof (UINTN));
+  if ((Ranges == NULL) || (Trees == NULL)) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Exit;
+  }
+
+  //
+  // Maximum segment trees over policy order of the exclusive ends of the non zero
+  // sized non strict and strict width ranges, and of the exclusive ends plus 1 of
+  // all ranges, so that an empty range at 0 still differs from an empty leaf.
+  //
+  NonStrictTree = Trees;
+  StrictTree    = Trees + 2 * Count;
+  AnyTree       = Trees + 4 * Count;
+
+  for (Index = 0; Index < Count; Index++) {
+    Ranges[Index].Start       = Descriptors[Index].IoAddress;
+    Ranges[Index].End         = (UINTN)Descriptors[Index].IoAddress + Descriptors[Index].LengthOrWidth;
+    Ranges[Index].Index       = Index;
+    Ranges[Index].StrictWidth = ((Descriptors[Index].Attributes & SECURE_POLICY_RESOURCE_ATTR_STRICT_WIDTH) != 0);
+  }
+
+  SortEntries (Ranges, Count, sizeof (POLICY_IO_RANGE), CompareIoRange);
+
+  //
+  // Sweep by start address. All ranges sharing a start address are inserted before
+  // any of them is checked, so that every range in the trees starts at or below the
+  // one being checked. Overlap then reduces to an inserted end above its start, and
+  // covering a strict width range to an inserted end at or above its end.
+  //
+  Status = EFI_SUCCESS;
+  for (GroupStart = 0; GroupStart < Count; GroupStart = GroupEnd) {
+    for (GroupEnd = GroupStart; (GroupEnd < Count) && (Ranges[GroupEnd].Start == Ranges[GroupStart].Start); GroupEnd++) {
+      Range = &Ranges[GroupEnd];
+      MaxTreeSet (AnyTree, Count, Range->Index, Range->End + 1);
+      if (Range->End != Range->Start) {
+        MaxTreeSet (Range->StrictWidth ? StrictTree : NonStrictTree, Count, Range->Index, Range->End);
+      }
+    }
+
+    for (Index = GroupStart; Index < GroupEnd; Index++) {
+      Range = &Ranges[Index];
+      if (Range->StrictWidth) {
+        // Strict width entry will only be shadowed by its superset
+        if (MaxTreeQuery (AnyTree, Count, Range->Index + 1, Count) >= Range->End + 1) {
+          DEBUG ((DEBUG_ERROR, "%a - IO policy %d strict width overlap check failed\n", __FUNCTION__, Range->Index));
+          Status = EFI_SECURITY_VIOLATION;
+          goto Exit;
+        }
+
+        // But it may not overlap any preceding non strict width entry
+        if ((Range->End != Range->Start) &&
+            (MaxTreeQuery (NonStrictTree, Count, 0, Range->Index) > Range->Start))
+        {
+          DEBUG ((DEBUG_ERROR, "%a - IO policy %d overlap check failed\n", __FUNCTION__, Range->Index));
+          Status = EFI_SECURITY_VIOLATION;
+          goto Exit;
+        }
+      } else if (Range->End != Range->Start) {
+        // Otherwise, any other non strict width entry or following entry may not overlap it
+        if ((MaxTreeQuery (NonStrictTree, Count, 0, Range->Index) > Range->Start) ||
+            (MaxTreeQuery (NonStrictTree, Count, Range->Index + 1, Count) > Range->Start) ||
+            (MaxTreeQuery (StrictTree, Count, Range->Index + 1, Count) > Range->Start))
+        {
+          DEBUG ((DEBUG_ERROR, "%a - IO policy %d overlap check failed\n", __FUNCTION__, Range->Index));
+          Status = EFI_SECURITY_VIOLATION;
+          goto Exit;
+        }
+      }
+    }
+  }
+
+Exit:
+  if (Ranges != NULL) {
+    FreePool (Ranges);
+  }
+
+  if (Trees != NULL) {
+    FreePool (Trees);
+  }
+
+  return Status;
+}
+
+/**
+  Sort a scratch copy of memory or MSR ranges and check that no two of them overlap.
+
+  @param[in, out] Ranges    The ranges, sorted by start address on return.
+  @param[in]      Count     The number of entries of Ranges, at least 1.
+
+  @retval EFI_SUCCESS             The ranges do not overlap.
+  @retval EFI_SECURITY_VIOLATION  Two ranges overlap.
+
+**/
+STATIC
+EFI_STATUS
+CheckSortedRangeOverlap (
+  IN OUT POLICY_RANGE  *Ranges,
+  IN     UINTN         Count
+  )
+{
+  UINTN  Index;
+
+  SortEntries (Ranges, Count, sizeof (POLICY_RANGE), CompareRange);
+
+  // Once sorted, a range can only overlap the ones right before it
+  for (Index = 1; Index < Count; Index++) {
+    if (Ranges[Index].Start <= Ranges[Index - 1].Last) {
+      return EFI_SECURITY_VIOLATION;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Check that the memory descriptors of a policy root do not overlap. When there is
+  more than one descriptor, a zero sized or wrapping descriptor fails the check too.
+
+  @param[in]  Descriptors   The memory descriptors, in policy order.
+  @param[in]  Count         The number of entries of Descriptors.
+
+  @retval EFI_SUCCESS             The descriptors do not overlap.
+  @retval EFI_SECURITY_VIOLATION  Two descriptors overlap, or one is malformed.
+  @retval EFI_OUT_OF_RESOURCES    The scratch copy could not be allocated.
+
+**/
+EFI_STATUS
+CheckMemPolicyOverlap (
+  IN CONST SMM_SUPV_SECURE_POLICY_MEM_DESCRIPTOR_V1_0  *Descriptors,
+  IN UINTN                                             Count
+  )
+{
+  EFI_STATUS    Status;
+  POLICY_RANGE  *Ranges;
+  UINTN         Index;
+
+  if (Count < 2) {
+    return EFI_SUCCESS;
+  }
+
+  Ranges = AllocatePool (Count * sizeof (POLICY_RANGE));
+  if (Ranges == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  for (Index = 0; Index < Count; Index++) {
+    Ranges[Index].Start = (UINTN)Descriptors[Index].BaseAddress;
+    Ranges[Index].Last  = Ranges[Index].Start + (UINTN)Descriptors[Index].Size - 1;
+    if ((Descriptors[Index].Size == 0) || (Ranges[Index].Last < Ranges[Index].Start)) {
+      DEBUG ((DEBUG_ERROR, "%a - Memory policy %d has invalid size\n", __FUNCTION__, Index));
+      Status = EFI_SECURITY_VIOLATION;
+      goto Exit;
+    }
+  }
+
+  Status = CheckSortedRangeOverlap (Ranges, Count);
+
+Exit:
+  FreePool (Ranges);
+  return Status;
+}
+
+/**
+  Check that the MSR descriptors of a policy root do not overlap. When there is
+  more than one descriptor, a zero sized or wrapping descriptor fails the check too.
+
+  @param[in]  Descriptors   The MSR descriptors, in policy order.
+  @param[in]  Count         The number of entries of Descriptors.
+
+  @retval EFI_SUCCESS             The descriptors do not overlap.
+  @retval EFI_SECURITY_VIOLATION  Two descriptors overlap, or one is malformed.
+  @retval EFI_OUT_OF_RESOURCES    The scratch copy could not be allocated.
+
+**/
+EFI_STATUS
+CheckMsrPolicyOverlap (
+  IN CONST SMM_SUPV_SECURE_POLICY_MSR_DESCRIPTOR_V1_0  *Descriptors,
+  IN UINTN                                             Count
+  )
+{
+  EFI_STATUS    Status;
+  POLICY_RANGE  *Ranges;
+  UINTN         Index;
+
+  if (Count < 2) {
+    return EFI_SUCCESS;
+  }
+
+  Ranges = AllocatePool (Count * sizeof (POLICY_RANGE));
+  if (Ranges == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  for (Index = 0; Index < Count; Index++) {
+    Ranges[Index].Start = (UINTN)Descriptors[Index].MsrAddress;
+    Ranges[Index].Last  = Ranges[Index].Start + (UINTN)Descriptors[Index].Length - 1;
+    if ((Descriptors[Index].Length == 0) || (Ranges[Index].Last < Ranges[Index].Start)) {
+      DEBUG ((DEBUG_ERROR, "%a - MSR policy %d has invalid size\n", __FUNCTION__, Index));
+      Status = EFI_SECURITY_VIOLATION;
+      goto Exit;
+    }
+  }
+
+  Status = CheckSortedRangeOverlap (Ranges, Count);
+
+Exit:
+  FreePool (Ranges);
+  return Status;
+}
+
+/**
+  Sort a scratch copy of keys and check that they are unique.
+
+  @param[in, out] Keys      The keys, sorted on return.
+  @param[in]      Count     The number of entries of Keys, at least 1.
+
+  @retval EFI_SUCCESS             Every key is unique.
+  @retval EFI_SECURITY_VIOLATION  A key is duplicated.
+
+**/
+STATIC
+EFI_STATUS
+CheckSortedKeyDuplication (
+  IN OUT UINT32  *Keys,
+  IN     UINTN   Count
+  )
+{
+  UINTN  Index;
+
+  SortEntries (Keys, Count, sizeof (UINT32), CompareKey);
+  for (Index = 1; Index < Count; Index++) {
+    if (Keys[Index] == Keys[Index - 1]) {
+      return EFI_SECURITY_VIOLATION;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Check that no two instruction descriptors of a policy root share an instruction index.
+
+  @param[in]  Descriptors   The instruction descriptors, in policy order.
+  @param[in]  Count         The number of entries of Descriptors.
+
+  @retval EFI_SUCCESS             Every instruction index is unique.
+  @retval EFI_SECURITY_VIOLATION  Two descriptors share an instruction index.
+  @retval EFI_OUT_OF_RESOURCES    The scratch copy could not be allocated.
+
+**/
+EFI_STATUS
+CheckInstructionPolicyDuplication (
+  IN CONST SMM_SUPV_SECURE_POLICY_INSTRUCTION_DESCRIPTOR_V1_0  *Descriptors,
+  IN UINTN                                                     Count
+  )
+{
+  EFI_STATUS  Status;
+  UINT32      *Keys;
+  UINTN       Index;
+
+  if (Count < 2) {
+    return EFI_SUCCESS;
+  }
+
+  Keys = AllocatePool (Count * sizeof (UINT32));
+  if (Keys == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  for (Index = 0; Index < Count; Index++) {
+    Keys[Index] = Descriptors[Index].InstructionIndex;
+  }
+
+  Status = CheckSortedKeyDuplication (Keys, Count);
+  FreePool (Keys);
+  return Status;
+}
+
+/**
+  Check that no two save state descriptors of a policy root share a map field,
+  regardless of their attributes.
+
+  @param[in]  Descriptors   The save state descriptors, in policy order.
+  @param[in]  Count         The number of entries of Descriptors.
+
+  @retval EFI_SUCCESS             Every map field is unique.
+  @retval EFI_SECURITY_VIOLATION  Two descriptors share a map field.
+  @retval EFI_OUT_OF_RESOURCES    The scratch copy could not be allocated.
+
+**/
+EFI_STATUS
+CheckSaveStatePolicyDuplication (
+  IN CONST SMM_SUPV_SECURE_POLICY_SAVE_STATE_DESCRIPTOR_V1_0  *Descriptors,
+  IN UINTN                                                    Count
+  )
+{
+  EFI_STATUS  Status;
+  UINT32      *Keys;
+  UINTN       Index;
+
+  if (Count < 2) {
+    return EFI_SUCCESS;
+  }
+
+  Keys = AllocatePool (Count * sizeof (UINT32));
+  if (Keys == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  for (Index = 0; Index < Count; Index++) {
+    Keys[Index] = Descriptors[Index].MapField;
+  }
+
+  Status = CheckSortedKeyDuplication (Keys, Count);
+  FreePool (Keys);
+  return Status;
+}
@@ -0,0 +1,111 @@
+/** @file
+  Overlap, shadowing and duplication checks of the descriptors of a secure policy.
+
+  The checks sort a scratch copy of the descriptors and sweep it once, instead of
+  comparing every pair of descriptors. They only depend on the descriptors passed
+  in, so that they can be exercised by host based unit tests.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef POLICY_OVERLAP_H_
+#define POLICY_OVERLAP_H_
+
+#include <SmmSecurePolicy.h>
+
+/**
+  Check the IO descriptors of a policy root against each other.
+
+  A descriptor following a strict width descriptor may only overlap it as long as it
+  does not cover the whole range of the strict width descriptor. Any other overlap
+  between two descriptors, or a zero sized descriptor paired with a preceding non
+  strict width descriptor, fails the check.
+
+  @param[in]  Descriptors   The IO descriptors, in policy order.
+  @param[in]  Count         The number of entries of Descriptors.
+
+  @retval EFI_SUCCESS             The descriptors do not conflict.
+  @retval EFI_SECURITY_VIOLATION  Two descriptors conflict.
+  @retval EFI_OUT_OF_RESOURCES    The scratch copy could not be allocated.
+
+**/
+EFI_STATUS
+CheckIoPolicyOverlap (
+  IN CONST SMM_SUPV_SECURE_POLICY_IO_DESCRIPTOR_V1_0  *Descriptors,
+  IN UINTN                                            Count
+  );
+
+/**
+  Check that the memory descriptors of a policy root do not overlap. When there is
+  more than one descriptor, a zero sized or wrapping descriptor fails the check too.
+
+  @param[in]  Descriptors   The memory descriptors, in policy order.
+  @param[in]  Count         The number of entries of Descriptors.
+
+  @retval EFI_SUCCESS             The descriptors do not overlap.
+  @retval EFI_SECURITY_VIOLATION  Two descriptors overlap, or one is malformed.
+  @retval EFI_OUT_OF_RESOURCES    The scratch copy could not be allocated.
+
+**/
+EFI_STATUS
+CheckMemPolicyOverlap (
+  IN CONST SMM_SUPV_SECURE_POLICY_MEM_DESCRIPTOR_V1_0  *Descriptors,
+  IN UINTN                                             Count
+  );
+
+/**
+  Check that the MSR descriptors of a policy root do not overlap. When there is
+  more than one descriptor, a zero sized or wrapping descriptor fails the check too.
+
+  @param[in]  Descriptors   The MSR descriptors, in policy order.
+  @param[in]  Count         The number of entries of Descriptors.
+
+  @retval EFI_SUCCESS             The descriptors do not overlap.
+  @retval EFI_SECURITY_VIOLATION  Two descriptors overlap, or one is malformed.
+  @retval EFI_OUT_OF_RESOURCES    The scratch copy could not be allocated.
+
+**/
+EFI_STATUS
+CheckMsrPolicyOverlap (
+  IN CONST SMM_SUPV_SECURE_POLICY_MSR_DESCRIPTOR_V1_0  *Descriptors,
+  IN UINTN                                             Count
+  );
+
+/**
+  Check that no two instruction descriptors of a policy root share an instruction index.
+
+  @param[in]  Descriptors   The instruction descriptors, in policy order.
+  @param[in]  Count         The number of entries of Descriptors.
+
+  @retval EFI_SUCCESS             Every instruction index is unique.
+  @retval EFI_SECURITY_VIOLATION  Two descriptors share an instruction index.
+  @retval EFI_OUT_OF_RESOURCES    The scratch copy could not be allocated.
+
+**/
+EFI_STATUS
+CheckInstructionPolicyDuplication (
+  IN CONST SMM_SUPV_SECURE_POLICY_INSTRUCTION_DESCRIPTOR_V1_0  *Descriptors,
+  IN UINTN                                                     Count
+  );
+
+/**
+  Check that no two save state descriptors of a policy root share a map field,
+  regardless of their attributes.
+
+  @param[in]  Descriptors   The save state descriptors, in policy order.
+  @param[in]  Count         The number of entries of Descriptors.
+
+  @retval EFI_SUCCESS             Every map field is unique.
+  @retval EFI_SECURITY_VIOLATION  Two descriptors share a map field.
+  @retval EFI_OUT_OF_RESOURCES    The scratch copy could not be allocated.
+
+**/
+EFI_STATUS
+CheckSaveStatePolicyDuplication (
+  IN CONST SMM_SUPV_SECURE_POLICY_SAVE_STATE_DESCRIPTOR_V1_0  *Descriptors,
+  IN UINTN                                                    Count
+  );
+
+#endif // POLICY_OVERLAP_H_
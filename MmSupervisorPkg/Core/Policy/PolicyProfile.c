@@ -0,0 +1,127 @@
+/** @file
+  Per-descriptor hit counters of the IO and MSR policy roots.
+
+  When PcdMmSupervisorPolicyProfileEnable is set, the syscall dispatcher records
+  which descriptor decided each IO and MSR request. The counters are exported
+  through MM_SUPERVISOR_REQUEST_POLICY_PROFILE so that SupervisorPolicyMaker.py
+  can move the hottest descriptors towards the front of their policy roots.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <PiMm.h>
+#include <SmmSecurePolicy.h>
+
+#include <Library/BaseLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/SynchronizationLib.h>
+
+#include "MmSupervisorCore.h"
+#include "Policy/Policy.h"
+
+UINT32  *mIoPolicyHitCounts    = NULL;
+UINT32  mIoPolicyHitSlotCount  = 0;
+UINT32  *mMsrPolicyHitCounts   = NULL;
+UINT32  mMsrPolicyHitSlotCount = 0;
+
+/**
+  Allocate the hit counters for the IO and MSR descriptors of the firmware policy.
+  Each policy root gets one counter per descriptor, plus a trailing one for the
+  walks that did not match any descriptor.
+
+  @retval EFI_SUCCESS             The hit counters are successfully allocated.
+  @retval EFI_NOT_READY           The firmware policy is not initialized yet.
+  @retval EFI_ALREADY_STARTED     The hit counters have already been allocated.
+  @retval EFI_OUT_OF_RESOURCES    Cannot allocate enough resource for the hit counters.
+
+**/
+EFI_STATUS
+PolicyProfileInit (
+  VOID
+  )
+{
+  SMM_SUPV_POLICY_ROOT_V1  *PolicyRoot;
+  UINT32                   Index;
+  UINT32                   IoSlots;
+  UINT32                   MsrSlots;
+
+  if (FirmwarePolicy == NULL) {
+    return EFI_NOT_READY;
+  }
+
+  if ((mIoPolicyHitCounts != NULL) || (mMsrPolicyHitCounts != NULL)) {
+    return EFI_ALREADY_STARTED;
+  }
+
+  IoSlots    = 1;
+  MsrSlots   = 1;
+  PolicyRoot = (SMM_SUPV_POLICY_ROOT_V1 *)((UINTN)FirmwarePolicy + FirmwarePolicy->PolicyRootOffset);
+  for (Index = 0; Index < FirmwarePolicy->PolicyRootCount; Index++) {
+    if (PolicyRoot[Index].Type == SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_IO) {
+      IoSlots = PolicyRoot[Index].Count + 1;
+    } else if (PolicyRoot[Index].Type == SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_MSR) {
+      MsrSlots = PolicyRoot[Index].Count + 1;
+    }
+  }
+
+  mIoPolicyHitCounts  = AllocateZeroPool (IoSlots * sizeof (UINT32));
+  mMsrPolicyHitCounts = AllocateZeroPool (MsrSlots * sizeof (UINT32));
+  if ((mIoPolicyHitCounts == NULL) || (mMsrPolicyHitCounts == NULL)) {
+    DEBUG ((DEBUG_ERROR, "%a Failed to allocate %d IO and %d MSR hit counters\n", __FUNCTION__, IoSlots, MsrSlots));
+    if (mIoPolicyHitCounts != NULL) {
+      FreePool (mIoPolicyHitCounts);
+      mIoPolicyHitCounts = NULL;
+    }
+
+    if (mMsrPolicyHitCounts != NULL) {
+      FreePool (mMsrPolicyHitCounts);
+      mMsrPolicyHitCounts = NULL;
+    }
+
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  mIoPolicyHitSlotCount  = IoSlots;
+  mMsrPolicyHitSlotCount = MsrSlots;
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Count one policy walk against the descriptor that decided it.
+
+  @param[in]  DescriptorType    SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_IO or
+                                SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_MSR.
+  @param[in]  DescriptorIndex   Index of the deciding descriptor in its policy root,
+                                the descriptor count if none matched.
+
+**/
+VOID
+RecordPolicyHit (
+  IN UINT32  DescriptorType,
+  IN UINT32  DescriptorIndex
+  )
+{
+  UINT32  *HitCounts;
+  UINT32  SlotCount;
+
+  if (DescriptorType == SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_IO) {
+    HitCounts = mIoPolicyHitCounts;
+    SlotCount = mIoPolicyHitSlotCount;
+  } else if (DescriptorType == SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_MSR) {
+    HitCounts = mMsrPolicyHitCounts;
+    SlotCount = mMsrPolicyHitSlotCount;
+  } else {
+    return;
+  }
+
+  if ((HitCounts == NULL) || (DescriptorIndex >= SlotCount)) {
+    return;
+  }
+
+  // Multiple CPUs can be serving syscalls at the same time
+  InterlockedIncrement (&HitCounts[DescriptorIndex]);
+}
@@ -0,0 +1,913 @@
+/** @file
+  Host based unit tests of the overlap, shadowing and duplication checks of secure
+  policy descriptors.
+
+  Random descriptor tables are checked through the sort and sweep routines and
+  through a copy of the previous pairwise comparison, and the verdicts are compared.
+  The tables are drawn from a narrow address window, so that overlaps, strict width
+  shadowing, zero sized and wrapping descriptors are frequent, and from a sparse
+  layout with a few injected conflicts, so that accepted tables are frequent too.
+
+  The random seed can be supplied as the first command line argument to reproduce
+  a reported failure.
+
+  Copyright (C) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#include <Library/UnitTestLib.h>
+
+#include "../PolicyOverlap.h"
+
+#define UNIT_TEST_APP_NAME     "MM Policy Overlap Tests"
+#define UNIT_TEST_APP_VERSION  "1.0"
+
+#define OVERLAP_TEST_DEFAULT_SEED      0x6C1D94E25B7A0F38ULL
+#define OVERLAP_TEST_POLICY_COUNT      4096
+#define OVERLAP_TEST_MAX_DESCRIPTORS   48
+#define OVERLAP_TEST_LARGE_COUNT       4000
+#define OVERLAP_TEST_SORTED_COUNT      0x40000
+
+STATIC UINT64  mOverlapTestSeed = OVERLAP_TEST_DEFAULT_SEED;
+STATIC UINT64  mRandomState;
+
+/**
+  Restart the pseudo random sequence, so that every test case draws its own
+  sequence from the seed.
+
+  @param[in]  Stream    Identifies the sequence of a test case.
+**/
+STATIC
+VOID
+SeedRandom (
+  IN UINT64  Stream
+  )
+{
+  mRandomState = mOverlapTestSeed + Stream * 0x9E3779B97F4A7C15ULL;
+  // A zero state would stay zero
+  if (mRandomState == 0) {
+    mRandomState = OVERLAP_TEST_DEFAULT_SEED;
+  }
+}
+
+/**
+  Get the next pseudo random number, the sequence only depends on the seed.
+
+  @return 64-bit pseudo random number.
+**/
+STATIC
+UINT64
+NextRandom (
+  VOID
+  )
+{
+  mRandomState ^= mRandomState >> 12;
+  mRandomState ^= mRandomState << 25;
+  mRandomState ^= mRandomState >> 27;
+  return mRandomState * 0x2545F4914F6CDD1DULL;
+}
+
+/**
+  Get a pseudo random number in [0, Bound).
+
+  @param[in]  Bound   Exclusive upper bound, must not be 0.
+
+  @return Pseudo random number below Bound.
+**/
+STATIC
+UINT32
+RandomBelow (
+  IN UINT32  Bound
+  )
+{
+  return (UINT32)(NextRandom () % Bound);
+}
+
+//
+// Reference model: the pairwise comparison of SecurityPolicyCheck as it was before
+// the descriptors were sorted.
+//
+
+/**
+  Check overlap status between two region.
+
+  @param  Address1         The start address of region 1.
+  @param  Size1            The size of region 1.
+  @param  Address2         The start address of region 2.
+  @param  Size2            The offset of region 2.
+  @param  IsOverlapping    Boolean to return if it's overlap.
+
+  @retval EFI_SUCCESS      There aren't any overflow occurred and overlap status have checked.
+  @retval EFI_SECURITY_VIOLATION   There is a overflow occurred.
+
+**/
+STATIC
+EFI_STATUS
+ReferenceOverlapStatus (
+  IN  UINTN    Address1,
+  IN  UINTN    Size1,
+  IN  UINTN    Address2,
+  IN  UINTN    Size2,
+  OUT BOOLEAN  *IsOverlapping
+  )
+{
+  UINTN  End1 = Address1 + Size1 - 1;
+  UINTN  End2 = Address2 + Size2 - 1;
+
+  // Potential underflow
+  if ((Size1 == 0) || (Size2 == 0)) {
+    return EFI_SECURITY_VIOLATION;
+  }
+
+  // Overflow
+  if (End1 < Address1) {
+    return EFI_SECURITY_VIOLATION;
+  }
+
+  // Overflow
+  if (End2 < Address2) {
+    return EFI_SECURITY_VIOLATION;
+  }
+
+  if ((Address1 <= End2) && (Address2 <= End1)) {
+    *IsOverlapping = TRUE;
+  } else {
+    *IsOverlapping = FALSE;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Pairwise IO descriptor check of the reference model.
+**/
+STATIC
+EFI_STATUS
+ReferenceCheckIo (
+  IN CONST SMM_SUPV_SECURE_POLICY_IO_DESCRIPTOR_V1_0  *IoDescriptors,
+  IN UINTN                                            Count
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Index1;
+  UINTN       Index2;
+  UINTN       TempAddress;
+  UINTN       TempSize;
+  BOOLEAN     IsOverlapping;
+
+  for (Index1 = 0; Index1 < Count; Index1++) {
+    for (Index2 = 0; Index2 < Index1; Index2++) {
+      TempAddress = IoDescriptors[Index1].IoAddress;
+      TempSize    = IoDescriptors[Index1].LengthOrWidth;
+
+      if (IoDescriptors[Index2].Attributes & SECURE_POLICY_RESOURCE_ATTR_STRICT_WIDTH) {
+        if ((TempAddress <= IoDescriptors[Index2].IoAddress) &&
+            (TempAddress + TempSize >= (UINT32)IoDescriptors[Index2].IoAddress + IoDescriptors[Index2].LengthOrWidth))
+        {
+          return EFI_SECURITY_VIOLATION;
+        }
+      } else {
+        Status = ReferenceOverlapStatus (
+                   (UINTN)IoDescriptors[Index2].IoAddress,
+                   (UINTN)IoDescriptors[Index2].LengthOrWidth,
+                   TempAddress,
+                   TempSize,
+                   &IsOverlapping
+                   );
+        if (EFI_ERROR (Status) || IsOverlapping) {
+          return EFI_SECURITY_VIOLATION;
+        }
+      }
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Pairwise memory descriptor check of the reference model.
+**/
+STATIC
+EFI_STATUS
+ReferenceCheckMem (
+  IN CONST SMM_SUPV_SECURE_POLICY_MEM_DESCRIPTOR_V1_0  *MemDescriptors,
+  IN UINTN                                             Count
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Index1;
+  UINTN       Index2;
+  BOOLEAN     IsOverlapping;
+
+  for (Index1 = 0; Index1 < Count; Index1++) {
+    for (Index2 = 0; Index2 < Index1; Index2++) {
+      Status = ReferenceOverlapStatus (
+                 (UINTN)MemDescriptors[Index2].BaseAddress,
+                 (UINTN)MemDescriptors[Index2].Size,
+                 (UINTN)MemDescriptors[Index1].BaseAddress,
+                 (UINTN)MemDescriptors[Index1].Size,
+                 &IsOverlapping
+                 );
+      if (EFI_ERROR (Status) || IsOverlapping) {
+        return EFI_SECURITY_VIOLATION;
+      }
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Pairwise MSR descriptor check of the reference model.
+**/
+STATIC
+EFI_STATUS
+ReferenceCheckMsr (
+  IN CONST SMM_SUPV_SECURE_POLICY_MSR_DESCRIPTOR_V1_0  *MsrDescriptors,
+  IN UINTN                                             Count
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Index1;
+  UINTN       Index2;
+  BOOLEAN     IsOverlapping;
+
+  for (Index1 = 0; Index1 < Count; Index1++) {
+    for (Index2 = 0; Index2 < Index1; Index2++) {
+      Status = ReferenceOverlapStatus (
+                 (UINTN)MsrDescriptors[Index2].MsrAddress,
+                 (UINTN)MsrDescriptors[Index2].Length,
+                 (UINTN)MsrDescriptors[Index1].MsrAddress,
+                 (UINTN)MsrDescriptors[Index1].Length,
+                 &IsOverlapping
+                 );
+      if (EFI_ERROR (Status) || IsOverlapping) {
+        return EFI_SECURITY_VIOLATION;
+      }
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Pairwise instruction descriptor check of the reference model.
+**/
+STATIC
+EFI_STATUS
+ReferenceCheckInstruction (
+  IN CONST SMM_SUPV_SECURE_POLICY_INSTRUCTION_DESCRIPTOR_V1_0  *InstrDescriptors,
+  IN UINTN                                                     Count
+  )
+{
+  UINTN  Index1;
+  UINTN  Index2;
+
+  for (Index1 = 0; Index1 < Count; Index1++) {
+    for (Index2 = 0; Index2 < Index1; Index2++) {
+      if (InstrDescriptors[Index1].InstructionIndex == InstrDescriptors[Index2].InstructionIndex) {
+        return EFI_SECURITY_VIOLATION;
+      }
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Pairwise save state descriptor check of the reference model.
+**/
+STATIC
+EFI_STATUS
+ReferenceCheckSaveState (
+  IN CONST SMM_SUPV_SECURE_POLICY_SAVE_STATE_DESCRIPTOR_V1_0  *SvstDescriptors,
+  IN UINTN                                                    Count
+  )
+{
+  UINTN  Index1;
+  UINTN  Index2;
+
+  for (Index1 = 0; Index1 < Count; Index1++) {
+    for (Index2 = 0; Index2 < Index1; Index2++) {
+      if (SvstDescriptors[Index1].MapField == SvstDescriptors[Index2].MapField) {
+        return EFI_SECURITY_VIOLATION;
+      }
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+//
+// Random descriptor tables.
+//
+
+/**
+  Generate a random range. Dense ranges are drawn from a narrow window so that most
+  of them collide, sparse ranges from disjoint slots of Slot units each, with a small
+  chance to straddle into the next slot.
+
+  @param[in]   Dense      TRUE to draw from the narrow window.
+  @param[in]   Slot       The index of the slot of a sparse range.
+  @param[in]   SlotSize   The size of a slot, at least 4.
+  @param[out]  Start      The start of the range.
+  @param[out]  Size       The size of the range.
+**/
+STATIC
+VOID
+GenerateRange (
+  IN  BOOLEAN  Dense,
+  IN  UINT32   Slot,
+  IN  UINT32   SlotSize,
+  OUT UINT64   *Start,
+  OUT UINT64   *Size
+  )
+{
+  if (Dense) {
+    *Start = RandomBelow (64);
+    *Size  = RandomBelow (12);
+    return;
+  }
+
+  *Start = (UINT64)Slot * SlotSize + RandomBelow (SlotSize / 2);
+  *Size  = 1 + RandomBelow (SlotSize / 2);
+  switch (RandomBelow (64)) {
+    case 0:
+      *Size = 0;
+      break;
+    case 1:
+      *Size += SlotSize;
+      break;
+    case 2:
+      *Start = (UINT64)Slot * SlotSize;
+      *Size  = SlotSize;
+      break;
+  }
+}
+
+/**
+  Pick the number of descriptors of a random table.
+
+  @return A number of descriptors in [0, OVERLAP_TEST_MAX_DESCRIPTORS].
+**/
+STATIC
+UINTN
+RandomDescriptorCount (
+  VOID
+  )
+{
+  // Tables of 0 to 3 descriptors hit the special cases of short tables
+  if (RandomBelow (4) == 0) {
+    return RandomBelow (4);
+  }
+
+  return RandomBelow (OVERLAP_TEST_MAX_DESCRIPTORS + 1);
+}
+
+/**
+  Shuffle the order of a table of descriptors.
+
+  @param[in, out] Table       The descriptors.
+  @param[in]      Count       The number of descriptors.
+  @param[in]      EntrySize   The size of a descriptor, at most 32 bytes.
+**/
+STATIC
+VOID
+ShuffleDescriptors (
+  IN OUT VOID   *Table,
+  IN     UINTN  Count,
+  IN     UINTN  EntrySize
+  )
+{
+  UINT8  Temp[32];
+  UINTN  Index;
+  UINTN  Other;
+
+  for (Index = Count; Index > 1; Index--) {
+    Other = RandomBelow ((UINT32)Index);
+    CopyMem (Temp, (UINT8 *)Table + (Index - 1) * EntrySize, EntrySize);
+    CopyMem ((UINT8 *)Table + (Index - 1) * EntrySize, (UINT8 *)Table + Other * EntrySize, EntrySize);
+    CopyMem ((UINT8 *)Table + Other * EntrySize, Temp, EntrySize);
+  }
+}
+
+/**
+  Generate a random table of IO descriptors.
+
+  @param[out]  Descriptors    Buffer of OVERLAP_TEST_MAX_DESCRIPTORS descriptors.
+
+  @return The number of descriptors generated.
+**/
+STATIC
+UINTN
+GenerateIoDescriptors (
+  OUT SMM_SUPV_SECURE_POLICY_IO_DESCRIPTOR_V1_0  *Descriptors
+  )
+{
+  UINTN    Count;
+  UINTN    Index;
+  UINT64   Start;
+  UINT64   Size;
+  BOOLEAN  Dense;
+  UINT32   StrictChance;
+
+  Count        = RandomDescriptorCount ();
+  Dense        = (RandomBelow (2) == 0);
+  StrictChance = RandomBelow (5);
+  for (Index = 0; Index < Count; Index++) {
+    GenerateRange (Dense, (UINT32)Index, 16, &Start, &Size);
+    // Nested strict width ranges are what shadowing is about
+    if (!Dense && (Index > 0) && (RandomBelow (8) == 0)) {
+      Start = Descriptors[Index - 1].IoAddress + RandomBelow (3);
+      Size  = RandomBelow (Descriptors[Index - 1].LengthOrWidth + 3);
+    }
+
+    // Ranges reaching the top of the IO space
+    if (RandomBelow (128) == 0) {
+      Start = 0xFFFF - RandomBelow (4);
+      Size  = RandomBelow (0x10000);
+    }
+
+    Descriptors[Index].IoAddress     = (UINT16)Start;
+    Descriptors[Index].LengthOrWidth = (UINT16)Size;
+    Descriptors[Index].Attributes    = (RandomBelow (4) < StrictChance) ? SECURE_POLICY_RESOURCE_ATTR_STRICT_WIDTH : 0;
+    Descriptors[Index].Attributes   |= (UINT16)RandomBelow (8);
+    Descriptors[Index].Reserved      = 0;
+  }
+
+  if (!Dense && (RandomBelow (2) == 0)) {
+    ShuffleDescriptors (Descriptors, Count, sizeof (*Descriptors));
+  }
+
+  return Count;
+}
+
+/**
+  Generate a random table of memory descriptors.
+
+  @param[out]  Descriptors    Buffer of OVERLAP_TEST_MAX_DESCRIPTORS descriptors.
+
+  @return The number of descriptors generated.
+**/
+STATIC
+UINTN
+GenerateMemDescriptors (
+  OUT SMM_SUPV_SECURE_POLICY_MEM_DESCRIPTOR_V1_0  *Descriptors
+  )
+{
+  UINTN    Count;
+  UINTN    Index;
+  UINT64   Start;
+  UINT64   Size;
+  BOOLEAN  Dense;
+
+  Count = RandomDescriptorCount ();
+  Dense = (RandomBelow (2) == 0);
+  for (Index = 0; Index < Count; Index++) {
+    GenerateRange (Dense, (UINT32)Index, 0x1000, &Start, &Size);
+    Start += 0xFED00000;
+    // Ranges wrapping or ending at the top of the address space
+    if (RandomBelow (128) == 0) {
+      Start = MAX_UINT64 - RandomBelow (0x1000);
+      Size  = RandomBelow (0x2000);
+    }
+
+    Descriptors[Index].BaseAddress   = Start;
+    Descriptors[Index].Size          = Size;
+    Descriptors[Index].MemAttributes = 0;
+    Descriptors[Index].Reserved      = 0;
+  }
+
+  ShuffleDescriptors (Descriptors, Count, sizeof (*Descriptors));
+  return Count;
+}
+
+/**
+  Generate a random table of MSR descriptors.
+
+  @param[out]  Descriptors    Buffer of OVERLAP_TEST_MAX_DESCRIPTORS descriptors.
+
+  @return The number of descriptors generated.
+**/
+STATIC
+UINTN
+GenerateMsrDescriptors (
+  OUT SMM_SUPV_SECURE_POLICY_MSR_DESCRIPTOR_V1_0  *Descriptors
+  )
+{
+  UINTN    Count;
+  UINTN    Index;
+  UINT64   Start;
+  UINT64   Size;
+  BOOLEAN  Dense;
+
+  Count = RandomDescriptorCount ();
+  Dense = (RandomBelow (2) == 0);
+  for (Index = 0; Index < Count; Index++) {
+    GenerateRange (Dense, (UINT32)Index, 0x100, &Start, &Size);
+    Start += 0xC0010000;
+    // Ranges reaching the top of the MSR space
+    if (RandomBelow (128) == 0) {
+      Start = MAX_UINT32 - RandomBelow (0x100);
+      Size  = RandomBelow (0x200);
+    }
+
+    Descriptors[Index].MsrAddress = (UINT32)Start;
+    Descriptors[Index].Length     = (UINT16)Size;
+    Descriptors[Index].Attributes = 0;
+  }
+
+  ShuffleDescriptors (Descriptors, Count, sizeof (*Descriptors));
+  return Count;
+}
+
+/**
+  Verify that the checks of random IO descriptor tables match the reference model.
+
+  @param[in]  Context    [Optional] An optional parameter that enables:
+                         1) test-case reuse with varied parameters and
+                         2) test-case re-entry for Target tests that need a
+                         reboot.  This parameter is a VOID* and it is the
+                         responsibility of the test author to ensure that the
+                         contents are well understood by all test cases that may
+                         consume it.
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+IoCheckMatchesReference (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  SMM_SUPV_SECURE_POLICY_IO_DESCRIPTOR_V1_0  Descriptors[OVERLAP_TEST_MAX_DESCRIPTORS];
+  UINTN                                      Count;
+  UINTN                                      Round;
+  UINTN                                      Accepted;
+  EFI_STATUS                                 Expected;
+
+  SeedRandom (0);
+  Accepted     = 0;
+  for (Round = 0; Round < OVERLAP_TEST_POLICY_COUNT; Round++) {
+    Count    = GenerateIoDescriptors (Descriptors);
+    Expected = ReferenceCheckIo (Descriptors, Count);
+    UT_ASSERT_STATUS_EQUAL (CheckIoPolicyOverlap (Descriptors, Count), Expected);
+    if (!EFI_ERROR (Expected)) {
+      Accepted++;
+    }
+  }
+
+  // Both verdicts have to be exercised for the comparison to mean anything
+  UT_ASSERT_NOT_EQUAL (Accepted, 0);
+  UT_ASSERT_NOT_EQUAL (Accepted, OVERLAP_TEST_POLICY_COUNT);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Verify that the checks of random memory and MSR descriptor tables match the
+  reference model.
+
+  @param[in]  Context    [Optional] An optional parameter that enables:
+                         1) test-case reuse with varied parameters and
+                         2) test-case re-entry for Target tests that need a
+                         reboot.  This parameter is a VOID* and it is the
+                         responsibility of the test author to ensure that the
+                         contents are well understood by all test cases that may
+                         consume it.
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+RangeCheckMatchesReference (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  SMM_SUPV_SECURE_POLICY_MEM_DESCRIPTOR_V1_0  MemDescriptors[OVERLAP_TEST_MAX_DESCRIPTORS];
+  SMM_SUPV_SECURE_POLICY_MSR_DESCRIPTOR_V1_0  MsrDescriptors[OVERLAP_TEST_MAX_DESCRIPTORS];
+  UINTN                                       Count;
+  UINTN                                       Round;
+  UINTN                                       Accepted;
+  EFI_STATUS                                  Expected;
+
+  SeedRandom (1);
+  Accepted     = 0;
+  for (Round = 0; Round < OVERLAP_TEST_POLICY_COUNT; Round++) {
+    Count    = GenerateMemDescriptors (MemDescriptors);
+    Expected = ReferenceCheckMem (MemDescriptors, Count);
+    UT_ASSERT_STATUS_EQUAL (CheckMemPolicyOverlap (MemDescriptors, Count), Expected);
+    if (!EFI_ERROR (Expected)) {
+      Accepted++;
+    }
+
+    Count    = GenerateMsrDescriptors (MsrDescriptors);
+    Expected = ReferenceCheckMsr (MsrDescriptors, Count);
+    UT_ASSERT_STATUS_EQUAL (CheckMsrPolicyOverlap (MsrDescriptors, Count), Expected);
+    if (!EFI_ERROR (Expected)) {
+      Accepted++;
+    }
+  }
+
+  UT_ASSERT_NOT_EQUAL (Accepted, 0);
+  UT_ASSERT_NOT_EQUAL (Accepted, 2 * OVERLAP_TEST_POLICY_COUNT);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Verify that the duplication checks of random instruction and save state descriptor
+  tables match the reference model.
+
+  @param[in]  Context    [Optional] An optional parameter that enables:
+                         1) test-case reuse with varied parameters and
+                         2) test-case re-entry for Target tests that need a
+                         reboot.  This parameter is a VOID* and it is the
+                         responsibility of the test author to ensure that the
+                         contents are well understood by all test cases that may
+                         consume it.
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+DuplicationCheckMatchesReference (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  SMM_SUPV_SECURE_POLICY_INSTRUCTION_DESCRIPTOR_V1_0  InstrDescriptors[OVERLAP_TEST_MAX_DESCRIPTORS];
+  SMM_SUPV_SECURE_POLICY_SAVE_STATE_DESCRIPTOR_V1_0   SvstDescriptors[OVERLAP_TEST_MAX_DESCRIPTORS];
+  UINTN                                               Count;
+  UINTN                                               Index;
+  UINTN                                               Round;
+  UINT32                                              KeyRange;
+  EFI_STATUS                                          Expected;
+
+  SeedRandom (2);
+  ZeroMem (InstrDescriptors, sizeof (InstrDescriptors));
+  ZeroMem (SvstDescriptors, sizeof (SvstDescriptors));
+  for (Round = 0; Round < OVERLAP_TEST_POLICY_COUNT; Round++) {
+    Count    = RandomDescriptorCount ();
+    KeyRange = 1 + RandomBelow (2 * OVERLAP_TEST_MAX_DESCRIPTORS * OVERLAP_TEST_MAX_DESCRIPTORS);
+    for (Index = 0; Index < Count; Index++) {
+      InstrDescriptors[Index].InstructionIndex = (UINT16)RandomBelow (KeyRange);
+      SvstDescriptors[Index].MapField          = (RandomBelow (2) == 0) ? RandomBelow (KeyRange) : (UINT32)NextRandom ();
+    }
+
+    Expected = ReferenceCheckInstruction (InstrDescriptors, Count);
+    UT_ASSERT_STATUS_EQUAL (CheckInstructionPolicyDuplication (InstrDescriptors, Count), Expected);
+
+    Expected = ReferenceCheckSaveState (SvstDescriptors, Count);
+    UT_ASSERT_STATUS_EQUAL (CheckSaveStatePolicyDuplication (SvstDescriptors, Count), Expected);
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Verify the order sensitive strict width rules of IO descriptors on hand picked
+  tables, and on a large table that the pairwise comparison would take long on.
+
+  @param[in]  Context    [Optional] An optional parameter that enables:
+                         1) test-case reuse with varied parameters and
+                         2) test-case re-entry for Target tests that need a
+                         reboot.  This parameter is a VOID* and it is the
+                         responsibility of the test author to ensure that the
+                         contents are well understood by all test cases that may
+                         consume it.
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+IoStrictWidthShadowing (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  SMM_SUPV_SECURE_POLICY_IO_DESCRIPTOR_V1_0  Descriptors[2];
+  SMM_SUPV_SECURE_POLICY_IO_DESCRIPTOR_V1_0  *Large;
+  UINTN                                      Index;
+
+  ZeroMem (Descriptors, sizeof (Descriptors));
+
+  // A strict width entry followed by a narrower one inside it is allowed
+  Descriptors[0].IoAddress     = 0xCF8;
+  Descriptors[0].LengthOrWidth = 8;
+  Descriptors[0].Attributes    = SECURE_POLICY_RESOURCE_ATTR_STRICT_WIDTH;
+  Descriptors[1].IoAddress     = 0xCFC;
+  Descriptors[1].LengthOrWidth = 1;
+  UT_ASSERT_NOT_EFI_ERROR (CheckIoPolicyOverlap (Descriptors, 2));
+
+  // But the same pair the other way around overlaps a non strict width entry
+  CopyMem (&Descriptors[1], &Descriptors[0], sizeof (Descriptors[0]));
+  Descriptors[0].IoAddress     = 0xCFC;
+  Descriptors[0].LengthOrWidth = 1;
+  Descriptors[0].Attributes    = 0;
+  UT_ASSERT_STATUS_EQUAL (CheckIoPolicyOverlap (Descriptors, 2), EFI_SECURITY_VIOLATION);
+
+  // A strict width entry followed by a superset of it is shadowed
+  Descriptors[0].IoAddress     = 0xCFC;
+  Descriptors[0].LengthOrWidth = 4;
+  Descriptors[0].Attributes    = SECURE_POLICY_RESOURCE_ATTR_STRICT_WIDTH;
+  Descriptors[1].IoAddress     = 0xCF8;
+  Descriptors[1].LengthOrWidth = 8;
+  Descriptors[1].Attributes    = SECURE_POLICY_RESOURCE_ATTR_STRICT_WIDTH;
+  UT_ASSERT_STATUS_EQUAL (CheckIoPolicyOverlap (Descriptors, 2), EFI_SECURITY_VIOLATION);
+
+  // Including by an identical one
+  CopyMem (&Descriptors[1], &Descriptors[0], sizeof (Descriptors[0]));
+  UT_ASSERT_STATUS_EQUAL (CheckIoPolicyOverlap (Descriptors, 2), EFI_SECURITY_VIOLATION);
+
+  // A zero sized strict width entry is shadowed by any following entry covering it
+  Descriptors[0].LengthOrWidth = 0;
+  Descriptors[1].IoAddress     = 0xCF8;
+  Descriptors[1].LengthOrWidth = 4;
+  UT_ASSERT_STATUS_EQUAL (CheckIoPolicyOverlap (Descriptors, 2), EFI_SECURITY_VIOLATION);
+  Descriptors[1].LengthOrWidth = 3;
+  UT_ASSERT_NOT_EFI_ERROR (CheckIoPolicyOverlap (Descriptors, 2));
+
+  // Partially overlapping strict width entries do not shadow each other
+  Large = AllocatePool (OVERLAP_TEST_LARGE_COUNT * sizeof (*Large));
+  UT_ASSERT_NOT_NULL (Large);
+  for (Index = 0; Index < OVERLAP_TEST_LARGE_COUNT; Index++) {
+    Large[Index].IoAddress     = (UINT16)(Index * 8);
+    Large[Index].LengthOrWidth = 12;
+    Large[Index].Attributes    = SECURE_POLICY_RESOURCE_ATTR_STRICT_WIDTH;
+    Large[Index].Reserved      = 0;
+  }
+
+  UT_ASSERT_NOT_EFI_ERROR (CheckIoPolicyOverlap (Large, OVERLAP_TEST_LARGE_COUNT));
+
+  // Until the last one covers the first one
+  Large[OVERLAP_TEST_LARGE_COUNT - 1].IoAddress     = 0;
+  Large[OVERLAP_TEST_LARGE_COUNT - 1].LengthOrWidth = 16;
+  UT_ASSERT_STATUS_EQUAL (CheckIoPolicyOverlap (Large, OVERLAP_TEST_LARGE_COUNT), EFI_SECURITY_VIOLATION);
+
+  FreePool (Large);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Verify the memory check on a large policy in ascending address order, the layout
+  produced by walking the page tables, and in descending order. Both are the worst
+  case of a quick sort pivoting on the last entry, which would recurse once per
+  descriptor.
+
+  @param[in]  Context    [Optional] An optional parameter that enables:
+                         1) test-case reuse with varied parameters and
+                         2) test-case re-entry for Target tests that need a
+                         reboot.  This parameter is a VOID* and it is the
+                         responsibility of the test author to ensure that the
+                         contents are well understood by all test cases that may
+                         consume it.
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+MemSortedLargePolicy (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  SMM_SUPV_SECURE_POLICY_MEM_DESCRIPTOR_V1_0  *Large;
+  UINTN                                       Index;
+  EFI_STATUS                                  Ascending;
+  EFI_STATUS                                  Descending;
+  EFI_STATUS                                  Overlapping;
+
+  Large = AllocateZeroPool (OVERLAP_TEST_SORTED_COUNT * sizeof (*Large));
+  UT_ASSERT_NOT_NULL (Large);
+
+  for (Index = 0; Index < OVERLAP_TEST_SORTED_COUNT; Index++) {
+    Large[Index].BaseAddress = 0x100000 + Index * 2 * EFI_PAGE_SIZE;
+    Large[Index].Size        = EFI_PAGE_SIZE;
+  }
+
+  Ascending = CheckMemPolicyOverlap (Large, OVERLAP_TEST_SORTED_COUNT);
+
+  for (Index = 0; Index < OVERLAP_TEST_SORTED_COUNT; Index++) {
+    Large[Index].BaseAddress = 0x100000 + (OVERLAP_TEST_SORTED_COUNT - 1 - Index) * 2 * EFI_PAGE_SIZE;
+  }
+
+  Descending = CheckMemPolicyOverlap (Large, OVERLAP_TEST_SORTED_COUNT);
+
+  // The second descriptor now reaches into the first one, which follows it in address order
+  Large[1].Size = 2 * EFI_PAGE_SIZE + 1;
+  Overlapping   = CheckMemPolicyOverlap (Large, OVERLAP_TEST_SORTED_COUNT);
+
+  FreePool (Large);
+
+  UT_ASSERT_NOT_EFI_ERROR (Ascending);
+  UT_ASSERT_NOT_EFI_ERROR (Descending);
+  UT_ASSERT_STATUS_EQUAL (Overlapping, EFI_SECURITY_VIOLATION);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Initialize the unit test framework, suite, and unit tests for the policy overlap
+  checks and run the tests.
+
+  @retval  EFI_SUCCESS           All test cases were dispatched.
+  @retval  EFI_OUT_OF_RESOURCES  There are not enough resources available to
+                                 initialize the unit tests.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+UnitTestingEntry (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      OverlapTests;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_APP_NAME, UNIT_TEST_APP_VERSION));
+  DEBUG ((DEBUG_INFO, "Random seed 0x%lx\n", mOverlapTestSeed));
+
+  //
+  // Start setting up the test framework for running the tests.
+  //
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_APP_NAME, gEfiCallerBaseName, UNIT_TEST_APP_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  //
+  // Populate the Policy Overlap Test Suite.
+  //
+  Status = CreateUnitTestSuite (&OverlapTests, Framework, "MM Policy Overlap Tests", "PolicyOverlap.Check", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for OverlapTests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  //
+  // --------------Suite-----------Description--------------Name----------Function--------Pre---Post-------------------Context-----------
+  //
+  AddTestCase (OverlapTests, "IO check should match reference on random policies", "IoDiffRandom", IoCheckMatchesReference, NULL, NULL, NULL);
+  AddTestCase (OverlapTests, "Memory and MSR checks should match reference on random policies", "RangeDiffRandom", RangeCheckMatchesReference, NULL, NULL, NULL);
+  AddTestCase (OverlapTests, "Duplication checks should match reference on random policies", "DupDiffRandom", DuplicationCheckMatchesReference, NULL, NULL, NULL);
+  AddTestCase (OverlapTests, "Strict width IO entries should only be shadowed by later supersets", "IoStrictWidth", IoStrictWidthShadowing, NULL, NULL, NULL);
+  AddTestCase (OverlapTests, "Large memory policies in address order should be checked", "MemSortedLarge", MemSortedLargePolicy, NULL, NULL, NULL);
+
+  //
+  // Execute the tests.
+  //
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+/**
+  Standard POSIX C entry point for host based unit test execution. An optional
+  first argument overrides the random seed.
+**/
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  if (argc > 1) {
+    mOverlapTestSeed = strtoull (argv[1], NULL, 0);
+  }
+
+  return UnitTestingEntry ();
+}
@@ -27,6 +27,12 @@ UINTN  RegisteredRing3JumpPointer = 0;
 UINTN  RegApRing3JumpPointer      = 0;
 UINTN  RegErrorReportJumpPointer  = 0;
 
+// CPL3 entry point of SYSRET demotions, which moves the first argument to rcx and jumps to the routine
+UINTN  RegSysretRing3Trampoline = 0;
+
+// Runtime switch over SYSRET demotions, cleared to compare them with the call gate fallback
+BOOLEAN  mSysretDemotionEnabled = TRUE;
+
 // Helper function to patch the call gate
 STATIC
 EFI_STATUS
@@ -185,6 +191,89 @@ Exit:
   }
 }
 
+/**
+  Check whether the next demotion goes through SYSRET.
+
+  @retval TRUE    SYSRET demotion is built in, enabled and its CPL3 trampoline is registered.
+  @retval FALSE   The next demotion goes through the call gate.
+**/
+BOOLEAN
+EFIAPI
+IsSysretDemotionActive (
+  VOID
+  )
+{
+  return FeaturePcdGet (PcdMmSupervisorSysretDemotionEnable) && mSysretDemotionEnabled && (RegSysretRing3Trampoline != 0);
+}
+
+/**
+  Prepare this core for a demotion through SYSRET, if the CPL3 trampoline is registered.
+
+  The call gate and TSS stay valid during a SYSRET demotion, for CPL3 return points built
+  before it and for exceptions raised in CPL3. They are only patched when stale, so that
+  the GDT read only toggling is skipped once a demotion from the same depth has run. No
+  far return is needed afterwards, gates and RSP0 are fetched from memory upon each use.
+
+  @param[in]      CpuIndex            CpuIndex value of this core.
+  @param[in]      ReturnPointer       CPL0 return point of the call gate.
+  @param[in]      Cpl0StackPtr        CPL0 stack to resume on once the demoted routine returns.
+
+  @return The CPL3 entry point for SYSRET, or 0 if the demotion has to go through the call gate.
+**/
+UINTN
+EFIAPI
+SetupSysretDemotion (
+  IN UINTN  CpuIndex,
+  IN VOID   *ReturnPointer,
+  IN VOID   *Cpl0StackPtr
+  )
+{
+  IA32_DESCRIPTOR           Gdtr;
+  IA32_IDT_GATE_DESCRIPTOR  *CallGatePtr;
+  IA32_TSS_DESCRIPTOR       *TssDescPtr;
+  IA32_TASK_STATE_SEGMENT   *TaskSegmentPtr;
+  UINTN                     GateOffset;
+  UINTN                     TssBase;
+
+  if (!IsSysretDemotionActive ()) {
+    return 0;
+  }
+
+  AsmReadGdtr (&Gdtr);
+
+  CallGatePtr    = (IA32_IDT_GATE_DESCRIPTOR *)(UINTN)(Gdtr.Base + CALL_GATE_OFFSET);
+  TssDescPtr     = (IA32_TSS_DESCRIPTOR *)(UINTN)(Gdtr.Base + TSS_SEL_OFFSET);
+  TaskSegmentPtr = (IA32_TASK_STATE_SEGMENT *)(UINTN)(Gdtr.Base + TSS_DESC_OFFSET);
+
+  GateOffset = (UINTN)CallGatePtr->Bits.OffsetLow |
+               ((UINTN)CallGatePtr->Bits.OffsetHigh << 16) |
+               LShiftU64 (CallGatePtr->Bits.OffsetUpper, 32);
+  TssBase = (UINTN)TssDescPtr->Bits.BaseLow |
+            ((UINTN)TssDescPtr->Bits.BaseMidl << 16) |
+            ((UINTN)TssDescPtr->Bits.BaseMidh << 24) |
+            LShiftU64 (TssDescPtr->Bits.BaseHigh, 32);
+
+  if ((GateOffset != (UINTN)ReturnPointer) ||
+      (TssBase != (UINTN)TaskSegmentPtr) ||
+      (TaskSegmentPtr->RSP0 != (UINT64)(UINTN)Cpl0StackPtr))
+  {
+    SmmClearGdtReadOnlyForThisProcessor ();
+    PatchCallGatePtr (CallGatePtr, ReturnPointer);
+    PatchTssDescriptor (TssDescPtr, TaskSegmentPtr, Cpl0StackPtr);
+    SmmSetGdtReadOnlyForThisProcessor ();
+  }
+
+  // Syscalls from the demoted routine and its SMM_SC_DEMOTED_RETURN both land on this stack
+  if (EFI_ERROR (UpdateCpl0StackPtrForGs (CpuIndex, (EFI_PHYSICAL_ADDRESS)(UINTN)Cpl0StackPtr)) ||
+      EFI_ERROR (UpdateSysretReturnRspForGs (CpuIndex, (EFI_PHYSICAL_ADDRESS)(UINTN)Cpl0StackPtr)))
+  {
+    // Let the call gate path report the failure
+    return 0;
+  }
+
+  return RegSysretRing3Trampoline;
+}
+
 // Setup ring transition for AP procedure
 VOID
 EFIAPI
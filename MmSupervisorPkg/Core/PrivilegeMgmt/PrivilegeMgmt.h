@@ -14,6 +14,8 @@
 #ifndef _MM_PRIVILEGE_MGMT_H_
 #define _MM_PRIVILEGE_MGMT_H_
 
+#include <Guid/MmSupervisorRequestData.h>
+
 #include <Library/SynchronizationLib.h>
 
 // This needs to be in consistency with SmiException.nasm
@@ -32,14 +34,28 @@ typedef struct {
   EFI_PHYSICAL_ADDRESS    SavedUserRsp; // Offset should equal to SAVED_USER_RSP in SysCallEntry.nasm
   EFI_PHYSICAL_ADDRESS    OsGsBasePtr;
   EFI_PHYSICAL_ADDRESS    OsGsSwapBasePtr;
+  EFI_PHYSICAL_ADDRESS    SysretReturnRsp; // Offset should equal to SYSRET_RETURN_RSP in SysCallEntry.nasm
 } MM_SUPV_SYSCALL_CACHE;
 
-extern UINTN      RegisteredRing3JumpPointer;
-extern UINTN      RegApRing3JumpPointer;
-extern UINTN      RegErrorReportJumpPointer;
-extern SPIN_LOCK  *mCpuToken;
-
-// Function to set up syscall MSR for just one thread/core
+typedef struct {
+  volatile UINT64                      Head;          // Free running count of recorded entries
+  UINT64                               Tail;          // Free running count of drained entries
+  MM_SUPERVISOR_SYSCALL_TRACE_ENTRY    *Entries;
+  UINT64                               Reserved[5];   // Keep each ring header in its own cache line, the rings are page aligned
+} MM_SUPV_SYSCALL_TRACE_RING;
+
+extern UINTN                       RegisteredRing3JumpPointer;
+extern UINTN                       RegApRing3JumpPointer;
+extern UINTN                       RegErrorReportJumpPointer;
+extern UINTN                       RegSysretRing3Trampoline;
+extern BOOLEAN                     mSysretDemotionEnabled;
+extern SPIN_LOCK                   *mCpuToken;
+extern MM_SUPV_SYSCALL_TRACE_RING  *mSyscallTraceRings;
+extern UINTN                       mSyscallTraceRingCount;
+extern UINT32                      mSyscallTraceEntriesPerCpu;
+X86_ASSEMBLY_PATCH_LABEL           gPatchSyscallFastPathEnabled;
+
+// Function to set up syscall MSR for just one thread/core, the context stays installed until RestoreCpl0MsrStar
 EFI_STATUS
 EFIAPI
 SetupCpl0MsrStar (
@@ -53,7 +69,7 @@ SetupBspCpl0MsrStar (
   VOID
   );
 
-// Function to restore MSR to runtime value
+// Function to restore MSR to runtime value, once per SMI when this CPU leaves MM, nothing to do if no demotion ran
 EFI_STATUS
 EFIAPI
 RestoreCpl0MsrStar (
@@ -83,6 +99,47 @@ SyscallInterfaceInit (
   IN UINTN  NumberOfCpus
   );
 
+/**
+  Allocate one syscall trace ring per CPU.
+
+  @param[in]  NumberOfCpus          Total number of CPUs need to be supported.
+
+  @retval EFI_SUCCESS               The trace rings are successfully allocated.
+  @retval EFI_ALREADY_STARTED       The trace rings have already been allocated.
+  @retval EFI_OUT_OF_RESOURCES      Cannot allocate enough resource for the trace rings.
+
+**/
+EFI_STATUS
+EFIAPI
+SyscallTraceInit (
+  IN UINTN  NumberOfCpus
+  );
+
+/**
+  Record one syscall into the trace ring of the executing CPU. The oldest entry
+  is overwritten when the ring is full.
+
+  @param[in]  CallIndex     The syscall index.
+  @param[in]  Arg1          First syscall argument.
+  @param[in]  Arg2          Second syscall argument.
+  @param[in]  Arg3          Third syscall argument.
+  @param[in]  CallerAddr    Return address of the CPL3 caller.
+  @param[in]  Status        Status of the syscall dispatcher.
+  @param[in]  EntryTsc      Time stamp counter value upon syscall entry.
+
+**/
+VOID
+EFIAPI
+RecordSyscallTrace (
+  IN UINTN       CallIndex,
+  IN UINTN       Arg1,
+  IN UINTN       Arg2,
+  IN UINTN       Arg3,
+  IN UINTN       CallerAddr,
+  IN EFI_STATUS  Status,
+  IN UINT64      EntryTsc
+  );
+
 UINT64
 EFIAPI
 SyscallCenter (
@@ -93,6 +150,40 @@ SyscallCenter (
   UINTN  CallerAddr
   );
 
+/**
+  Serve a syscall on the register-only fast path.
+
+  @param[in]  CallIndex     The syscall index, one of the indices routed to the
+                            fast path by SyscallCenter in SysCallEntry.nasm.
+  @param[in]  Arg1          First syscall argument.
+  @param[in]  Arg2          Second syscall argument.
+  @param[in]  Arg3          Third syscall argument.
+  @param[out] Ret           Value to be returned to the CPL3 caller.
+
+  @retval TRUE              The syscall was served, Ret holds the result.
+  @retval FALSE             The syscall needs to be served by the full path.
+**/
+BOOLEAN
+EFIAPI
+SyscallFastDispatcher (
+  IN  UINTN   CallIndex,
+  IN  UINTN   Arg1,
+  IN  UINTN   Arg2,
+  IN  UINTN   Arg3,
+  OUT UINT64  *Ret
+  );
+
+/**
+  Let SyscallCenter route the register-only syscalls to SyscallFastDispatcher, only if
+  the toolchain built the fast path without vector registers. Otherwise SyscallCenter
+  keeps taking the full path for every syscall.
+**/
+VOID
+EFIAPI
+SyscallFastPathInit (
+  VOID
+  );
+
 // Setup ring transition for AP procedure
 VOID
 EFIAPI
@@ -106,6 +197,35 @@ SyncMmEntryContextToCpl3 (
   VOID
   );
 
+/**
+  Check whether the next demotion goes through SYSRET.
+
+  @retval TRUE    SYSRET demotion is built in, enabled and its CPL3 trampoline is registered.
+  @retval FALSE   The next demotion goes through the call gate.
+**/
+BOOLEAN
+EFIAPI
+IsSysretDemotionActive (
+  VOID
+  );
+
+/**
+  Prepare this core for a demotion through SYSRET, if the CPL3 trampoline is registered.
+
+  @param[in]      CpuIndex            CpuIndex value of this core.
+  @param[in]      ReturnPointer       CPL0 return point of the call gate.
+  @param[in]      Cpl0StackPtr        CPL0 stack to resume on once the demoted routine returns.
+
+  @return The CPL3 entry point for SYSRET, or 0 if the demotion has to go through the call gate.
+**/
+UINTN
+EFIAPI
+SetupSysretDemotion (
+  IN UINTN  CpuIndex,
+  IN VOID   *ReturnPointer,
+  IN VOID   *Cpl0StackPtr
+  );
+
 /**
   Invoke specified routine on specified core in CPL 3.
 
@@ -211,4 +331,22 @@ UpdateCpl0StackPtrForGs (
   IN EFI_PHYSICAL_ADDRESS  Cpl0StackPtr
   );
 
+/**
+  Arm or disarm SMM_SC_DEMOTED_RETURN for CpuIndex.
+
+  @param[in]      CpuIndex            CpuIndex value of intended core, cannot be
+                                      greater than mNumberOfCpus.
+  @param[in]      Cpl0StackPtr        Ring0 stack pointer to resume InvokeDemotedRoutine on,
+                                      0 to disarm.
+
+  @retval EFI_SUCCESS               The return stack pointer is successfully updated.
+  @retval EFI_INVALID_PARAMETER     The CpuIndex is out of range.
+**/
+EFI_STATUS
+EFIAPI
+UpdateSysretReturnRspForGs (
+  IN UINTN                 CpuIndex,
+  IN EFI_PHYSICAL_ADDRESS  Cpl0StackPtr
+  );
+
 #endif
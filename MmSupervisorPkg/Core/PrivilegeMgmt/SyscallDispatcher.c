@@ -23,6 +23,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include "MmSupervisorCore.h"
 #include "PrivilegeMgmt.h"
 #include "Relocate/Relocate.h"
+#include "Services/MpService/MpService.h"
 #include "Handler/Handler.h"
 #include "Mem/Mem.h"
 #include "Policy/Policy.h"
@@ -214,6 +215,39 @@ QueryHobStartFromConfTable (
   return HobList;
 }
 
+/**
+  Count the policy descriptor that decides an IO or MSR syscall, when policy profiling
+  is enabled. The verdict itself is left to the regular policy check.
+
+  @param[in]  DescriptorType    SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_IO or
+                                SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_MSR.
+  @param[in]  Target            The IO port or MSR address.
+  @param[in]  IoWidth           The EFI_MM_IO_WIDTH of an IO request, ignored otherwise.
+  @param[in]  AccessMask        One of SECURE_POLICY_RESOURCE_ATTR_READ or
+                                SECURE_POLICY_RESOURCE_ATTR_WRITE.
+**/
+STATIC
+VOID
+ProfilePolicyAccess (
+  IN UINT32           DescriptorType,
+  IN UINT32           Target,
+  IN EFI_MM_IO_WIDTH  IoWidth,
+  IN UINT32           AccessMask
+  )
+{
+  UINT32  DescriptorIndex;
+
+  if (!FeaturePcdGet (PcdMmSupervisorPolicyProfileEnable)) {
+    return;
+  }
+
+  if (EvaluatePolicyAccess (FirmwarePolicy, DescriptorType, Target, IoWidth, AccessMask, &DescriptorIndex) == EFI_INVALID_PARAMETER) {
+    return;
+  }
+
+  RecordPolicyHit (DescriptorType, DescriptorIndex);
+}
+
 /**
   Conduct Syscall dispatch.
 **/
@@ -232,6 +266,7 @@ SyscallDispatcher (
   EFI_HANDLE  MmHandle;
   BOOLEAN     IsUserRange = FALSE;
   EFI_STATUS  Status      = EFI_SUCCESS;
+  UINT64      EntryTsc    = 0;
 
   if (mPcdCheck) {
     mPrintEnabled = FeaturePcdGet (PcdMmSupervisorPrintPortsEnable);
@@ -239,28 +274,13 @@ SyscallDispatcher (
   }
 
   if (FeaturePcdGet (PcdEnableSyscallLogs)) {
-    while (!AcquireSpinLockOrFail (mCpuToken)) {
-      CpuPause ();
-    }
-
-    DEBUG ((
-      DEBUG_INFO,
-      "%a Enter... CallIndex: %lx, Arg1: %lx, Arg2: %lx, Arg3: %lx, CallerAddr: %p, Ring3Stack %p\n",
-      __FUNCTION__,
-      CallIndex,
-      Arg1,
-      Arg2,
-      Arg3,
-      CallerAddr,
-      Ring3StackPointer
-      ));
-
-    ReleaseSpinLock (mCpuToken);
+    EntryTsc = AsmReadTsc ();
   }
 
   // The real policy come from DRTM event is copied over to FirmwarePolicy
   switch (CallIndex) {
     case SMM_SC_RDMSR:
+      ProfilePolicyAccess (SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_MSR, (UINT32)Arg1, 0, SECURE_POLICY_RESOURCE_ATTR_READ_DIS);
       Status = IsMsrReadWriteAllowed (
                  FirmwarePolicy,
                  (UINT32)Arg1,
@@ -279,6 +299,7 @@ SyscallDispatcher (
 
       break;
     case SMM_SC_WRMSR:
+      ProfilePolicyAccess (SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_MSR, (UINT32)Arg1, 0, SECURE_POLICY_RESOURCE_ATTR_WRITE_DIS);
       Status = IsMsrReadWriteAllowed (
                  FirmwarePolicy,
                  (UINT32)Arg1,
@@ -317,6 +338,7 @@ SyscallDispatcher (
         goto Exit;
       }
 
+      ProfilePolicyAccess (SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_IO, (UINT32)Arg1, (EFI_MM_IO_WIDTH)Arg2, SECURE_POLICY_RESOURCE_ATTR_READ_DIS);
       Status = IsIoReadWriteAllowed (
                  FirmwarePolicy,
                  (UINT32)Arg1,
@@ -353,6 +375,7 @@ SyscallDispatcher (
         goto Exit;
       }
 
+      ProfilePolicyAccess (SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_IO, (UINT32)Arg1, (EFI_MM_IO_WIDTH)Arg2, SECURE_POLICY_RESOURCE_ATTR_WRITE_DIS);
       Status = IsIoReadWriteAllowed (
                  FirmwarePolicy,
                  (UINT32)Arg1,
@@ -445,17 +468,20 @@ SyscallDispatcher (
 
       break;
     case SMM_REG_HDL_JMP:
+      // Arg3 is the optional SYSRET demotion trampoline, demotions keep using the call gate without it
       if ((RegisteredRing3JumpPointer != 0) ||
           (RegApRing3JumpPointer != 0))
       {
         Status = EFI_ALREADY_STARTED;
       } else if ((EFI_ERROR (InspectTargetRangeOwnership (Arg1, sizeof (Arg1), &IsUserRange)) || !IsUserRange) ||
-                 (EFI_ERROR (InspectTargetRangeOwnership (Arg2, sizeof (Arg2), &IsUserRange)) || !IsUserRange))
+                 (EFI_ERROR (InspectTargetRangeOwnership (Arg2, sizeof (Arg2), &IsUserRange)) || !IsUserRange) ||
+                 ((Arg3 != 0) && (EFI_ERROR (InspectTargetRangeOwnership (Arg3, sizeof (Arg3), &IsUserRange)) || !IsUserRange)))
       {
         Status = EFI_SECURITY_VIOLATION;
       } else {
         RegisteredRing3JumpPointer = Arg1;
         RegApRing3JumpPointer      = Arg2;
+        RegSysretRing3Trampoline   = Arg3;
       }
 
       break;
@@ -524,6 +550,19 @@ SyscallDispatcher (
         Status = EFI_SECURITY_VIOLATION;
       }
 
+      break;
+    case SMM_START_ALL_AP_PROC:
+      if ((!EFI_ERROR (InspectTargetRangeOwnership (Arg1, sizeof (Arg1), &IsUserRange)) && IsUserRange) &&
+          (!EFI_ERROR (InspectTargetRangeOwnership (Arg2, 1, &IsUserRange)) && IsUserRange))
+      {
+        // An AP handing out procedures would wait on its own BUSY, let the caller run the work alone
+        if (AmIBsp ()) {
+          Ret = SmmStartupAllApsNonBlocking ((EFI_AP_PROCEDURE)Arg1, (VOID *)Arg2);
+        }
+      } else {
+        Status = EFI_SECURITY_VIOLATION;
+      }
+
       break;
     case SMM_REG_HNDL:
       if ((!EFI_ERROR (InspectTargetRangeOwnership (Arg1, sizeof (Arg1), &IsUserRange)) && IsUserRange) &&
@@ -572,6 +611,9 @@ SyscallDispatcher (
     case SMM_QRY_HOB:
       Ret = (UINT64)QueryHobStartFromConfTable ();
       break;
+    case SMM_QRY_HOB_INDEX:
+      Ret = (UINT64)(UINTN)mMmHobIndex;
+      break;
     case SMM_ERR_RPT_JMP:
       if (EFI_ERROR (InspectTargetRangeOwnership (Arg1, sizeof (Arg1), &IsUserRange)) || !IsUserRange) {
         Status = EFI_SECURITY_VIOLATION;
@@ -615,12 +657,25 @@ SyscallDispatcher (
     case SMM_MM_IS_COMM_BUFF:
       Ret = (UINT64)VerifyRequestUserCommBuffer ((VOID *)(UINTN)Arg1, (UINTN)Arg2);
       break;
+    case SMM_SC_NULL:
+    case SMM_SC_NULL_FAST:
+      // Round-trip measurement only, SMM_SC_NULL_FAST lands here when the fast path is unavailable
+      Ret = AsmReadTsc ();
+      break;
+    case SMM_SC_DEMOTED_RETURN:
+      // SyscallCenter serves it while a SYSRET demotion is armed, there is nothing to return from here
+      Status = EFI_ACCESS_DENIED;
+      break;
     default:
       Status = EFI_INVALID_PARAMETER;
       break;
   }
 
 Exit:
+  if (FeaturePcdGet (PcdEnableSyscallLogs)) {
+    RecordSyscallTrace (CallIndex, Arg1, Arg2, Arg3, CallerAddr, Status, EntryTsc);
+  }
+
   if (mPrintInfo) {
     PrintDict ();
     mPrintInfo = FALSE;
@@ -639,9 +694,5 @@ Exit:
     CpuDeadLoop ();
   }
 
-  if (FeaturePcdGet (PcdEnableSyscallLogs)) {
-    DEBUG ((DEBUG_INFO, "%a Exit...\n", __FUNCTION__));
-  }
-
   return Ret;
 }
@@ -0,0 +1,169 @@
+/** @file
+  Register-only syscall handlers served without preserving the CPL3 FPU/SSE state.
+
+  SyscallCenter routes the legacy register-only syscall indices and SMM_SC_NULL_FAST
+  here before paying for the FXSAVE/FXRSTOR pair and the data segment reloads. Everything in
+  this translation unit is compiled without vector register usage, and it only
+  calls into register-only primitives (MSR, IO port, TSC and cache instructions)
+  and the quiet policy evaluator of SmmPolicyGateLib, which is built with the same
+  restriction. Any request that is rejected, malformed or needs logging or profiling is handed
+  back to the full path, which will re-evaluate it and report the failure.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <PiMm.h>
+#include <SmmSecurePolicy.h>
+
+#include <Protocol/MmCpuIo.h>
+
+#include <Library/BaseLib.h>
+#include <Library/CpuLib.h>
+#include <Library/IoLib.h>
+#include <Library/PcdLib.h>
+#include <Library/SysCallLib.h>
+#include <Library/SmmPolicyGateLib.h>
+
+#include "MmSupervisorCore.h"
+#include "PrivilegeMgmt.h"
+#include "Policy/Policy.h"
+
+//
+// The CPL3 FPU/SSE state is live while the routines below execute. Only toolchains
+// that can guarantee integer-only code generation for this file get the fast path,
+// for the others SyscallFastPathInit leaves SyscallCenter on the full state
+// preservation path, and nothing in this file is ever called.
+//
+#if defined (__GNUC__) && !defined (__clang__) && (__GNUC__ >= 8)
+#pragma GCC target ("general-regs-only")
+#define SYSCALL_FAST_PATH_ENABLED  TRUE
+#else
+#define SYSCALL_FAST_PATH_ENABLED  FALSE
+#endif
+
+/**
+  Let SyscallCenter route the register-only syscalls to SyscallFastDispatcher, only if
+  the toolchain built the fast path without vector registers. Otherwise SyscallCenter
+  keeps taking the full path for every syscall.
+**/
+VOID
+EFIAPI
+SyscallFastPathInit (
+  VOID
+  )
+{
+  PatchInstructionX86 (gPatchSyscallFastPathEnabled, SYSCALL_FAST_PATH_ENABLED, 1);
+}
+
+/**
+  Serve a syscall on the register-only fast path.
+
+  @param[in]  CallIndex     The syscall index, one of the indices routed to the
+                            fast path by SyscallCenter in SysCallEntry.nasm.
+  @param[in]  Arg1          First syscall argument.
+  @param[in]  Arg2          Second syscall argument.
+  @param[in]  Arg3          Third syscall argument.
+  @param[out] Ret           Value to be returned to the CPL3 caller.
+
+  @retval TRUE              The syscall was served, Ret holds the result.
+  @retval FALSE             The syscall needs to be served by the full path.
+**/
+BOOLEAN
+EFIAPI
+SyscallFastDispatcher (
+  IN  UINTN   CallIndex,
+  IN  UINTN   Arg1,
+  IN  UINTN   Arg2,
+  IN  UINTN   Arg3,
+  OUT UINT64  *Ret
+  )
+{
+  if (!SYSCALL_FAST_PATH_ENABLED ||
+      FeaturePcdGet (PcdEnableSyscallLogs) ||
+      FeaturePcdGet (PcdMmSupervisorPrintPortsEnable) ||
+      FeaturePcdGet (PcdMmSupervisorPolicyProfileEnable) ||
+      (FirmwarePolicy == NULL))
+  {
+    return FALSE;
+  }
+
+  *Ret = 0;
+  switch (CallIndex) {
+    case SMM_SC_RDMSR:
+      if (EFI_ERROR (EvaluatePolicyAccess (FirmwarePolicy, SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_MSR, (UINT32)Arg1, 0, SECURE_POLICY_RESOURCE_ATTR_READ_DIS, NULL))) {
+        return FALSE;
+      }
+
+      *Ret = AsmReadMsr64 ((UINT32)Arg1);
+      break;
+    case SMM_SC_WRMSR:
+      if (EFI_ERROR (EvaluatePolicyAccess (FirmwarePolicy, SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_MSR, (UINT32)Arg1, 0, SECURE_POLICY_RESOURCE_ATTR_WRITE_DIS, NULL))) {
+        return FALSE;
+      }
+
+      AsmWriteMsr64 ((UINT32)Arg1, (UINT64)Arg2);
+      break;
+    case SMM_SC_CLI:
+      if (EFI_ERROR (EvaluatePolicyAccess (FirmwarePolicy, SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_INSTRUCTION, SECURE_POLICY_INSTRUCTION_CLI, 0, 0, NULL))) {
+        return FALSE;
+      }
+
+      DisableInterrupts ();
+      break;
+    case SMM_SC_IO_READ:
+      if (EFI_ERROR (EvaluatePolicyAccess (FirmwarePolicy, SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_IO, (UINT32)Arg1, (EFI_MM_IO_WIDTH)Arg2, SECURE_POLICY_RESOURCE_ATTR_READ_DIS, NULL))) {
+        return FALSE;
+      }
+
+      if (Arg2 == MM_IO_UINT8) {
+        *Ret = (UINT64)IoRead8 ((UINTN)Arg1);
+      } else if (Arg2 == MM_IO_UINT16) {
+        *Ret = (UINT64)IoRead16 ((UINTN)Arg1);
+      } else if (Arg2 == MM_IO_UINT32) {
+        *Ret = (UINT64)IoRead32 ((UINTN)Arg1);
+      } else {
+        return FALSE;
+      }
+
+      break;
+    case SMM_SC_IO_WRITE:
+      if (EFI_ERROR (EvaluatePolicyAccess (FirmwarePolicy, SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_IO, (UINT32)Arg1, (EFI_MM_IO_WIDTH)Arg2, SECURE_POLICY_RESOURCE_ATTR_WRITE_DIS, NULL))) {
+        return FALSE;
+      }
+
+      if (Arg2 == MM_IO_UINT8) {
+        IoWrite8 ((UINTN)Arg1, (UINT8)Arg3);
+      } else if (Arg2 == MM_IO_UINT16) {
+        IoWrite16 ((UINTN)Arg1, (UINT16)Arg3);
+      } else if (Arg2 == MM_IO_UINT32) {
+        IoWrite32 ((UINTN)Arg1, (UINT32)Arg3);
+      } else {
+        return FALSE;
+      }
+
+      break;
+    case SMM_SC_WBINVD:
+      if (EFI_ERROR (EvaluatePolicyAccess (FirmwarePolicy, SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_INSTRUCTION, SECURE_POLICY_INSTRUCTION_WBINVD, 0, 0, NULL))) {
+        return FALSE;
+      }
+
+      AsmWbinvd ();
+      break;
+    case SMM_SC_HLT:
+      if (EFI_ERROR (EvaluatePolicyAccess (FirmwarePolicy, SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_INSTRUCTION, SECURE_POLICY_INSTRUCTION_HLT, 0, 0, NULL))) {
+        return FALSE;
+      }
+
+      CpuSleep ();
+      break;
+    case SMM_SC_NULL_FAST:
+      *Ret = AsmReadTsc ();
+      break;
+    default:
+      return FALSE;
+  }
+
+  return TRUE;
+}
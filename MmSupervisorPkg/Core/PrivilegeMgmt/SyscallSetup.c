@@ -11,6 +11,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <StandaloneMm.h>
 #include <Library/BaseLib.h>
 #include <Library/MemoryAllocationLib.h>
+#include <Library/PcdLib.h>
 #include <Register/Msr.h>
 
 #include "MmSupervisorCore.h"
@@ -25,7 +26,10 @@ UINT64                 *mMsrEferStore   = NULL;
 MM_SUPV_SYSCALL_CACHE  *mMmSupvGsStore  = NULL;
 SPIN_LOCK              *mCpuToken       = NULL;
 
-// Function to set up syscall MSR for just one thread/core
+// Per CPU flag of whether the syscall MSR context is installed and the OS values are held in the stores above
+BOOLEAN  *mSyscallContextLive = NULL;
+
+// Function to set up syscall MSR for just one thread/core, the context stays installed until RestoreCpl0MsrStar
 EFI_STATUS
 EFIAPI
 SetupCpl0MsrStar (
@@ -40,7 +44,8 @@ SetupCpl0MsrStar (
   if ((mMsrStarStore == NULL) ||
       (mMsrStar64Store == NULL) ||
       (mMsrEferStore == NULL) ||
-      (mMmSupvGsStore == NULL))
+      (mMmSupvGsStore == NULL) ||
+      (mSyscallContextLive == NULL))
   {
     Status = EFI_NOT_READY;
     ASSERT (FALSE);
@@ -53,6 +58,12 @@ SetupCpl0MsrStar (
     goto Cleanup;
   }
 
+  // Already installed by an earlier demotion in this SMI, the stores must keep the OS values
+  if (mSyscallContextLive[CpuIndex]) {
+    Status = EFI_SUCCESS;
+    goto Cleanup;
+  }
+
   Eax                     = 0;
   Edx                     = 0;
   mMsrStarStore[CpuIndex] = (UINT64)AsmReadMsr64 (MSR_IA32_STAR);
@@ -76,7 +87,8 @@ SetupCpl0MsrStar (
   mMmSupvGsStore[CpuIndex].OsGsSwapBasePtr = (UINT64)AsmReadMsr64 (MSR_IA32_KERNEL_GS_BASE);
   AsmWriteMsr64 (MSR_IA32_KERNEL_GS_BASE, (UINTN)&mMmSupvGsStore[CpuIndex]);
 
-  Status = EFI_SUCCESS;
+  mSyscallContextLive[CpuIndex] = TRUE;
+  Status                        = EFI_SUCCESS;
 
 Cleanup:
   return Status;
@@ -96,7 +108,7 @@ SetupBspCpl0MsrStar (
   return Status;
 }
 
-// Function to restore MSR to runtime value
+// Function to restore MSR to runtime value, once per SMI when this CPU leaves MM, nothing to do if no demotion ran
 EFI_STATUS
 EFIAPI
 RestoreCpl0MsrStar (
@@ -105,6 +117,14 @@ RestoreCpl0MsrStar (
 {
   EFI_STATUS  Status;
 
+  if ((mSyscallContextLive == NULL) ||
+      (CpuIndex >= mNumberOfCpus) ||
+      !mSyscallContextLive[CpuIndex])
+  {
+    Status = EFI_SUCCESS;
+    goto Cleanup;
+  }
+
   if ((mMsrStarStore == NULL) ||
       (mMsrStar64Store == NULL) ||
       (mMsrEferStore == NULL) ||
@@ -127,7 +147,8 @@ RestoreCpl0MsrStar (
   AsmWriteMsr64 (MSR_IA32_GS_BASE, mMmSupvGsStore[CpuIndex].OsGsBasePtr);
   AsmWriteMsr64 (MSR_IA32_KERNEL_GS_BASE, mMmSupvGsStore[CpuIndex].OsGsSwapBasePtr);
 
-  Status = EFI_SUCCESS;
+  mSyscallContextLive[CpuIndex] = FALSE;
+  Status                        = EFI_SUCCESS;
 
 Cleanup:
   return Status;
@@ -209,6 +230,33 @@ UpdateCpl0StackPtrForGs (
   return EFI_SUCCESS;
 }
 
+/**
+  Arm or disarm SMM_SC_DEMOTED_RETURN for CpuIndex.
+
+  @param[in]      CpuIndex            CpuIndex value of intended core, cannot be
+                                      greater than mNumberOfCpus.
+  @param[in]      Cpl0StackPtr        Ring0 stack pointer to resume InvokeDemotedRoutine on,
+                                      0 to disarm.
+
+  @retval EFI_SUCCESS               The return stack pointer is successfully updated.
+  @retval EFI_INVALID_PARAMETER     The CpuIndex is out of range.
+**/
+EFI_STATUS
+EFIAPI
+UpdateSysretReturnRspForGs (
+  IN UINTN                 CpuIndex,
+  IN EFI_PHYSICAL_ADDRESS  Cpl0StackPtr
+  )
+{
+  if ((CpuIndex >= mNumberOfCpus) || (mMmSupvGsStore == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  mMmSupvGsStore[CpuIndex].SysretReturnRsp = Cpl0StackPtr;
+
+  return EFI_SUCCESS;
+}
+
 /**
 
   Setup the pool for STAR MSR holders.
@@ -231,12 +279,16 @@ SyscallInterfaceInit (
   mMsrStarStore   = AllocatePool (sizeof (UINT64) * NumberOfCpus);
   mMsrStar64Store = AllocatePool (sizeof (UINT64) * NumberOfCpus);
   mMsrEferStore   = AllocatePool (sizeof (UINT64) * NumberOfCpus);
-  mMmSupvGsStore  = AllocatePool (sizeof (MM_SUPV_SYSCALL_CACHE) * NumberOfCpus);
+  // Zeroed so that no CPU starts with SMM_SC_DEMOTED_RETURN armed
+  mMmSupvGsStore = AllocateZeroPool (sizeof (MM_SUPV_SYSCALL_CACHE) * NumberOfCpus);
+
+  mSyscallContextLive = AllocateZeroPool (sizeof (BOOLEAN) * NumberOfCpus);
 
   if ((mMsrStarStore == NULL) ||
       (mMsrStar64Store == NULL) ||
       (mMsrEferStore == NULL) ||
-      (mMmSupvGsStore == NULL))
+      (mMmSupvGsStore == NULL) ||
+      (mSyscallContextLive == NULL))
   {
     Status = EFI_OUT_OF_RESOURCES;
     goto Exit;
@@ -256,6 +308,17 @@ SyscallInterfaceInit (
   }
 
   InitializeSpinLock (mCpuToken);
+
+  SyscallFastPathInit ();
+
+  if (FeaturePcdGet (PcdEnableSyscallLogs)) {
+    // Tracing is a diagnostic aid, do not fail the syscall interface over it
+    Status = SyscallTraceInit (NumberOfCpus);
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_ERROR, "%a Syscall trace rings are not available - %r\n", __FUNCTION__, Status));
+    }
+  }
+
   Status = EFI_SUCCESS;
 
 Exit:
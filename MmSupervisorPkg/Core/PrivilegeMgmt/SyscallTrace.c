@@ -0,0 +1,145 @@
+/** @file
+  Per-CPU binary syscall trace rings.
+
+  Each CPU only ever records into its own ring, so the recording path does not
+  take any lock. The rings are drained by the supervisor request handler through
+  MM_SUPERVISOR_REQUEST_SYSCALL_TRACE and decoded on host.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <PiMm.h>
+
+#include <Guid/MmSupervisorRequestData.h>
+
+#include <Library/BaseLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PcdLib.h>
+
+#include "MmSupervisorCore.h"
+#include "PrivilegeMgmt.h"
+#include "Services/CpuService/CpuService.h"
+
+MM_SUPV_SYSCALL_TRACE_RING  *mSyscallTraceRings        = NULL;
+UINTN                       mSyscallTraceRingCount     = 0;
+UINT32                      mSyscallTraceEntriesPerCpu = 0;
+
+/**
+  Allocate one syscall trace ring per CPU.
+
+  @param[in]  NumberOfCpus          Total number of CPUs need to be supported.
+
+  @retval EFI_SUCCESS               The trace rings are successfully allocated.
+  @retval EFI_ALREADY_STARTED       The trace rings have already been allocated.
+  @retval EFI_OUT_OF_RESOURCES      Cannot allocate enough resource for the trace rings.
+
+**/
+EFI_STATUS
+EFIAPI
+SyscallTraceInit (
+  IN UINTN  NumberOfCpus
+  )
+{
+  UINTN                              Index;
+  UINT32                             EntriesPerCpu;
+  UINTN                              RingPages;
+  MM_SUPERVISOR_SYSCALL_TRACE_ENTRY  *Entries;
+
+  if (mSyscallTraceRings != NULL) {
+    return EFI_ALREADY_STARTED;
+  }
+
+  EntriesPerCpu = FixedPcdGet32 (PcdSyscallTraceEntriesPerCpu);
+  if ((EntriesPerCpu == 0) || (NumberOfCpus == 0)) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  // The ring positions are free running counters, keep the ring size a power of 2
+  EntriesPerCpu = GetPowerOfTwo32 (EntriesPerCpu);
+
+  // Pool allocations are only 8 byte aligned, page align the ring headers so that each one fills a cache line
+  RingPages          = EFI_SIZE_TO_PAGES (sizeof (MM_SUPV_SYSCALL_TRACE_RING) * NumberOfCpus);
+  mSyscallTraceRings = AllocateAlignedPages (RingPages, EFI_PAGE_SIZE);
+  Entries            = AllocateZeroPool (sizeof (MM_SUPERVISOR_SYSCALL_TRACE_ENTRY) * EntriesPerCpu * NumberOfCpus);
+  if ((mSyscallTraceRings == NULL) || (Entries == NULL)) {
+    DEBUG ((DEBUG_ERROR, "%a Failed to allocate syscall trace rings for %d CPUs\n", __FUNCTION__, NumberOfCpus));
+    if (mSyscallTraceRings != NULL) {
+      FreeAlignedPages (mSyscallTraceRings, RingPages);
+      mSyscallTraceRings = NULL;
+    }
+
+    if (Entries != NULL) {
+      FreePool (Entries);
+    }
+
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  ZeroMem (mSyscallTraceRings, EFI_PAGES_TO_SIZE (RingPages));
+  for (Index = 0; Index < NumberOfCpus; Index++) {
+    mSyscallTraceRings[Index].Entries = &Entries[Index * EntriesPerCpu];
+  }
+
+  mSyscallTraceRingCount     = NumberOfCpus;
+  mSyscallTraceEntriesPerCpu = EntriesPerCpu;
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Record one syscall into the trace ring of the executing CPU. The oldest entry
+  is overwritten when the ring is full.
+
+  @param[in]  CallIndex     The syscall index.
+  @param[in]  Arg1          First syscall argument.
+  @param[in]  Arg2          Second syscall argument.
+  @param[in]  Arg3          Third syscall argument.
+  @param[in]  CallerAddr    Return address of the CPL3 caller.
+  @param[in]  Status        Status of the syscall dispatcher.
+  @param[in]  EntryTsc      Time stamp counter value upon syscall entry.
+
+**/
+VOID
+EFIAPI
+RecordSyscallTrace (
+  IN UINTN       CallIndex,
+  IN UINTN       Arg1,
+  IN UINTN       Arg2,
+  IN UINTN       Arg3,
+  IN UINTN       CallerAddr,
+  IN EFI_STATUS  Status,
+  IN UINT64      EntryTsc
+  )
+{
+  UINTN                              CpuIndex;
+  MM_SUPV_SYSCALL_TRACE_RING         *Ring;
+  MM_SUPERVISOR_SYSCALL_TRACE_ENTRY  *Entry;
+
+  if (mSyscallTraceRings == NULL) {
+    return;
+  }
+
+  if (EFI_ERROR (SmmWhoAmI (NULL, &CpuIndex)) || (CpuIndex >= mSyscallTraceRingCount)) {
+    return;
+  }
+
+  Ring  = &mSyscallTraceRings[CpuIndex];
+  Entry = &Ring->Entries[Ring->Head & (mSyscallTraceEntriesPerCpu - 1)];
+
+  Entry->Tsc        = EntryTsc;
+  Entry->CallIndex  = (UINT32)CallIndex;
+  Entry->CpuIndex   = (UINT32)CpuIndex;
+  Entry->Arg1       = Arg1;
+  Entry->Arg2       = Arg2;
+  Entry->Arg3       = Arg3;
+  Entry->CallerAddr = CallerAddr;
+  Entry->Status     = (UINT64)Status;
+  Entry->Cycles     = AsmReadTsc () - EntryTsc;
+
+  // Publish the entry only after its content is in place
+  MemoryFence ();
+  Ring->Head++;
+}
@@ -29,6 +29,16 @@ CPU_HOT_PLUG_DATA  mCpuHotPlugData = {
 volatile BOOLEAN  *mRebased;
 volatile BOOLEAN  mIsBsp;
 
+//
+// Index of the processor being relocated, published by BSP before sending each relocation SMI
+//
+volatile UINTN  mRelocatingCpuIndex;
+
+//
+// Performance counter ticks spent on relocating each processor, from SMI IPI to semaphore
+//
+UINT64  *mRelocationTicks = NULL;
+
 ///
 /// Handle for the SMM CPU Protocol
 ///
@@ -179,18 +189,16 @@ DumpModuleInfoByIp (
   IN  UINTN  CallerIpAddress
   )
 {
-  UINTN  Pe32Data;
-  VOID   *PdbPointer;
+  CONST MM_IMAGE_INDEX_ENTRY  *ImageEntry;
 
   //
-  // Find Image Base
+  // Find the image holding the address, loaded images are all indexed
   //
-  Pe32Data = PeCoffSearchImageBase (CallerIpAddress);
-  if (Pe32Data != 0) {
+  ImageEntry = MmImageIndexLookup (CallerIpAddress);
+  if (ImageEntry != NULL) {
     DEBUG ((DEBUG_ERROR, "It is invoked from the instruction before IP(0x%p)", (VOID *)CallerIpAddress));
-    PdbPointer = PeCoffLoaderGetPdbPointer ((VOID *)Pe32Data);
-    if (PdbPointer != NULL) {
-      DEBUG ((DEBUG_ERROR, " in module (%a)\n", PdbPointer));
+    if (ImageEntry->PdbString != NULL) {
+      DEBUG ((DEBUG_ERROR, " in module (%a)\n", ImageEntry->PdbString));
     }
   }
 }
@@ -216,41 +224,82 @@ SmmInitHandler (
 
   ASSERT (mNumberOfCpus <= mMaxNumberOfCpus);
 
-  for (Index = 0; Index < mNumberOfCpus; Index++) {
-    if (ApicId == (UINT32)gSmmCpuPrivate->ProcessorInfo[Index].ProcessorId) {
-      //
-      // Initialize SMM specific features on the currently executing CPU
-      //
-      SmmCpuFeaturesInitializeProcessor (
-        Index,
-        mIsBsp,
-        gSmmCpuPrivate->ProcessorInfo,
-        &mCpuHotPlugData
-        );
-
-      //
-      // Check XD and BTS features on each processor on normal boot
-      //
-      CheckFeatureSupported ();
-
-      if (mIsBsp) {
-        //
-        // BSP rebase is already done above.
-        // Initialize private data during S3 resume
-        //
-        InitializeMpSyncData ();
+  //
+  // Processors are relocated one at a time, the BSP has published the index of the processor
+  // it sent the SMI to. Only search the processor information if it does not match.
+  //
+  Index = mRelocatingCpuIndex;
+  if ((Index >= mNumberOfCpus) || (ApicId != (UINT32)gSmmCpuPrivate->ProcessorInfo[Index].ProcessorId)) {
+    for (Index = 0; Index < mNumberOfCpus; Index++) {
+      if (ApicId == (UINT32)gSmmCpuPrivate->ProcessorInfo[Index].ProcessorId) {
+        break;
       }
+    }
 
-      //
-      // Hook return after RSM to set SMM re-based flag
-      //
-      SemaphoreHook (Index, &mRebased[Index]);
-
+    if (Index >= mNumberOfCpus) {
+      ASSERT (FALSE);
       return;
     }
   }
 
-  ASSERT (FALSE);
+  //
+  // Initialize SMM specific features on the currently executing CPU
+  //
+  SmmCpuFeaturesInitializeProcessor (
+    Index,
+    mIsBsp,
+    gSmmCpuPrivate->ProcessorInfo,
+    &mCpuHotPlugData
+    );
+
+  //
+  // Check XD and BTS features on each processor on normal boot
+  //
+  CheckFeatureSupported ();
+
+  if (mIsBsp) {
+    //
+    // BSP rebase is already done above.
+    // Initialize private data during S3 resume
+    //
+    InitializeMpSyncData ();
+  }
+
+  //
+  // Hook return after RSM to set SMM re-based flag
+  //
+  SemaphoreHook (Index, &mRebased[Index]);
+}
+
+/**
+  Send the relocation SMI to one processor and wait for it to exit SMM with the
+  new SMBASE. The time consumed is recorded in mRelocationTicks when available.
+
+  @param[in] CpuIndex   The index of the processor to be relocated.
+  @param[in] ApicId     The APIC ID of the processor to be relocated.
+
+**/
+STATIC
+VOID
+SmmRelocateOneBase (
+  IN UINTN   CpuIndex,
+  IN UINT32  ApicId
+  )
+{
+  UINT64  StartTicker;
+
+  mRelocatingCpuIndex = CpuIndex;
+  StartTicker         = GetPerformanceCounter ();
+  SendSmiIpi (ApicId);
+  //
+  // Wait for this processor to finish its 1st SMI
+  //
+  while (!mRebased[CpuIndex]) {
+  }
+
+  if (mRelocationTicks != NULL) {
+    mRelocationTicks[CpuIndex] = GetPerformanceCounter () - StartTicker;
+  }
 }
 
 /**
@@ -272,6 +321,7 @@ SmmRelocateBases (
   UINT32                ApicId;
   UINTN                 Index;
   UINTN                 BspIndex;
+  UINT64                TotalTicks;
 
   //
   // Make sure the reserved size is large enough for procedure SmmInitTemplate.
@@ -315,18 +365,15 @@ SmmRelocateBases (
   //
   // Relocate SM bases for all APs
   // This is APs' 1st SMI - rebase will be done here, and APs' default SMI handler will be overridden by gcSmmInitTemplate
+  // All processors share the default SMBASE and its save state map until relocated, so they have to be relocated one
+  // at a time.
   //
   mIsBsp   = FALSE;
   BspIndex = (UINTN)-1;
   for (Index = 0; Index < mNumberOfCpus; Index++) {
     mRebased[Index] = FALSE;
     if (ApicId != (UINT32)gSmmCpuPrivate->ProcessorInfo[Index].ProcessorId) {
-      SendSmiIpi ((UINT32)gSmmCpuPrivate->ProcessorInfo[Index].ProcessorId);
-      //
-      // Wait for this AP to finish its 1st SMI
-      //
-      while (!mRebased[Index]) {
-      }
+      SmmRelocateOneBase (Index, (UINT32)gSmmCpuPrivate->ProcessorInfo[Index].ProcessorId);
     } else {
       //
       // BSP will be Relocated later
@@ -340,18 +387,40 @@ SmmRelocateBases (
   //
   ASSERT (BspIndex != (UINTN)-1);
   mIsBsp = TRUE;
-  SendSmiIpi (ApicId);
-  //
-  // Wait for the BSP to finish its 1st SMI
-  //
-  while (!mRebased[BspIndex]) {
-  }
+  SmmRelocateOneBase (BspIndex, ApicId);
 
   //
   // Restore contents at address 0x38000
   //
   CopyMem (CpuStatePtr, &BakBuf2, sizeof (BakBuf2));
   CopyMem (U8Ptr, BakBuf, sizeof (BakBuf));
+
+  //
+  // Report the relocation time only after all processors are done, so that printing does not add to it
+  //
+  if (mRelocationTicks != NULL) {
+    TotalTicks = 0;
+    for (Index = 0; Index < mNumberOfCpus; Index++) {
+      DEBUG ((
+        DEBUG_INFO,
+        "%a - CPU[%03d] APIC ID 0x%x relocated to SMBASE 0x%lx in %ldns\n",
+        __FUNCTION__,
+        Index,
+        (UINT32)gSmmCpuPrivate->ProcessorInfo[Index].ProcessorId,
+        (UINT64)mCpuHotPlugData.SmBase[Index],
+        GetTimeInNanoSecond (mRelocationTicks[Index])
+        ));
+      TotalTicks += mRelocationTicks[Index];
+    }
+
+    DEBUG ((DEBUG_INFO, "%a - %d processors relocated in %ldns\n", __FUNCTION__, mNumberOfCpus, GetTimeInNanoSecond (TotalTicks)));
+
+    //
+    // The timing is reported, later relocations do not need it
+    //
+    FreePool (mRelocationTicks);
+    mRelocationTicks = NULL;
+  }
 }
 
 EFI_STATUS
@@ -898,6 +967,10 @@ SetupSmiEntryExit (
   //
   mRebased = (BOOLEAN *)AllocateZeroPool (sizeof (BOOLEAN) * mMaxNumberOfCpus);
   ASSERT (mRebased != NULL);
+  //
+  // Relocation timing is informational only, relocation proceeds without it
+  //
+  mRelocationTicks = (UINT64 *)AllocateZeroPool (sizeof (UINT64) * mMaxNumberOfCpus);
   SmmRelocateBases ();
 
   //
@@ -0,0 +1,88 @@
+/** @file
+  Routines of selecting the demotion path through MM Supervisor communicate protocol.
+
+Copyright (C) Microsoft Corporation.
+
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <PiMm.h>
+
+#include <Guid/MmSupervisorRequestData.h>
+
+#include <Library/BaseLib.h>
+#include <Library/DebugLib.h>
+#include <Library/PcdLib.h>
+
+#include "MmSupervisorCore.h"
+#include "Mem/Mem.h"
+#include "PrivilegeMgmt/PrivilegeMgmt.h"
+
+/**
+  Function that selects how later demotions enter and leave CPL3 routines. Selecting SYSRET
+  when it is not available leaves the demotions on the call gate, which is reported back.
+
+  The switch only exists to compare the two paths, so it is not served outside of test
+  builds.
+
+  @param[in, out] PathBuffer    Buffer holding the requested path, updated with the path in effect.
+
+  @retval EFI_SUCCESS               The path is selected.
+  @retval EFI_UNSUPPORTED           PcdMmSupervisorTestEnable is not set.
+  @retval EFI_INVALID_PARAMETER     PathBuffer is a null pointer or the requested path is unknown.
+  @retval EFI_SECURITY_VIOLATION    PathBuffer is not pointing to designated supervisor buffer.
+  @retval EFI_ACCESS_DENIED         If request occurs before MM foundation is setup.
+
+**/
+EFI_STATUS
+ProcessDemotionPathRequest (
+  IN OUT MM_SUPERVISOR_DEMOTION_PATH_BUFFER  *PathBuffer
+  )
+{
+  EFI_STATUS  Status;
+
+  if (!FeaturePcdGet (PcdMmSupervisorTestEnable)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  if (!mCoreInitializationComplete) {
+    return EFI_ACCESS_DENIED;
+  }
+
+  if (PathBuffer == NULL) {
+    Status = EFI_INVALID_PARAMETER;
+    DEBUG ((DEBUG_ERROR, "%a Input argument is a null pointer!!!\n", __FUNCTION__));
+    goto Exit;
+  }
+
+  Status = VerifyRequestSupvCommBuffer (PathBuffer, sizeof (MM_SUPERVISOR_DEMOTION_PATH_BUFFER));
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a Input buffer %p is illegal - %r!!!\n", __FUNCTION__, PathBuffer, Status));
+    goto Exit;
+  }
+
+  switch (PathBuffer->RequestedPath) {
+    case MM_SUPERVISOR_DEMOTION_PATH_CALL_GATE:
+      mSysretDemotionEnabled = FALSE;
+      break;
+
+    case MM_SUPERVISOR_DEMOTION_PATH_SYSRET:
+      mSysretDemotionEnabled = TRUE;
+      break;
+
+    case MM_SUPERVISOR_DEMOTION_PATH_QUERY:
+      break;
+
+    default:
+      Status = EFI_INVALID_PARAMETER;
+      DEBUG ((DEBUG_ERROR, "%a Unknown demotion path %d!!!\n", __FUNCTION__, PathBuffer->RequestedPath));
+      goto Exit;
+  }
+
+  PathBuffer->SelectedPath = mSysretDemotionEnabled ? MM_SUPERVISOR_DEMOTION_PATH_SYSRET : MM_SUPERVISOR_DEMOTION_PATH_CALL_GATE;
+  PathBuffer->ActivePath   = IsSysretDemotionActive () ? MM_SUPERVISOR_DEMOTION_PATH_SYSRET : MM_SUPERVISOR_DEMOTION_PATH_CALL_GATE;
+
+Exit:
+  return Status;
+}
@@ -0,0 +1,67 @@
+/** @file
+  Routines of reporting the page table pool usage through MM Supervisor communicate protocol.
+
+Copyright (C) Microsoft Corporation.
+
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <PiMm.h>
+
+#include <Guid/MmSupervisorRequestData.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+
+#include "MmSupervisorCore.h"
+#include "Mem/Mem.h"
+
+/**
+  Function that reports the usage of the page table pools.
+
+  @param[out] UsageBuffer   Buffer to hold the page table pool usage.
+
+  @retval EFI_SUCCESS               The usage is successfully reported.
+  @retval EFI_INVALID_PARAMETER     UsageBuffer is a null pointer.
+  @retval EFI_SECURITY_VIOLATION    UsageBuffer is not pointing to designated supervisor buffer.
+  @retval EFI_ACCESS_DENIED         If request occurs before MM foundation is setup.
+
+**/
+EFI_STATUS
+ProcessPageTableUsageRequest (
+  OUT MM_SUPERVISOR_PAGE_TABLE_USAGE_BUFFER  *UsageBuffer
+  )
+{
+  EFI_STATUS  Status;
+
+  if (!mCoreInitializationComplete) {
+    return EFI_ACCESS_DENIED;
+  }
+
+  if (UsageBuffer == NULL) {
+    Status = EFI_INVALID_PARAMETER;
+    DEBUG ((DEBUG_ERROR, "%a Input argument is a null pointer!!!\n", __FUNCTION__));
+    goto Exit;
+  }
+
+  Status = VerifyRequestSupvCommBuffer (UsageBuffer, sizeof (MM_SUPERVISOR_PAGE_TABLE_USAGE_BUFFER));
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a Input buffer %p is illegal - %r!!!\n", __FUNCTION__, UsageBuffer, Status));
+    goto Exit;
+  }
+
+  ZeroMem (UsageBuffer, sizeof (MM_SUPERVISOR_PAGE_TABLE_USAGE_BUFFER));
+  UsageBuffer->EstimatedPages      = mPageTablePoolUsage.EstimatedPages;
+  UsageBuffer->ReservedPages       = mPageTablePoolUsage.ReservedPages;
+  UsageBuffer->UsedPages           = mPageTablePoolUsage.UsedPages;
+  UsageBuffer->PoolCount           = (UINT32)mPageTablePoolUsage.PoolCount;
+  UsageBuffer->SplitEstimatedPages = mPageTablePoolUsage.ExEstimatedPages;
+  UsageBuffer->SplitReservedPages  = mPageTablePoolUsage.ExReservedPages;
+  UsageBuffer->SplitUsedPages      = mPageTablePoolUsage.ExReservedPages - mPageTablePoolEx.FreePages;
+  UsageBuffer->SplitFailedRequests = mPageTablePoolUsage.ExFailedRequests;
+
+Exit:
+  return Status;
+}
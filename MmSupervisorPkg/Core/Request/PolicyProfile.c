@@ -0,0 +1,80 @@
+/** @file
+  Routines of exporting the IO and MSR policy hit counters through MM Supervisor communicate protocol.
+
+Copyright (C) Microsoft Corporation.
+
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <PiMm.h>
+
+#include <Guid/MmSupervisorRequestData.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+
+#include "MmSupervisorCore.h"
+#include "Mem/Mem.h"
+#include "Policy/Policy.h"
+
+/**
+  Function that copies the IO and MSR policy hit counters into the supplied buffer. The
+  counters keep accumulating after this request.
+
+  @param[in, out] ProfileBuffer       Buffer to hold the profile header and the hit counters.
+  @param[in]      SuppliedBufferSize  Maximal buffer size supplied by caller.
+
+  @retval EFI_SUCCESS               The hit counters are successfully copied.
+  @retval EFI_UNSUPPORTED           Policy profiling is not enabled.
+  @retval EFI_INVALID_PARAMETER     ProfileBuffer is a null pointer.
+  @retval EFI_SECURITY_VIOLATION    ProfileBuffer is not pointing to designated supervisor buffer.
+  @retval EFI_BUFFER_TOO_SMALL      ProfileBuffer cannot hold all the hit counters.
+
+**/
+EFI_STATUS
+ProcessPolicyProfileRequest (
+  IN OUT MM_SUPERVISOR_POLICY_PROFILE_BUFFER  *ProfileBuffer,
+  IN     UINT64                               SuppliedBufferSize
+  )
+{
+  EFI_STATUS  Status;
+  UINT32      *HitCounts;
+  UINT64      RequiredSize;
+
+  if ((mIoPolicyHitCounts == NULL) || (mMsrPolicyHitCounts == NULL)) {
+    Status = EFI_UNSUPPORTED;
+    goto Exit;
+  }
+
+  if (ProfileBuffer == NULL) {
+    Status = EFI_INVALID_PARAMETER;
+    DEBUG ((DEBUG_ERROR, "%a Input argument is a null pointer!!!\n", __FUNCTION__));
+    goto Exit;
+  }
+
+  Status = VerifyRequestSupvCommBuffer (ProfileBuffer, (UINTN)SuppliedBufferSize);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a Input buffer %p is illegal - %r!!!\n", __FUNCTION__, ProfileBuffer, Status));
+    goto Exit;
+  }
+
+  RequiredSize = sizeof (MM_SUPERVISOR_POLICY_PROFILE_BUFFER) +
+                 ((UINT64)mIoPolicyHitSlotCount + mMsrPolicyHitSlotCount) * sizeof (UINT32);
+  if (SuppliedBufferSize < RequiredSize) {
+    Status = EFI_BUFFER_TOO_SMALL;
+    DEBUG ((DEBUG_ERROR, "%a Buffer is too small to fit all hit counters: 0x%lx < 0x%lx\n", __FUNCTION__, SuppliedBufferSize, RequiredSize));
+    goto Exit;
+  }
+
+  ProfileBuffer->IoDescriptorCount  = mIoPolicyHitSlotCount - 1;
+  ProfileBuffer->MsrDescriptorCount = mMsrPolicyHitSlotCount - 1;
+
+  HitCounts = (UINT32 *)(ProfileBuffer + 1);
+  CopyMem (HitCounts, mIoPolicyHitCounts, mIoPolicyHitSlotCount * sizeof (UINT32));
+  CopyMem (HitCounts + mIoPolicyHitSlotCount, mMsrPolicyHitCounts, mMsrPolicyHitSlotCount * sizeof (UINT32));
+
+Exit:
+  return Status;
+}
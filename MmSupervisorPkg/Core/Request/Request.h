@@ -95,4 +95,78 @@ ProcessUpdateCommBufferRequest (
   IN MM_SUPERVISOR_COMM_UPDATE_BUFFER  *UpdateCommBuffer
   );
 
+/**
+  Function that drains recorded syscall trace entries into the supplied buffer. The entries
+  are grouped by CPU and returned in chronological order per CPU. Entries that do not fit
+  into the supplied buffer are kept in the rings for the next request.
+
+  @param[in, out] TraceBuffer         Buffer to hold the trace header and the drained entries.
+  @param[in]      SuppliedBufferSize  Maximal buffer size supplied by caller.
+
+  @retval EFI_SUCCESS               The trace entries are successfully drained.
+  @retval EFI_UNSUPPORTED           Syscall tracing is not enabled.
+  @retval EFI_INVALID_PARAMETER     TraceBuffer is a null pointer.
+  @retval EFI_SECURITY_VIOLATION    TraceBuffer is not pointing to designated supervisor buffer.
+  @retval EFI_BUFFER_TOO_SMALL      TraceBuffer cannot hold a single trace entry.
+
+**/
+EFI_STATUS
+ProcessSyscallTraceRequest (
+  IN OUT MM_SUPERVISOR_SYSCALL_TRACE_BUFFER  *TraceBuffer,
+  IN     UINT64                              SuppliedBufferSize
+  );
+
+/**
+  Function that copies the IO and MSR policy hit counters into the supplied buffer. The
+  counters keep accumulating after this request.
+
+  @param[in, out] ProfileBuffer       Buffer to hold the profile header and the hit counters.
+  @param[in]      SuppliedBufferSize  Maximal buffer size supplied by caller.
+
+  @retval EFI_SUCCESS               The hit counters are successfully copied.
+  @retval EFI_UNSUPPORTED           Policy profiling is not enabled.
+  @retval EFI_INVALID_PARAMETER     ProfileBuffer is a null pointer.
+  @retval EFI_SECURITY_VIOLATION    ProfileBuffer is not pointing to designated supervisor buffer.
+  @retval EFI_BUFFER_TOO_SMALL      ProfileBuffer cannot hold all the hit counters.
+
+**/
+EFI_STATUS
+ProcessPolicyProfileRequest (
+  IN OUT MM_SUPERVISOR_POLICY_PROFILE_BUFFER  *ProfileBuffer,
+  IN     UINT64                               SuppliedBufferSize
+  );
+
+/**
+  Function that reports the usage of the page table pools.
+
+  @param[out] UsageBuffer   Buffer to hold the page table pool usage.
+
+  @retval EFI_SUCCESS               The usage is successfully reported.
+  @retval EFI_INVALID_PARAMETER     UsageBuffer is a null pointer.
+  @retval EFI_SECURITY_VIOLATION    UsageBuffer is not pointing to designated supervisor buffer.
+  @retval EFI_ACCESS_DENIED         If request occurs before MM foundation is setup.
+
+**/
+EFI_STATUS
+ProcessPageTableUsageRequest (
+  OUT MM_SUPERVISOR_PAGE_TABLE_USAGE_BUFFER  *UsageBuffer
+  );
+
+/**
+  Function that selects how later demotions enter and leave CPL3 routines, in test builds only.
+
+  @param[in, out] PathBuffer    Buffer holding the requested path, updated with the path in effect.
+
+  @retval EFI_SUCCESS               The path is selected.
+  @retval EFI_UNSUPPORTED           PcdMmSupervisorTestEnable is not set.
+  @retval EFI_INVALID_PARAMETER     PathBuffer is a null pointer or the requested path is unknown.
+  @retval EFI_SECURITY_VIOLATION    PathBuffer is not pointing to designated supervisor buffer.
+  @retval EFI_ACCESS_DENIED         If request occurs before MM foundation is setup.
+
+**/
+EFI_STATUS
+ProcessDemotionPathRequest (
+  IN OUT MM_SUPERVISOR_DEMOTION_PATH_BUFFER  *PathBuffer
+  );
+
 #endif // _MM_SUPV_REQUEST_H_
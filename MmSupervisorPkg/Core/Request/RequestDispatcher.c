@@ -21,6 +21,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include "MmSupervisorCore.h"
 #include "Mem/Mem.h"
 #include "Request.h"
+#include "Policy/Policy.h"
 
 /**
   Software MMI handler that is called when a supervisor service is requested.
@@ -148,6 +149,102 @@ MmSupvRequestHandler (
                                       );
       break;
 
+    case MM_SUPERVISOR_REQUEST_SYSCALL_TRACE:
+      ExpectedSize += sizeof (MM_SUPERVISOR_SYSCALL_TRACE_BUFFER);
+      if (*CommBufferSize < ExpectedSize) {
+        DEBUG ((
+          DEBUG_ERROR,
+          "%a - Syscall trace request has bad comm buffer size! %d < %d\n",
+          __FUNCTION__,
+          *CommBufferSize,
+          ExpectedSize
+          ));
+        return EFI_INVALID_PARAMETER;
+      }
+
+      // Use the rest of the common buffer to host as many trace entries as possible
+      ExpectedSize                = *CommBufferSize - sizeof (MM_SUPERVISOR_REQUEST_HEADER);
+      MmSupvRequestHeader->Result = ProcessSyscallTraceRequest (
+                                      (MM_SUPERVISOR_SYSCALL_TRACE_BUFFER *)(MmSupvRequestHeader + 1),
+                                      ExpectedSize
+                                      );
+      if (!EFI_ERROR (MmSupvRequestHeader->Result)) {
+        *CommBufferSize = sizeof (MM_SUPERVISOR_REQUEST_HEADER) + sizeof (MM_SUPERVISOR_SYSCALL_TRACE_BUFFER) +
+                          (UINTN)((MM_SUPERVISOR_SYSCALL_TRACE_BUFFER *)(MmSupvRequestHeader + 1))->EntryCount * sizeof (MM_SUPERVISOR_SYSCALL_TRACE_ENTRY);
+      }
+
+      break;
+
+    case MM_SUPERVISOR_REQUEST_POLICY_PROFILE:
+      ExpectedSize += sizeof (MM_SUPERVISOR_POLICY_PROFILE_BUFFER);
+      if (*CommBufferSize < ExpectedSize) {
+        DEBUG ((
+          DEBUG_ERROR,
+          "%a - Policy profile request has bad comm buffer size! %d < %d\n",
+          __FUNCTION__,
+          *CommBufferSize,
+          ExpectedSize
+          ));
+        return EFI_INVALID_PARAMETER;
+      }
+
+      // Use the rest of the common buffer to host the hit counters
+      ExpectedSize                = *CommBufferSize - sizeof (MM_SUPERVISOR_REQUEST_HEADER);
+      MmSupvRequestHeader->Result = ProcessPolicyProfileRequest (
+                                      (MM_SUPERVISOR_POLICY_PROFILE_BUFFER *)(MmSupvRequestHeader + 1),
+                                      ExpectedSize
+                                      );
+      if (!EFI_ERROR (MmSupvRequestHeader->Result)) {
+        *CommBufferSize = sizeof (MM_SUPERVISOR_REQUEST_HEADER) + sizeof (MM_SUPERVISOR_POLICY_PROFILE_BUFFER) +
+                          (mIoPolicyHitSlotCount + mMsrPolicyHitSlotCount) * sizeof (UINT32);
+      }
+
+      break;
+
+    case MM_SUPERVISOR_REQUEST_PAGE_TABLE_USAGE:
+      ExpectedSize += sizeof (MM_SUPERVISOR_PAGE_TABLE_USAGE_BUFFER);
+      if (*CommBufferSize < ExpectedSize) {
+        DEBUG ((
+          DEBUG_ERROR,
+          "%a - Page table usage request has bad comm buffer size! %d < %d\n",
+          __FUNCTION__,
+          *CommBufferSize,
+          ExpectedSize
+          ));
+        return EFI_INVALID_PARAMETER;
+      }
+
+      MmSupvRequestHeader->Result = ProcessPageTableUsageRequest (
+                                      (MM_SUPERVISOR_PAGE_TABLE_USAGE_BUFFER *)(MmSupvRequestHeader + 1)
+                                      );
+      if (!EFI_ERROR (MmSupvRequestHeader->Result)) {
+        *CommBufferSize = ExpectedSize;
+      }
+
+      break;
+
+    case MM_SUPERVISOR_REQUEST_DEMOTION_PATH:
+      ExpectedSize += sizeof (MM_SUPERVISOR_DEMOTION_PATH_BUFFER);
+      if (*CommBufferSize < ExpectedSize) {
+        DEBUG ((
+          DEBUG_ERROR,
+          "%a - Demotion path request has bad comm buffer size! %d < %d\n",
+          __FUNCTION__,
+          *CommBufferSize,
+          ExpectedSize
+          ));
+        return EFI_INVALID_PARAMETER;
+      }
+
+      MmSupvRequestHeader->Result = ProcessDemotionPathRequest (
+                                      (MM_SUPERVISOR_DEMOTION_PATH_BUFFER *)(MmSupvRequestHeader + 1)
+                                      );
+      if (!EFI_ERROR (MmSupvRequestHeader->Result)) {
+        *CommBufferSize = ExpectedSize;
+      }
+
+      break;
+
     default:
       // Mark unknown requested command as EFI_UNSUPPORTED.
       DEBUG ((DEBUG_ERROR, "%a - Invalid command requested! %d\n", __FUNCTION__, MmSupvRequestHeader->Request));
@@ -0,0 +1,117 @@
+/** @file
+  Routines of draining the per-CPU syscall trace rings through MM Supervisor communicate protocol.
+
+Copyright (C) Microsoft Corporation.
+
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <PiMm.h>
+
+#include <Guid/MmSupervisorRequestData.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+
+#include "MmSupervisorCore.h"
+#include "Mem/Mem.h"
+#include "PrivilegeMgmt/PrivilegeMgmt.h"
+
+/**
+  Function that drains recorded syscall trace entries into the supplied buffer. The entries
+  are grouped by CPU and returned in chronological order per CPU. Entries that do not fit
+  into the supplied buffer are kept in the rings for the next request.
+
+  @param[in, out] TraceBuffer         Buffer to hold the trace header and the drained entries.
+  @param[in]      SuppliedBufferSize  Maximal buffer size supplied by caller.
+
+  @retval EFI_SUCCESS               The trace entries are successfully drained.
+  @retval EFI_UNSUPPORTED           Syscall tracing is not enabled.
+  @retval EFI_INVALID_PARAMETER     TraceBuffer is a null pointer.
+  @retval EFI_SECURITY_VIOLATION    TraceBuffer is not pointing to designated supervisor buffer.
+  @retval EFI_BUFFER_TOO_SMALL      TraceBuffer cannot hold a single trace entry.
+
+**/
+EFI_STATUS
+ProcessSyscallTraceRequest (
+  IN OUT MM_SUPERVISOR_SYSCALL_TRACE_BUFFER  *TraceBuffer,
+  IN     UINT64                              SuppliedBufferSize
+  )
+{
+  EFI_STATUS                         Status;
+  MM_SUPV_SYSCALL_TRACE_RING         *Ring;
+  MM_SUPERVISOR_SYSCALL_TRACE_ENTRY  *Entries;
+  UINT64                             MaxEntries;
+  UINT64                             EntryCount;
+  UINT64                             DroppedCount;
+  UINT64                             RemainingCount;
+  UINT64                             Head;
+  UINTN                              Index;
+
+  if (mSyscallTraceRings == NULL) {
+    Status = EFI_UNSUPPORTED;
+    goto Exit;
+  }
+
+  if (TraceBuffer == NULL) {
+    Status = EFI_INVALID_PARAMETER;
+    DEBUG ((DEBUG_ERROR, "%a Input argument is a null pointer!!!\n", __FUNCTION__));
+    goto Exit;
+  }
+
+  Status = VerifyRequestSupvCommBuffer (TraceBuffer, (UINTN)SuppliedBufferSize);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a Input buffer %p is illegal - %r!!!\n", __FUNCTION__, TraceBuffer, Status));
+    goto Exit;
+  }
+
+  MaxEntries = 0;
+  if (SuppliedBufferSize > sizeof (MM_SUPERVISOR_SYSCALL_TRACE_BUFFER)) {
+    MaxEntries = DivU64x32 (SuppliedBufferSize - sizeof (MM_SUPERVISOR_SYSCALL_TRACE_BUFFER), sizeof (MM_SUPERVISOR_SYSCALL_TRACE_ENTRY));
+  }
+
+  if (MaxEntries == 0) {
+    Status = EFI_BUFFER_TOO_SMALL;
+    DEBUG ((DEBUG_ERROR, "%a Buffer is too small to fit a single trace entry: 0x%lx\n", __FUNCTION__, SuppliedBufferSize));
+    goto Exit;
+  }
+
+  Entries        = (MM_SUPERVISOR_SYSCALL_TRACE_ENTRY *)(TraceBuffer + 1);
+  EntryCount     = 0;
+  DroppedCount   = 0;
+  RemainingCount = 0;
+
+  for (Index = 0; Index < mSyscallTraceRingCount; Index++) {
+    Ring = &mSyscallTraceRings[Index];
+    Head = Ring->Head;
+
+    // The writer has lapped this ring since the last drain, the oldest entries are gone
+    if (Head - Ring->Tail > mSyscallTraceEntriesPerCpu) {
+      DroppedCount += Head - Ring->Tail - mSyscallTraceEntriesPerCpu;
+      Ring->Tail    = Head - mSyscallTraceEntriesPerCpu;
+    }
+
+    while ((Ring->Tail < Head) && (EntryCount < MaxEntries)) {
+      CopyMem (
+        &Entries[EntryCount],
+        &Ring->Entries[Ring->Tail & (mSyscallTraceEntriesPerCpu - 1)],
+        sizeof (MM_SUPERVISOR_SYSCALL_TRACE_ENTRY)
+        );
+      EntryCount++;
+      Ring->Tail++;
+    }
+
+    RemainingCount += Head - Ring->Tail;
+  }
+
+  TraceBuffer->NumberOfCpus   = (UINT32)mSyscallTraceRingCount;
+  TraceBuffer->EntriesPerCpu  = mSyscallTraceEntriesPerCpu;
+  TraceBuffer->EntryCount     = EntryCount;
+  TraceBuffer->DroppedCount   = DroppedCount;
+  TraceBuffer->RemainingCount = RemainingCount;
+
+Exit:
+  return Status;
+}
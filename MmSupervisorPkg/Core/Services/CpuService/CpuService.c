@@ -70,6 +70,45 @@ SmmGetProcessorInfo (
   return EFI_SUCCESS;
 }
 
+/**
+  Derive the handle number of the calling processor from the GDT it executes on. Each
+  processor enters MM with its own GDT out of mGdtBuffer, see InitGdt, so the offset of
+  GDTR base into that buffer identifies the processor without reading its APIC ID.
+
+  @param[out] ProcessorNumber     The handle number of currently executing processor.
+
+  @retval TRUE    ProcessorNumber is returned.
+  @retval FALSE   The calling processor is not on a per processor GDT, e.g. before
+                  the SMI handlers are installed.
+
+**/
+STATIC
+BOOLEAN
+GetProcessorNumberFromGdt (
+  OUT UINTN  *ProcessorNumber
+  )
+{
+  IA32_DESCRIPTOR  Gdtr;
+  UINTN            Offset;
+
+  if (mGdtStepSize == 0) {
+    return FALSE;
+  }
+
+  AsmReadGdtr (&Gdtr);
+  if (Gdtr.Base < (UINTN)mGdtBuffer) {
+    return FALSE;
+  }
+
+  Offset = Gdtr.Base - (UINTN)mGdtBuffer;
+  if ((Offset >= mGdtBufferSize) || ((Offset % mGdtStepSize) != 0)) {
+    return FALSE;
+  }
+
+  *ProcessorNumber = Offset / mGdtStepSize;
+  return TRUE;
+}
+
 /**
   This return the handle number for the calling processor.
 
@@ -98,6 +137,18 @@ SmmWhoAmI (
     return EFI_INVALID_PARAMETER;
   }
 
+  if (GetProcessorNumberFromGdt (&Index)) {
+    //
+    // APIC IDs are unique, so matching the entry found is as good as the scan below
+    //
+    DEBUG_CODE_BEGIN ();
+    ASSERT (gSmmCpuPrivate->ProcessorInfo[Index].ProcessorId == GetApicId ());
+    DEBUG_CODE_END ();
+
+    *ProcessorNumber = Index;
+    return EFI_SUCCESS;
+  }
+
   ApicId = GetApicId ();
 
   for (Index = 0; Index < mMaxNumberOfCpus; Index++) {
@@ -1735,6 +1735,56 @@ SmmStartupThisAp (
            );
 }
 
+/**
+  Schedule a procedure to run on all the present APs in a non-blocking fashion.
+
+  The procedure is scheduled regardless of PcdCpuSmmBlockStartupThisAp, so that the BSP
+  can take part in the work while the APs are running it. Procedures in user range are
+  demoted by ProcedureWrapper, the same way as SmmStartupThisAp does.
+
+  @param  Procedure                The address of the procedure to run
+  @param  ProcArguments            The parameter to pass to the procedure on every AP
+
+  @return Number of APs the procedure is scheduled on, the caller has to track the
+          completion of the procedure by itself.
+
+**/
+UINTN
+SmmStartupAllApsNonBlocking (
+  IN      EFI_AP_PROCEDURE  Procedure,
+  IN OUT  VOID              *ProcArguments OPTIONAL
+  )
+{
+  UINTN  Index;
+  UINTN  ApCount;
+
+  ApCount = 0;
+  for (Index = 0; Index < mMaxNumberOfCpus; Index++) {
+    if (!IsPresentAp (Index)) {
+      continue;
+    }
+
+    gSmmCpuPrivate->ApWrapperFunc[Index].Procedure         = Procedure;
+    gSmmCpuPrivate->ApWrapperFunc[Index].ProcedureArgument = ProcArguments;
+
+    if (!EFI_ERROR (
+           InternalSmmStartupThisAp (
+             ProcedureWrapper,
+             Index,
+             &gSmmCpuPrivate->ApWrapperFunc[Index],
+             &mSmmStartupThisApToken,
+             0,
+             NULL
+             )
+           ))
+    {
+      ApCount++;
+    }
+  }
+
+  return ApCount;
+}
+
 /**
   This function sets DR6 & DR7 according to SMM save state, before running SMM C code.
   They are useful when you want to enable hardware breakpoints in SMM without entry SMM mode.
@@ -1969,6 +2019,12 @@ SmiRendezvous (
   }
 
 Exit:
+  //
+  // Hand the syscall MSRs back to the interrupted context, if any routine was demoted on this
+  // CPU during this SMI. They are installed once by the first demotion and kept until here.
+  //
+  RestoreCpl0MsrStar (CpuIndex);
+
   SmmCpuFeaturesRendezvousExit (CpuIndex);
 
   //
@@ -153,6 +153,22 @@ SmmBlockingStartupThisAp (
   IN OUT  VOID              *ProcArguments OPTIONAL
   );
 
+/**
+  Schedule a procedure to run on all the present APs in a non-blocking fashion.
+
+  @param  Procedure                The address of the procedure to run
+  @param  ProcArguments            The parameter to pass to the procedure on every AP
+
+  @return Number of APs the procedure is scheduled on, the caller has to track the
+          completion of the procedure by itself.
+
+**/
+UINTN
+SmmStartupAllApsNonBlocking (
+  IN      EFI_AP_PROCEDURE  Procedure,
+  IN OUT  VOID              *ProcArguments OPTIONAL
+  );
+
 /**
   Create 4G PageTable in SMRAM.
 
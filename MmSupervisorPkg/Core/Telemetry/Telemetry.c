@@ -48,11 +48,10 @@ PrepareNReportError (
   IN EFI_SYSTEM_CONTEXT  SystemContext
   )
 {
-  EFI_STATUS            Status;
-  EFI_GUID              DriverGuid;
-  EFI_PHYSICAL_ADDRESS  DriverAddr;
-  UINT64                FaultRIP;
-  UINTN                 CpuIndex;
+  EFI_STATUS                  Status;
+  CONST MM_IMAGE_INDEX_ENTRY  *ImageEntry;
+  UINT64                      FaultRIP;
+  UINTN                       CpuIndex;
 
   MM_SUPV_TELEMETRY_DATA  *TelemtryData;
 
@@ -89,17 +88,16 @@ PrepareNReportError (
   TelemtryData->ExceptionRIP = FaultRIP;
   if (IsBufferInsideMmram (FaultRIP & ~(EFI_PAGE_MASK), EFI_PAGE_SIZE)) {
     // Attempting to execute code outside of MMRAM, do not run driver look up routines
-    DriverAddr                      = PeCoffSearchImageBase (FaultRIP);
-    TelemtryData->DriverLoadAddress = DriverAddr;
-    DEBUG ((DEBUG_INFO, "%a Loaded image is calculated to be: %p from caller address: %p\n", __FUNCTION__, DriverAddr, FaultRIP));
-
-    Status = FindFileNameFromDiscoveredList (DriverAddr, &DriverGuid);
-    if (!EFI_ERROR (Status)) {
-      CopyMem (&TelemtryData->DriverId, &DriverGuid, sizeof (EFI_GUID));
-    } else {
-      DEBUG ((DEBUG_ERROR, "%a Cannot locate the file name from loaded image address: %p... - %r\n", __FUNCTION__, DriverAddr, Status));
+    ImageEntry = MmImageIndexLookup (FaultRIP);
+    if (ImageEntry == NULL) {
+      Status = EFI_NOT_FOUND;
+      DEBUG ((DEBUG_ERROR, "%a Cannot locate the loaded image from caller address: %p... - %r\n", __FUNCTION__, FaultRIP, Status));
       goto Done;
     }
+
+    TelemtryData->DriverLoadAddress = ImageEntry->ImageBase;
+    CopyMem (&TelemtryData->DriverId, &ImageEntry->DriverEntry->FileName, sizeof (EFI_GUID));
+    DEBUG ((DEBUG_INFO, "%a Loaded image is calculated to be: %p from caller address: %p\n", __FUNCTION__, ImageEntry->ImageBase, FaultRIP));
   } else {
     TelemtryData->DriverLoadAddress = FaultRIP;
     ZeroMem (&TelemtryData->DriverId, sizeof (EFI_GUID));
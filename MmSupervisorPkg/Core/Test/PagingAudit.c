@@ -71,14 +71,15 @@ SmmLoadedImageTableDump (
   OUT SMM_PAGE_AUDIT_MISC_DATA_COMM_BUFFER  *CommBuffer
   )
 {
-  EFI_STATUS                 Status;
-  UINTN                      HandleBufferSize;
-  UINTN                      HandleBufferCount;
-  EFI_HANDLE                 *HandleBuffer;
-  EFI_LOADED_IMAGE_PROTOCOL  *LoadedImage;
-  UINTN                      SourceIndex;
-  UINTN                      DestinationIndex;
-  CHAR8                      *ImageName;
+  EFI_STATUS                  Status;
+  UINTN                       HandleBufferSize;
+  UINTN                       HandleBufferCount;
+  EFI_HANDLE                  *HandleBuffer;
+  EFI_LOADED_IMAGE_PROTOCOL   *LoadedImage;
+  UINTN                       SourceIndex;
+  UINTN                       DestinationIndex;
+  CONST CHAR8                 *ImageName;
+  CONST MM_IMAGE_INDEX_ENTRY  *ImageEntry;
 
   //
   // First, need to get a buffer of all the handles for loaded images.
@@ -147,7 +148,9 @@ SmmLoadedImageTableDump (
       CommBuffer->SmmImage[DestinationIndex].ImageBase = (UINT64)LoadedImage->ImageBase;
       CommBuffer->SmmImage[DestinationIndex].ImageSize = (UINT64)LoadedImage->ImageSize;
 
-      ImageName = PeCoffLoaderGetPdbPointer (LoadedImage->ImageBase);
+      // Both the name and the file GUID come from the image index, the image is not parsed again
+      ImageEntry = MmImageIndexLookup ((EFI_PHYSICAL_ADDRESS)(UINTN)LoadedImage->ImageBase);
+      ImageName  = (ImageEntry == NULL) ? NULL : ImageEntry->PdbString;
       if (ImageName == NULL) {
         DEBUG ((DEBUG_WARN, "%a The image of interest (0x%p) does not have a name.\n", __FUNCTION__, LoadedImage->ImageBase));
       }
@@ -158,12 +161,11 @@ SmmLoadedImageTableDump (
         ((ImageName == NULL) ? "NULL" : ImageName),
         MAX_IMAGE_NAME_SIZE-1
         );
-      Status = FindFileNameFromDiscoveredList (
-                 (EFI_PHYSICAL_ADDRESS)(UINTN)LoadedImage->ImageBase,
-                 &CommBuffer->SmmImage[DestinationIndex].ImageGuid
-                 );
       // Only handle error with ASSERT here as this code should only be built with ASSERT turned on.
-      ASSERT_EFI_ERROR (Status);
+      ASSERT (ImageEntry != NULL);
+      if (ImageEntry != NULL) {
+        CopyGuid (&CommBuffer->SmmImage[DestinationIndex].ImageGuid, &ImageEntry->DriverEntry->FileName);
+      }
     }
 
     // Update the return count and HasMore.
@@ -182,8 +182,9 @@ EFI_MMRAM_DESCRIPTOR    *mCurrentMmramRange;
 EFI_PHYSICAL_ADDRESS    mMmramCacheBase;
 UINT64                  mMmramCacheSize;
 
-// MU_CHANGE: Loaded Fixed Address information is unsupported
-// EFI_LOAD_FIXED_ADDRESS_CONFIGURATION_TABLE    *mLMFAConfigurationTable = NULL;
+// MU_CHANGE: MM_SUPV: Base of the MMRAM range reserved for all MM code when Loading Module At
+// Fixed Address feature is enabled, build tool assigns MM images their offsets against it.
+EFI_PHYSICAL_ADDRESS  mLoadFixAddressMmramBase = 0;
 
 //
 // Table of PPI notification and GUIDed Event notifications that the SMM IPL requires
@@ -430,100 +431,104 @@ MmDriverDispatchNotify (
 
 // MU_CHANGE Ends: MM_SUPV
 
-// MU_CHANGE: Loaded Fixed Address information is unsupported
-// /**
-//   Get the fixed loading address from image header assigned by build tool. This function only be called
-//   when Loading module at Fixed address feature enabled.
-
-//   @param  ImageContext              Pointer to the image context structure that describes the PE/COFF
-//                                     image that needs to be examined by this function.
-//   @retval EFI_SUCCESS               An fixed loading address is assigned to this image by build tools .
-//   @retval EFI_NOT_FOUND             The image has no assigned fixed loading address.
-// **/
-// EFI_STATUS
-// GetPeCoffImageFixLoadingAssignedAddress(
-//   IN OUT PE_COFF_LOADER_IMAGE_CONTEXT  *ImageContext
-//   )
-// {
-//    UINTN                              SectionHeaderOffset;
-//    EFI_STATUS                         Status;
-//    EFI_IMAGE_SECTION_HEADER           SectionHeader;
-//    EFI_IMAGE_OPTIONAL_HEADER_UNION    *ImgHdr;
-//    EFI_PHYSICAL_ADDRESS               FixLoadingAddress;
-//    UINT16                             Index;
-//    UINTN                              Size;
-//    UINT16                             NumberOfSections;
-//    EFI_PHYSICAL_ADDRESS               MmramBase;
-//    UINT64                             MmCodeSize;
-//    UINT64                             ValueInSectionHeader;
-//    //
-//    // Build tool will calculate the smm code size and then patch the PcdLoadFixAddressSmmCodePageNumber
-//    //
-//    MmCodeSize = EFI_PAGES_TO_SIZE (PcdGet32(PcdLoadFixAddressSmmCodePageNumber));
-
-//    FixLoadingAddress = 0;
-//    Status = EFI_NOT_FOUND;
-//    MmramBase = mLMFAConfigurationTable->SmramBase;
-//    //
-//    // Get PeHeader pointer
-//    //
-//    ImgHdr = (EFI_IMAGE_OPTIONAL_HEADER_UNION *)((CHAR8* )ImageContext->Handle + ImageContext->PeCoffHeaderOffset);
-//    SectionHeaderOffset = ImageContext->PeCoffHeaderOffset +
-//                          sizeof (UINT32) +
-//                          sizeof (EFI_IMAGE_FILE_HEADER) +
-//                          ImgHdr->Pe32.FileHeader.SizeOfOptionalHeader;
-//    NumberOfSections = ImgHdr->Pe32.FileHeader.NumberOfSections;
-
-//    //
-//    // Get base address from the first section header that doesn't point to code section.
-//    //
-//    for (Index = 0; Index < NumberOfSections; Index++) {
-//      //
-//      // Read section header from file
-//      //
-//      Size = sizeof (EFI_IMAGE_SECTION_HEADER);
-//      Status = ImageContext->ImageRead (
-//                               ImageContext->Handle,
-//                               SectionHeaderOffset,
-//                               &Size,
-//                               &SectionHeader
-//                               );
-//      if (EFI_ERROR (Status)) {
-//        return Status;
-//      }
-
-//      Status = EFI_NOT_FOUND;
-
-//      if ((SectionHeader.Characteristics & EFI_IMAGE_SCN_CNT_CODE) == 0) {
-//        //
-//        // Build tool saves the offset to SMRAM base as image base in PointerToRelocations & PointerToLineNumbers fields in the
-//        // first section header that doesn't point to code section in image header. And there is an assumption that when the
-//        // feature is enabled, if a module is assigned a loading address by tools, PointerToRelocations & PointerToLineNumbers
-//        // fields should NOT be Zero, or else, these 2 fields should be set to Zero
-//        //
-//        ValueInSectionHeader = ReadUnaligned64((UINT64*)&SectionHeader.PointerToRelocations);
-//        if (ValueInSectionHeader != 0) {
-//          //
-//          // Found first section header that doesn't point to code section in which build tool saves the
-//          // offset to SMRAM base as image base in PointerToRelocations & PointerToLineNumbers fields
-//          //
-//          FixLoadingAddress = (EFI_PHYSICAL_ADDRESS)(MmramBase + (INT64)ValueInSectionHeader);
-
-//          if (MmramBase + MmCodeSize > FixLoadingAddress && MmramBase <=  FixLoadingAddress) {
-//            //
-//            // The assigned address is valid. Return the specified loading address
-//            //
-//            ImageContext->ImageAddress = FixLoadingAddress;
-//            Status = EFI_SUCCESS;
-//          }
-//        }
-//        break;
-//      }
-//      SectionHeaderOffset += sizeof (EFI_IMAGE_SECTION_HEADER);
-//    }
-//    DEBUG ((DEBUG_INFO|DEBUG_LOAD, "LOADING MODULE FIXED INFO: Loading module at fixed address %x, Status = %r \n", FixLoadingAddress, Status));
-//    return Status;
-// }
+/**
+  Get the fixed loading address from image header assigned by build tool. This function only be called
+  when Loading module at Fixed address feature enabled.
+
+  @param  ImageContext              Pointer to the image context structure that describes the PE/COFF
+                                    image that needs to be examined by this function.
+  @retval EFI_SUCCESS               An fixed loading address is assigned to this image by build tools .
+  @retval EFI_NOT_FOUND             The image has no assigned fixed loading address.
+**/
+EFI_STATUS
+GetPeCoffImageFixLoadingAssignedAddress (
+  IN OUT PE_COFF_LOADER_IMAGE_CONTEXT  *ImageContext
+  )
+{
+  UINTN                            SectionHeaderOffset;
+  EFI_STATUS                       Status;
+  EFI_IMAGE_SECTION_HEADER         SectionHeader;
+  EFI_IMAGE_OPTIONAL_HEADER_UNION  *ImgHdr;
+  EFI_PHYSICAL_ADDRESS             FixLoadingAddress;
+  UINT16                           Index;
+  UINTN                            Size;
+  UINT16                           NumberOfSections;
+  EFI_PHYSICAL_ADDRESS             MmramBase;
+  UINT64                           MmCodeSize;
+  UINT64                           ValueInSectionHeader;
+
+  //
+  // Build tool will calculate the smm code size and then patch the PcdLoadFixAddressSmmCodePageNumber
+  //
+  MmCodeSize = EFI_PAGES_TO_SIZE (PcdGet32 (PcdLoadFixAddressSmmCodePageNumber));
+
+  FixLoadingAddress = 0;
+  Status            = EFI_NOT_FOUND;
+  // MU_CHANGE: MM_SUPV: There is no LMFA configuration table in PEI, the MMRAM base is cached locally
+  MmramBase = mLoadFixAddressMmramBase;
+  //
+  // Get PeHeader pointer
+  //
+  ImgHdr              = (EFI_IMAGE_OPTIONAL_HEADER_UNION *)((CHAR8 *)ImageContext->Handle + ImageContext->PeCoffHeaderOffset);
+  SectionHeaderOffset = ImageContext->PeCoffHeaderOffset +
+                        sizeof (UINT32) +
+                        sizeof (EFI_IMAGE_FILE_HEADER) +
+                        ImgHdr->Pe32.FileHeader.SizeOfOptionalHeader;
+  NumberOfSections = ImgHdr->Pe32.FileHeader.NumberOfSections;
+
+  //
+  // Get base address from the first section header that doesn't point to code section.
+  //
+  for (Index = 0; Index < NumberOfSections; Index++) {
+    //
+    // Read section header from file
+    //
+    Size   = sizeof (EFI_IMAGE_SECTION_HEADER);
+    Status = ImageContext->ImageRead (
+                             ImageContext->Handle,
+                             SectionHeaderOffset,
+                             &Size,
+                             &SectionHeader
+                             );
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    Status = EFI_NOT_FOUND;
+
+    if ((SectionHeader.Characteristics & EFI_IMAGE_SCN_CNT_CODE) == 0) {
+      //
+      // Build tool saves the offset to SMRAM base as image base in PointerToRelocations & PointerToLineNumbers fields in the
+      // first section header that doesn't point to code section in image header. And there is an assumption that when the
+      // feature is enabled, if a module is assigned a loading address by tools, PointerToRelocations & PointerToLineNumbers
+      // fields should NOT be Zero, or else, these 2 fields should be set to Zero
+      //
+      ValueInSectionHeader = ReadUnaligned64 ((UINT64 *)&SectionHeader.PointerToRelocations);
+      if (ValueInSectionHeader != 0) {
+        //
+        // Found first section header that doesn't point to code section in which build tool saves the
+        // offset to SMRAM base as image base in PointerToRelocations & PointerToLineNumbers fields
+        //
+        FixLoadingAddress = (EFI_PHYSICAL_ADDRESS)(MmramBase + (INT64)ValueInSectionHeader);
+
+        if ((MmramBase + MmCodeSize > FixLoadingAddress) && (MmramBase <=  FixLoadingAddress)) {
+          //
+          // The assigned address is valid. Return the specified loading address
+          //
+          ImageContext->ImageAddress = FixLoadingAddress;
+          Status                     = EFI_SUCCESS;
+        }
+      }
+
+      break;
+    }
+
+    SectionHeaderOffset += sizeof (EFI_IMAGE_SECTION_HEADER);
+  }
+
+  DEBUG ((DEBUG_INFO|DEBUG_LOAD, "LOADING MODULE FIXED INFO: Loading module at fixed address %x, Status = %r \n", FixLoadingAddress, Status));
+  return Status;
+}
 
 // MU_CHANGE Starts: The MM core address found routine is updated with PEI services
 
@@ -649,48 +654,46 @@ ExecuteMmCoreFromMmram (
     return Status;
   }
 
-  // MU_CHANGE: Loaded Fixed Address information is unsupported
   //
   // if Loading module at Fixed Address feature is enabled, the SMM core driver will be loaded to
   // the address assigned by build tool.
   //
-  if (PcdGet64 (PcdLoadModuleAtFixAddressEnable) != 0) {
-    ASSERT (FALSE);
-    // //
-    // // Get the fixed loading address assigned by Build tool
-    // //
-    // Status = GetPeCoffImageFixLoadingAssignedAddress (&ImageContext);
-    // if (!EFI_ERROR (Status)) {
-    //   //
-    //   // Since the memory range to load SMM CORE will be cut out in SMM core, so no need to allocate and free this range
-    //   //
-    //   PageCount = 0;
-    //   //
-    //   // Reserved Mmram Region for SmmCore is not used, and remove it from MmramRangeCount.
-    //   //
-    //   gMmCorePrivate->MmramRangeCount --;
-    // } else {
-    //   DEBUG ((DEBUG_INFO, "LOADING MODULE FIXED ERROR: Loading module at fixed address at address failed\n"));
-    //   //
-    //   // Allocate memory for the image being loaded from the EFI_SRAM_DESCRIPTOR
-    //   // specified by MmramRange
-    //   //
-    //   PageCount = (UINTN)EFI_SIZE_TO_PAGES((UINTN)ImageContext.ImageSize + ImageContext.SectionAlignment);
-
-    //   ASSERT ((MmramRange->PhysicalSize & EFI_PAGE_MASK) == 0);
-    //   ASSERT (MmramRange->PhysicalSize > EFI_PAGES_TO_SIZE (PageCount));
-
-    //   MmramRange->PhysicalSize -= EFI_PAGES_TO_SIZE (PageCount);
-    //   MmramRangeSmmCore->CpuStart = MmramRange->CpuStart + MmramRange->PhysicalSize;
-    //   MmramRangeSmmCore->PhysicalStart = MmramRange->PhysicalStart + MmramRange->PhysicalSize;
-    //   MmramRangeSmmCore->RegionState = MmramRange->RegionState | EFI_ALLOCATED;
-    //   MmramRangeSmmCore->PhysicalSize = EFI_PAGES_TO_SIZE (PageCount);
-
-    //   //
-    //   // Align buffer on section boundary
-    //   //
-    //   ImageContext.ImageAddress = MmramRangeSmmCore->CpuStart;
-    // }
+  if (mLoadFixAddressMmramBase != 0) {
+    //
+    // Get the fixed loading address assigned by Build tool
+    //
+    Status = GetPeCoffImageFixLoadingAssignedAddress (&ImageContext);
+    if (!EFI_ERROR (Status)) {
+      //
+      // Since the memory range to load SMM CORE will be cut out in SMM core, so no need to allocate and free this range
+      //
+      PageCount = 0;
+      //
+      // Reserved Mmram Region for SmmCore is not used, and remove it from MmramRangeCount.
+      //
+      gMmCorePrivate->MmramRangeCount--;
+    } else {
+      DEBUG ((DEBUG_INFO, "LOADING MODULE FIXED ERROR: Loading module at fixed address at address failed\n"));
+      //
+      // Allocate memory for the image being loaded from the EFI_SRAM_DESCRIPTOR
+      // specified by MmramRange
+      //
+      PageCount = (UINTN)EFI_SIZE_TO_PAGES ((UINTN)ImageContext.ImageSize + ImageContext.SectionAlignment);
+
+      ASSERT ((MmramRange->PhysicalSize & EFI_PAGE_MASK) == 0);
+      ASSERT (MmramRange->PhysicalSize > EFI_PAGES_TO_SIZE (PageCount));
+
+      MmramRange->PhysicalSize        -= EFI_PAGES_TO_SIZE (PageCount);
+      MmramRangeSmmCore->CpuStart      = MmramRange->CpuStart + MmramRange->PhysicalSize;
+      MmramRangeSmmCore->PhysicalStart = MmramRange->PhysicalStart + MmramRange->PhysicalSize;
+      MmramRangeSmmCore->RegionState   = MmramRange->RegionState | EFI_ALLOCATED;
+      MmramRangeSmmCore->PhysicalSize  = EFI_PAGES_TO_SIZE (PageCount);
+
+      //
+      // Align buffer on section boundary
+      //
+      ImageContext.ImageAddress = MmramRangeSmmCore->CpuStart;
+    }
   } else {
     //
     // Allocate memory for the image being loaded from the EFI_SRAM_DESCRIPTOR
@@ -1111,13 +1114,11 @@ GetFullMmramRanges (
   // Reserve one entry for SMM Core in the full SMRAM ranges.
   //
   AdditionMmramRangeCount = 1;
-  // MU_CHANGE: Loaded Fixed Address information is unsupported
   if (PcdGet64 (PcdLoadModuleAtFixAddressEnable) != 0) {
-    ASSERT (FALSE);
-    // //
-    // // Reserve two entries for all SMM drivers and SMM Core in the full SMRAM ranges.
-    // //
-    // AdditionMmramRangeCount = 2;
+    //
+    // Reserve two entries for all SMM drivers and SMM Core in the full SMRAM ranges.
+    //
+    AdditionMmramRangeCount = 2;
   }
 
   if (MmramReservedCount == 0) {
@@ -1330,10 +1331,10 @@ MmIplPeiEntry (
   UINT64      MaxSize;
   UINTN       Size;
   UINTN       MmramRangeCount;
-  // UINT64                          MmCodeSize;
+  UINT64      MmCodeSize;
   // EFI_CPU_ARCH_PROTOCOL           *CpuArch;
   // EFI_STATUS                      SetAttrStatus;
-  // EFI_MMRAM_DESCRIPTOR            *MmramRangeSmmDriver;
+  EFI_MMRAM_DESCRIPTOR  *MmramRangeSmmDriver;
   // EFI_GCD_MEMORY_SPACE_DESCRIPTOR MemDesc;
   EFI_MMRAM_DESCRIPTOR  *MmramRanges;
   // MU_CHANGE: MM_SUPV: Test supervisor communication before publishing protocol
@@ -1466,48 +1467,41 @@ MmIplPeiEntry (
       }
     }
 
-    // MU_CHANGE: Loaded Fixed Address information is unsupported
     //
-    // if Loading module at Fixed Address feature is enabled, save the SMRAM base to Load
-    // Modules At Fixed Address Configuration Table.
+    // if Loading module at Fixed Address feature is enabled, reserve the start of the SMRAM window
+    // for all SMM code, the build tool assigns SMM images their addresses in it.
     //
     if (PcdGet64 (PcdLoadModuleAtFixAddressEnable) != 0) {
-      ASSERT (FALSE);
-      // //
-      // // Build tool will calculate the smm code size and then patch the PcdLoadFixAddressSmmCodePageNumber
-      // //
-      // MmCodeSize = LShiftU64 (PcdGet32(PcdLoadFixAddressSmmCodePageNumber), EFI_PAGE_SHIFT);
-      // //
-      // // The SMRAM available memory is assumed to be larger than MmCodeSize
-      // //
-      // ASSERT (mCurrentMmramRange->PhysicalSize > MmCodeSize);
-      // //
-      // // Retrieve Load modules At fixed address configuration table and save the SMRAM base.
-      // //
-      // Status = EfiGetSystemConfigurationTable (
-      //           &gLoadFixedAddressConfigurationTableGuid,
-      //          (VOID **) &mLMFAConfigurationTable
-      //          );
-      // if (mLMFAConfigurationTable != NULL) {
-      //   mLMFAConfigurationTable->SmramBase = mCurrentMmramRange->CpuStart;
-      //   //
-      //   // Print the SMRAM base
-      //   //
-      //   DEBUG ((DEBUG_INFO, "LOADING MODULE FIXED INFO: TSEG BASE is %x. \n", mLMFAConfigurationTable->SmramBase));
-      // }
+      //
+      // Build tool will calculate the smm code size and then patch the PcdLoadFixAddressSmmCodePageNumber
+      //
+      MmCodeSize = LShiftU64 (PcdGet32 (PcdLoadFixAddressSmmCodePageNumber), EFI_PAGE_SHIFT);
+      //
+      // The SMRAM available memory is assumed to be larger than MmCodeSize
+      //
+      ASSERT (mCurrentMmramRange->PhysicalSize > MmCodeSize);
+      //
+      // MU_CHANGE: MM_SUPV: There is no LMFA configuration table in PEI, cache the SMRAM base for
+      // the MM core load, the MM core finds the range below through its MMRAM ranges.
+      //
+      mLoadFixAddressMmramBase = mCurrentMmramRange->CpuStart;
+      //
+      // Print the SMRAM base
+      //
+      DEBUG ((DEBUG_INFO, "LOADING MODULE FIXED INFO: TSEG BASE is %x. \n", mLoadFixAddressMmramBase));
 
-      // //
-      // // Fill the Mmram range for all SMM code
-      // //
-      // MmramRangeSmmDriver = &MmramRanges[gMmCorePrivate->MmramRangeCount - 2];
-      // MmramRangeSmmDriver->CpuStart      = mCurrentMmramRange->CpuStart;
-      // MmramRangeSmmDriver->PhysicalStart = mCurrentMmramRange->PhysicalStart;
-      // MmramRangeSmmDriver->RegionState   = mCurrentMmramRange->RegionState | EFI_ALLOCATED;
-      // MmramRangeSmmDriver->PhysicalSize  = MmCodeSize;
-
-      // mCurrentMmramRange->PhysicalSize  -= MmCodeSize;
-      // mCurrentMmramRange->CpuStart       = mCurrentMmramRange->CpuStart + MmCodeSize;
-      // mCurrentMmramRange->PhysicalStart  = mCurrentMmramRange->PhysicalStart + MmCodeSize;
+      //
+      // Fill the Mmram range for all SMM code
+      //
+      MmramRangeSmmDriver                = &MmramRanges[gMmCorePrivate->MmramRangeCount - 2];
+      MmramRangeSmmDriver->CpuStart      = mCurrentMmramRange->CpuStart;
+      MmramRangeSmmDriver->PhysicalStart = mCurrentMmramRange->PhysicalStart;
+      MmramRangeSmmDriver->RegionState   = mCurrentMmramRange->RegionState | EFI_ALLOCATED;
+      MmramRangeSmmDriver->PhysicalSize  = MmCodeSize;
+
+      mCurrentMmramRange->PhysicalSize -= MmCodeSize;
+      mCurrentMmramRange->CpuStart      = mCurrentMmramRange->CpuStart + MmCodeSize;
+      mCurrentMmramRange->PhysicalStart = mCurrentMmramRange->PhysicalStart + MmCodeSize;
     }
 
     //
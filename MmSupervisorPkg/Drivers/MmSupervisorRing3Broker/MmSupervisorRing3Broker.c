@@ -15,8 +15,10 @@
 
 #include <Guid/EventGroup.h>
 
+#include <Library/BaseLib.h>
 #include <Library/DebugLib.h>
 #include <Library/BaseMemoryLib.h>
+#include <Library/PcdLib.h>
 #include <Library/MmServicesTableLib.h>
 #include <Library/SysCallLib.h>
 
@@ -24,6 +26,8 @@
 #include "MmCpu/SyscallMmCpuRing3Broker.h"
 #include "Handler/MmHandlerProfileBroker.h"
 
+#define SYSCALL_ROUND_TRIP_ITERATIONS  1000
+
 //
 // Table of MMI Handlers that are registered by the MM Core when it is initialized
 //
@@ -274,6 +278,51 @@ MmEndOfDxeHandler (
   return Status;
 }
 
+/**
+  Measure the average syscall round trip cost of the register-only fast path
+  against the full FX state preserving path, using the CPL3 TSC.
+
+  @param[in] Iterations     Number of syscalls issued per path.
+
+**/
+VOID
+MeasureSyscallRoundTrip (
+  IN UINTN  Iterations
+  )
+{
+  UINTN   Index;
+  UINT64  Start;
+  UINT64  FastTicks;
+  UINT64  FullTicks;
+
+  if (Iterations == 0) {
+    return;
+  }
+
+  Start = AsmReadTsc ();
+  for (Index = 0; Index < Iterations; Index++) {
+    SysCall (SMM_SC_NULL_FAST, 0, 0, 0);
+  }
+
+  FastTicks = AsmReadTsc () - Start;
+
+  Start = AsmReadTsc ();
+  for (Index = 0; Index < Iterations; Index++) {
+    SysCall (SMM_SC_NULL, 0, 0, 0);
+  }
+
+  FullTicks = AsmReadTsc () - Start;
+
+  DEBUG ((
+    DEBUG_INFO,
+    "%a - %d round trips, fast path %ld ticks/call, full path %ld ticks/call\n",
+    __func__,
+    Iterations,
+    DivU64x64Remainder (FastTicks, Iterations, NULL),
+    DivU64x64Remainder (FullTicks, Iterations, NULL)
+    ));
+}
+
 EFI_STATUS
 EFIAPI
 MmSupervisorRing3BrokerEntry (
@@ -288,8 +337,12 @@ MmSupervisorRing3BrokerEntry (
 
   MmInitializeMemoryServices ();
 
-  // Step 1: Register with MM Core with handler jump point
-  SysCall (SMM_REG_HDL_JMP, (UINTN)CentralRing3JumpPointer, (UINTN)ApRing3JumpPointer, 0);
+  if (FeaturePcdGet (PcdMmSupervisorTestEnable)) {
+    MeasureSyscallRoundTrip (SYSCALL_ROUND_TRIP_ITERATIONS);
+  }
+
+  // Step 1: Register with MM Core with handler jump point, and the trampoline for SYSRET demotions
+  SysCall (SMM_REG_HDL_JMP, (UINTN)CentralRing3JumpPointer, (UINTN)ApRing3JumpPointer, (UINTN)SysretRing3Trampoline);
 
   // Step 2: Register ring 3 version of gMmst
   SysCall (SMM_SET_CPL3_TBL, (UINTN)&gMmShimMmst, 0, 0);
@@ -98,6 +98,16 @@ ApRing3JumpPointer (
   IN VOID               *ProcedureArgument
   );
 
+//
+// CPL3 entry point of SYSRET demotions, with the routine in rax and its first argument
+// in r10. Not callable from C.
+//
+VOID
+EFIAPI
+SysretRing3Trampoline (
+  VOID
+  );
+
 EFI_STATUS
 EFIAPI
 SyscallMmInstallConfigurationTable (
@@ -0,0 +1,65 @@
+/** @file
+  Definitions of the vectored MM communicate message, which carries several ordinary
+  MM communicate messages to the MM core in a single MMI.
+
+  The vectored message is sent through the existing MM communicate PPI or protocol, with
+  gMmVectoredCommunicateGuid as its HeaderGuid. Its payload is an MM_VECTORED_COMMUNICATE_HEADER
+  followed by MessageCount MM_VECTORED_COMMUNICATE_ENTRY, each 8 byte aligned. The MM core
+  dispatches the embedded messages in order, as if each of them were sent on its own, and
+  reports the status and updated MessageLength of each message in its entry.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef MM_VECTORED_COMMUNICATE_H_
+#define MM_VECTORED_COMMUNICATE_H_
+
+#define MM_VECTORED_COMMUNICATE_GUID \
+  { 0x4252622f, 0x864c, 0x467b, { 0xa8, 0xeb, 0xa4, 0x4d, 0xdb, 0x30, 0x69, 0x00 } }
+
+#define MM_VECTORED_COMMUNICATE_SIGNATURE  SIGNATURE_32('M', 'V', 'C', 'M')
+
+//
+// Upper bound of messages in one vectored message, so that a single MMI stays bounded.
+//
+#define MM_VECTORED_COMMUNICATE_MAX_MESSAGES  64
+
+#pragma pack(push, 1)
+
+typedef struct {
+  UINT32    Signature;
+  UINT32    MessageCount;
+} MM_VECTORED_COMMUNICATE_HEADER;
+
+/**
+  One embedded message. EntrySize covers the whole entry, including the data of Message and the
+  padding up to the next entry, and must be a multiple of 8. Message.MessageLength is the size of
+  the message data upon input, and the size returned by its handler upon output.
+
+**/
+typedef struct {
+  UINT32                       EntrySize;
+  UINT32                       Reserved;
+  UINT64                       ReturnStatus; // EFI_SUCCESS, or EFI_NOT_FOUND if no handler claimed the message
+  EFI_MM_COMMUNICATE_HEADER    Message;
+} MM_VECTORED_COMMUNICATE_ENTRY;
+
+#pragma pack(pop)
+
+//
+// Size of an entry apart from the data of its message.
+//
+#define MM_VECTORED_COMMUNICATE_ENTRY_OVERHEAD \
+  (OFFSET_OF (MM_VECTORED_COMMUNICATE_ENTRY, Message) + OFFSET_OF (EFI_MM_COMMUNICATE_HEADER, Data))
+
+//
+// Size of an entry carrying DataSize bytes of message data.
+//
+#define MM_VECTORED_COMMUNICATE_ENTRY_SIZE(DataSize) \
+  ALIGN_VALUE (MM_VECTORED_COMMUNICATE_ENTRY_OVERHEAD + (DataSize), 8)
+
+extern EFI_GUID  gMmVectoredCommunicateGuid;
+
+#endif // MM_VECTORED_COMMUNICATE_H_
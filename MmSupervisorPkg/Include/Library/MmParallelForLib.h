@@ -0,0 +1,60 @@
+/** @file
+
+  Provides a work-stealing parallel-for service over the CPUs gathered in an MMI.
+
+  Copyright (C) Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef __MM_PARALLEL_FOR_LIB_H__
+#define __MM_PARALLEL_FOR_LIB_H__
+
+/**
+  Body of a parallel-for loop, called with consecutive sub-ranges of the iteration space.
+  It may run on any CPU gathered in the current MMI, concurrently with other sub-ranges.
+
+  @param[in]  Context   The context supplied to MmParallelFor.
+  @param[in]  Begin     First index of the sub-range.
+  @param[in]  End       One past the last index of the sub-range.
+
+**/
+typedef
+VOID
+(EFIAPI *MM_PARALLEL_FOR_BODY)(
+  IN VOID   *Context OPTIONAL,
+  IN UINTN  Begin,
+  IN UINTN  End
+  );
+
+/**
+  Run Body over the iteration space [0, Count) on all the CPUs in MM.
+
+  The iteration space is split evenly into one range per CPU. Each CPU consumes its own
+  range GrainSize indices at a time, and steals half of the remainder of another CPU once
+  its own range runs dry. The function returns after all the indices are consumed.
+
+  This function has to be called from the CPU running the MMI handlers. Only the calling
+  CPU takes part in the work if the APs cannot be started.
+
+  @param[in]  Count       Number of indices in the iteration space.
+  @param[in]  GrainSize   Maximal number of indices passed to one call of Body, zero
+                          lets the library choose.
+  @param[in]  Body        Loop body.
+  @param[in]  Context     Context passed to every call of Body.
+
+  @retval EFI_SUCCESS             All the indices are consumed by Body.
+  @retval EFI_INVALID_PARAMETER   Body is NULL, or Count or GrainSize exceed MAX_UINT32.
+  @retval EFI_OUT_OF_RESOURCES    Cannot allocate the scheduling state.
+**/
+EFI_STATUS
+EFIAPI
+MmParallelFor (
+  IN UINTN                 Count,
+  IN UINTN                 GrainSize,
+  IN MM_PARALLEL_FOR_BODY  Body,
+  IN VOID                  *Context OPTIONAL
+  );
+
+#endif // __MM_PARALLEL_FOR_LIB_H__
@@ -86,6 +86,42 @@ IsInstructionExecutionAllowed (
   IN UINT16                            InstructionIndex
   );
 
+/**
+  Evaluate an IO, MSR or instruction request against the policy without emitting
+  any debug output. The verdict is identical to the one of IsIoReadWriteAllowed,
+  IsMsrReadWriteAllowed and IsInstructionExecutionAllowed, which makes this routine
+  suitable for paths that must not reach into the debug infrastructure, i.e. the
+  syscall fast path. Callers are expected to re-run the verbose interface on
+  rejection if a diagnostic message is desired.
+
+  @param[in]  SmmSecurityPolicy - The address of applied SMM secure policy.
+  @param[in]  DescriptorType    - SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_IO,
+                                  SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_MSR or
+                                  SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_INSTRUCTION.
+  @param[in]  Target            - The IO port, MSR address or the instruction index
+                                  defined in SECURE_POLICY_INSTRUCTION.
+  @param[in]  IoWidth           - The EFI_MM_IO_WIDTH of an IO request, ignored otherwise.
+  @param[in]  AccessMask        - One of SECURE_POLICY_RESOURCE_ATTR_READ or
+                                  SECURE_POLICY_RESOURCE_ATTR_WRITE, ignored for
+                                  instruction requests.
+  @param[out] DescriptorIndex   - Optional, index of the descriptor that decided the
+                                  verdict, or the descriptor count if none matched.
+
+  @retval EFI_ACCESS_DENIED     The requested operation is not allowed by the policy.
+          EFI_INVALID_PARAMETER The request is malformed.
+          EFI_SUCCESS           The requested operation is allowed by the policy.
+**/
+EFI_STATUS
+EFIAPI
+EvaluatePolicyAccess (
+  IN  SMM_SUPV_SECURE_POLICY_DATA_V1_0  *SmmSecurityPolicy,
+  IN  UINT32                            DescriptorType,
+  IN  UINT32                            Target,
+  IN  EFI_MM_IO_WIDTH                   IoWidth,
+  IN  UINT32                            AccessMask,
+  OUT UINT32                            *DescriptorIndex OPTIONAL
+  );
+
 /**
   Given a save state index defined in SECURE_POLICY_SVST, determine if it is
   within policy to allow execution.
@@ -55,6 +55,19 @@ typedef enum {
   SMM_SC_SVST_READ_2  = 0x10021,
   SMM_MM_UNBLOCKED    = 0x10022,
   SMM_MM_IS_COMM_BUFF = 0x10023,
+  // Null syscalls for round-trip measurement, both return the CPL0 TSC value.
+  // SMM_SC_NULL_FAST is served by the register-only fast path, SMM_SC_NULL always
+  // goes through the full FPU state preservation path.
+  SMM_SC_NULL_FAST = 0x10024,
+  SMM_SC_NULL      = 0x10025,
+  // Returns the read only index of the published HOB list, see MM_HOB_INDEX.
+  SMM_QRY_HOB_INDEX = 0x10026,
+  // Starts Arg1 with argument Arg2 on all the present APs without waiting for them,
+  // returns the number of APs it is started on. Only honored on the BSP.
+  SMM_START_ALL_AP_PROC = 0x10027,
+  // Ends a routine the supervisor demoted through SYSRET, Arg1 is its return status. Only
+  // issued by CPL3 return points when the low dword of r15 carries this index.
+  SMM_SC_DEMOTED_RETURN = 0x10028,
 } SMM_SYS_CALL;
 
 UINT64
@@ -22,6 +22,11 @@
 #define SMM_SUPV_ACCESS_ATTR_ALLOW  0
 #define SMM_SUPV_ACCESS_ATTR_DENY   1
 
+// Flags of SMM_SUPV_SECURE_POLICY_DATA_V1_0. SORTED_DESCRIPTORS is set by the policy tool when the IO and MSR
+// range descriptors of each policy root are sorted by address and do not overlap, with IO strict width
+// descriptors placed ahead of all IO range descriptors.
+#define SMM_SUPV_SECURE_POLICY_FLAG_SORTED_DESCRIPTORS  BIT0
+
 // Starting from v1.0 of SMM supervisor policy, the attribute bits only define attribute type,
 // whereas the access type is described by the AccessAttr from its policy root (see SMM_SUPV_POLICY_ROOT)
 #define SECURE_POLICY_RESOURCE_ATTR_READ          BIT0
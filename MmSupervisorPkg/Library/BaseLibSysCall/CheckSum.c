@@ -9,6 +9,7 @@
 **/
 
 #include "BaseLibInternals.h"
+#include "CheckSumAccel.h"
 
 /**
   Returns the sum of all elements in a buffer in unit of UINT8.
@@ -35,17 +36,10 @@ CalculateSum8 (
   IN      UINTN        Length
   )
 {
-  UINT8  Sum;
-  UINTN  Count;
-
   ASSERT (Buffer != NULL);
   ASSERT (Length <= (MAX_ADDRESS - ((UINTN)Buffer) + 1));
 
-  for (Sum = 0, Count = 0; Count < Length; Count++) {
-    Sum = (UINT8)(Sum + *(Buffer + Count));
-  }
-
-  return Sum;
+  return InternalCalculateSum8 (Buffer, Length);
 }
 
 /**
@@ -109,21 +103,12 @@ CalculateSum16 (
   IN      UINTN         Length
   )
 {
-  UINT16  Sum;
-  UINTN   Count;
-  UINTN   Total;
-
   ASSERT (Buffer != NULL);
   ASSERT (((UINTN)Buffer & 0x1) == 0);
   ASSERT ((Length & 0x1) == 0);
   ASSERT (Length <= (MAX_ADDRESS - ((UINTN)Buffer) + 1));
 
-  Total = Length / sizeof (*Buffer);
-  for (Sum = 0, Count = 0; Count < Total; Count++) {
-    Sum = (UINT16)(Sum + *(Buffer + Count));
-  }
-
-  return Sum;
+  return InternalCalculateSum16 (Buffer, Length);
 }
 
 /**
@@ -189,21 +174,12 @@ CalculateSum32 (
   IN      UINTN         Length
   )
 {
-  UINT32  Sum;
-  UINTN   Count;
-  UINTN   Total;
-
   ASSERT (Buffer != NULL);
   ASSERT (((UINTN)Buffer & 0x3) == 0);
   ASSERT ((Length & 0x3) == 0);
   ASSERT (Length <= (MAX_ADDRESS - ((UINTN)Buffer) + 1));
 
-  Total = Length / sizeof (*Buffer);
-  for (Sum = 0, Count = 0; Count < Total; Count++) {
-    Sum = Sum + *(Buffer + Count);
-  }
-
-  return Sum;
+  return InternalCalculateSum32 (Buffer, Length);
 }
 
 /**
@@ -610,10 +586,11 @@ CalculateCrc32 (
   ASSERT (Length <= (MAX_ADDRESS - ((UINTN)Buffer) + 1));
 
   //
-  // Compute CRC
+  // Compute CRC, the bulk of the buffer through PCLMULQDQ when available
   //
-  Crc = 0xffffffff;
-  for (Index = 0, Ptr = Buffer; Index < Length; Index++, Ptr++) {
+  Crc   = 0xffffffff;
+  Index = InternalCrc32Accelerated (&Crc, Buffer, Length);
+  for (Ptr = (UINT8 *)Buffer + Index; Index < Length; Index++, Ptr++) {
     Crc = (Crc >> 8) ^ mCrcTable[(UINT8)Crc ^ *Ptr];
   }
 
@@ -756,6 +733,10 @@ CalculateCrc32c (
   Buf = Buffer;
   Crc = ~InitialValue;
 
+  if (InternalCrc32cAccelerated (&Crc, Buf, Length)) {
+    return ~Crc;
+  }
+
   while (Length-- != 0) {
     Crc = mCrc32cLookupTable[(Crc & 0xFF) ^ *(Buf++)] ^ (Crc >> 8);
   }
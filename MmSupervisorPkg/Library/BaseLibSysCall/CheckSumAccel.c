@@ -0,0 +1,266 @@
+/** @file
+  Wide-word sum kernels, and the runtime dispatch to the SSE4.2 and PCLMULQDQ CRC
+  kernels of X64/CheckSumAccel.nasm.
+
+  The byte and word sums are accumulated in independent lanes of a 64-bit register,
+  which are drained before they can carry into their neighbours. The CRC kernels are
+  only used when CPUID reports the needed instructions, the table driven loops of
+  CheckSum.c remain the fallback.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Base.h>
+#include <Library/BaseLib.h>
+#include <Register/Intel/Cpuid.h>
+
+#include "CheckSumAccel.h"
+
+#define SUM8_LANE_MASK   0x00FF00FF00FF00FFull
+#define SUM16_LANE_MASK  0x0000FFFF0000FFFFull
+
+//
+// Each 16-bit lane gains at most 2 * 0xFF per word, each 32-bit lane at most
+// 2 * 0xFFFF per word.
+//
+#define SUM8_WORDS_PER_DRAIN   128
+#define SUM16_WORDS_PER_DRAIN  32768
+
+STATIC UINT32  mCheckSumFeatures = 0;
+
+/**
+  Return the checksum related features of the executing processor. CPUID is only
+  queried on the first call.
+
+  @return A bit mask of CHECK_SUM_FEATURE_*.
+
+**/
+UINT32
+InternalCheckSumGetFeatures (
+  VOID
+  )
+{
+  CPUID_VERSION_INFO_ECX  Ecx;
+  UINT32                  Features;
+
+  if ((mCheckSumFeatures & CHECK_SUM_FEATURE_PROBED) != 0) {
+    return mCheckSumFeatures;
+  }
+
+  Features = CHECK_SUM_FEATURE_PROBED;
+  AsmCpuid (CPUID_VERSION_INFO, NULL, NULL, &Ecx.Uint32, NULL);
+  if (Ecx.Bits.SSE4_2 != 0) {
+    Features |= CHECK_SUM_FEATURE_SSE42;
+  }
+
+  // The final reduction of the folding uses PEXTRD from SSE4.1
+  if ((Ecx.Bits.PCLMULQDQ != 0) && (Ecx.Bits.SSE4_1 != 0)) {
+    Features |= CHECK_SUM_FEATURE_PCLMUL;
+  }
+
+  mCheckSumFeatures = Features;
+  return Features;
+}
+
+/**
+  Override the checksum related features, so that tests can compare the
+  portable paths with the accelerated ones on the same processor.
+
+  @param[in]  Features  A bit mask of CHECK_SUM_FEATURE_*, 0 to probe CPUID again.
+
+**/
+VOID
+InternalCheckSumSetFeatures (
+  IN UINT32  Features
+  )
+{
+  mCheckSumFeatures = (Features == 0) ? 0 : (Features | CHECK_SUM_FEATURE_PROBED);
+}
+
+/**
+  Returns the sum of all bytes of a buffer, with carry bits dropped, 8 bytes at a time.
+
+  @param[in]  Buffer    The pointer to the buffer.
+  @param[in]  Length    The size, in bytes, of Buffer.
+
+  @return The 8-bit sum of Buffer.
+
+**/
+UINT8
+InternalCalculateSum8 (
+  IN CONST UINT8  *Buffer,
+  IN UINTN        Length
+  )
+{
+  UINT8   Sum;
+  UINT64  Lanes;
+  UINT64  Word;
+  UINTN   Words;
+
+  Sum = 0;
+  while ((Length != 0) && (((UINTN)Buffer & 0x7) != 0)) {
+    Sum = (UINT8)(Sum + *Buffer++);
+    Length--;
+  }
+
+  while (Length >= sizeof (UINT64)) {
+    Words   = MIN (Length / sizeof (UINT64), SUM8_WORDS_PER_DRAIN);
+    Length -= Words * sizeof (UINT64);
+    for (Lanes = 0; Words != 0; Words--, Buffer += sizeof (UINT64)) {
+      Word   = *(CONST UINT64 *)Buffer;
+      Lanes += (Word & SUM8_LANE_MASK) + ((Word >> 8) & SUM8_LANE_MASK);
+    }
+
+    // Carries only move upwards, so the low byte of the total is exact
+    Sum = (UINT8)(Sum + Lanes + (Lanes >> 16) + (Lanes >> 32) + (Lanes >> 48));
+  }
+
+  while (Length != 0) {
+    Sum = (UINT8)(Sum + *Buffer++);
+    Length--;
+  }
+
+  return Sum;
+}
+
+/**
+  Returns the sum of all 16-bit values of a buffer, with carry bits dropped, 8 bytes
+  at a time.
+
+  @param[in]  Buffer    The pointer to the buffer, aligned on a 16-bit boundary.
+  @param[in]  Length    The size, in bytes, of Buffer, a multiple of 2.
+
+  @return The 16-bit sum of Buffer.
+
+**/
+UINT16
+InternalCalculateSum16 (
+  IN CONST UINT16  *Buffer,
+  IN UINTN         Length
+  )
+{
+  UINT16  Sum;
+  UINT64  Lanes;
+  UINT64  Word;
+  UINTN   Words;
+
+  Sum = 0;
+  while ((Length >= sizeof (UINT16)) && (((UINTN)Buffer & 0x7) != 0)) {
+    Sum     = (UINT16)(Sum + *Buffer++);
+    Length -= sizeof (UINT16);
+  }
+
+  while (Length >= sizeof (UINT64)) {
+    Words   = MIN (Length / sizeof (UINT64), SUM16_WORDS_PER_DRAIN);
+    Length -= Words * sizeof (UINT64);
+    for (Lanes = 0; Words != 0; Words--, Buffer += sizeof (UINT64) / sizeof (UINT16)) {
+      Word   = *(CONST UINT64 *)Buffer;
+      Lanes += (Word & SUM16_LANE_MASK) + ((Word >> 16) & SUM16_LANE_MASK);
+    }
+
+    Sum = (UINT16)(Sum + Lanes + (Lanes >> 32));
+  }
+
+  while (Length >= sizeof (UINT16)) {
+    Sum     = (UINT16)(Sum + *Buffer++);
+    Length -= sizeof (UINT16);
+  }
+
+  return Sum;
+}
+
+/**
+  Returns the sum of all 32-bit values of a buffer, with carry bits dropped, 8 bytes
+  at a time.
+
+  @param[in]  Buffer    The pointer to the buffer, aligned on a 32-bit boundary.
+  @param[in]  Length    The size, in bytes, of Buffer, a multiple of 4.
+
+  @return The 32-bit sum of Buffer.
+
+**/
+UINT32
+InternalCalculateSum32 (
+  IN CONST UINT32  *Buffer,
+  IN UINTN         Length
+  )
+{
+  UINT32  Sum;
+  UINT64  Word;
+
+  Sum = 0;
+  if ((Length >= sizeof (UINT32)) && (((UINTN)Buffer & 0x7) != 0)) {
+    Sum     = *Buffer++;
+    Length -= sizeof (UINT32);
+  }
+
+  for ( ; Length >= sizeof (UINT64); Length -= sizeof (UINT64), Buffer += 2) {
+    Word = *(CONST UINT64 *)Buffer;
+    Sum += (UINT32)Word + (UINT32)(Word >> 32);
+  }
+
+  if (Length >= sizeof (UINT32)) {
+    Sum += *Buffer;
+  }
+
+  return Sum;
+}
+
+/**
+  Update a raw CRC32 (ITU-T V.42) register with the leading part of a buffer through
+  PCLMULQDQ folding, if the processor supports it and the buffer is long enough.
+
+  @param[in, out] Crc       The raw CRC register, without the initial and final inversion.
+  @param[in]      Buffer    The pointer to the buffer.
+  @param[in]      Length    The size, in bytes, of Buffer.
+
+  @return The number of leading bytes consumed, a multiple of 16. The caller has to
+          process the rest of the buffer.
+
+**/
+UINTN
+InternalCrc32Accelerated (
+  IN OUT UINT32      *Crc,
+  IN     CONST UINT8 *Buffer,
+  IN     UINTN       Length
+  )
+{
+  if ((Length < CRC32_PCLMUL_MIN_LENGTH) ||
+      ((InternalCheckSumGetFeatures () & CHECK_SUM_FEATURE_PCLMUL) == 0))
+  {
+    return 0;
+  }
+
+  Length &= ~(UINTN)0xF;
+  *Crc    = InternalCrc32Pclmul (*Crc, Buffer, Length);
+  return Length;
+}
+
+/**
+  Update a raw CRC32C register with a whole buffer through the SSE4.2 CRC32
+  instruction, if the processor supports it.
+
+  @param[in, out] Crc       The raw CRC register, without the initial and final inversion.
+  @param[in]      Buffer    The pointer to the buffer.
+  @param[in]      Length    The size, in bytes, of Buffer.
+
+  @retval TRUE    The whole buffer is consumed.
+  @retval FALSE   The processor lacks SSE4.2, Crc is left unchanged.
+
+**/
+BOOLEAN
+InternalCrc32cAccelerated (
+  IN OUT UINT32      *Crc,
+  IN     CONST UINT8 *Buffer,
+  IN     UINTN       Length
+  )
+{
+  if ((InternalCheckSumGetFeatures () & CHECK_SUM_FEATURE_SSE42) == 0) {
+    return FALSE;
+  }
+
+  *Crc = InternalCrc32cSse42 (*Crc, Buffer, Length);
+  return TRUE;
+}
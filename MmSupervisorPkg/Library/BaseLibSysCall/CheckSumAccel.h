@@ -0,0 +1,170 @@
+/** @file
+  Declaration of the wide-word and hardware accelerated checksum kernels used by
+  CheckSum.c. They are kept apart from BaseLibInternals.h so that the host based
+  unit tests can build them against the host BaseLib.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef CHECK_SUM_ACCEL_H_
+#define CHECK_SUM_ACCEL_H_
+
+#define CHECK_SUM_FEATURE_PROBED  BIT0
+#define CHECK_SUM_FEATURE_SSE42   BIT1
+#define CHECK_SUM_FEATURE_PCLMUL  BIT2
+
+//
+// Shortest buffer worth the setup of the PCLMULQDQ folding, also the minimum
+// length InternalCrc32Pclmul accepts.
+//
+#define CRC32_PCLMUL_MIN_LENGTH  64
+
+/**
+  Return the checksum related features of the executing processor. CPUID is only
+  queried on the first call.
+
+  @return A bit mask of CHECK_SUM_FEATURE_*.
+
+**/
+UINT32
+InternalCheckSumGetFeatures (
+  VOID
+  );
+
+/**
+  Override the checksum related features, so that tests can compare the
+  portable paths with the accelerated ones on the same processor.
+
+  @param[in]  Features  A bit mask of CHECK_SUM_FEATURE_*, 0 to probe CPUID again.
+
+**/
+VOID
+InternalCheckSumSetFeatures (
+  IN UINT32  Features
+  );
+
+/**
+  Returns the sum of all bytes of a buffer, with carry bits dropped, 8 bytes at a time.
+
+  @param[in]  Buffer    The pointer to the buffer.
+  @param[in]  Length    The size, in bytes, of Buffer.
+
+  @return The 8-bit sum of Buffer.
+
+**/
+UINT8
+InternalCalculateSum8 (
+  IN CONST UINT8  *Buffer,
+  IN UINTN        Length
+  );
+
+/**
+  Returns the sum of all 16-bit values of a buffer, with carry bits dropped, 8 bytes
+  at a time.
+
+  @param[in]  Buffer    The pointer to the buffer, aligned on a 16-bit boundary.
+  @param[in]  Length    The size, in bytes, of Buffer, a multiple of 2.
+
+  @return The 16-bit sum of Buffer.
+
+**/
+UINT16
+InternalCalculateSum16 (
+  IN CONST UINT16  *Buffer,
+  IN UINTN         Length
+  );
+
+/**
+  Returns the sum of all 32-bit values of a buffer, with carry bits dropped, 8 bytes
+  at a time.
+
+  @param[in]  Buffer    The pointer to the buffer, aligned on a 32-bit boundary.
+  @param[in]  Length    The size, in bytes, of Buffer, a multiple of 4.
+
+  @return The 32-bit sum of Buffer.
+
+**/
+UINT32
+InternalCalculateSum32 (
+  IN CONST UINT32  *Buffer,
+  IN UINTN         Length
+  );
+
+/**
+  Update a raw CRC32 (ITU-T V.42) register with the leading part of a buffer through
+  PCLMULQDQ folding, if the processor supports it and the buffer is long enough.
+
+  @param[in, out] Crc       The raw CRC register, without the initial and final inversion.
+  @param[in]      Buffer    The pointer to the buffer.
+  @param[in]      Length    The size, in bytes, of Buffer.
+
+  @return The number of leading bytes consumed, a multiple of 16. The caller has to
+          process the rest of the buffer.
+
+**/
+UINTN
+InternalCrc32Accelerated (
+  IN OUT UINT32      *Crc,
+  IN     CONST UINT8 *Buffer,
+  IN     UINTN       Length
+  );
+
+/**
+  Update a raw CRC32C register with a whole buffer through the SSE4.2 CRC32
+  instruction, if the processor supports it.
+
+  @param[in, out] Crc       The raw CRC register, without the initial and final inversion.
+  @param[in]      Buffer    The pointer to the buffer.
+  @param[in]      Length    The size, in bytes, of Buffer.
+
+  @retval TRUE    The whole buffer is consumed.
+  @retval FALSE   The processor lacks SSE4.2, Crc is left unchanged.
+
+**/
+BOOLEAN
+InternalCrc32cAccelerated (
+  IN OUT UINT32      *Crc,
+  IN     CONST UINT8 *Buffer,
+  IN     UINTN       Length
+  );
+
+/**
+  Update a raw CRC32C register through the SSE4.2 CRC32 instruction.
+
+  @param[in]  Crc       The raw CRC register.
+  @param[in]  Buffer    The pointer to the buffer.
+  @param[in]  Length    The size, in bytes, of Buffer.
+
+  @return The updated raw CRC register.
+
+**/
+UINT32
+EFIAPI
+InternalCrc32cSse42 (
+  IN UINT32       Crc,
+  IN CONST UINT8  *Buffer,
+  IN UINTN        Length
+  );
+
+/**
+  Update a raw CRC32 (ITU-T V.42) register through PCLMULQDQ folding.
+
+  @param[in]  Crc       The raw CRC register.
+  @param[in]  Buffer    The pointer to the buffer.
+  @param[in]  Length    The size, in bytes, of Buffer, at least CRC32_PCLMUL_MIN_LENGTH
+                        and a multiple of 16.
+
+  @return The updated raw CRC register.
+
+**/
+UINT32
+EFIAPI
+InternalCrc32Pclmul (
+  IN UINT32       Crc,
+  IN CONST UINT8  *Buffer,
+  IN UINTN        Length
+  );
+
+#endif // CHECK_SUM_ACCEL_H_
@@ -7,6 +7,7 @@
 **/
 
 #include "BaseLibInternals.h"
+#include "StringAccel.h"
 
 #define RSIZE_MAX  (PcdGet32 (PcdMaximumUnicodeStringLength))
 
@@ -121,8 +122,6 @@ StrnLenS (
   IN UINTN         MaxSize
   )
 {
-  UINTN  Length;
-
   ASSERT (((UINTN)String & BIT0) == 0);
 
   //
@@ -136,18 +135,10 @@ StrnLenS (
   // Otherwise, the StrnLenS function returns the number of characters that precede the
   // terminating null character. If there is no null character in the first MaxSize characters of
   // String then StrnLenS returns MaxSize. At most the first MaxSize characters of String shall
-  // be accessed by StrnLenS.
+  // be accessed by StrnLenS. The SSE2 scan reads whole aligned 16-byte blocks, which never
+  // cross into a page that the string does not touch.
   //
-  Length = 0;
-  while (String[Length] != 0) {
-    if (Length >= MaxSize - 1) {
-      return MaxSize;
-    }
-
-    Length++;
-  }
-
-  return Length;
+  return InternalStrnLenSse2 (String, MaxSize);
 }
 
 /**
@@ -267,11 +258,8 @@ StrCpyS (
   // The StrCpyS function copies the string pointed to by Source (including the terminating
   // null character) into the array pointed to by Destination.
   //
-  while (*Source != 0) {
-    *(Destination++) = *(Source++);
-  }
-
-  *Destination = 0;
+  CopyMem (Destination, Source, SourceLen * sizeof (*Source));
+  Destination[SourceLen] = 0;
 
   return RETURN_SUCCESS;
 }
@@ -361,12 +349,8 @@ StrnCpyS (
   // pointed to by Destination. If no null character was copied from Source, then Destination[Length] is set to a null
   // character.
   //
-  while ((SourceLen > 0) && (*Source != 0)) {
-    *(Destination++) = *(Source++);
-    SourceLen--;
-  }
-
-  *Destination = 0;
+  CopyMem (Destination, Source, SourceLen * sizeof (*Source));
+  Destination[SourceLen] = 0;
 
   return RETURN_SUCCESS;
 }
@@ -461,11 +445,8 @@ StrCatS (
   // from Source overwrites the null character at the end of Destination.
   //
   Destination = Destination + DestLen;
-  while (*Source != 0) {
-    *(Destination++) = *(Source++);
-  }
-
-  *Destination = 0;
+  CopyMem (Destination, Source, SourceLen * sizeof (*Source));
+  Destination[SourceLen] = 0;
 
   return RETURN_SUCCESS;
 }
@@ -573,12 +554,8 @@ StrnCatS (
   // a null character.
   //
   Destination = Destination + DestLen;
-  while ((SourceLen > 0) && (*Source != 0)) {
-    *(Destination++) = *(Source++);
-    SourceLen--;
-  }
-
-  *Destination = 0;
+  CopyMem (Destination, Source, SourceLen * sizeof (*Source));
+  Destination[SourceLen] = 0;
 
   return RETURN_SUCCESS;
 }
@@ -1698,8 +1675,6 @@ AsciiStrnLenS (
   IN UINTN        MaxSize
   )
 {
-  UINTN  Length;
-
   //
   // If String is a null pointer or MaxSize is 0, then the AsciiStrnLenS function returns zero.
   //
@@ -1711,18 +1686,10 @@ AsciiStrnLenS (
   // Otherwise, the AsciiStrnLenS function returns the number of characters that precede the
   // terminating null character. If there is no null character in the first MaxSize characters of
   // String then AsciiStrnLenS returns MaxSize. At most the first MaxSize characters of String shall
-  // be accessed by AsciiStrnLenS.
+  // be accessed by AsciiStrnLenS. The SSE2 scan reads whole aligned 16-byte blocks, which never
+  // cross into a page that the string does not touch.
   //
-  Length = 0;
-  while (String[Length] != 0) {
-    if (Length >= MaxSize - 1) {
-      return MaxSize;
-    }
-
-    Length++;
-  }
-
-  return Length;
+  return InternalAsciiStrnLenSse2 (String, MaxSize);
 }
 
 /**
@@ -1835,11 +1802,8 @@ AsciiStrCpyS (
   // The AsciiStrCpyS function copies the string pointed to by Source (including the terminating
   // null character) into the array pointed to by Destination.
   //
-  while (*Source != 0) {
-    *(Destination++) = *(Source++);
-  }
-
-  *Destination = 0;
+  CopyMem (Destination, Source, SourceLen * sizeof (*Source));
+  Destination[SourceLen] = 0;
 
   return RETURN_SUCCESS;
 }
@@ -1923,12 +1887,8 @@ AsciiStrnCpyS (
   // pointed to by Destination. If no null character was copied from Source, then Destination[Length] is set to a null
   // character.
   //
-  while ((SourceLen > 0) && (*Source != 0)) {
-    *(Destination++) = *(Source++);
-    SourceLen--;
-  }
-
-  *Destination = 0;
+  CopyMem (Destination, Source, SourceLen * sizeof (*Source));
+  Destination[SourceLen] = 0;
 
   return RETURN_SUCCESS;
 }
@@ -2017,11 +1977,8 @@ AsciiStrCatS (
   // from Source overwrites the null character at the end of Destination.
   //
   Destination = Destination + DestLen;
-  while (*Source != 0) {
-    *(Destination++) = *(Source++);
-  }
-
-  *Destination = 0;
+  CopyMem (Destination, Source, SourceLen * sizeof (*Source));
+  Destination[SourceLen] = 0;
 
   return RETURN_SUCCESS;
 }
@@ -2123,12 +2080,8 @@ AsciiStrnCatS (
   // a null character.
   //
   Destination = Destination + DestLen;
-  while ((SourceLen > 0) && (*Source != 0)) {
-    *(Destination++) = *(Source++);
-    SourceLen--;
-  }
-
-  *Destination = 0;
+  CopyMem (Destination, Source, SourceLen * sizeof (*Source));
+  Destination[SourceLen] = 0;
 
   return RETURN_SUCCESS;
 }
@@ -7,6 +7,7 @@
 **/
 
 #include "BaseLibInternals.h"
+#include "StringAccel.h"
 
 /**
   Returns the length of a Null-terminated Unicode string.
@@ -36,14 +37,14 @@ StrLen (
   ASSERT (String != NULL);
   ASSERT (((UINTN)String & BIT0) == 0);
 
-  for (Length = 0; *String != L'\0'; String++, Length++) {
-    //
-    // If PcdMaximumUnicodeStringLength is not zero,
-    // length should not more than PcdMaximumUnicodeStringLength
-    //
-    if (PcdGet32 (PcdMaximumUnicodeStringLength) != 0) {
-      ASSERT (Length < PcdGet32 (PcdMaximumUnicodeStringLength));
-    }
+  Length = InternalStrnLenSse2 (String, MAX_UINTN);
+
+  //
+  // If PcdMaximumUnicodeStringLength is not zero,
+  // length should not more than PcdMaximumUnicodeStringLength
+  //
+  if (PcdGet32 (PcdMaximumUnicodeStringLength) != 0) {
+    ASSERT (Length <= PcdGet32 (PcdMaximumUnicodeStringLength));
   }
 
   return Length;
@@ -111,18 +112,17 @@ StrCmp (
   IN      CONST CHAR16  *SecondString
   )
 {
+  UINTN  Index;
+
   //
   // ASSERT both strings are less long than PcdMaximumUnicodeStringLength
   //
   ASSERT (StrSize (FirstString) != 0);
   ASSERT (StrSize (SecondString) != 0);
 
-  while ((*FirstString != L'\0') && (*FirstString == *SecondString)) {
-    FirstString++;
-    SecondString++;
-  }
+  Index = InternalStrnCmpSse2 (FirstString, SecondString, MAX_UINTN);
 
-  return *FirstString - *SecondString;
+  return FirstString[Index] - SecondString[Index];
 }
 
 /**
@@ -180,17 +180,12 @@ StrnCmp (
     ASSERT (Length <= PcdGet32 (PcdMaximumUnicodeStringLength));
   }
 
-  while ((*FirstString != L'\0') &&
-         (*SecondString != L'\0') &&
-         (*FirstString == *SecondString) &&
-         (Length > 1))
-  {
-    FirstString++;
-    SecondString++;
-    Length--;
-  }
+  //
+  // The last of the Length characters is compared whether or not it matches
+  //
+  Length = InternalStrnCmpSse2 (FirstString, SecondString, Length - 1);
 
-  return *FirstString - *SecondString;
+  return FirstString[Length] - SecondString[Length];
 }
 
 /**
@@ -226,8 +221,7 @@ StrStr (
   IN      CONST CHAR16  *SearchString
   )
 {
-  CONST CHAR16  *FirstMatch;
-  CONST CHAR16  *SearchStringTmp;
+  UINTN  Index;
 
   //
   // ASSERT both strings are less long than PcdMaximumUnicodeStringLength.
@@ -240,29 +234,26 @@ StrStr (
     return (CHAR16 *)String;
   }
 
-  while (*String != L'\0') {
-    SearchStringTmp = SearchString;
-    FirstMatch      = String;
-
-    while (  (*String == *SearchStringTmp)
-          && (*String != L'\0'))
-    {
-      String++;
-      SearchStringTmp++;
+  while (TRUE) {
+    //
+    // Skip to the next occurrence of the first character, then compare the rest
+    //
+    String = InternalStrChrSse2 (String, *SearchString);
+    if (*String == L'\0') {
+      return NULL;
     }
 
-    if (*SearchStringTmp == L'\0') {
-      return (CHAR16 *)FirstMatch;
+    Index = InternalStrnCmpSse2 (SearchString + 1, String + 1, MAX_UINTN);
+    if (SearchString[Index + 1] == L'\0') {
+      return (CHAR16 *)String;
     }
 
-    if (*String == L'\0') {
+    if (String[Index + 1] == L'\0') {
       return NULL;
     }
 
-    String = FirstMatch + 1;
+    String++;
   }
-
-  return NULL;
 }
 
 /**
@@ -634,14 +625,14 @@ AsciiStrLen (
 
   ASSERT (String != NULL);
 
-  for (Length = 0; *String != '\0'; String++, Length++) {
-    //
-    // If PcdMaximumUnicodeStringLength is not zero,
-    // length should not more than PcdMaximumUnicodeStringLength
-    //
-    if (PcdGet32 (PcdMaximumAsciiStringLength) != 0) {
-      ASSERT (Length < PcdGet32 (PcdMaximumAsciiStringLength));
-    }
+  Length = InternalAsciiStrnLenSse2 (String, MAX_UINTN);
+
+  //
+  // If PcdMaximumAsciiStringLength is not zero,
+  // length should not more than PcdMaximumAsciiStringLength
+  //
+  if (PcdGet32 (PcdMaximumAsciiStringLength) != 0) {
+    ASSERT (Length <= PcdGet32 (PcdMaximumAsciiStringLength));
   }
 
   return Length;
@@ -706,18 +697,17 @@ AsciiStrCmp (
   IN      CONST CHAR8  *SecondString
   )
 {
+  UINTN  Index;
+
   //
   // ASSERT both strings are less long than PcdMaximumAsciiStringLength
   //
   ASSERT (AsciiStrSize (FirstString));
   ASSERT (AsciiStrSize (SecondString));
 
-  while ((*FirstString != '\0') && (*FirstString == *SecondString)) {
-    FirstString++;
-    SecondString++;
-  }
+  Index = InternalAsciiStrnCmpSse2 (FirstString, SecondString, MAX_UINTN);
 
-  return *FirstString - *SecondString;
+  return FirstString[Index] - SecondString[Index];
 }
 
 /**
@@ -877,17 +867,12 @@ AsciiStrnCmp (
     ASSERT (Length <= PcdGet32 (PcdMaximumAsciiStringLength));
   }
 
-  while ((*FirstString != '\0') &&
-         (*SecondString != '\0') &&
-         (*FirstString == *SecondString) &&
-         (Length > 1))
-  {
-    FirstString++;
-    SecondString++;
-    Length--;
-  }
+  //
+  // The last of the Length characters is compared whether or not it matches
+  //
+  Length = InternalAsciiStrnCmpSse2 (FirstString, SecondString, Length - 1);
 
-  return *FirstString - *SecondString;
+  return FirstString[Length] - SecondString[Length];
 }
 
 /**
@@ -921,8 +906,7 @@ AsciiStrStr (
   IN      CONST CHAR8  *SearchString
   )
 {
-  CONST CHAR8  *FirstMatch;
-  CONST CHAR8  *SearchStringTmp;
+  UINTN  Index;
 
   //
   // ASSERT both strings are less long than PcdMaximumAsciiStringLength
@@ -934,29 +918,26 @@ AsciiStrStr (
     return (CHAR8 *)String;
   }
 
-  while (*String != '\0') {
-    SearchStringTmp = SearchString;
-    FirstMatch      = String;
-
-    while (  (*String == *SearchStringTmp)
-          && (*String != '\0'))
-    {
-      String++;
-      SearchStringTmp++;
+  while (TRUE) {
+    //
+    // Skip to the next occurrence of the first character, then compare the rest
+    //
+    String = InternalAsciiStrChrSse2 (String, *SearchString);
+    if (*String == '\0') {
+      return NULL;
     }
 
-    if (*SearchStringTmp == '\0') {
-      return (CHAR8 *)FirstMatch;
+    Index = InternalAsciiStrnCmpSse2 (SearchString + 1, String + 1, MAX_UINTN);
+    if (SearchString[Index + 1] == '\0') {
+      return (CHAR8 *)String;
     }
 
-    if (*String == '\0') {
+    if (String[Index + 1] == '\0') {
       return NULL;
     }
 
-    String = FirstMatch + 1;
+    String++;
   }
-
-  return NULL;
 }
 
 /**
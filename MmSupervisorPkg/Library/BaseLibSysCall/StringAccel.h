@@ -0,0 +1,124 @@
+/** @file
+  Declaration of the SSE2 string kernels of X64/StringAccel.nasm used by String.c
+  and SafeString.c. They are kept apart from BaseLibInternals.h so that the host
+  based unit tests can build them against the host BaseLib.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef STRING_ACCEL_H_
+#define STRING_ACCEL_H_
+
+/**
+  Returns the number of Unicode characters before the Null-terminator, or MaxLength
+  if there is none in the first MaxLength characters.
+
+  @param[in]  String      A pointer to a Null-terminated Unicode string, aligned on
+                          a 16-bit boundary.
+  @param[in]  MaxLength   The maximum number of characters to scan, must not be 0.
+
+  @return The length of String, at most MaxLength.
+
+**/
+UINTN
+EFIAPI
+InternalStrnLenSse2 (
+  IN CONST CHAR16  *String,
+  IN UINTN         MaxLength
+  );
+
+/**
+  Returns the number of ASCII characters before the Null-terminator, or MaxLength
+  if there is none in the first MaxLength characters.
+
+  @param[in]  String      A pointer to a Null-terminated ASCII string.
+  @param[in]  MaxLength   The maximum number of characters to scan, must not be 0.
+
+  @return The length of String, at most MaxLength.
+
+**/
+UINTN
+EFIAPI
+InternalAsciiStrnLenSse2 (
+  IN CONST CHAR8  *String,
+  IN UINTN        MaxLength
+  );
+
+/**
+  Returns the index of the first Unicode character, among the first Length ones,
+  that differs between the two strings or is the Null-terminator of FirstString.
+
+  @param[in]  FirstString   A pointer to a Null-terminated Unicode string, aligned
+                            on a 16-bit boundary.
+  @param[in]  SecondString  A pointer to a Null-terminated Unicode string, aligned
+                            on a 16-bit boundary.
+  @param[in]  Length        The maximum number of characters to compare.
+
+  @return The index of the first mismatch or Null-terminator, Length if there is none.
+
+**/
+UINTN
+EFIAPI
+InternalStrnCmpSse2 (
+  IN CONST CHAR16  *FirstString,
+  IN CONST CHAR16  *SecondString,
+  IN UINTN         Length
+  );
+
+/**
+  Returns the index of the first ASCII character, among the first Length ones,
+  that differs between the two strings or is the Null-terminator of FirstString.
+
+  @param[in]  FirstString   A pointer to a Null-terminated ASCII string.
+  @param[in]  SecondString  A pointer to a Null-terminated ASCII string.
+  @param[in]  Length        The maximum number of characters to compare.
+
+  @return The index of the first mismatch or Null-terminator, Length if there is none.
+
+**/
+UINTN
+EFIAPI
+InternalAsciiStrnCmpSse2 (
+  IN CONST CHAR8  *FirstString,
+  IN CONST CHAR8  *SecondString,
+  IN UINTN        Length
+  );
+
+/**
+  Returns the first occurrence of a Unicode character in a string.
+
+  @param[in]  String  A pointer to a Null-terminated Unicode string, aligned on a
+                      16-bit boundary.
+  @param[in]  Char    The character to search for.
+
+  @return A pointer to the first Char in String, or to the Null-terminator if Char
+          does not occur.
+
+**/
+CHAR16 *
+EFIAPI
+InternalStrChrSse2 (
+  IN CONST CHAR16  *String,
+  IN CHAR16        Char
+  );
+
+/**
+  Returns the first occurrence of an ASCII character in a string.
+
+  @param[in]  String  A pointer to a Null-terminated ASCII string.
+  @param[in]  Char    The character to search for.
+
+  @return A pointer to the first Char in String, or to the Null-terminator if Char
+          does not occur.
+
+**/
+CHAR8 *
+EFIAPI
+InternalAsciiStrChrSse2 (
+  IN CONST CHAR8  *String,
+  IN CHAR8        Char
+  );
+
+#endif // STRING_ACCEL_H_
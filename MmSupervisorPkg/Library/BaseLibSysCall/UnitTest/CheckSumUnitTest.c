@@ -0,0 +1,477 @@
+/** @file
+  Host based unit tests of the wide-word and hardware accelerated checksum kernels
+  of BaseLibSysCall.
+
+  Random buffers at random alignments are summed and CRC'ed through the kernels of
+  CheckSumAccel.c and through the portable routines of the host BaseLib, and the
+  results have to match. The accelerated CRC kernels are skipped when the host
+  processor lacks the instructions. A last case times both paths over a large
+  buffer and logs the result.
+
+  The random seed can be supplied as the first command line argument to reproduce
+  a reported failure.
+
+  Copyright (C) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <time.h>
+#include <cmocka.h>
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#include <Library/UnitTestLib.h>
+
+#include "../CheckSumAccel.h"
+
+#define UNIT_TEST_APP_NAME     "BaseLibSysCall CheckSum Tests"
+#define UNIT_TEST_APP_VERSION  "1.0"
+
+#define CHECK_SUM_TEST_DEFAULT_SEED   0x5EED0C4C5C0FFEE1ULL
+#define CHECK_SUM_TEST_ROUNDS         4096
+#define CHECK_SUM_TEST_MAX_OFFSET     64
+#define CHECK_SUM_TEST_MAX_LENGTH     SIZE_16KB
+#define CHECK_SUM_TEST_BUFFER_SIZE    (CHECK_SUM_TEST_MAX_LENGTH + CHECK_SUM_TEST_MAX_OFFSET)
+#define CHECK_SUM_BENCH_LENGTH        SIZE_4MB
+#define CHECK_SUM_BENCH_ROUNDS        8
+
+typedef struct {
+  UINT8    *Buffer;
+} TEST_CONTEXT_CHECK_SUM;
+
+STATIC UINT64  mCheckSumTestSeed = CHECK_SUM_TEST_DEFAULT_SEED;
+STATIC UINT64  mRandomState;
+
+/**
+  Get the next pseudo random number, the sequence only depends on the seed.
+
+  @return 64-bit pseudo random number.
+**/
+STATIC
+UINT64
+NextRandom (
+  VOID
+  )
+{
+  mRandomState ^= mRandomState >> 12;
+  mRandomState ^= mRandomState << 25;
+  mRandomState ^= mRandomState >> 27;
+  return mRandomState * 0x2545F4914F6CDD1DULL;
+}
+
+/**
+  Get a pseudo random number in [0, Bound).
+
+  @param[in]  Bound   Exclusive upper bound, must not be 0.
+
+  @return Pseudo random number below Bound.
+**/
+STATIC
+UINTN
+RandomBelow (
+  IN UINTN  Bound
+  )
+{
+  return (UINTN)(NextRandom () % Bound);
+}
+
+/**
+  Fill the test buffer with random bytes, and every now and then with runs of 0xFF
+  so that the sum lanes are driven close to their drain points.
+
+  @param[in]  Buffer    Buffer to fill.
+  @param[in]  Length    Size of Buffer in bytes.
+**/
+STATIC
+VOID
+FillTestBuffer (
+  IN UINT8  *Buffer,
+  IN UINTN  Length
+  )
+{
+  UINTN  Index;
+
+  if (RandomBelow (8) == 0) {
+    SetMem (Buffer, Length, 0xFF);
+    return;
+  }
+
+  for (Index = 0; Index < Length; Index++) {
+    Buffer[Index] = (UINT8)NextRandom ();
+  }
+}
+
+/**
+  Allocate the shared test buffer and reset the random sequence.
+
+  @param[in]  Context   The TEST_CONTEXT_CHECK_SUM of the test.
+
+  @retval  UNIT_TEST_PASSED   The buffer is ready.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+PrepareCheckSumTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  TEST_CONTEXT_CHECK_SUM  *CheckSumCntx;
+
+  CheckSumCntx = (TEST_CONTEXT_CHECK_SUM *)Context;
+  mRandomState = (mCheckSumTestSeed != 0) ? mCheckSumTestSeed : CHECK_SUM_TEST_DEFAULT_SEED;
+
+  CheckSumCntx->Buffer = AllocatePool (MAX (CHECK_SUM_TEST_BUFFER_SIZE, CHECK_SUM_BENCH_LENGTH));
+  UT_ASSERT_NOT_NULL (CheckSumCntx->Buffer);
+
+  InternalCheckSumSetFeatures (0);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Free the shared test buffer.
+
+  @param[in]  Context   The TEST_CONTEXT_CHECK_SUM of the test.
+**/
+STATIC
+VOID
+EFIAPI
+CleanUpCheckSumTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  TEST_CONTEXT_CHECK_SUM  *CheckSumCntx;
+
+  CheckSumCntx = (TEST_CONTEXT_CHECK_SUM *)Context;
+  if (CheckSumCntx->Buffer != NULL) {
+    FreePool (CheckSumCntx->Buffer);
+    CheckSumCntx->Buffer = NULL;
+  }
+
+  InternalCheckSumSetFeatures (0);
+}
+
+/**
+  The wide-word sums should match the portable sums for random buffers, offsets
+  and lengths.
+
+  @param[in]  Context   The TEST_CONTEXT_CHECK_SUM of the test.
+
+  @retval  UNIT_TEST_PASSED             All sums match.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A sum differs.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+WideSumsMatchPortable (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  TEST_CONTEXT_CHECK_SUM  *CheckSumCntx;
+  UINTN                   Round;
+  UINTN                   Offset;
+  UINTN                   Length;
+  UINT8                   *Data;
+
+  CheckSumCntx = (TEST_CONTEXT_CHECK_SUM *)Context;
+  for (Round = 0; Round < CHECK_SUM_TEST_ROUNDS; Round++) {
+    Offset = RandomBelow (CHECK_SUM_TEST_MAX_OFFSET);
+    Length = RandomBelow (CHECK_SUM_TEST_MAX_LENGTH + 1);
+    Data   = CheckSumCntx->Buffer + Offset;
+    FillTestBuffer (CheckSumCntx->Buffer, CHECK_SUM_TEST_BUFFER_SIZE);
+
+    UT_ASSERT_EQUAL (InternalCalculateSum8 (Data, Length), CalculateSum8 (Data, Length));
+
+    Data   = (UINT8 *)ALIGN_POINTER (Data, sizeof (UINT16));
+    Length = Length & ~(UINTN)(sizeof (UINT16) - 1);
+    UT_ASSERT_EQUAL (
+      InternalCalculateSum16 ((UINT16 *)Data, Length),
+      CalculateSum16 ((UINT16 *)Data, Length)
+      );
+
+    Data   = (UINT8 *)ALIGN_POINTER (Data, sizeof (UINT32));
+    Length = Length & ~(UINTN)(sizeof (UINT32) - 1);
+    UT_ASSERT_EQUAL (
+      InternalCalculateSum32 ((UINT32 *)Data, Length),
+      CalculateSum32 ((UINT32 *)Data, Length)
+      );
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  The PCLMULQDQ and SSE4.2 CRC kernels should match the table driven CRCs for
+  random buffers, offsets and lengths.
+
+  @param[in]  Context   The TEST_CONTEXT_CHECK_SUM of the test.
+
+  @retval  UNIT_TEST_PASSED             All CRCs match.
+  @retval  UNIT_TEST_SKIPPED            The host processor has neither kernel.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A CRC differs.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+AcceleratedCrcsMatchPortable (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  TEST_CONTEXT_CHECK_SUM  *CheckSumCntx;
+  UINT32                  Features;
+  UINTN                   Round;
+  UINTN                   Offset;
+  UINTN                   Length;
+  UINTN                   Consumed;
+  UINT8                   *Data;
+  UINT32                  Crc;
+  UINT32                  Seed;
+
+  Features = InternalCheckSumGetFeatures ();
+  if ((Features & (CHECK_SUM_FEATURE_PCLMUL | CHECK_SUM_FEATURE_SSE42)) == 0) {
+    UT_LOG_WARNING ("Host processor supports neither PCLMULQDQ nor SSE4.2\n");
+    return UNIT_TEST_SKIPPED;
+  }
+
+  CheckSumCntx = (TEST_CONTEXT_CHECK_SUM *)Context;
+  for (Round = 0; Round < CHECK_SUM_TEST_ROUNDS; Round++) {
+    Offset = RandomBelow (CHECK_SUM_TEST_MAX_OFFSET);
+    // Favor short buffers, where the head and tail handling is most of the work
+    Length = RandomBelow ((Round & 1) ? CHECK_SUM_TEST_MAX_LENGTH + 1 : 4 * CRC32_PCLMUL_MIN_LENGTH);
+    Data   = CheckSumCntx->Buffer + Offset;
+    FillTestBuffer (CheckSumCntx->Buffer, CHECK_SUM_TEST_BUFFER_SIZE);
+
+    if ((Features & CHECK_SUM_FEATURE_PCLMUL) != 0) {
+      // CheckSum.c finishes the tail with the table, only the folded prefix is new
+      Crc      = 0xFFFFFFFF;
+      Consumed = InternalCrc32Accelerated (&Crc, Data, Length);
+      UT_ASSERT_EQUAL (Consumed % 16, 0);
+      UT_ASSERT_TRUE (Consumed <= Length);
+      UT_ASSERT_TRUE ((Consumed != 0) || (Length < CRC32_PCLMUL_MIN_LENGTH));
+      UT_ASSERT_TRUE ((Consumed == 0) || (Length - Consumed < 16));
+      UT_ASSERT_EQUAL (Crc ^ 0xFFFFFFFF, CalculateCrc32 (Data, Consumed));
+    }
+
+    if ((Features & CHECK_SUM_FEATURE_SSE42) != 0) {
+      Seed = (UINT32)NextRandom ();
+      Crc  = ~Seed;
+      UT_ASSERT_TRUE (InternalCrc32cAccelerated (&Crc, Data, Length));
+      UT_ASSERT_EQUAL (~Crc, CalculateCrc32c (Data, Length, Seed));
+    }
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Without the processor features, the accelerated paths should decline the work
+  and leave the CRC register untouched.
+
+  @param[in]  Context   The TEST_CONTEXT_CHECK_SUM of the test.
+
+  @retval  UNIT_TEST_PASSED             The portable fallback is taken.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  An accelerated kernel is used.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+FallbackWithoutFeatures (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  TEST_CONTEXT_CHECK_SUM  *CheckSumCntx;
+  UINT32                  Crc;
+
+  CheckSumCntx = (TEST_CONTEXT_CHECK_SUM *)Context;
+  FillTestBuffer (CheckSumCntx->Buffer, CHECK_SUM_TEST_BUFFER_SIZE);
+
+  InternalCheckSumSetFeatures (CHECK_SUM_FEATURE_PROBED);
+  Crc = 0x12345678;
+  UT_ASSERT_EQUAL (InternalCrc32Accelerated (&Crc, CheckSumCntx->Buffer, CHECK_SUM_TEST_MAX_LENGTH), 0);
+  UT_ASSERT_FALSE (InternalCrc32cAccelerated (&Crc, CheckSumCntx->Buffer, CHECK_SUM_TEST_MAX_LENGTH));
+  UT_ASSERT_EQUAL (Crc, 0x12345678);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Time the portable and the accelerated paths over a large buffer and log the
+  results. Only the equality of the results is asserted.
+
+  @param[in]  Context   The TEST_CONTEXT_CHECK_SUM of the test.
+
+  @retval  UNIT_TEST_PASSED             The benchmark ran.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  The paths disagree.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+BenchmarkCheckSums (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  TEST_CONTEXT_CHECK_SUM  *CheckSumCntx;
+  UINT32                  Features;
+  UINTN                   Round;
+  UINTN                   Consumed;
+  clock_t                 Start;
+  clock_t                 Portable;
+  clock_t                 Accelerated;
+  UINT8                   ExpectedSum;
+  UINT8                   Sum;
+  UINT32                  Expected;
+  UINT32                  Crc;
+
+  CheckSumCntx = (TEST_CONTEXT_CHECK_SUM *)Context;
+  Features     = InternalCheckSumGetFeatures ();
+  ExpectedSum  = 0;
+  Sum          = 0;
+  Expected     = 0;
+  Crc          = 0;
+  Consumed     = 0;
+  FillTestBuffer (CheckSumCntx->Buffer, CHECK_SUM_BENCH_LENGTH);
+
+  Start = clock ();
+  for (Round = 0; Round < CHECK_SUM_BENCH_ROUNDS; Round++) {
+    ExpectedSum = CalculateSum8 (CheckSumCntx->Buffer, CHECK_SUM_BENCH_LENGTH);
+  }
+
+  Portable = clock () - Start;
+  Start    = clock ();
+  for (Round = 0; Round < CHECK_SUM_BENCH_ROUNDS; Round++) {
+    Sum = InternalCalculateSum8 (CheckSumCntx->Buffer, CHECK_SUM_BENCH_LENGTH);
+  }
+
+  Accelerated = clock () - Start;
+  UT_ASSERT_EQUAL (Sum, ExpectedSum);
+  UT_LOG_INFO ("Sum8 of %d bytes: portable %d, wide %d clock ticks\n", CHECK_SUM_BENCH_LENGTH, (INT32)Portable, (INT32)Accelerated);
+
+  if ((Features & CHECK_SUM_FEATURE_PCLMUL) != 0) {
+    Start = clock ();
+    for (Round = 0; Round < CHECK_SUM_BENCH_ROUNDS; Round++) {
+      Expected = CalculateCrc32 (CheckSumCntx->Buffer, CHECK_SUM_BENCH_LENGTH);
+    }
+
+    Portable = clock () - Start;
+    Start    = clock ();
+    for (Round = 0; Round < CHECK_SUM_BENCH_ROUNDS; Round++) {
+      Crc      = 0xFFFFFFFF;
+      Consumed = InternalCrc32Accelerated (&Crc, CheckSumCntx->Buffer, CHECK_SUM_BENCH_LENGTH);
+    }
+
+    Accelerated = clock () - Start;
+    UT_ASSERT_EQUAL (Consumed, CHECK_SUM_BENCH_LENGTH);
+    UT_ASSERT_EQUAL (Crc ^ 0xFFFFFFFF, Expected);
+    UT_LOG_INFO ("CRC32 of %d bytes: table %d, PCLMULQDQ %d clock ticks\n", CHECK_SUM_BENCH_LENGTH, (INT32)Portable, (INT32)Accelerated);
+  }
+
+  if ((Features & CHECK_SUM_FEATURE_SSE42) != 0) {
+    Start = clock ();
+    for (Round = 0; Round < CHECK_SUM_BENCH_ROUNDS; Round++) {
+      Expected = CalculateCrc32c (CheckSumCntx->Buffer, CHECK_SUM_BENCH_LENGTH, 0);
+    }
+
+    Portable = clock () - Start;
+    Start    = clock ();
+    for (Round = 0; Round < CHECK_SUM_BENCH_ROUNDS; Round++) {
+      Crc = 0xFFFFFFFF;
+      InternalCrc32cAccelerated (&Crc, CheckSumCntx->Buffer, CHECK_SUM_BENCH_LENGTH);
+    }
+
+    Accelerated = clock () - Start;
+    UT_ASSERT_EQUAL (Crc ^ 0xFFFFFFFF, Expected);
+    UT_LOG_INFO ("CRC32C of %d bytes: table %d, SSE4.2 %d clock ticks\n", CHECK_SUM_BENCH_LENGTH, (INT32)Portable, (INT32)Accelerated);
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Initialize the unit test framework, suite, and unit tests for the checksum
+  kernels and run the tests.
+
+  @retval  EFI_SUCCESS           All test cases were dispatched.
+  @retval  EFI_OUT_OF_RESOURCES  There are not enough resources available to
+                                 initialize the unit tests.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+UnitTestingEntry (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      CheckSumTests;
+  TEST_CONTEXT_CHECK_SUM      CheckSumContext;
+
+  Framework = NULL;
+  ZeroMem (&CheckSumContext, sizeof (CheckSumContext));
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_APP_NAME, UNIT_TEST_APP_VERSION));
+  DEBUG ((DEBUG_INFO, "Random seed 0x%lx\n", mCheckSumTestSeed));
+
+  //
+  // Start setting up the test framework for running the tests.
+  //
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_APP_NAME, gEfiCallerBaseName, UNIT_TEST_APP_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  //
+  // Populate the CheckSum Test Suite.
+  //
+  Status = CreateUnitTestSuite (&CheckSumTests, Framework, "BaseLibSysCall CheckSum Tests", "BaseLibSysCall.CheckSum", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for CheckSumTests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  //
+  // --------------Suite-----------Description--------------Name----------Function--------Pre---Post-------------------Context-----------
+  //
+  AddTestCase (CheckSumTests, "Wide sums should match portable sums", "WideSums", WideSumsMatchPortable, PrepareCheckSumTest, CleanUpCheckSumTest, &CheckSumContext);
+  AddTestCase (CheckSumTests, "Accelerated CRCs should match table CRCs", "AcceleratedCrcs", AcceleratedCrcsMatchPortable, PrepareCheckSumTest, CleanUpCheckSumTest, &CheckSumContext);
+  AddTestCase (CheckSumTests, "CRCs should fall back without CPU support", "Fallback", FallbackWithoutFeatures, PrepareCheckSumTest, CleanUpCheckSumTest, &CheckSumContext);
+  AddTestCase (CheckSumTests, "Benchmark portable and accelerated paths", "Benchmark", BenchmarkCheckSums, PrepareCheckSumTest, CleanUpCheckSumTest, &CheckSumContext);
+
+  //
+  // Execute the tests.
+  //
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+/**
+  Standard POSIX C entry point for host based unit test execution. An optional
+  first argument overrides the random seed.
+**/
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  if (argc > 1) {
+    mCheckSumTestSeed = strtoull (argv[1], NULL, 0);
+  }
+
+  return UnitTestingEntry ();
+}
@@ -0,0 +1,495 @@
+/** @file
+  Host based unit tests of the SSE2 string kernels of BaseLibSysCall.
+
+  Random Unicode and ASCII strings at random alignments are measured, compared and
+  searched through the kernels of X64/StringAccel.nasm and through the portable
+  routines of the host BaseLib, and the results have to match. Every other string
+  is placed so that its Null-terminator is the last character of a page, which is
+  where a careless vector load would run into the next page. A last case times both
+  paths over long strings and logs the result.
+
+  The random seed can be supplied as the first command line argument to reproduce
+  a reported failure.
+
+  Copyright (C) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <time.h>
+#include <cmocka.h>
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#include <Library/UnitTestLib.h>
+
+#include "../StringAccel.h"
+
+#define UNIT_TEST_APP_NAME     "BaseLibSysCall String Tests"
+#define UNIT_TEST_APP_VERSION  "1.0"
+
+#define STRING_TEST_DEFAULT_SEED  0x0DDBA11CAFEF00D5ULL
+#define STRING_TEST_ROUNDS        8192
+#define STRING_TEST_MAX_LENGTH    300
+#define STRING_TEST_PAGES         4
+#define STRING_BENCH_LENGTH       (EFI_PAGE_SIZE - 1)
+#define STRING_BENCH_ROUNDS       4096
+
+typedef struct {
+  UINT8    *First;
+  UINT8    *Second;
+} TEST_CONTEXT_STRING;
+
+STATIC UINT64  mStringTestSeed = STRING_TEST_DEFAULT_SEED;
+STATIC UINT64  mRandomState;
+
+/**
+  Get the next pseudo random number, the sequence only depends on the seed.
+
+  @return 64-bit pseudo random number.
+**/
+STATIC
+UINT64
+NextRandom (
+  VOID
+  )
+{
+  mRandomState ^= mRandomState >> 12;
+  mRandomState ^= mRandomState << 25;
+  mRandomState ^= mRandomState >> 27;
+  return mRandomState * 0x2545F4914F6CDD1DULL;
+}
+
+/**
+  Get a pseudo random number in [0, Bound).
+
+  @param[in]  Bound   Exclusive upper bound, must not be 0.
+
+  @return Pseudo random number below Bound.
+**/
+STATIC
+UINTN
+RandomBelow (
+  IN UINTN  Bound
+  )
+{
+  return (UINTN)(NextRandom () % Bound);
+}
+
+/**
+  Pick where a string of Size bytes goes in a test buffer: either at a random
+  offset, or so that it ends exactly at the end of the first page.
+
+  @param[in]  Buffer      Test buffer of STRING_TEST_PAGES pages.
+  @param[in]  Size        Size of the string in bytes, including the Null-terminator.
+  @param[in]  Alignment   Required alignment of the string.
+
+  @return Where the string starts.
+**/
+STATIC
+UINT8 *
+PlaceString (
+  IN UINT8  *Buffer,
+  IN UINTN  Size,
+  IN UINTN  Alignment
+  )
+{
+  if (RandomBelow (2) == 0) {
+    return Buffer + EFI_PAGE_SIZE - Size;
+  }
+
+  return Buffer + EFI_PAGE_SIZE + (RandomBelow (EFI_PAGE_SIZE) & ~(Alignment - 1));
+}
+
+/**
+  Fill a Unicode string with a small alphabet, so that partial matches are common.
+  A few characters get a high byte, so that byte-wise shortcuts would be caught.
+
+  @param[out] String    Buffer of Length + 1 characters.
+  @param[in]  Length    Number of characters before the Null-terminator.
+  @param[in]  Alphabet  Number of distinct low characters to pick from.
+**/
+STATIC
+VOID
+FillUnicodeString (
+  OUT CHAR16  *String,
+  IN  UINTN   Length,
+  IN  UINTN   Alphabet
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < Length; Index++) {
+    String[Index] = (CHAR16)(L'a' + RandomBelow (Alphabet));
+    if (RandomBelow (8) == 0) {
+      String[Index] |= 0x4100;
+    }
+  }
+
+  String[Length] = L'\0';
+}
+
+/**
+  Fill an ASCII string with a small alphabet, so that partial matches are common.
+
+  @param[out] String    Buffer of Length + 1 characters.
+  @param[in]  Length    Number of characters before the Null-terminator.
+  @param[in]  Alphabet  Number of distinct characters to pick from.
+**/
+STATIC
+VOID
+FillAsciiString (
+  OUT CHAR8  *String,
+  IN  UINTN  Length,
+  IN  UINTN  Alphabet
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < Length; Index++) {
+    String[Index] = (CHAR8)('a' + RandomBelow (Alphabet));
+  }
+
+  String[Length] = '\0';
+}
+
+/**
+  Allocate the test buffers and reset the random sequence.
+
+  @param[in]  Context   The TEST_CONTEXT_STRING of the test.
+
+  @retval  UNIT_TEST_PASSED   The buffers are ready.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+PrepareStringTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  TEST_CONTEXT_STRING  *StringCntx;
+
+  StringCntx   = (TEST_CONTEXT_STRING *)Context;
+  mRandomState = (mStringTestSeed != 0) ? mStringTestSeed : STRING_TEST_DEFAULT_SEED;
+
+  StringCntx->First  = AllocatePages (STRING_TEST_PAGES);
+  StringCntx->Second = AllocatePages (STRING_TEST_PAGES);
+  UT_ASSERT_NOT_NULL (StringCntx->First);
+  UT_ASSERT_NOT_NULL (StringCntx->Second);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Free the test buffers.
+
+  @param[in]  Context   The TEST_CONTEXT_STRING of the test.
+**/
+STATIC
+VOID
+EFIAPI
+CleanUpStringTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  TEST_CONTEXT_STRING  *StringCntx;
+
+  StringCntx = (TEST_CONTEXT_STRING *)Context;
+  if (StringCntx->First != NULL) {
+    FreePages (StringCntx->First, STRING_TEST_PAGES);
+    StringCntx->First = NULL;
+  }
+
+  if (StringCntx->Second != NULL) {
+    FreePages (StringCntx->Second, STRING_TEST_PAGES);
+    StringCntx->Second = NULL;
+  }
+}
+
+/**
+  The Unicode kernels should match the portable routines on random strings.
+
+  @param[in]  Context   The TEST_CONTEXT_STRING of the test.
+
+  @retval  UNIT_TEST_PASSED             All results match.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A result differs.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+UnicodeKernelsMatchPortable (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  TEST_CONTEXT_STRING  *StringCntx;
+  UINTN                Round;
+  UINTN                Alphabet;
+  UINTN                FirstLength;
+  UINTN                SecondLength;
+  UINTN                Length;
+  UINTN                Index;
+  CHAR16               *First;
+  CHAR16               *Second;
+  CHAR16               *Expected;
+  CHAR16               Char;
+
+  StringCntx = (TEST_CONTEXT_STRING *)Context;
+  for (Round = 0; Round < STRING_TEST_ROUNDS; Round++) {
+    Alphabet     = 1 + RandomBelow (4);
+    FirstLength  = RandomBelow ((Round & 1) ? STRING_TEST_MAX_LENGTH : 24);
+    SecondLength = RandomBelow (FirstLength + 4);
+    First        = (CHAR16 *)PlaceString (StringCntx->First, (FirstLength + 1) * sizeof (CHAR16), sizeof (CHAR16));
+    Second       = (CHAR16 *)PlaceString (StringCntx->Second, (SecondLength + 1) * sizeof (CHAR16), sizeof (CHAR16));
+    FillUnicodeString (First, FirstLength, Alphabet);
+    FillUnicodeString (Second, SecondLength, Alphabet);
+
+    // Mostly a common prefix, so that the compare runs for a while
+    for (Index = 0; (Index < MIN (FirstLength, SecondLength)) && (RandomBelow (64) != 0); Index++) {
+      Second[Index] = First[Index];
+    }
+
+    UT_ASSERT_EQUAL (InternalStrnLenSse2 (First, MAX_UINTN), StrLen (First));
+    Length = 1 + RandomBelow (STRING_TEST_MAX_LENGTH);
+    UT_ASSERT_EQUAL (InternalStrnLenSse2 (First, Length), StrnLenS (First, Length));
+
+    Index = InternalStrnCmpSse2 (First, Second, MAX_UINTN);
+    UT_ASSERT_EQUAL ((INTN)(First[Index] - Second[Index]), StrCmp (First, Second));
+    Length = 1 + RandomBelow (STRING_TEST_MAX_LENGTH);
+    Index  = InternalStrnCmpSse2 (First, Second, Length - 1);
+    UT_ASSERT_EQUAL ((INTN)(First[Index] - Second[Index]), StrnCmp (First, Second, Length));
+
+    Char     = (CHAR16)(L'a' + RandomBelow (Alphabet + 1));
+    Expected = First;
+    while ((*Expected != L'\0') && (*Expected != Char)) {
+      Expected++;
+    }
+
+    UT_ASSERT_TRUE (InternalStrChrSse2 (First, Char) == Expected);
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  The ASCII kernels should match the portable routines on random strings.
+
+  @param[in]  Context   The TEST_CONTEXT_STRING of the test.
+
+  @retval  UNIT_TEST_PASSED             All results match.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A result differs.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+AsciiKernelsMatchPortable (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  TEST_CONTEXT_STRING  *StringCntx;
+  UINTN                Round;
+  UINTN                Alphabet;
+  UINTN                FirstLength;
+  UINTN                SecondLength;
+  UINTN                Length;
+  UINTN                Index;
+  CHAR8                *First;
+  CHAR8                *Second;
+  CHAR8                *Expected;
+  CHAR8                Char;
+
+  StringCntx = (TEST_CONTEXT_STRING *)Context;
+  for (Round = 0; Round < STRING_TEST_ROUNDS; Round++) {
+    Alphabet     = 1 + RandomBelow (4);
+    FirstLength  = RandomBelow ((Round & 1) ? STRING_TEST_MAX_LENGTH : 40);
+    SecondLength = RandomBelow (FirstLength + 4);
+    First        = (CHAR8 *)PlaceString (StringCntx->First, FirstLength + 1, 1);
+    Second       = (CHAR8 *)PlaceString (StringCntx->Second, SecondLength + 1, 1);
+    FillAsciiString (First, FirstLength, Alphabet);
+    FillAsciiString (Second, SecondLength, Alphabet);
+
+    for (Index = 0; (Index < MIN (FirstLength, SecondLength)) && (RandomBelow (64) != 0); Index++) {
+      Second[Index] = First[Index];
+    }
+
+    UT_ASSERT_EQUAL (InternalAsciiStrnLenSse2 (First, MAX_UINTN), AsciiStrLen (First));
+    Length = 1 + RandomBelow (STRING_TEST_MAX_LENGTH);
+    UT_ASSERT_EQUAL (InternalAsciiStrnLenSse2 (First, Length), AsciiStrnLenS (First, Length));
+
+    Index = InternalAsciiStrnCmpSse2 (First, Second, MAX_UINTN);
+    UT_ASSERT_EQUAL ((INTN)(First[Index] - Second[Index]), AsciiStrCmp (First, Second));
+    Length = 1 + RandomBelow (STRING_TEST_MAX_LENGTH);
+    Index  = InternalAsciiStrnCmpSse2 (First, Second, Length - 1);
+    UT_ASSERT_EQUAL ((INTN)(First[Index] - Second[Index]), AsciiStrnCmp (First, Second, Length));
+
+    Char     = (CHAR8)('a' + RandomBelow (Alphabet + 1));
+    Expected = First;
+    while ((*Expected != '\0') && (*Expected != Char)) {
+      Expected++;
+    }
+
+    UT_ASSERT_TRUE (InternalAsciiStrChrSse2 (First, Char) == Expected);
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Time the portable routines and the kernels over long strings and log the
+  results. Only the equality of the results is asserted.
+
+  @param[in]  Context   The TEST_CONTEXT_STRING of the test.
+
+  @retval  UNIT_TEST_PASSED             The benchmark ran.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  The paths disagree.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+BenchmarkStrings (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  TEST_CONTEXT_STRING  *StringCntx;
+  CHAR16               *First;
+  CHAR16               *Second;
+  UINTN                Round;
+  UINTN                Expected;
+  UINTN                Actual;
+  INTN                 ExpectedCmp;
+  INTN                 ActualCmp;
+  clock_t              Start;
+  clock_t              Portable;
+  clock_t              Vector;
+
+  StringCntx = (TEST_CONTEXT_STRING *)Context;
+  First      = (CHAR16 *)StringCntx->First;
+  Second     = (CHAR16 *)StringCntx->Second;
+  FillUnicodeString (First, STRING_BENCH_LENGTH, 26);
+  CopyMem (Second, First, (STRING_BENCH_LENGTH + 1) * sizeof (CHAR16));
+
+  Expected = 0;
+  Actual   = 0;
+  Start    = clock ();
+  for (Round = 0; Round < STRING_BENCH_ROUNDS; Round++) {
+    Expected += StrLen (First);
+  }
+
+  Portable = clock () - Start;
+  Start    = clock ();
+  for (Round = 0; Round < STRING_BENCH_ROUNDS; Round++) {
+    Actual += InternalStrnLenSse2 (First, MAX_UINTN);
+  }
+
+  Vector = clock () - Start;
+  UT_ASSERT_EQUAL (Actual, Expected);
+  UT_LOG_INFO ("StrLen of %d characters: portable %d, SSE2 %d clock ticks\n", STRING_BENCH_LENGTH, (INT32)Portable, (INT32)Vector);
+
+  ExpectedCmp = 0;
+  ActualCmp   = 0;
+  Start       = clock ();
+  for (Round = 0; Round < STRING_BENCH_ROUNDS; Round++) {
+    ExpectedCmp += StrCmp (First, Second);
+  }
+
+  Portable = clock () - Start;
+  Start    = clock ();
+  for (Round = 0; Round < STRING_BENCH_ROUNDS; Round++) {
+    Actual     = InternalStrnCmpSse2 (First, Second, MAX_UINTN);
+    ActualCmp += First[Actual] - Second[Actual];
+  }
+
+  Vector = clock () - Start;
+  UT_ASSERT_EQUAL (ActualCmp, ExpectedCmp);
+  UT_LOG_INFO ("StrCmp of %d characters: portable %d, SSE2 %d clock ticks\n", STRING_BENCH_LENGTH, (INT32)Portable, (INT32)Vector);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Initialize the unit test framework, suite, and unit tests for the string
+  kernels and run the tests.
+
+  @retval  EFI_SUCCESS           All test cases were dispatched.
+  @retval  EFI_OUT_OF_RESOURCES  There are not enough resources available to
+                                 initialize the unit tests.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+UnitTestingEntry (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      StringTests;
+  TEST_CONTEXT_STRING         StringContext;
+
+  Framework = NULL;
+  ZeroMem (&StringContext, sizeof (StringContext));
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_APP_NAME, UNIT_TEST_APP_VERSION));
+  DEBUG ((DEBUG_INFO, "Random seed 0x%lx\n", mStringTestSeed));
+
+  //
+  // Start setting up the test framework for running the tests.
+  //
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_APP_NAME, gEfiCallerBaseName, UNIT_TEST_APP_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  //
+  // Populate the String Test Suite.
+  //
+  Status = CreateUnitTestSuite (&StringTests, Framework, "BaseLibSysCall String Tests", "BaseLibSysCall.String", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for StringTests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  //
+  // --------------Suite-----------Description--------------Name----------Function--------Pre---Post-------------------Context-----------
+  //
+  AddTestCase (StringTests, "Unicode kernels should match portable routines", "Unicode", UnicodeKernelsMatchPortable, PrepareStringTest, CleanUpStringTest, &StringContext);
+  AddTestCase (StringTests, "ASCII kernels should match portable routines", "Ascii", AsciiKernelsMatchPortable, PrepareStringTest, CleanUpStringTest, &StringContext);
+  AddTestCase (StringTests, "Benchmark portable and SSE2 routines", "Benchmark", BenchmarkStrings, PrepareStringTest, CleanUpStringTest, &StringContext);
+
+  //
+  // Execute the tests.
+  //
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+/**
+  Standard POSIX C entry point for host based unit test execution. An optional
+  first argument overrides the random seed.
+**/
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  if (argc > 1) {
+    mStringTestSeed = strtoull (argv[1], NULL, 0);
+  }
+
+  return UnitTestingEntry ();
+}
@@ -0,0 +1,134 @@
+/** @file
+  Ordering and lookup of the read-only HOB index, shared by the MM supervisor that
+  sorts the index and the HOB library of user modules that searches it.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MmHobIndexLib.h>
+
+/**
+  Order 2 GUIDs as a pair of 64-bit integers, lower half first.
+
+  @param[in]  Guid1     Pointer to the first GUID.
+  @param[in]  Guid2     Pointer to the second GUID.
+
+  @retval <0            Guid1 is ordered before Guid2.
+  @retval 0             The GUIDs are identical.
+  @retval >0            Guid1 is ordered after Guid2.
+
+**/
+INTN
+EFIAPI
+MmHobIndexCompareGuid (
+  IN CONST EFI_GUID  *Guid1,
+  IN CONST EFI_GUID  *Guid2
+  )
+{
+  UINT64  Lhs;
+  UINT64  Rhs;
+
+  Lhs = ReadUnaligned64 ((CONST UINT64 *)Guid1);
+  Rhs = ReadUnaligned64 ((CONST UINT64 *)Guid2);
+  if (Lhs == Rhs) {
+    Lhs = ReadUnaligned64 ((CONST UINT64 *)Guid1 + 1);
+    Rhs = ReadUnaligned64 ((CONST UINT64 *)Guid2 + 1);
+  }
+
+  if (Lhs == Rhs) {
+    return 0;
+  }
+
+  return (Lhs < Rhs) ? -1 : 1;
+}
+
+/**
+  Sort callback ordering GUID HOB index entries by GUID name and then by HOB offset.
+
+  @param[in]  Buffer1   Pointer to the first MM_HOB_INDEX_GUID_ENTRY.
+  @param[in]  Buffer2   Pointer to the second MM_HOB_INDEX_GUID_ENTRY.
+
+  @retval <0            Buffer1 is ordered before Buffer2.
+  @retval 0             The entries are identical.
+  @retval >0            Buffer1 is ordered after Buffer2.
+
+**/
+INTN
+EFIAPI
+MmHobIndexCompareGuidEntry (
+  IN CONST VOID  *Buffer1,
+  IN CONST VOID  *Buffer2
+  )
+{
+  CONST MM_HOB_INDEX_GUID_ENTRY  *Entry1;
+  CONST MM_HOB_INDEX_GUID_ENTRY  *Entry2;
+  INTN                           Result;
+
+  Entry1 = (CONST MM_HOB_INDEX_GUID_ENTRY *)Buffer1;
+  Entry2 = (CONST MM_HOB_INDEX_GUID_ENTRY *)Buffer2;
+
+  Result = MmHobIndexCompareGuid (&Entry1->Name, &Entry2->Name);
+  if (Result != 0) {
+    return Result;
+  }
+
+  if (Entry1->HobOffset == Entry2->HobOffset) {
+    return 0;
+  }
+
+  return (Entry1->HobOffset < Entry2->HobOffset) ? -1 : 1;
+}
+
+/**
+  Binary search the HOB index for the first GUID HOB named Guid at or after StartOffset.
+
+  @param[in]  HobIndex      The HOB index, followed by its sorted GUID entries.
+  @param[in]  Guid          The GUID to match with.
+  @param[in]  StartOffset   Offset from the start of the HOB list to search from.
+
+  @return The matched GUID entry, or NULL if there is no such GUID HOB.
+
+**/
+CONST MM_HOB_INDEX_GUID_ENTRY *
+EFIAPI
+MmHobIndexFindGuid (
+  IN CONST MM_HOB_INDEX  *HobIndex,
+  IN CONST EFI_GUID      *Guid,
+  IN UINT64              StartOffset
+  )
+{
+  CONST MM_HOB_INDEX_GUID_ENTRY  *GuidEntries;
+  UINTN                          Low;
+  UINTN                          High;
+  UINTN                          Mid;
+  INTN                           Result;
+
+  GuidEntries = (CONST MM_HOB_INDEX_GUID_ENTRY *)(HobIndex + 1);
+
+  //
+  // Lower bound of (Guid, StartOffset) among entries sorted by name then offset.
+  //
+  Low  = 0;
+  High = HobIndex->GuidEntryCount;
+  while (Low < High) {
+    Mid    = Low + (High - Low) / 2;
+    Result = MmHobIndexCompareGuid (&GuidEntries[Mid].Name, Guid);
+    if ((Result < 0) || ((Result == 0) && (GuidEntries[Mid].HobOffset < StartOffset))) {
+      Low = Mid + 1;
+    } else {
+      High = Mid;
+    }
+  }
+
+  if ((Low < HobIndex->GuidEntryCount) && CompareGuid (&GuidEntries[Low].Name, Guid)) {
+    return &GuidEntries[Low];
+  }
+
+  return NULL;
+}
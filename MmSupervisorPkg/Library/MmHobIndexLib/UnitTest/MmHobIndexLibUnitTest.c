@@ -0,0 +1,496 @@
+/** @file
+  Host based unit tests of the HOB index ordering and lookup routines shared by
+  MM supervisor and the HOB library of user modules.
+
+  A HOB list is built with repeated GUID HOBs, GUIDs that only differ in their upper
+  64 bits and GUIDs absent from the list. The index is sorted the way MM supervisor
+  sorts it, and every lookup through MmHobIndexFindGuid, from every HOB of the list,
+  is compared against a linear walk of the HOB list.
+
+  Copyright (C) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <Uefi.h>
+#include <Pi/PiHob.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/SortLib.h>
+#include <Library/MmHobIndexLib.h>
+
+#include <Library/UnitTestLib.h>
+
+#define UNIT_TEST_APP_NAME     "MM HOB Index Lib Tests"
+#define UNIT_TEST_APP_VERSION  "1.0"
+
+// Marks a layout entry that is not a GUID extension HOB
+#define HOB_TEST_NOT_GUID  MAX_UINTN
+
+typedef struct {
+  UINT16    HobType;
+  UINTN     GuidIndex;
+  UINT16    DataSize;
+} HOB_TEST_LAYOUT;
+
+typedef struct {
+  VOID            *HobList;
+  UINTN           HobListSize;
+  MM_HOB_INDEX    *HobIndex;
+} TEST_CONTEXT_HOB_INDEX;
+
+//
+// The first 3 GUIDs share their lower 64 bits. The first 2 GUIDs, as well as the next 2,
+// are ordered differently byte by byte than as 64-bit integers.
+//
+STATIC CONST EFI_GUID  mHobTestGuids[] = {
+  { 0x11223344, 0x5566, 0x7788, { 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }
+  },
+  { 0x11223344, 0x5566, 0x7788, { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01 }
+  },
+  { 0x11223344, 0x5566, 0x7788, { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }
+  },
+  { 0x00000002, 0x0000, 0x0000, { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }
+  },
+  { 0x01000000, 0x0000, 0x0000, { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }
+  },
+  { 0xA1B2C3D4, 0xE5F6, 0x0718, { 0x29, 0x3A, 0x4B, 0x5C, 0x6D, 0x7E, 0x8F, 0x90 }
+  },
+  //
+  // GUIDs below are not in the HOB list.
+  //
+  { 0x11223344, 0x5566, 0x7788, { 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }
+  },
+  { 0x00000000, 0x0000, 0x0000, { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }
+  },
+  { 0xFFFFFFFF, 0xFFFF, 0xFFFF, { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }
+  },
+};
+
+STATIC CONST HOB_TEST_LAYOUT  mHobTestLayout[] = {
+  { EFI_HOB_TYPE_MEMORY_ALLOCATION,   HOB_TEST_NOT_GUID, sizeof (EFI_HOB_MEMORY_ALLOCATION)  },
+  { EFI_HOB_TYPE_GUID_EXTENSION,      5,                 8                                   },
+  { EFI_HOB_TYPE_GUID_EXTENSION,      0,                 16                                  },
+  { EFI_HOB_TYPE_RESOURCE_DESCRIPTOR, HOB_TEST_NOT_GUID, sizeof (EFI_HOB_RESOURCE_DESCRIPTOR) },
+  { EFI_HOB_TYPE_GUID_EXTENSION,      2,                 0                                   },
+  { EFI_HOB_TYPE_GUID_EXTENSION,      0,                 24                                  },
+  { EFI_HOB_TYPE_GUID_EXTENSION,      4,                 8                                   },
+  { EFI_HOB_TYPE_GUID_EXTENSION,      1,                 8                                   },
+  { EFI_HOB_TYPE_MEMORY_ALLOCATION,   HOB_TEST_NOT_GUID, sizeof (EFI_HOB_MEMORY_ALLOCATION)  },
+  { EFI_HOB_TYPE_GUID_EXTENSION,      3,                 32                                  },
+  { EFI_HOB_TYPE_GUID_EXTENSION,      0,                 8                                   },
+  { EFI_HOB_TYPE_GUID_EXTENSION,      4,                 16                                  },
+};
+
+/**
+  Size of the HOB described by a layout entry.
+
+  @param[in]  Layout    The layout entry.
+
+  @return The HOB length, rounded up to 8 bytes.
+
+**/
+STATIC
+UINT16
+GetTestHobLength (
+  IN CONST HOB_TEST_LAYOUT  *Layout
+  )
+{
+  if (Layout->GuidIndex == HOB_TEST_NOT_GUID) {
+    return Layout->DataSize;
+  }
+
+  return (UINT16)ALIGN_VALUE (sizeof (EFI_HOB_GUID_TYPE) + Layout->DataSize, 8);
+}
+
+/**
+  Find the first GUID HOB named Guid at or after StartOffset by walking the HOB list.
+
+  @param[in]  HobList       The HOB list.
+  @param[in]  Guid          The GUID to match with.
+  @param[in]  StartOffset   Offset of the HOB to start the walk from.
+
+  @return Offset of the matched GUID HOB, or MAX_UINT64 if there is none.
+
+**/
+STATIC
+UINT64
+LinearFindGuid (
+  IN VOID            *HobList,
+  IN CONST EFI_GUID  *Guid,
+  IN UINT64          StartOffset
+  )
+{
+  EFI_PEI_HOB_POINTERS  Hob;
+
+  for (Hob.Raw = (UINT8 *)HobList + StartOffset; !END_OF_HOB_LIST (Hob); Hob.Raw = GET_NEXT_HOB (Hob)) {
+    if ((GET_HOB_TYPE (Hob) == EFI_HOB_TYPE_GUID_EXTENSION) && CompareGuid (&Hob.Guid->Name, Guid)) {
+      return (UINT64)(Hob.Raw - (UINT8 *)HobList);
+    }
+  }
+
+  return MAX_UINT64;
+}
+
+/**
+  Build the HOB list from mHobTestLayout and index its GUID HOBs the way MM supervisor does.
+
+  @param[in]  Context   The TEST_CONTEXT_HOB_INDEX to populate.
+
+  @retval UNIT_TEST_PASSED                    The HOB list and index are built.
+  @retval UNIT_TEST_ERROR_PREREQUISITE_NOT_MET  Out of resources.
+
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+PrepareHobIndex (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  TEST_CONTEXT_HOB_INDEX   *IndexContext;
+  EFI_PEI_HOB_POINTERS     Hob;
+  MM_HOB_INDEX_GUID_ENTRY  *GuidEntries;
+  UINTN                    GuidCount;
+  UINTN                    Index;
+
+  IndexContext = (TEST_CONTEXT_HOB_INDEX *)Context;
+
+  IndexContext->HobListSize = sizeof (EFI_HOB_GENERIC_HEADER);
+  GuidCount                 = 0;
+  for (Index = 0; Index < ARRAY_SIZE (mHobTestLayout); Index++) {
+    IndexContext->HobListSize += GetTestHobLength (&mHobTestLayout[Index]);
+    if (mHobTestLayout[Index].GuidIndex != HOB_TEST_NOT_GUID) {
+      GuidCount++;
+    }
+  }
+
+  IndexContext->HobList  = AllocateZeroPool (IndexContext->HobListSize);
+  IndexContext->HobIndex = AllocateZeroPool (sizeof (MM_HOB_INDEX) + GuidCount * sizeof (MM_HOB_INDEX_GUID_ENTRY));
+  if ((IndexContext->HobList == NULL) || (IndexContext->HobIndex == NULL)) {
+    return UNIT_TEST_ERROR_PREREQUISITE_NOT_MET;
+  }
+
+  IndexContext->HobIndex->Signature      = MM_HOB_INDEX_SIGNATURE;
+  IndexContext->HobIndex->GuidEntryCount = (UINT32)GuidCount;
+  IndexContext->HobIndex->HobListStart   = (UINT64)(UINTN)IndexContext->HobList;
+  IndexContext->HobIndex->HobListSize    = IndexContext->HobListSize;
+  GuidEntries                            = (MM_HOB_INDEX_GUID_ENTRY *)(IndexContext->HobIndex + 1);
+
+  Hob.Raw   = IndexContext->HobList;
+  GuidCount = 0;
+  for (Index = 0; Index < ARRAY_SIZE (mHobTestLayout); Index++) {
+    Hob.Header->HobType   = mHobTestLayout[Index].HobType;
+    Hob.Header->HobLength = GetTestHobLength (&mHobTestLayout[Index]);
+    if (mHobTestLayout[Index].GuidIndex != HOB_TEST_NOT_GUID) {
+      CopyGuid (&Hob.Guid->Name, &mHobTestGuids[mHobTestLayout[Index].GuidIndex]);
+      CopyGuid (&GuidEntries[GuidCount].Name, &Hob.Guid->Name);
+      GuidEntries[GuidCount].HobOffset = (UINT64)(Hob.Raw - (UINT8 *)IndexContext->HobList);
+      GuidCount++;
+    }
+
+    Hob.Raw = GET_NEXT_HOB (Hob);
+  }
+
+  Hob.Header->HobType   = EFI_HOB_TYPE_END_OF_HOB_LIST;
+  Hob.Header->HobLength = sizeof (EFI_HOB_GENERIC_HEADER);
+
+  PerformQuickSort (GuidEntries, GuidCount, sizeof (MM_HOB_INDEX_GUID_ENTRY), MmHobIndexCompareGuidEntry);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Free the HOB list and index built by PrepareHobIndex.
+
+  @param[in]  Context   The TEST_CONTEXT_HOB_INDEX to clean up.
+
+**/
+STATIC
+VOID
+EFIAPI
+CleanUpHobIndex (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  TEST_CONTEXT_HOB_INDEX  *IndexContext;
+
+  IndexContext = (TEST_CONTEXT_HOB_INDEX *)Context;
+  if (IndexContext->HobList != NULL) {
+    FreePool (IndexContext->HobList);
+    IndexContext->HobList = NULL;
+  }
+
+  if (IndexContext->HobIndex != NULL) {
+    FreePool (IndexContext->HobIndex);
+    IndexContext->HobIndex = NULL;
+  }
+}
+
+/**
+  Sorted index entries must be strictly ascending by GUID and then by HOB offset.
+
+  @param[in]  Context   The TEST_CONTEXT_HOB_INDEX under test.
+
+  @retval UNIT_TEST_PASSED              The index is ordered.
+  @retval UNIT_TEST_ERROR_TEST_FAILED   An entry is out of order.
+
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+IndexEntriesAreOrdered (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  TEST_CONTEXT_HOB_INDEX         *IndexContext;
+  CONST MM_HOB_INDEX_GUID_ENTRY  *GuidEntries;
+  UINTN                          Index;
+
+  IndexContext = (TEST_CONTEXT_HOB_INDEX *)Context;
+  GuidEntries  = (CONST MM_HOB_INDEX_GUID_ENTRY *)(IndexContext->HobIndex + 1);
+
+  for (Index = 1; Index < IndexContext->HobIndex->GuidEntryCount; Index++) {
+    UT_ASSERT_TRUE (MmHobIndexCompareGuidEntry (&GuidEntries[Index - 1], &GuidEntries[Index]) < 0);
+    UT_ASSERT_TRUE (MmHobIndexCompareGuidEntry (&GuidEntries[Index], &GuidEntries[Index - 1]) > 0);
+    UT_ASSERT_EQUAL (MmHobIndexCompareGuidEntry (&GuidEntries[Index], &GuidEntries[Index]), 0);
+  }
+
+  //
+  // GUIDs sharing their lower 64 bits are ordered by the upper 64 bits, and the lower
+  // 64 bits are compared as an integer rather than byte by byte.
+  //
+  UT_ASSERT_TRUE (MmHobIndexCompareGuid (&mHobTestGuids[0], &mHobTestGuids[1]) < 0);
+  UT_ASSERT_TRUE (MmHobIndexCompareGuid (&mHobTestGuids[1], &mHobTestGuids[2]) < 0);
+  UT_ASSERT_TRUE (MmHobIndexCompareGuid (&mHobTestGuids[3], &mHobTestGuids[4]) < 0);
+  UT_ASSERT_EQUAL (MmHobIndexCompareGuid (&mHobTestGuids[5], &mHobTestGuids[5]), 0);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Every lookup of every test GUID, started from every HOB of the list, must return the
+  same GUID HOB as a linear walk. This covers hits, misses, repeated GUIDs and starting
+  past the last instance of a GUID.
+
+  @param[in]  Context   The TEST_CONTEXT_HOB_INDEX under test.
+
+  @retval UNIT_TEST_PASSED              All lookups match the linear walk.
+  @retval UNIT_TEST_ERROR_TEST_FAILED   A lookup differs from the linear walk.
+
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+FindGuidMatchesLinearWalk (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  TEST_CONTEXT_HOB_INDEX         *IndexContext;
+  CONST MM_HOB_INDEX_GUID_ENTRY  *Entry;
+  EFI_PEI_HOB_POINTERS           Hob;
+  UINT64                         StartOffset;
+  UINT64                         Expected;
+  UINTN                          GuidIndex;
+  UINTN                          HitCount;
+  UINTN                          MissCount;
+
+  IndexContext = (TEST_CONTEXT_HOB_INDEX *)Context;
+  HitCount     = 0;
+  MissCount    = 0;
+
+  Hob.Raw = IndexContext->HobList;
+  while (TRUE) {
+    StartOffset = (UINT64)(Hob.Raw - (UINT8 *)IndexContext->HobList);
+    for (GuidIndex = 0; GuidIndex < ARRAY_SIZE (mHobTestGuids); GuidIndex++) {
+      Expected = LinearFindGuid (IndexContext->HobList, &mHobTestGuids[GuidIndex], StartOffset);
+      Entry    = MmHobIndexFindGuid (IndexContext->HobIndex, &mHobTestGuids[GuidIndex], StartOffset);
+      if (Expected == MAX_UINT64) {
+        UT_ASSERT_TRUE (Entry == NULL);
+        MissCount++;
+      } else {
+        UT_ASSERT_NOT_NULL (Entry);
+        UT_ASSERT_TRUE (CompareGuid (&Entry->Name, &mHobTestGuids[GuidIndex]));
+        UT_ASSERT_EQUAL (Entry->HobOffset, Expected);
+        HitCount++;
+      }
+    }
+
+    if (END_OF_HOB_LIST (Hob)) {
+      break;
+    }
+
+    Hob.Raw = GET_NEXT_HOB (Hob);
+  }
+
+  //
+  // Make sure the layout exercised both outcomes.
+  //
+  UT_ASSERT_NOT_EQUAL (HitCount, 0);
+  UT_ASSERT_NOT_EQUAL (MissCount, 0);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Repeated GUID HOBs must be found in HOB list order when each lookup starts right
+  after the previous match, the way GetNextGuidHob is used to enumerate them.
+
+  @param[in]  Context   The TEST_CONTEXT_HOB_INDEX under test.
+
+  @retval UNIT_TEST_PASSED              All instances are enumerated in order.
+  @retval UNIT_TEST_ERROR_TEST_FAILED   An instance is missed or out of order.
+
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+FindGuidEnumeratesDuplicates (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  TEST_CONTEXT_HOB_INDEX         *IndexContext;
+  CONST MM_HOB_INDEX_GUID_ENTRY  *Entry;
+  EFI_PEI_HOB_POINTERS           Hob;
+  UINT64                         StartOffset;
+  UINT64                         Expected;
+  UINTN                          Count;
+
+  IndexContext = (TEST_CONTEXT_HOB_INDEX *)Context;
+  StartOffset  = 0;
+  Count        = 0;
+
+  while (TRUE) {
+    Expected = LinearFindGuid (IndexContext->HobList, &mHobTestGuids[0], StartOffset);
+    Entry    = MmHobIndexFindGuid (IndexContext->HobIndex, &mHobTestGuids[0], StartOffset);
+    if (Expected == MAX_UINT64) {
+      UT_ASSERT_TRUE (Entry == NULL);
+      break;
+    }
+
+    UT_ASSERT_NOT_NULL (Entry);
+    UT_ASSERT_EQUAL (Entry->HobOffset, Expected);
+    Count++;
+
+    Hob.Raw     = (UINT8 *)IndexContext->HobList + Entry->HobOffset;
+    StartOffset = (UINT64)(GET_NEXT_HOB (Hob) - (UINT8 *)IndexContext->HobList);
+  }
+
+  UT_ASSERT_EQUAL (Count, 3);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Lookups in an index without GUID entries must not match anything.
+
+  @param[in]  Context   Unused.
+
+  @retval UNIT_TEST_PASSED              No lookup matched.
+  @retval UNIT_TEST_ERROR_TEST_FAILED   A lookup matched.
+
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+FindGuidInEmptyIndex (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  MM_HOB_INDEX  HobIndex;
+  UINTN         GuidIndex;
+
+  ZeroMem (&HobIndex, sizeof (HobIndex));
+  HobIndex.Signature = MM_HOB_INDEX_SIGNATURE;
+
+  for (GuidIndex = 0; GuidIndex < ARRAY_SIZE (mHobTestGuids); GuidIndex++) {
+    UT_ASSERT_TRUE (MmHobIndexFindGuid (&HobIndex, &mHobTestGuids[GuidIndex], 0) == NULL);
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Initialize the unit test framework, suite, and unit tests for the HOB index
+  routines and run them.
+
+  @retval  EFI_SUCCESS           All test cases were dispatched.
+  @retval  EFI_OUT_OF_RESOURCES  There are not enough resources available to
+                                 initialize the unit tests.
+**/
+EFI_STATUS
+EFIAPI
+UnitTestingEntry (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      IndexTests;
+  TEST_CONTEXT_HOB_INDEX      IndexContext;
+
+  Framework = NULL;
+  ZeroMem (&IndexContext, sizeof (IndexContext));
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_APP_NAME, UNIT_TEST_APP_VERSION));
+
+  //
+  // Start setting up the test framework for running the tests.
+  //
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_APP_NAME, gEfiCallerBaseName, UNIT_TEST_APP_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  //
+  // Populate the HOB Index Test Suite.
+  //
+  Status = CreateUnitTestSuite (&IndexTests, Framework, "MM HOB Index Tests", "MmHobIndexLib.Find", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for IndexTests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  //
+  // --------------Suite-----------Description--------------Name----------Function--------Pre---Post-------------------Context-----------
+  //
+  AddTestCase (IndexTests, "Index entries should be sorted by GUID then offset", "Order", IndexEntriesAreOrdered, PrepareHobIndex, CleanUpHobIndex, &IndexContext);
+  AddTestCase (IndexTests, "Lookups should match a linear walk of the HOB list", "DiffLinear", FindGuidMatchesLinearWalk, PrepareHobIndex, CleanUpHobIndex, &IndexContext);
+  AddTestCase (IndexTests, "Repeated GUID HOBs should be found in list order", "Duplicates", FindGuidEnumeratesDuplicates, PrepareHobIndex, CleanUpHobIndex, &IndexContext);
+  AddTestCase (IndexTests, "Lookups in an empty index should miss", "Empty", FindGuidInEmptyIndex, NULL, NULL, NULL);
+
+  //
+  // Execute the tests.
+  //
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+/**
+  Standard POSIX C entry point for host based unit execution.
+**/
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  return UnitTestingEntry ();
+}
@@ -0,0 +1,254 @@
+/** @file
+  Work-stealing parallel-for over the CPUs gathered in an MMI.
+
+  The iteration space is split into one range per CPU. The owner of a range consumes it
+  from the front, GrainSize indices at a time, while the CPUs that ran out of work steal the
+  back half of it. Both ends are packed in one 64-bit word so that every transfer of work is
+  a single compare-exchange, which holds at CPL0 and CPL3 alike.
+
+  Copyright (C) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <PiMm.h>
+
+#include <Library/BaseLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/MmParallelForLib.h>
+#include <Library/SynchronizationLib.h>
+
+#include "MmParallelForLibInternal.h"
+
+#define PACK_RANGE(Begin, End)  (LShiftU64 ((UINT64)(End), 32) | (UINT32)(Begin))
+#define RANGE_BEGIN(Range)      ((UINT32)(Range))
+#define RANGE_END(Range)        ((UINT32)RShiftU64 ((Range), 32))
+
+/**
+  Take the next GrainSize indices from the front of a range, by its owner.
+
+  @param[in, out]  Deque       Range of the calling worker.
+  @param[in]       GrainSize   Maximal number of indices to take.
+  @param[out]      Begin       First index taken.
+  @param[out]      End         One past the last index taken.
+
+  @retval TRUE     Some indices are taken.
+  @retval FALSE    The range is empty.
+**/
+STATIC
+BOOLEAN
+PopFront (
+  IN OUT MM_PARALLEL_FOR_DEQUE  *Deque,
+  IN     UINT32                 GrainSize,
+  OUT    UINT32                 *Begin,
+  OUT    UINT32                 *End
+  )
+{
+  UINT64  Range;
+  UINT32  RangeBegin;
+  UINT32  RangeEnd;
+  UINT32  Split;
+
+  do {
+    Range      = Deque->Range;
+    RangeBegin = RANGE_BEGIN (Range);
+    RangeEnd   = RANGE_END (Range);
+    if (RangeBegin >= RangeEnd) {
+      return FALSE;
+    }
+
+    Split = (RangeEnd - RangeBegin > GrainSize) ? RangeBegin + GrainSize : RangeEnd;
+  } while (InterlockedCompareExchange64 (&Deque->Range, Range, PACK_RANGE (Split, RangeEnd)) != Range);
+
+  *Begin = RangeBegin;
+  *End   = Split;
+  return TRUE;
+}
+
+/**
+  Take the back half of a range, or all of it if it is not larger than GrainSize,
+  on behalf of another worker.
+
+  @param[in, out]  Deque       Range of the victim.
+  @param[in]       GrainSize   Grain size of the loop.
+  @param[out]      Begin       First index stolen.
+  @param[out]      End         One past the last index stolen.
+
+  @retval TRUE     Some indices are stolen.
+  @retval FALSE    The range is empty.
+**/
+STATIC
+BOOLEAN
+StealBack (
+  IN OUT MM_PARALLEL_FOR_DEQUE  *Deque,
+  IN     UINT32                 GrainSize,
+  OUT    UINT32                 *Begin,
+  OUT    UINT32                 *End
+  )
+{
+  UINT64  Range;
+  UINT32  RangeBegin;
+  UINT32  RangeEnd;
+  UINT32  Split;
+
+  do {
+    Range      = Deque->Range;
+    RangeBegin = RANGE_BEGIN (Range);
+    RangeEnd   = RANGE_END (Range);
+    if (RangeBegin >= RangeEnd) {
+      return FALSE;
+    }
+
+    Split = (RangeEnd - RangeBegin > GrainSize) ? RangeBegin + (RangeEnd - RangeBegin) / 2 : RangeBegin;
+  } while (InterlockedCompareExchange64 (&Deque->Range, Range, PACK_RANGE (RangeBegin, Split)) != Range);
+
+  *Begin = Split;
+  *End   = RangeEnd;
+  return TRUE;
+}
+
+/**
+  Worker of a parallel-for loop, run by every participating CPU. It takes the next free
+  range, drains it, then steals from the other ranges until none is left.
+
+  @param[in, out]  Buffer    Pointer to the MM_PARALLEL_FOR_STATE.
+
+**/
+VOID
+EFIAPI
+MmParallelForWorker (
+  IN OUT VOID  *Buffer
+  )
+{
+  MM_PARALLEL_FOR_STATE  *State;
+  MM_PARALLEL_FOR_DEQUE  *Own;
+  UINT32                 OwnIndex;
+  UINT32                 Offset;
+  UINT32                 Begin;
+  UINT32                 End;
+  BOOLEAN                Stolen;
+
+  State    = (MM_PARALLEL_FOR_STATE *)Buffer;
+  OwnIndex = InterlockedIncrement (&State->NextDeque) - 1;
+
+  //
+  // There is one range per CPU, a worker without one has nothing to add.
+  //
+  if (OwnIndex < State->DequeCount) {
+    Own = &State->Deques[OwnIndex];
+    do {
+      while (PopFront (Own, State->GrainSize, &Begin, &End)) {
+        State->Body (State->Context, Begin, End);
+      }
+
+      //
+      // Only the owner refills its empty range and thieves leave empty ranges alone,
+      // so the stolen indices can be published with a plain store.
+      //
+      Stolen = FALSE;
+      for (Offset = 1; Offset < State->DequeCount; Offset++) {
+        if (StealBack (&State->Deques[(OwnIndex + Offset) % State->DequeCount], State->GrainSize, &Begin, &End)) {
+          Own->Range = PACK_RANGE (Begin, End);
+          Stolen = TRUE;
+          break;
+        }
+      }
+    } while (Stolen);
+  }
+
+  InterlockedIncrement (&State->ExitedWorkers);
+}
+
+/**
+  Run Body over the iteration space [0, Count) on all the CPUs in MM.
+
+  The iteration space is split evenly into one range per CPU. Each CPU consumes its own
+  range GrainSize indices at a time, and steals half of the remainder of another CPU once
+  its own range runs dry. The function returns after all the indices are consumed.
+
+  This function has to be called from the CPU running the MMI handlers. Only the calling
+  CPU takes part in the work if the APs cannot be started.
+
+  @param[in]  Count       Number of indices in the iteration space.
+  @param[in]  GrainSize   Maximal number of indices passed to one call of Body, zero
+                          lets the library choose.
+  @param[in]  Body        Loop body.
+  @param[in]  Context     Context passed to every call of Body.
+
+  @retval EFI_SUCCESS             All the indices are consumed by Body.
+  @retval EFI_INVALID_PARAMETER   Body is NULL, or Count or GrainSize exceed MAX_UINT32.
+  @retval EFI_OUT_OF_RESOURCES    Cannot allocate the scheduling state.
+**/
+EFI_STATUS
+EFIAPI
+MmParallelFor (
+  IN UINTN                 Count,
+  IN UINTN                 GrainSize,
+  IN MM_PARALLEL_FOR_BODY  Body,
+  IN VOID                  *Context OPTIONAL
+  )
+{
+  MM_PARALLEL_FOR_STATE  *State;
+  UINTN                  StateSize;
+  UINTN                  Pages;
+  UINT32                 DequeCount;
+  UINT32                 Index;
+  UINTN                  WorkerCount;
+
+  if ((Body == NULL) || (Count > MAX_UINT32) || (GrainSize > MAX_UINT32)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (Count == 0) {
+    return EFI_SUCCESS;
+  }
+
+  DequeCount = (UINT32)MIN (MAX (MmParallelForGetCpuCount (), 1), Count);
+  if (GrainSize == 0) {
+    GrainSize = MAX (Count / ((UINTN)DequeCount * MM_PARALLEL_FOR_AUTO_GRAIN_DIVISOR), 1);
+  }
+
+  //
+  // Pages keep the ranges cache line aligned.
+  //
+  StateSize = ALIGN_VALUE (sizeof (MM_PARALLEL_FOR_STATE), MM_PARALLEL_FOR_CACHE_LINE_SIZE);
+  Pages     = EFI_SIZE_TO_PAGES (StateSize + DequeCount * sizeof (MM_PARALLEL_FOR_DEQUE));
+  State     = AllocatePages (Pages);
+  if (State == NULL) {
+    DEBUG ((DEBUG_ERROR, "%a Failed to allocate the state of %d workers\n", __FUNCTION__, DequeCount));
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  State->Body          = Body;
+  State->Context       = Context;
+  State->GrainSize     = (UINT32)GrainSize;
+  State->DequeCount    = DequeCount;
+  State->Deques        = (MM_PARALLEL_FOR_DEQUE *)((UINTN)State + StateSize);
+  State->NextDeque     = 0;
+  State->ExitedWorkers = 0;
+  for (Index = 0; Index < DequeCount; Index++) {
+    State->Deques[Index].Range = PACK_RANGE (
+                                   DivU64x32 (MultU64x32 (Count, Index), DequeCount),
+                                   DivU64x32 (MultU64x32 (Count, Index + 1), DequeCount)
+                                   );
+  }
+
+  //
+  // The ranges of the CPUs that do not show up are stolen by the others, the calling CPU
+  // always takes part so that every index is consumed.
+  //
+  WorkerCount = 0;
+  if (DequeCount > 1) {
+    WorkerCount = MmParallelForStartWorkers (State);
+  }
+
+  MmParallelForWorker (State);
+
+  while (State->ExitedWorkers < WorkerCount + 1) {
+    CpuPause ();
+  }
+
+  FreePages (State, Pages);
+  return EFI_SUCCESS;
+}
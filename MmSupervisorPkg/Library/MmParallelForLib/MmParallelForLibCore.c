@@ -0,0 +1,66 @@
+/** @file
+  Starts the parallel-for workers of the MM supervisor.
+
+  Copyright (C) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <PiMm.h>
+
+#include <Library/MmParallelForLib.h>
+
+#include "MmParallelForLibInternal.h"
+
+//
+// This instance is linked into the MM supervisor core, whose system table is not published
+// through MmServicesTableLib.
+//
+extern EFI_MM_SYSTEM_TABLE  gMmCoreMmst;
+
+/**
+  Start MmParallelForWorker on the other CPUs gathered in the current MMI, without waiting
+  for them to finish.
+
+  The workers are started one AP at a time through MmStartupThisAp. When
+  PcdCpuSmmBlockStartupThisAp is set, each AP drains the whole loop before the next one
+  is started, so the loop effectively runs on one CPU.
+
+  @param[in]  State     Scheduling state to pass to the workers.
+
+  @return Number of workers started.
+**/
+UINTN
+MmParallelForStartWorkers (
+  IN MM_PARALLEL_FOR_STATE  *State
+  )
+{
+  UINTN  Index;
+  UINTN  WorkerCount;
+
+  WorkerCount = 0;
+  for (Index = 0; Index < gMmCoreMmst.NumberOfCpus; Index++) {
+    if (Index == gMmCoreMmst.CurrentlyExecutingCpu) {
+      continue;
+    }
+
+    if (!EFI_ERROR (gMmCoreMmst.MmStartupThisAp (MmParallelForWorker, Index, State))) {
+      WorkerCount++;
+    }
+  }
+
+  return WorkerCount;
+}
+
+/**
+  Number of CPUs that may take part in a parallel-for loop.
+
+  @return Number of CPUs.
+**/
+UINTN
+MmParallelForGetCpuCount (
+  VOID
+  )
+{
+  return gMmCoreMmst.NumberOfCpus;
+}
@@ -0,0 +1,79 @@
+/** @file
+  Internal definitions of the work-stealing parallel-for library.
+
+  Copyright (C) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef MM_PARALLEL_FOR_LIB_INTERNAL_H_
+#define MM_PARALLEL_FOR_LIB_INTERNAL_H_
+
+#define MM_PARALLEL_FOR_CACHE_LINE_SIZE  64
+
+//
+// Grain size picked when the caller passes zero, in fractions of the initial range of a CPU
+//
+#define MM_PARALLEL_FOR_AUTO_GRAIN_DIVISOR  8
+
+//
+// Remaining range of one worker. Begin is kept in the low 32 bits and End in the high 32 bits,
+// so that the owner and the thieves can both shrink it with a single compare-exchange. Each
+// range sits on its own cache line.
+//
+typedef struct {
+  volatile UINT64    Range;
+  UINT8              Reserved[MM_PARALLEL_FOR_CACHE_LINE_SIZE - sizeof (UINT64)];
+} MM_PARALLEL_FOR_DEQUE;
+
+//
+// Scheduling state shared by all the workers of one MmParallelFor call. It has to be accessible
+// from the privilege level the workers run at.
+//
+typedef struct {
+  MM_PARALLEL_FOR_BODY     Body;
+  VOID                     *Context;
+  UINT32                   GrainSize;
+  UINT32                   DequeCount;
+  MM_PARALLEL_FOR_DEQUE    *Deques;
+  volatile UINT32          NextDeque;
+  volatile UINT32          ExitedWorkers;
+} MM_PARALLEL_FOR_STATE;
+
+/**
+  Worker of a parallel-for loop, run by every participating CPU. It takes the next free
+  range, drains it, then steals from the other ranges until none is left.
+
+  @param[in, out]  Buffer    Pointer to the MM_PARALLEL_FOR_STATE.
+
+**/
+VOID
+EFIAPI
+MmParallelForWorker (
+  IN OUT VOID  *Buffer
+  );
+
+/**
+  Start MmParallelForWorker on the other CPUs gathered in the current MMI, without waiting
+  for them to finish.
+
+  @param[in]  State     Scheduling state to pass to the workers.
+
+  @return Number of workers started.
+**/
+UINTN
+MmParallelForStartWorkers (
+  IN MM_PARALLEL_FOR_STATE  *State
+  );
+
+/**
+  Number of CPUs that may take part in a parallel-for loop.
+
+  @return Number of CPUs.
+**/
+UINTN
+MmParallelForGetCpuCount (
+  VOID
+  );
+
+#endif // MM_PARALLEL_FOR_LIB_INTERNAL_H_
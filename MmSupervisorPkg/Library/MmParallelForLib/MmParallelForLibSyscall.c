@@ -0,0 +1,44 @@
+/** @file
+  Starts the parallel-for workers of user MM drivers through the MM supervisor.
+
+  Copyright (C) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <PiMm.h>
+
+#include <Library/MmParallelForLib.h>
+#include <Library/MmServicesTableLib.h>
+#include <Library/SysCallLib.h>
+
+#include "MmParallelForLibInternal.h"
+
+/**
+  Start MmParallelForWorker on the other CPUs gathered in the current MMI, without waiting
+  for them to finish. A single syscall starts a demoted worker on every present AP.
+
+  @param[in]  State     Scheduling state to pass to the workers.
+
+  @return Number of workers started.
+**/
+UINTN
+MmParallelForStartWorkers (
+  IN MM_PARALLEL_FOR_STATE  *State
+  )
+{
+  return (UINTN)SysCall (SMM_START_ALL_AP_PROC, (UINTN)MmParallelForWorker, (UINTN)State, 0);
+}
+
+/**
+  Number of CPUs that may take part in a parallel-for loop.
+
+  @return Number of CPUs.
+**/
+UINTN
+MmParallelForGetCpuCount (
+  VOID
+  )
+{
+  return gMmst->NumberOfCpus;
+}
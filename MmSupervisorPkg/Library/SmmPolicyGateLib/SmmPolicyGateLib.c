@@ -17,6 +17,223 @@
 #include <Library/SysCallLib.h>
 #include <Library/SafeIntLib.h>
 
+//
+// The policy gate is consumed by the syscall fast path, which does not preserve the
+// CPL3 FPU/SSE state. Keep this library free of vector register usage on the same
+// toolchains that enable the fast path in SyscallFastPath.c.
+//
+#if defined (__GNUC__) && !defined (__clang__) && (__GNUC__ >= 8)
+#pragma GCC target ("general-regs-only")
+#endif
+
+/**
+  Locate the policy root of a given descriptor type.
+
+  @param[in]  SmmSecurityPolicy - The address of applied SMM secure policy.
+  @param[in]  DescriptorType    - One of SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_*.
+
+  @retval Pointer to the matching policy root, NULL if not found.
+**/
+STATIC
+SMM_SUPV_POLICY_ROOT_V1 *
+FindPolicyRoot (
+  IN SMM_SUPV_SECURE_POLICY_DATA_V1_0  *SmmSecurityPolicy,
+  IN UINT32                            DescriptorType
+  )
+{
+  SMM_SUPV_POLICY_ROOT_V1  *PolicyRoot;
+  UINT32                   i;
+
+  PolicyRoot = (SMM_SUPV_POLICY_ROOT_V1 *)((UINTN)SmmSecurityPolicy + SmmSecurityPolicy->PolicyRootOffset);
+  for (i = 0; i < SmmSecurityPolicy->PolicyRootCount; i++) {
+    if (PolicyRoot[i].Type == DescriptorType) {
+      return &PolicyRoot[i];
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  Walk the IO descriptors of a policy root and look for the first entry covering
+  the requested access. This routine does not produce any debug output.
+
+  @param[in]  SmmSecurityPolicy - The address of applied SMM secure policy.
+  @param[in]  PolicyRoot        - The IO policy root.
+  @param[in]  IoAddress         - The address of the IO port.
+  @param[in]  IoSize            - The size of the requested access in bytes.
+  @param[in]  AccessMask        - One of SECURE_POLICY_RESOURCE_ATTR_READ or
+                                  SECURE_POLICY_RESOURCE_ATTR_WRITE.
+  @param[out] DescriptorIndex   - Index of the descriptor that terminated the walk,
+                                  PolicyRoot->Count if none did.
+
+  @retval TRUE      A covering descriptor has the requested access attribute set.
+  @retval FALSE     No covering descriptor has the requested access attribute set.
+**/
+STATIC
+BOOLEAN
+IoPolicyLookup (
+  IN  SMM_SUPV_SECURE_POLICY_DATA_V1_0  *SmmSecurityPolicy,
+  IN  SMM_SUPV_POLICY_ROOT_V1           *PolicyRoot,
+  IN  UINT32                            IoAddress,
+  IN  UINT32                            IoSize,
+  IN  UINT32                            AccessMask,
+  OUT UINT32                            *DescriptorIndex
+  )
+{
+  SMM_SUPV_SECURE_POLICY_IO_DESCRIPTOR_V1_0  *IoDescriptor;
+  BOOLEAN                                    FoundMatch;
+  UINT32                                     i;
+
+  FoundMatch   = FALSE;
+  IoDescriptor = (SMM_SUPV_SECURE_POLICY_IO_DESCRIPTOR_V1_0 *)((UINTN)SmmSecurityPolicy + PolicyRoot->Offset);
+  for (i = 0; i < PolicyRoot->Count; i++) {
+    //
+    // See if this IO request address is covered by the current Security
+    // Descriptor.
+    //
+    if ((IoDescriptor[i].Attributes & SECURE_POLICY_RESOURCE_ATTR_STRICT_WIDTH) &&
+        (IoAddress == (UINT32)IoDescriptor[i].IoAddress) &&
+        (IoSize == (UINT32)IoDescriptor[i].LengthOrWidth))
+    {
+      //
+      // We found an exactly matched policy for the address and size in question.
+      //
+      FoundMatch = ((IoDescriptor[i].Attributes & AccessMask) != 0);
+      break;
+    } else if (((IoDescriptor[i].Attributes & SECURE_POLICY_RESOURCE_ATTR_STRICT_WIDTH) == 0) &&
+               (((IoAddress >= (UINT32)IoDescriptor[i].IoAddress) &&
+                 (IoAddress < (UINT32)IoDescriptor[i].IoAddress + IoDescriptor[i].LengthOrWidth)) ||
+                ((IoAddress + (UINT32)IoSize > (UINT32)IoDescriptor[i].IoAddress) &&
+                 (IoAddress + (UINT32)IoSize <= (UINT32)IoDescriptor[i].IoAddress + IoDescriptor[i].LengthOrWidth))))
+    {
+      //
+      // We found a policy for the address in question.
+      //
+      FoundMatch = ((IoDescriptor[i].Attributes & AccessMask) != 0);
+      break;
+    }
+  }
+
+  *DescriptorIndex = i;
+  return FoundMatch;
+}
+
+/**
+  Walk the MSR descriptors of a policy root and look for the first entry covering
+  the requested access. This routine does not produce any debug output.
+
+  @param[in]  SmmSecurityPolicy - The address of applied SMM secure policy.
+  @param[in]  PolicyRoot        - The MSR policy root.
+  @param[in]  MsrAddress        - The address of the MSR.
+  @param[in]  AccessMask        - One of SECURE_POLICY_RESOURCE_ATTR_READ or
+                                  SECURE_POLICY_RESOURCE_ATTR_WRITE.
+  @param[out] DescriptorIndex   - Index of the descriptor that terminated the walk,
+                                  PolicyRoot->Count if none did.
+
+  @retval TRUE      A covering descriptor has the requested access attribute set.
+  @retval FALSE     No covering descriptor has the requested access attribute set.
+**/
+STATIC
+BOOLEAN
+MsrPolicyLookup (
+  IN  SMM_SUPV_SECURE_POLICY_DATA_V1_0  *SmmSecurityPolicy,
+  IN  SMM_SUPV_POLICY_ROOT_V1           *PolicyRoot,
+  IN  UINT32                            MsrAddress,
+  IN  UINT32                            AccessMask,
+  OUT UINT32                            *DescriptorIndex
+  )
+{
+  SMM_SUPV_SECURE_POLICY_MSR_DESCRIPTOR_V1_0  *MsrDescriptor;
+  BOOLEAN                                     FoundMatch;
+  UINT32                                      i;
+
+  FoundMatch    = FALSE;
+  MsrDescriptor = (SMM_SUPV_SECURE_POLICY_MSR_DESCRIPTOR_V1_0 *)((UINTN)SmmSecurityPolicy + PolicyRoot->Offset);
+  for (i = 0; i < PolicyRoot->Count; i++) {
+    //
+    // See if this request is in the current descriptor
+    //
+    if ((MsrAddress >= MsrDescriptor[i].MsrAddress) &&
+        (MsrAddress < MsrDescriptor[i].MsrAddress + MsrDescriptor[i].Length))
+    {
+      FoundMatch = ((MsrDescriptor[i].Attributes & AccessMask) != 0);
+      break;
+    }
+  }
+
+  *DescriptorIndex = i;
+  return FoundMatch;
+}
+
+/**
+  Walk the instruction descriptors of a policy root and look for the entry of
+  the requested instruction. This routine does not produce any debug output.
+
+  @param[in]  SmmSecurityPolicy - The address of applied SMM secure policy.
+  @param[in]  PolicyRoot        - The instruction policy root.
+  @param[in]  InstructionIndex  - The instruction index defined in
+                                  SECURE_POLICY_INSTRUCTION.
+  @param[out] DescriptorIndex   - Index of the descriptor that terminated the walk,
+                                  PolicyRoot->Count if none did.
+
+  @retval TRUE      The instruction descriptor has the execute attribute set.
+  @retval FALSE     No descriptor has the execute attribute set for this instruction.
+**/
+STATIC
+BOOLEAN
+InstructionPolicyLookup (
+  IN  SMM_SUPV_SECURE_POLICY_DATA_V1_0  *SmmSecurityPolicy,
+  IN  SMM_SUPV_POLICY_ROOT_V1           *PolicyRoot,
+  IN  UINT16                            InstructionIndex,
+  OUT UINT32                            *DescriptorIndex
+  )
+{
+  SMM_SUPV_SECURE_POLICY_INSTRUCTION_DESCRIPTOR_V1_0  *InstrDescriptor;
+  BOOLEAN                                             FoundMatch;
+  UINT32                                              i;
+
+  FoundMatch      = FALSE;
+  InstrDescriptor = (SMM_SUPV_SECURE_POLICY_INSTRUCTION_DESCRIPTOR_V1_0 *)((UINTN)SmmSecurityPolicy + PolicyRoot->Offset);
+  for (i = 0; i < PolicyRoot->Count; i++) {
+    //
+    // See if this request is in the current descriptor
+    //
+    if (InstructionIndex == InstrDescriptor[i].InstructionIndex) {
+      FoundMatch = ((InstrDescriptor[i].Attributes & SECURE_POLICY_RESOURCE_ATTR_EXECUTE) != 0);
+      break;
+    }
+  }
+
+  *DescriptorIndex = i;
+  return FoundMatch;
+}
+
+/**
+  Translate the result of a descriptor walk into an access verdict.
+
+  @param[in]  PolicyRoot        - The policy root that was walked.
+  @param[in]  FoundMatch        - Whether a descriptor with the requested attribute was found.
+
+  @retval TRUE      The access should be rejected.
+  @retval FALSE     The access should be granted.
+**/
+STATIC
+BOOLEAN
+IsAccessRejected (
+  IN SMM_SUPV_POLICY_ROOT_V1  *PolicyRoot,
+  IN BOOLEAN                  FoundMatch
+  )
+{
+  //
+  // We reject access based on:
+  // 1. found a matching policy, reject access if this is a deny list
+  // 2. did not find a matching policy, reject access if this is an allow list
+  //
+  return (FoundMatch && (PolicyRoot->AccessAttr == SMM_SUPV_ACCESS_ATTR_DENY)) ||
+         (!FoundMatch && (PolicyRoot->AccessAttr == SMM_SUPV_ACCESS_ATTR_ALLOW));
+}
+
 /**
   Given an IO port address and size, determine if the request is allowed by
   our policy.
@@ -45,13 +262,12 @@ IsIoReadWriteAllowed (
   IN UINT32                            AccessMask
   )
 {
-  EFI_STATUS                                 Status        = EFI_SUCCESS;
-  SMM_SUPV_SECURE_POLICY_IO_DESCRIPTOR_V1_0  *IoDescriptor = NULL;
-  SMM_SUPV_POLICY_ROOT_V1                    *PolicyRoot   = NULL;
-  UINT32                                     IoSize        = 0;
-  UINT32                                     i;
-  BOOLEAN                                    FoundMatch = FALSE;
-  UINT16                                     Dummy;
+  EFI_STATUS               Status      = EFI_SUCCESS;
+  SMM_SUPV_POLICY_ROOT_V1  *PolicyRoot = NULL;
+  UINT32                   IoSize      = 0;
+  UINT32                   i;
+  BOOLEAN                  FoundMatch;
+  UINT16                   Dummy;
 
   //
   // Check to ensure that only one of SECURE_POLICY_RESOURCE_ATTR_READ
@@ -100,77 +316,15 @@ IsIoReadWriteAllowed (
     goto Exit;
   }
 
-  PolicyRoot = (SMM_SUPV_POLICY_ROOT_V1 *)((UINTN)SmmSecurityPolicy + SmmSecurityPolicy->PolicyRootOffset);
-  for (i = 0; i < SmmSecurityPolicy->PolicyRootCount; i++) {
-    if (PolicyRoot[i].Type == SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_IO) {
-      PolicyRoot = &PolicyRoot[i];
-      break;
-    }
-  }
-
-  if (i >= SmmSecurityPolicy->PolicyRootCount) {
+  PolicyRoot = FindPolicyRoot (SmmSecurityPolicy, SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_IO);
+  if (PolicyRoot == NULL) {
     DEBUG ((DEBUG_WARN, "%a Could not find IO policy root, bail to be on the safe side.\n", __FUNCTION__));
     Status = EFI_ACCESS_DENIED;
     goto Exit;
   }
 
-  IoDescriptor = (SMM_SUPV_SECURE_POLICY_IO_DESCRIPTOR_V1_0 *)((UINTN)SmmSecurityPolicy + PolicyRoot->Offset);
-  for (i = 0; i < PolicyRoot->Count; i++) {
-    //
-    // See if this IO request address is covered by the current Security
-    // Descriptor.
-    //
-    if ((IoDescriptor[i].Attributes & SECURE_POLICY_RESOURCE_ATTR_STRICT_WIDTH) &&
-        (IoAddress == (UINT32)IoDescriptor[i].IoAddress) &&
-        (IoSize == (UINT32)IoDescriptor[i].LengthOrWidth))
-    {
-      //
-      // We found an exactly matched policy for the address and size in question.
-      //
-      if (IoDescriptor[i].Attributes & AccessMask) {
-        //
-        // Someone is trying to access something that matches policy.
-        //
-        DEBUG ((DEBUG_VERBOSE, "%a Strict width access matches an entry of Security Policy.\n", __FUNCTION__));
-        FoundMatch = TRUE;
-      }
-
-      //
-      // We are finished.
-      //
-      break;
-    } else if (((IoDescriptor[i].Attributes & SECURE_POLICY_RESOURCE_ATTR_STRICT_WIDTH) == 0) &&
-               (((IoAddress >= (UINT32)IoDescriptor[i].IoAddress) &&
-                 (IoAddress < (UINT32)IoDescriptor[i].IoAddress + IoDescriptor[i].LengthOrWidth)) ||
-                ((IoAddress + (UINT32)IoSize > (UINT32)IoDescriptor[i].IoAddress) &&
-                 (IoAddress + (UINT32)IoSize <= (UINT32)IoDescriptor[i].IoAddress + IoDescriptor[i].LengthOrWidth))))
-    {
-      //
-      // We found a policy for the address in question.
-      //
-      if (IoDescriptor[i].Attributes & AccessMask) {
-        //
-        // Someone is trying to access something that matches policy.
-        //
-        DEBUG ((DEBUG_VERBOSE, "%a Access matches an entry of the Security Policy.\n", __FUNCTION__));
-        FoundMatch = TRUE;
-      }
-
-      //
-      // We are finished.
-      //
-      break;
-    }
-  }
-
-  if ((FoundMatch && (PolicyRoot->AccessAttr == SMM_SUPV_ACCESS_ATTR_DENY)) ||
-      (!FoundMatch && (PolicyRoot->AccessAttr == SMM_SUPV_ACCESS_ATTR_ALLOW)))
-  {
-    //
-    // We reject access based on:
-    // 1. found a matching policy, reject access if this is a deny list
-    // 2. did not find a matching policy, reject access if this is an allow list
-    //
+  FoundMatch = IoPolicyLookup (SmmSecurityPolicy, PolicyRoot, IoAddress, IoSize, AccessMask, &i);
+  if (IsAccessRejected (PolicyRoot, FoundMatch)) {
     DEBUG ((
       DEBUG_ERROR,
       "%a Rejecting IO access based on policy walk through: Index: %d, AccessAttr: 0x%x.\n",
@@ -211,11 +365,10 @@ IsMsrReadWriteAllowed (
   IN UINT32                            AccessMask
   )
 {
-  EFI_STATUS                                  Status         = EFI_SUCCESS;
-  SMM_SUPV_SECURE_POLICY_MSR_DESCRIPTOR_V1_0  *MsrDescriptor = NULL;
-  SMM_SUPV_POLICY_ROOT_V1                     *PolicyRoot    = NULL;
-  UINT32                                      i;
-  BOOLEAN                                     FoundMatch = FALSE;
+  EFI_STATUS               Status      = EFI_SUCCESS;
+  SMM_SUPV_POLICY_ROOT_V1  *PolicyRoot = NULL;
+  UINT32                   i;
+  BOOLEAN                  FoundMatch;
 
   //
   // Check to ensure that only one of SECURE_POLICY_RESOURCE_ATTR_READ
@@ -229,54 +382,15 @@ IsMsrReadWriteAllowed (
     goto Exit;
   }
 
-  PolicyRoot = (SMM_SUPV_POLICY_ROOT_V1 *)((UINTN)SmmSecurityPolicy + SmmSecurityPolicy->PolicyRootOffset);
-  for (i = 0; i < SmmSecurityPolicy->PolicyRootCount; i++) {
-    if (PolicyRoot[i].Type == SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_MSR) {
-      PolicyRoot = &PolicyRoot[i];
-      break;
-    }
-  }
-
-  if (i >= SmmSecurityPolicy->PolicyRootCount) {
+  PolicyRoot = FindPolicyRoot (SmmSecurityPolicy, SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_MSR);
+  if (PolicyRoot == NULL) {
     DEBUG ((DEBUG_WARN, "%a Could not find MSR policy root, bail to be on the safe side.\n", __FUNCTION__));
     Status = EFI_ACCESS_DENIED;
     goto Exit;
   }
 
-  MsrDescriptor = (SMM_SUPV_SECURE_POLICY_MSR_DESCRIPTOR_V1_0 *)((UINTN)SmmSecurityPolicy + PolicyRoot->Offset);
-  for (i = 0; i < PolicyRoot->Count; i++) {
-    //
-    // See if this request is in the current descriptor
-    //
-    if ((MsrAddress >= MsrDescriptor[i].MsrAddress) &&
-        (MsrAddress < MsrDescriptor[i].MsrAddress + MsrDescriptor[i].Length))
-    {
-      //
-      // We found a policy for the address in question.
-      //
-      if (MsrDescriptor[i].Attributes & AccessMask) {
-        //
-        // Someone is trying to access something that matches policy.
-        //
-        DEBUG ((DEBUG_VERBOSE, "%a Access matches an entry of the Security Policy\n", __FUNCTION__));
-        FoundMatch = TRUE;
-      }
-
-      //
-      // We are finished.
-      //
-      break;
-    }
-  }
-
-  if ((FoundMatch && (PolicyRoot->AccessAttr == SMM_SUPV_ACCESS_ATTR_DENY)) ||
-      (!FoundMatch && (PolicyRoot->AccessAttr == SMM_SUPV_ACCESS_ATTR_ALLOW)))
-  {
-    //
-    // We reject access based on:
-    // 1. found a matching policy, reject access if this is a deny list
-    // 2. did not find a matching policy, reject access if this is an allow list
-    //
+  FoundMatch = MsrPolicyLookup (SmmSecurityPolicy, PolicyRoot, MsrAddress, AccessMask, &i);
+  if (IsAccessRejected (PolicyRoot, FoundMatch)) {
     DEBUG ((
       DEBUG_ERROR,
       "%a Rejecting MSR access based on policy walk through: Index: %d, AccessAttr: 0x%x.\n",
@@ -313,11 +427,10 @@ IsInstructionExecutionAllowed (
   IN UINT16                            InstructionIndex
   )
 {
-  EFI_STATUS                                          Status           = EFI_SUCCESS;
-  SMM_SUPV_SECURE_POLICY_INSTRUCTION_DESCRIPTOR_V1_0  *InstrDescriptor = NULL;
-  SMM_SUPV_POLICY_ROOT_V1                             *PolicyRoot      = NULL;
-  UINT32                                              i;
-  BOOLEAN                                             FoundMatch = FALSE;
+  EFI_STATUS               Status      = EFI_SUCCESS;
+  SMM_SUPV_POLICY_ROOT_V1  *PolicyRoot = NULL;
+  UINT32                   i;
+  BOOLEAN                  FoundMatch;
 
   //
   // Check to ensure that only one of SECURE_POLICY_INSTRUCTION was requested.
@@ -328,52 +441,15 @@ IsInstructionExecutionAllowed (
     goto Exit;
   }
 
-  PolicyRoot = (SMM_SUPV_POLICY_ROOT_V1 *)((UINTN)SmmSecurityPolicy + SmmSecurityPolicy->PolicyRootOffset);
-  for (i = 0; i < SmmSecurityPolicy->PolicyRootCount; i++) {
-    if (PolicyRoot[i].Type == SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_INSTRUCTION) {
-      PolicyRoot = &PolicyRoot[i];
-      break;
-    }
-  }
-
-  if (i >= SmmSecurityPolicy->PolicyRootCount) {
+  PolicyRoot = FindPolicyRoot (SmmSecurityPolicy, SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_INSTRUCTION);
+  if (PolicyRoot == NULL) {
     DEBUG ((DEBUG_WARN, "%a Could not find Instruction policy root, bail to be on the safe side.\n", __FUNCTION__));
     Status = EFI_ACCESS_DENIED;
     goto Exit;
   }
 
-  InstrDescriptor = (SMM_SUPV_SECURE_POLICY_INSTRUCTION_DESCRIPTOR_V1_0 *)((UINTN)SmmSecurityPolicy + PolicyRoot->Offset);
-  for (i = 0; i < PolicyRoot->Count; i++) {
-    //
-    // See if this request is in the current descriptor
-    //
-    if (InstructionIndex == InstrDescriptor[i].InstructionIndex) {
-      //
-      // We found a policy for the instruction specified.
-      //
-      if (InstrDescriptor[i].Attributes & SECURE_POLICY_RESOURCE_ATTR_EXECUTE) {
-        //
-        // Requested instruction found in policy execution is prohibited.
-        //
-        DEBUG ((DEBUG_INFO, "%a Execution matches an entry of the Security Policy\n", __FUNCTION__));
-        FoundMatch = TRUE;
-      }
-
-      //
-      // We are finished.
-      //
-      break;
-    }
-  }
-
-  if ((FoundMatch && (PolicyRoot->AccessAttr == SMM_SUPV_ACCESS_ATTR_DENY)) ||
-      (!FoundMatch && (PolicyRoot->AccessAttr == SMM_SUPV_ACCESS_ATTR_ALLOW)))
-  {
-    //
-    // We reject access based on:
-    // 1. found a matching policy, reject access if this is a deny list
-    // 2. did not find a matching policy, reject access if this is an allow list
-    //
+  FoundMatch = InstructionPolicyLookup (SmmSecurityPolicy, PolicyRoot, InstructionIndex, &i);
+  if (IsAccessRejected (PolicyRoot, FoundMatch)) {
     DEBUG ((
       DEBUG_ERROR,
       "%a Rejecting Instruction access based on policy walk through: Index: %d, AccessAttr: 0x%x.\n",
@@ -388,6 +464,116 @@ Exit:
   return Status;
 }
 
+/**
+  Evaluate an IO, MSR or instruction request against the policy without emitting
+  any debug output. The verdict is identical to the one of IsIoReadWriteAllowed,
+  IsMsrReadWriteAllowed and IsInstructionExecutionAllowed, which makes this routine
+  suitable for paths that must not reach into the debug infrastructure, i.e. the
+  syscall fast path. Callers are expected to re-run the verbose interface on
+  rejection if a diagnostic message is desired.
+
+  @param[in]  SmmSecurityPolicy - The address of applied SMM secure policy.
+  @param[in]  DescriptorType    - SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_IO,
+                                  SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_MSR or
+                                  SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_INSTRUCTION.
+  @param[in]  Target            - The IO port, MSR address or the instruction index
+                                  defined in SECURE_POLICY_INSTRUCTION.
+  @param[in]  IoWidth           - The EFI_MM_IO_WIDTH of an IO request, ignored otherwise.
+  @param[in]  AccessMask        - One of SECURE_POLICY_RESOURCE_ATTR_READ or
+                                  SECURE_POLICY_RESOURCE_ATTR_WRITE, ignored for
+                                  instruction requests.
+  @param[out] DescriptorIndex   - Optional, index of the descriptor that decided the
+                                  verdict, or the descriptor count if none matched.
+
+  @retval EFI_ACCESS_DENIED     The requested operation is not allowed by the policy.
+          EFI_INVALID_PARAMETER The request is malformed.
+          EFI_SUCCESS           The requested operation is allowed by the policy.
+**/
+EFI_STATUS
+EFIAPI
+EvaluatePolicyAccess (
+  IN  SMM_SUPV_SECURE_POLICY_DATA_V1_0  *SmmSecurityPolicy,
+  IN  UINT32                            DescriptorType,
+  IN  UINT32                            Target,
+  IN  EFI_MM_IO_WIDTH                   IoWidth,
+  IN  UINT32                            AccessMask,
+  OUT UINT32                            *DescriptorIndex OPTIONAL
+  )
+{
+  SMM_SUPV_POLICY_ROOT_V1  *PolicyRoot;
+  UINT32                   IoSize;
+  UINT32                   Index;
+  BOOLEAN                  FoundMatch;
+
+  Index = 0;
+  if (DescriptorIndex != NULL) {
+    *DescriptorIndex = 0;
+  }
+
+  if (SmmSecurityPolicy == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if ((DescriptorType != SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_INSTRUCTION) &&
+      ((AccessMask & SECURE_POLICY_RESOURCE_ATTR_READ) != SECURE_POLICY_RESOURCE_ATTR_READ) &&
+      ((AccessMask & SECURE_POLICY_RESOURCE_ATTR_WRITE) != SECURE_POLICY_RESOURCE_ATTR_WRITE))
+  {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  PolicyRoot = FindPolicyRoot (SmmSecurityPolicy, DescriptorType);
+
+  switch (DescriptorType) {
+    case SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_IO:
+      if (IoWidth == MM_IO_UINT8) {
+        IoSize = sizeof (UINT8);
+      } else if (IoWidth == MM_IO_UINT16) {
+        IoSize = sizeof (UINT16);
+      } else if (IoWidth == MM_IO_UINT32) {
+        IoSize = sizeof (UINT32);
+      } else {
+        return EFI_INVALID_PARAMETER;
+      }
+
+      if ((Target > MAX_UINT16) || (Target + IoSize > MAX_UINT16 + 1)) {
+        return EFI_INVALID_PARAMETER;
+      }
+
+      if (PolicyRoot == NULL) {
+        return EFI_ACCESS_DENIED;
+      }
+
+      FoundMatch = IoPolicyLookup (SmmSecurityPolicy, PolicyRoot, Target, IoSize, AccessMask, &Index);
+      break;
+    case SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_MSR:
+      if (PolicyRoot == NULL) {
+        return EFI_ACCESS_DENIED;
+      }
+
+      FoundMatch = MsrPolicyLookup (SmmSecurityPolicy, PolicyRoot, Target, AccessMask, &Index);
+      break;
+    case SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_INSTRUCTION:
+      if (Target >= SECURE_POLICY_INSTRUCTION_COUNT) {
+        return EFI_INVALID_PARAMETER;
+      }
+
+      if (PolicyRoot == NULL) {
+        return EFI_ACCESS_DENIED;
+      }
+
+      FoundMatch = InstructionPolicyLookup (SmmSecurityPolicy, PolicyRoot, (UINT16)Target, &Index);
+      break;
+    default:
+      return EFI_INVALID_PARAMETER;
+  }
+
+  if (DescriptorIndex != NULL) {
+    *DescriptorIndex = Index;
+  }
+
+  return IsAccessRejected (PolicyRoot, FoundMatch) ? EFI_ACCESS_DENIED : EFI_SUCCESS;
+}
+
 /**
   Given a save state index defined in SECURE_POLICY_SVST, determine if it is
   within policy to allow execution.
@@ -0,0 +1,1063 @@
+/** @file
+  Differential fuzz tests and lookup benchmark of the instance in MmSupervisorPkg
+  of the SmmPolicyGateLib class.
+
+  Randomized policies are evaluated through both the quiet and the verbose gate
+  interfaces and compared against a plain reference model of the policy format.
+  The reference model deliberately follows the descriptor layout as written, so
+  that any change of verdict or of the deciding descriptor introduced by gate
+  optimizations is caught here.
+
+  The fuzzing seed can be supplied as the first command line argument to
+  reproduce a reported failure.
+
+  Copyright (C) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <time.h>
+#include <cmocka.h>
+
+#include <Uefi.h>
+#include <SmmSecurePolicy.h>
+#include <Protocol/MmCpuIo.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#include <Library/UnitTestLib.h>
+#include <Library/SmmPolicyGateLib.h>
+
+#define UNIT_TEST_APP_NAME     "SmmPolicyGateLib Fuzz and Benchmark Tests"
+#define UNIT_TEST_APP_VERSION  "1.0"
+
+#define FUZZ_DEFAULT_SEED          0x5EC0DE5EED5EC0DEULL
+#define FUZZ_POLICY_COUNT          256
+#define FUZZ_MAX_DESCRIPTOR_COUNT  64
+#define FUZZ_REQUESTS_PER_POLICY   2048
+#define FUZZ_LARGE_REQUEST_COUNT   65536
+// The verbose interfaces print on every rejection, only cross check them periodically
+#define FUZZ_VERBOSE_CHECK_INTERVAL  64
+
+// Sized after production policies with generous headroom
+#define BENCH_IO_DESCRIPTOR_COUNT   2048
+#define BENCH_MSR_DESCRIPTOR_COUNT  4096
+#define BENCH_REQUEST_POOL_SIZE     4096
+#define BENCH_LOOKUP_COUNT          (1024 * 1024)
+
+// Policy roots of the generated policies
+#define FUZZ_ROOT_COUNT  4
+
+// Sentinel of no descriptor decision, only used by the reference model
+#define REFERENCE_NO_DESCRIPTOR  MAX_UINT32
+
+typedef struct {
+  UINT32    DescriptorType;
+  UINT32    Target;
+  UINT32    IoWidth;
+  UINT32    AccessMask;
+} FUZZ_REQUEST;
+
+typedef struct {
+  UINT32    Type;
+  UINT32    Count;
+  UINT8     AccessAttr;
+  UINT32    DescriptorSize;
+} FUZZ_ROOT_LAYOUT;
+
+typedef struct {
+  SMM_SUPV_SECURE_POLICY_DATA_V1_0    *Policy;
+  FUZZ_REQUEST                        *Requests;
+} TEST_CONTEXT_FUZZ;
+
+STATIC UINT64  mFuzzSeed = FUZZ_DEFAULT_SEED;
+STATIC UINT64  mRandomState;
+
+STATIC CONST UINT32  mFuzzAccessMasks[] = {
+  0,
+  SECURE_POLICY_RESOURCE_ATTR_READ,
+  SECURE_POLICY_RESOURCE_ATTR_WRITE,
+  SECURE_POLICY_RESOURCE_ATTR_READ | SECURE_POLICY_RESOURCE_ATTR_WRITE
+};
+
+// Representative ranges of architectural and model specific MSRs
+STATIC CONST UINT32  mFuzzMsrBases[] = {
+  0x00000000,
+  0x00000800,
+  0xC0000080,
+  0xC0010000,
+  0xC0011000
+};
+
+/**
+  Get the next pseudo random number, the sequence only depends on the seed.
+
+  @return 64-bit pseudo random number.
+**/
+STATIC
+UINT64
+NextRandom (
+  VOID
+  )
+{
+  mRandomState ^= mRandomState >> 12;
+  mRandomState ^= mRandomState << 25;
+  mRandomState ^= mRandomState >> 27;
+  return mRandomState * 0x2545F4914F6CDD1DULL;
+}
+
+/**
+  Get a pseudo random number in [0, Bound).
+
+  @param[in]  Bound   Exclusive upper bound, must not be 0.
+
+  @return Pseudo random number below Bound.
+**/
+STATIC
+UINT32
+RandomBelow (
+  IN UINT32  Bound
+  )
+{
+  return (UINT32)(NextRandom () % Bound);
+}
+
+/**
+  Pick a pseudo random MSR address close to one of the representative MSR ranges.
+
+  @return MSR address.
+**/
+STATIC
+UINT32
+RandomMsrAddress (
+  VOID
+  )
+{
+  return mFuzzMsrBases[RandomBelow (ARRAY_SIZE (mFuzzMsrBases))] + RandomBelow (0x400);
+}
+
+/**
+  Allocate a policy with one policy root per descriptor type and fill in the roots.
+  Descriptors are left zeroed for the caller to populate.
+
+  @param[in]  IoCount       Number of IO descriptors, MAX_UINT32 to omit the IO root.
+  @param[in]  MsrCount      Number of MSR descriptors, MAX_UINT32 to omit the MSR root.
+  @param[in]  InsCount      Number of instruction descriptors, MAX_UINT32 to omit the root.
+  @param[in]  IoAttr        AccessAttr of the IO root.
+  @param[in]  MsrAttr       AccessAttr of the MSR root.
+  @param[in]  InsAttr       AccessAttr of the instruction root.
+
+  @return The allocated policy, NULL if out of resources.
+**/
+STATIC
+SMM_SUPV_SECURE_POLICY_DATA_V1_0 *
+AllocateFuzzPolicy (
+  IN UINT32  IoCount,
+  IN UINT32  MsrCount,
+  IN UINT32  InsCount,
+  IN UINT8   IoAttr,
+  IN UINT8   MsrAttr,
+  IN UINT8   InsAttr
+  )
+{
+  SMM_SUPV_SECURE_POLICY_DATA_V1_0  *Policy;
+  SMM_SUPV_POLICY_ROOT_V1           *Roots;
+  FUZZ_ROOT_LAYOUT                  Layouts[FUZZ_ROOT_COUNT];
+  FUZZ_ROOT_LAYOUT                  Swap;
+  UINT32                            PolicySize;
+  UINT32                            Offset;
+  UINT32                            RootCount;
+  UINT32                            Index;
+  UINT32                            Other;
+
+  // An empty legacy memory root in front makes the gate skip over unrelated roots
+  Layouts[0].Type           = SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_MEM;
+  Layouts[0].Count          = 0;
+  Layouts[0].AccessAttr     = SMM_SUPV_ACCESS_ATTR_ALLOW;
+  Layouts[0].DescriptorSize = sizeof (SMM_SUPV_SECURE_POLICY_MEM_DESCRIPTOR_V1_0);
+  RootCount                 = 1;
+
+  if (IoCount != MAX_UINT32) {
+    Layouts[RootCount].Type           = SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_IO;
+    Layouts[RootCount].Count          = IoCount;
+    Layouts[RootCount].AccessAttr     = IoAttr;
+    Layouts[RootCount].DescriptorSize = sizeof (SMM_SUPV_SECURE_POLICY_IO_DESCRIPTOR_V1_0);
+    RootCount++;
+  }
+
+  if (MsrCount != MAX_UINT32) {
+    Layouts[RootCount].Type           = SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_MSR;
+    Layouts[RootCount].Count          = MsrCount;
+    Layouts[RootCount].AccessAttr     = MsrAttr;
+    Layouts[RootCount].DescriptorSize = sizeof (SMM_SUPV_SECURE_POLICY_MSR_DESCRIPTOR_V1_0);
+    RootCount++;
+  }
+
+  if (InsCount != MAX_UINT32) {
+    Layouts[RootCount].Type           = SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_INSTRUCTION;
+    Layouts[RootCount].Count          = InsCount;
+    Layouts[RootCount].AccessAttr     = InsAttr;
+    Layouts[RootCount].DescriptorSize = sizeof (SMM_SUPV_SECURE_POLICY_INSTRUCTION_DESCRIPTOR_V1_0);
+    RootCount++;
+  }
+
+  // The gate must not depend on the order of policy roots
+  for (Index = RootCount - 1; Index > 0; Index--) {
+    Other = RandomBelow (Index + 1);
+    CopyMem (&Swap, &Layouts[Index], sizeof (Swap));
+    CopyMem (&Layouts[Index], &Layouts[Other], sizeof (Swap));
+    CopyMem (&Layouts[Other], &Swap, sizeof (Swap));
+  }
+
+  PolicySize = sizeof (SMM_SUPV_SECURE_POLICY_DATA_V1_0) + RootCount * sizeof (SMM_SUPV_POLICY_ROOT_V1);
+  for (Index = 0; Index < RootCount; Index++) {
+    PolicySize += Layouts[Index].Count * Layouts[Index].DescriptorSize;
+  }
+
+  Policy = AllocateZeroPool (PolicySize);
+  if (Policy == NULL) {
+    return NULL;
+  }
+
+  Policy->VersionMinor     = 0x0000;
+  Policy->VersionMajor     = 0x0001;
+  Policy->Size             = PolicySize;
+  Policy->PolicyRootOffset = sizeof (SMM_SUPV_SECURE_POLICY_DATA_V1_0);
+  Policy->PolicyRootCount  = RootCount;
+
+  Roots  = (SMM_SUPV_POLICY_ROOT_V1 *)(Policy + 1);
+  Offset = sizeof (SMM_SUPV_SECURE_POLICY_DATA_V1_0) + RootCount * sizeof (SMM_SUPV_POLICY_ROOT_V1);
+  for (Index = 0; Index < RootCount; Index++) {
+    Roots[Index].Version        = 1;
+    Roots[Index].PolicyRootSize = sizeof (SMM_SUPV_POLICY_ROOT_V1);
+    Roots[Index].Type           = Layouts[Index].Type;
+    Roots[Index].Offset         = Offset;
+    Roots[Index].Count          = Layouts[Index].Count;
+    Roots[Index].AccessAttr     = Layouts[Index].AccessAttr;
+    Offset                     += Layouts[Index].Count * Layouts[Index].DescriptorSize;
+  }
+
+  return Policy;
+}
+
+/**
+  Locate the policy root of a given type, reference model.
+
+  @param[in]  Policy          The policy to search.
+  @param[in]  DescriptorType  One of SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_*.
+
+  @return The first policy root of DescriptorType, NULL if none.
+**/
+STATIC
+SMM_SUPV_POLICY_ROOT_V1 *
+ReferenceFindRoot (
+  IN SMM_SUPV_SECURE_POLICY_DATA_V1_0  *Policy,
+  IN UINT32                            DescriptorType
+  )
+{
+  SMM_SUPV_POLICY_ROOT_V1  *Roots;
+  UINT32                   Index;
+
+  Roots = (SMM_SUPV_POLICY_ROOT_V1 *)((UINT8 *)Policy + Policy->PolicyRootOffset);
+  for (Index = 0; Index < Policy->PolicyRootCount; Index++) {
+    if (Roots[Index].Type == DescriptorType) {
+      return &Roots[Index];
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  Get the descriptor of a policy root, reference model.
+
+  @param[in]  Policy          The policy that owns the root.
+  @param[in]  Root            The policy root.
+  @param[in]  DescriptorSize  Size of one descriptor of this root.
+  @param[in]  Index           Index of the descriptor.
+
+  @return Pointer to the descriptor.
+**/
+STATIC
+VOID *
+ReferenceDescriptor (
+  IN SMM_SUPV_SECURE_POLICY_DATA_V1_0  *Policy,
+  IN SMM_SUPV_POLICY_ROOT_V1           *Root,
+  IN UINTN                             DescriptorSize,
+  IN UINT32                            Index
+  )
+{
+  return (UINT8 *)Policy + Root->Offset + Index * DescriptorSize;
+}
+
+/**
+  Evaluate one request against the policy with the reference model. The model
+  follows the policy format definition: the first descriptor covering the request
+  decides whether the requested attribute is listed, the policy root decides
+  whether listed means allowed or denied.
+
+  Strict width IO descriptors only cover requests of the same port and width.
+  Other IO descriptors cover requests whose first or last port is within range.
+
+  @param[in]  Policy          The policy to evaluate against.
+  @param[in]  Request         The request to evaluate.
+  @param[out] DescriptorIndex Index of the deciding descriptor, descriptor count if
+                              no descriptor covers the request, 0 if no walk was done.
+
+  @return The expected verdict of the gate.
+**/
+STATIC
+EFI_STATUS
+ReferencePolicyAccess (
+  IN  SMM_SUPV_SECURE_POLICY_DATA_V1_0  *Policy,
+  IN  CONST FUZZ_REQUEST                *Request,
+  OUT UINT32                            *DescriptorIndex
+  )
+{
+  SMM_SUPV_POLICY_ROOT_V1                             *Root;
+  SMM_SUPV_SECURE_POLICY_IO_DESCRIPTOR_V1_0           *Io;
+  SMM_SUPV_SECURE_POLICY_MSR_DESCRIPTOR_V1_0          *Msr;
+  SMM_SUPV_SECURE_POLICY_INSTRUCTION_DESCRIPTOR_V1_0  *Ins;
+  UINT64                                              First;
+  UINT64                                              Last;
+  UINT64                                              End;
+  UINT32                                              Size;
+  UINT32                                              Index;
+  UINT32                                              Decided;
+  BOOLEAN                                             Listed;
+
+  *DescriptorIndex = 0;
+  Root             = NULL;
+
+  if ((Request->DescriptorType != SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_INSTRUCTION) &&
+      ((Request->AccessMask & (SECURE_POLICY_RESOURCE_ATTR_READ | SECURE_POLICY_RESOURCE_ATTR_WRITE)) == 0))
+  {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Decided = REFERENCE_NO_DESCRIPTOR;
+  Listed  = FALSE;
+
+  switch (Request->DescriptorType) {
+    case SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_IO:
+      switch (Request->IoWidth) {
+        case MM_IO_UINT8:
+          Size = 1;
+          break;
+        case MM_IO_UINT16:
+          Size = 2;
+          break;
+        case MM_IO_UINT32:
+          Size = 4;
+          break;
+        default:
+          return EFI_INVALID_PARAMETER;
+      }
+
+      First = Request->Target;
+      Last  = First + Size - 1;
+      if (Last > MAX_UINT16) {
+        return EFI_INVALID_PARAMETER;
+      }
+
+      Root = ReferenceFindRoot (Policy, Request->DescriptorType);
+      if (Root == NULL) {
+        return EFI_ACCESS_DENIED;
+      }
+
+      for (Index = 0; Index < Root->Count && Decided == REFERENCE_NO_DESCRIPTOR; Index++) {
+        Io  = ReferenceDescriptor (Policy, Root, sizeof (*Io), Index);
+        End = (UINT64)Io->IoAddress + Io->LengthOrWidth;
+        if ((Io->Attributes & SECURE_POLICY_RESOURCE_ATTR_STRICT_WIDTH) != 0) {
+          if ((First == Io->IoAddress) && (Size == Io->LengthOrWidth)) {
+            Decided = Index;
+          }
+        } else if (((First >= Io->IoAddress) && (First < End)) || ((Last >= Io->IoAddress) && (Last < End))) {
+          Decided = Index;
+        }
+
+        if (Decided != REFERENCE_NO_DESCRIPTOR) {
+          Listed = (Io->Attributes & Request->AccessMask) != 0;
+        }
+      }
+
+      break;
+
+    case SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_MSR:
+      Root = ReferenceFindRoot (Policy, Request->DescriptorType);
+      if (Root == NULL) {
+        return EFI_ACCESS_DENIED;
+      }
+
+      for (Index = 0; Index < Root->Count && Decided == REFERENCE_NO_DESCRIPTOR; Index++) {
+        Msr = ReferenceDescriptor (Policy, Root, sizeof (*Msr), Index);
+        if ((Request->Target >= Msr->MsrAddress) && ((UINT64)Request->Target < (UINT64)Msr->MsrAddress + Msr->Length)) {
+          Decided = Index;
+          Listed  = (Msr->Attributes & Request->AccessMask) != 0;
+        }
+      }
+
+      break;
+
+    case SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_INSTRUCTION:
+      if (Request->Target >= SECURE_POLICY_INSTRUCTION_COUNT) {
+        return EFI_INVALID_PARAMETER;
+      }
+
+      Root = ReferenceFindRoot (Policy, Request->DescriptorType);
+      if (Root == NULL) {
+        return EFI_ACCESS_DENIED;
+      }
+
+      for (Index = 0; Index < Root->Count && Decided == REFERENCE_NO_DESCRIPTOR; Index++) {
+        Ins = ReferenceDescriptor (Policy, Root, sizeof (*Ins), Index);
+        if (Ins->InstructionIndex == Request->Target) {
+          Decided = Index;
+          Listed  = (Ins->Attributes & SECURE_POLICY_RESOURCE_ATTR_EXECUTE) != 0;
+        }
+      }
+
+      break;
+
+    default:
+      return EFI_INVALID_PARAMETER;
+  }
+
+  *DescriptorIndex = (Decided == REFERENCE_NO_DESCRIPTOR) ? Root->Count : Decided;
+
+  if (Root->AccessAttr == SMM_SUPV_ACCESS_ATTR_ALLOW) {
+    return Listed ? EFI_SUCCESS : EFI_ACCESS_DENIED;
+  }
+
+  return Listed ? EFI_ACCESS_DENIED : EFI_SUCCESS;
+}
+
+/**
+  Fill the descriptors of a fuzz policy with random content.
+
+  @param[in]  Policy    The policy allocated by AllocateFuzzPolicy.
+**/
+STATIC
+VOID
+RandomizePolicyDescriptors (
+  IN SMM_SUPV_SECURE_POLICY_DATA_V1_0  *Policy
+  )
+{
+  SMM_SUPV_POLICY_ROOT_V1                             *Root;
+  SMM_SUPV_SECURE_POLICY_IO_DESCRIPTOR_V1_0           *Io;
+  SMM_SUPV_SECURE_POLICY_MSR_DESCRIPTOR_V1_0          *Msr;
+  SMM_SUPV_SECURE_POLICY_INSTRUCTION_DESCRIPTOR_V1_0  *Ins;
+  STATIC CONST UINT16                                 IoWidths[] = { 1, 2, 4 };
+  UINT32                                              Index;
+
+  Root = ReferenceFindRoot (Policy, SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_IO);
+  for (Index = 0; (Root != NULL) && (Index < Root->Count); Index++) {
+    Io             = ReferenceDescriptor (Policy, Root, sizeof (*Io), Index);
+    Io->Attributes = (UINT16)RandomBelow (SECURE_POLICY_RESOURCE_ATTR_WRITE << 1);
+    if (RandomBelow (4) == 0) {
+      // Strict width entries, including ones touching the top of the IO space
+      Io->Attributes   |= SECURE_POLICY_RESOURCE_ATTR_STRICT_WIDTH;
+      Io->LengthOrWidth = IoWidths[RandomBelow (ARRAY_SIZE (IoWidths))];
+      Io->IoAddress     = (RandomBelow (8) == 0) ? (UINT16)(0x10000 - Io->LengthOrWidth) : (UINT16)RandomBelow (0x1000);
+    } else {
+      Io->LengthOrWidth = (RandomBelow (8) == 0) ? (UINT16)RandomBelow (0x400) : (UINT16)(1 + RandomBelow (16));
+      Io->IoAddress     = (UINT16)RandomBelow (0x1000);
+    }
+  }
+
+  Root = ReferenceFindRoot (Policy, SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_MSR);
+  for (Index = 0; (Root != NULL) && (Index < Root->Count); Index++) {
+    Msr             = ReferenceDescriptor (Policy, Root, sizeof (*Msr), Index);
+    Msr->Attributes = (UINT16)RandomBelow (SECURE_POLICY_RESOURCE_ATTR_WRITE << 1);
+    Msr->MsrAddress = RandomMsrAddress ();
+    Msr->Length     = (RandomBelow (8) == 0) ? (UINT16)RandomBelow (0x200) : (UINT16)(1 + RandomBelow (8));
+  }
+
+  Root = ReferenceFindRoot (Policy, SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_INSTRUCTION);
+  for (Index = 0; (Root != NULL) && (Index < Root->Count); Index++) {
+    Ins                   = ReferenceDescriptor (Policy, Root, sizeof (*Ins), Index);
+    Ins->InstructionIndex = (UINT16)RandomBelow (SECURE_POLICY_INSTRUCTION_COUNT + 1);
+    Ins->Attributes       = (RandomBelow (4) == 0) ? 0 : SECURE_POLICY_RESOURCE_ATTR_EXECUTE;
+  }
+}
+
+/**
+  Generate a random request, biased towards the boundaries of the policy descriptors.
+
+  @param[in]  Policy    The policy the request will be evaluated against.
+  @param[out] Request   The generated request.
+**/
+STATIC
+VOID
+RandomizeRequest (
+  IN  SMM_SUPV_SECURE_POLICY_DATA_V1_0  *Policy,
+  OUT FUZZ_REQUEST                      *Request
+  )
+{
+  SMM_SUPV_POLICY_ROOT_V1                     *Root;
+  SMM_SUPV_SECURE_POLICY_IO_DESCRIPTOR_V1_0   *Io;
+  SMM_SUPV_SECURE_POLICY_MSR_DESCRIPTOR_V1_0  *Msr;
+  UINT32                                      Pick;
+
+  Pick                = RandomBelow (16);
+  Request->AccessMask = mFuzzAccessMasks[RandomBelow (ARRAY_SIZE (mFuzzAccessMasks))];
+  Request->IoWidth    = RandomBelow (MM_IO_UINT64 + 1);
+
+  if (Pick < 7) {
+    Request->DescriptorType = SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_IO;
+    Root                    = ReferenceFindRoot (Policy, Request->DescriptorType);
+    if ((Root != NULL) && (Root->Count != 0) && (RandomBelow (2) == 0)) {
+      Io              = ReferenceDescriptor (Policy, Root, sizeof (*Io), RandomBelow (Root->Count));
+      Request->Target = (UINT32)(Io->IoAddress + Io->LengthOrWidth + 4 - RandomBelow (Io->LengthOrWidth + 8));
+      Request->Target = (Request->Target > 0x10003) ? RandomBelow (0x10) : Request->Target;
+    } else {
+      Request->Target = (RandomBelow (16) == 0) ? 0xFFFC + RandomBelow (8) : RandomBelow (0x1000);
+    }
+  } else if (Pick < 14) {
+    Request->DescriptorType = SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_MSR;
+    Root                    = ReferenceFindRoot (Policy, Request->DescriptorType);
+    if ((Root != NULL) && (Root->Count != 0) && (RandomBelow (2) == 0)) {
+      Msr             = ReferenceDescriptor (Policy, Root, sizeof (*Msr), RandomBelow (Root->Count));
+      Request->Target = Msr->MsrAddress + Msr->Length + 2 - RandomBelow (Msr->Length + 4);
+    } else {
+      Request->Target = (RandomBelow (16) == 0) ? (UINT32)NextRandom () : RandomMsrAddress ();
+    }
+  } else if (Pick < 15) {
+    Request->DescriptorType = SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_INSTRUCTION;
+    Request->Target         = RandomBelow (SECURE_POLICY_INSTRUCTION_COUNT + 2);
+  } else {
+    // Descriptor types the gate does not evaluate
+    Request->DescriptorType = (RandomBelow (2) == 0) ? SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_MEM : SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_SAVE_STATE;
+    Request->Target         = RandomBelow (0x100);
+  }
+}
+
+/**
+  Evaluate a request through the verbose gate interface of its descriptor type.
+
+  @param[in]  Policy    The policy to evaluate against.
+  @param[in]  Request   The request to evaluate.
+
+  @return The verdict of the verbose interface.
+**/
+STATIC
+EFI_STATUS
+VerbosePolicyAccess (
+  IN SMM_SUPV_SECURE_POLICY_DATA_V1_0  *Policy,
+  IN CONST FUZZ_REQUEST                *Request
+  )
+{
+  switch (Request->DescriptorType) {
+    case SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_IO:
+      return IsIoReadWriteAllowed (Policy, Request->Target, (EFI_MM_IO_WIDTH)Request->IoWidth, Request->AccessMask);
+    case SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_MSR:
+      return IsMsrReadWriteAllowed (Policy, Request->Target, Request->AccessMask);
+    case SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_INSTRUCTION:
+      if (Request->Target > MAX_UINT16) {
+        return EFI_INVALID_PARAMETER;
+      }
+
+      return IsInstructionExecutionAllowed (Policy, (UINT16)Request->Target);
+    default:
+      return EFI_INVALID_PARAMETER;
+  }
+}
+
+/**
+  Compare the gate against the reference model for one request.
+
+  @param[in]  Policy        The policy to evaluate against.
+  @param[in]  Request       The request to evaluate.
+  @param[in]  CheckVerbose  Also compare the verdict of the verbose interface.
+
+  @retval  UNIT_TEST_PASSED             The gate agrees with the reference model.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  The gate disagrees with the reference model.
+**/
+STATIC
+UNIT_TEST_STATUS
+CompareWithReference (
+  IN SMM_SUPV_SECURE_POLICY_DATA_V1_0  *Policy,
+  IN CONST FUZZ_REQUEST                *Request,
+  IN BOOLEAN                           CheckVerbose
+  )
+{
+  EFI_STATUS  Expected;
+  EFI_STATUS  Status;
+  UINT32      ExpectedIndex;
+  UINT32      Index;
+
+  Expected = ReferencePolicyAccess (Policy, Request, &ExpectedIndex);
+  Status   = EvaluatePolicyAccess (
+               Policy,
+               Request->DescriptorType,
+               Request->Target,
+               (EFI_MM_IO_WIDTH)Request->IoWidth,
+               Request->AccessMask,
+               &Index
+               );
+
+  if ((Status != Expected) || (Index != ExpectedIndex)) {
+    UT_LOG_ERROR (
+      "Seed 0x%lx: type %d target 0x%x width %d mask 0x%x, gate %r at %d, reference %r at %d\n",
+      mFuzzSeed,
+      Request->DescriptorType,
+      Request->Target,
+      Request->IoWidth,
+      Request->AccessMask,
+      Status,
+      Index,
+      Expected,
+      ExpectedIndex
+      );
+  }
+
+  UT_ASSERT_STATUS_EQUAL (Status, Expected);
+  UT_ASSERT_EQUAL (Index, ExpectedIndex);
+
+  if (CheckVerbose) {
+    UT_ASSERT_STATUS_EQUAL (VerbosePolicyAccess (Policy, Request), Expected);
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/*
+  Helper function to seed the random generator, so every test case is reproducible on its own.
+*/
+UNIT_TEST_STATUS
+EFIAPI
+SeedFuzzTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  TEST_CONTEXT_FUZZ  *FuzzCntx;
+
+  FuzzCntx           = (TEST_CONTEXT_FUZZ *)Context;
+  FuzzCntx->Policy   = NULL;
+  FuzzCntx->Requests = NULL;
+
+  // The generator cannot leave the all zero state
+  mRandomState = (mFuzzSeed != 0) ? mFuzzSeed : FUZZ_DEFAULT_SEED;
+
+  return UNIT_TEST_PASSED;
+}
+
+/*
+  Helper function to create a real-world-sized allow list policy of IO, MSR and instruction
+  descriptors, along with a pool of requests to evaluate against it.
+*/
+UNIT_TEST_STATUS
+EFIAPI
+CreateLargeFuzzPolicy (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  TEST_CONTEXT_FUZZ  *FuzzCntx;
+  UINT32             Index;
+
+  SeedFuzzTest (Context);
+  FuzzCntx = (TEST_CONTEXT_FUZZ *)Context;
+
+  FuzzCntx->Policy = AllocateFuzzPolicy (
+                       BENCH_IO_DESCRIPTOR_COUNT,
+                       BENCH_MSR_DESCRIPTOR_COUNT,
+                       SECURE_POLICY_INSTRUCTION_COUNT,
+                       SMM_SUPV_ACCESS_ATTR_ALLOW,
+                       SMM_SUPV_ACCESS_ATTR_ALLOW,
+                       SMM_SUPV_ACCESS_ATTR_ALLOW
+                       );
+  FuzzCntx->Requests = AllocatePool (BENCH_REQUEST_POOL_SIZE * sizeof (FUZZ_REQUEST));
+  UT_ASSERT_NOT_NULL (FuzzCntx->Policy);
+  UT_ASSERT_NOT_NULL (FuzzCntx->Requests);
+
+  RandomizePolicyDescriptors (FuzzCntx->Policy);
+  for (Index = 0; Index < BENCH_REQUEST_POOL_SIZE; Index++) {
+    RandomizeRequest (FuzzCntx->Policy, &FuzzCntx->Requests[Index]);
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/*
+  Helper function to clean up prepared policy and requests, if needed.
+*/
+VOID
+EFIAPI
+ClearFuzzPolicy (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  TEST_CONTEXT_FUZZ  *FuzzCntx;
+
+  FuzzCntx = (TEST_CONTEXT_FUZZ *)Context;
+  if (FuzzCntx->Policy != NULL) {
+    FreePool (FuzzCntx->Policy);
+    FuzzCntx->Policy = NULL;
+  }
+
+  if (FuzzCntx->Requests != NULL) {
+    FreePool (FuzzCntx->Requests);
+    FuzzCntx->Requests = NULL;
+  }
+}
+
+/**
+  Differential test of the policy gate against the reference model on small random
+  policies with random allow and deny roots, strict width entries and missing roots.
+
+  @param[in]  Context    [Optional] An optional parameter that enables:
+                         1) test-case reuse with varied parameters and
+                         2) test-case re-entry for Target tests that need a
+                         reboot.  This parameter is a VOID* and it is the
+                         responsibility of the test author to ensure that the
+                         contents are well understood by all test cases that may
+                         consume it.
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+PolicyGateDifferentialOnRandomPolicies (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  TEST_CONTEXT_FUZZ  *FuzzCntx;
+  FUZZ_REQUEST       Request;
+  UNIT_TEST_STATUS   TestStatus;
+  UINT32             PolicyIndex;
+  UINT32             Index;
+  UINT32             Counts[3];
+
+  FuzzCntx = (TEST_CONTEXT_FUZZ *)Context;
+
+  for (PolicyIndex = 0; PolicyIndex < FUZZ_POLICY_COUNT; PolicyIndex++) {
+    for (Index = 0; Index < ARRAY_SIZE (Counts); Index++) {
+      // Occasionally drop the root entirely, or keep it without descriptors
+      Counts[Index] = RandomBelow (FUZZ_MAX_DESCRIPTOR_COUNT + 1);
+      if (RandomBelow (8) == 0) {
+        Counts[Index] = (RandomBelow (2) == 0) ? MAX_UINT32 : 0;
+      }
+    }
+
+    FuzzCntx->Policy = AllocateFuzzPolicy (
+                         Counts[0],
+                         Counts[1],
+                         Counts[2],
+                         (UINT8)RandomBelow (2),
+                         (UINT8)RandomBelow (2),
+                         (UINT8)RandomBelow (2)
+                         );
+    UT_ASSERT_NOT_NULL (FuzzCntx->Policy);
+    RandomizePolicyDescriptors (FuzzCntx->Policy);
+
+    for (Index = 0; Index < FUZZ_REQUESTS_PER_POLICY; Index++) {
+      RandomizeRequest (FuzzCntx->Policy, &Request);
+      TestStatus = CompareWithReference (FuzzCntx->Policy, &Request, (Index % FUZZ_VERBOSE_CHECK_INTERVAL) == 0);
+      if (TestStatus != UNIT_TEST_PASSED) {
+        UT_LOG_ERROR ("Policy %d of seed 0x%lx failed at request %d\n", PolicyIndex, mFuzzSeed, Index);
+        return TestStatus;
+      }
+    }
+
+    FreePool (FuzzCntx->Policy);
+    FuzzCntx->Policy = NULL;
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Differential test of the policy gate against the reference model on a real-world-sized
+  policy, where the deciding descriptor is typically deep into the descriptor list.
+
+  @param[in]  Context    [Optional] An optional parameter that enables:
+                         1) test-case reuse with varied parameters and
+                         2) test-case re-entry for Target tests that need a
+                         reboot.  This parameter is a VOID* and it is the
+                         responsibility of the test author to ensure that the
+                         contents are well understood by all test cases that may
+                         consume it.
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+PolicyGateDifferentialOnLargePolicy (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  TEST_CONTEXT_FUZZ  *FuzzCntx;
+  FUZZ_REQUEST       Request;
+  UNIT_TEST_STATUS   TestStatus;
+  UINT32             Index;
+
+  FuzzCntx = (TEST_CONTEXT_FUZZ *)Context;
+
+  for (Index = 0; Index < FUZZ_LARGE_REQUEST_COUNT; Index++) {
+    RandomizeRequest (FuzzCntx->Policy, &Request);
+    TestStatus = CompareWithReference (FuzzCntx->Policy, &Request, (Index % FUZZ_VERBOSE_CHECK_INTERVAL) == 0);
+    if (TestStatus != UNIT_TEST_PASSED) {
+      return TestStatus;
+    }
+  }
+
+  // Flip to deny lists, every verdict of a valid request should flip as well
+  ReferenceFindRoot (FuzzCntx->Policy, SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_IO)->AccessAttr  = SMM_SUPV_ACCESS_ATTR_DENY;
+  ReferenceFindRoot (FuzzCntx->Policy, SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_MSR)->AccessAttr = SMM_SUPV_ACCESS_ATTR_DENY;
+
+  for (Index = 0; Index < BENCH_REQUEST_POOL_SIZE; Index++) {
+    TestStatus = CompareWithReference (FuzzCntx->Policy, &FuzzCntx->Requests[Index], FALSE);
+    if (TestStatus != UNIT_TEST_PASSED) {
+      return TestStatus;
+    }
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Measure the lookups per second of the quiet policy gate interface on a real-world-sized
+  policy for one kind of access. The requests are pre-generated to keep the random
+  generator out of the measurement.
+
+  @param[in]  Policy          The policy to evaluate against.
+  @param[in]  Requests        Pool of BENCH_REQUEST_POOL_SIZE requests.
+  @param[in]  DescriptorType  The descriptor type to measure.
+  @param[in]  AccessMask      The access mask to measure, ignored for instructions.
+  @param[in]  Name            Name of the measured access for the report.
+
+  @retval  UNIT_TEST_PASSED             The measurement has completed.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  No valid request of this kind was generated.
+**/
+STATIC
+UNIT_TEST_STATUS
+MeasureLookups (
+  IN SMM_SUPV_SECURE_POLICY_DATA_V1_0  *Policy,
+  IN FUZZ_REQUEST                      *Requests,
+  IN UINT32                            DescriptorType,
+  IN UINT32                            AccessMask,
+  IN CONST CHAR8                       *Name
+  )
+{
+  FUZZ_REQUEST  *Selected;
+  UINT32        SelectedCount;
+  UINT32        Granted;
+  UINT32        Index;
+  UINT32        ExpectedIndex;
+  clock_t       Start;
+  clock_t       Elapsed;
+  UINT64        Rate;
+
+  Selected      = AllocatePool (BENCH_REQUEST_POOL_SIZE * sizeof (FUZZ_REQUEST));
+  SelectedCount = 0;
+  UT_ASSERT_NOT_NULL (Selected);
+
+  // Only keep the well formed requests of the measured kind
+  for (Index = 0; Index < BENCH_REQUEST_POOL_SIZE; Index++) {
+    if (Requests[Index].DescriptorType != DescriptorType) {
+      continue;
+    }
+
+    CopyMem (&Selected[SelectedCount], &Requests[Index], sizeof (FUZZ_REQUEST));
+    Selected[SelectedCount].AccessMask = AccessMask;
+    if (ReferencePolicyAccess (Policy, &Selected[SelectedCount], &ExpectedIndex) != EFI_INVALID_PARAMETER) {
+      SelectedCount++;
+    }
+  }
+
+  if (SelectedCount == 0) {
+    FreePool (Selected);
+    UT_LOG_ERROR ("No valid %a request generated\n", Name);
+    return UNIT_TEST_ERROR_TEST_FAILED;
+  }
+
+  Granted = 0;
+  Start   = clock ();
+  for (Index = 0; Index < BENCH_LOOKUP_COUNT; Index++) {
+    if (!EFI_ERROR (
+           EvaluatePolicyAccess (
+             Policy,
+             DescriptorType,
+             Selected[Index % SelectedCount].Target,
+             (EFI_MM_IO_WIDTH)Selected[Index % SelectedCount].IoWidth,
+             AccessMask,
+             NULL
+             )
+           ))
+    {
+      Granted++;
+    }
+  }
+
+  Elapsed = clock () - Start;
+  Rate    = (Elapsed > 0) ? (UINT64)BENCH_LOOKUP_COUNT * CLOCKS_PER_SEC / (UINT64)Elapsed : 0;
+
+  // Printed directly so the numbers are visible regardless of the debug library in use
+  printf (
+    "  %-10s %8u lookups over %4u requests, %3u%% granted: %llu lookups/s\n",
+    Name,
+    BENCH_LOOKUP_COUNT,
+    SelectedCount,
+    (UINT32)((UINT64)Granted * 100 / BENCH_LOOKUP_COUNT),
+    (unsigned long long)Rate
+    );
+  UT_LOG_INFO ("%a: %ld lookups/s\n", Name, Rate);
+
+  FreePool (Selected);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Benchmark of the quiet policy gate interface on a real-world-sized policy.
+
+  @param[in]  Context    [Optional] An optional parameter that enables:
+                         1) test-case reuse with varied parameters and
+                         2) test-case re-entry for Target tests that need a
+                         reboot.  This parameter is a VOID* and it is the
+                         responsibility of the test author to ensure that the
+                         contents are well understood by all test cases that may
+                         consume it.
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+PolicyGateLookupBenchmark (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  TEST_CONTEXT_FUZZ  *FuzzCntx;
+  UNIT_TEST_STATUS   TestStatus;
+
+  FuzzCntx = (TEST_CONTEXT_FUZZ *)Context;
+
+  printf (
+    "Policy gate lookups, %d IO and %d MSR descriptors on allow lists:\n",
+    BENCH_IO_DESCRIPTOR_COUNT,
+    BENCH_MSR_DESCRIPTOR_COUNT
+    );
+
+  TestStatus = MeasureLookups (FuzzCntx->Policy, FuzzCntx->Requests, SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_IO, SECURE_POLICY_RESOURCE_ATTR_READ, "IO read");
+  if (TestStatus == UNIT_TEST_PASSED) {
+    TestStatus = MeasureLookups (FuzzCntx->Policy, FuzzCntx->Requests, SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_IO, SECURE_POLICY_RESOURCE_ATTR_WRITE, "IO write");
+  }
+
+  if (TestStatus == UNIT_TEST_PASSED) {
+    TestStatus = MeasureLookups (FuzzCntx->Policy, FuzzCntx->Requests, SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_MSR, SECURE_POLICY_RESOURCE_ATTR_READ, "MSR read");
+  }
+
+  if (TestStatus == UNIT_TEST_PASSED) {
+    TestStatus = MeasureLookups (FuzzCntx->Policy, FuzzCntx->Requests, SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_MSR, SECURE_POLICY_RESOURCE_ATTR_WRITE, "MSR write");
+  }
+
+  if (TestStatus == UNIT_TEST_PASSED) {
+    TestStatus = MeasureLookups (FuzzCntx->Policy, FuzzCntx->Requests, SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_INSTRUCTION, 0, "Ins");
+  }
+
+  return TestStatus;
+}
+
+/**
+  Initialize the unit test framework, suite, and unit tests for the
+  SmmPolicyGateLib and run the SmmPolicyGateLib fuzz and benchmark tests.
+
+  @retval  EFI_SUCCESS           All test cases were dispatched.
+  @retval  EFI_OUT_OF_RESOURCES  There are not enough resources available to
+                                 initialize the unit tests.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+UnitTestingEntry (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      FuzzTests;
+  UNIT_TEST_SUITE_HANDLE      BenchmarkTests;
+  TEST_CONTEXT_FUZZ           FuzzContext;
+
+  Framework            = NULL;
+  FuzzContext.Policy   = NULL;
+  FuzzContext.Requests = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_APP_NAME, UNIT_TEST_APP_VERSION));
+  DEBUG ((DEBUG_INFO, "Fuzzing seed 0x%lx\n", mFuzzSeed));
+
+  //
+  // Start setting up the test framework for running the tests.
+  //
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_APP_NAME, gEfiCallerBaseName, UNIT_TEST_APP_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  //
+  // Populate the SmmPolicyGateLib Fuzz Test Suite.
+  //
+  Status = CreateUnitTestSuite (&FuzzTests, Framework, "SmmPolicyGateLib Differential Fuzz Tests", "SmmPolicyGateLib.Fuzz", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for FuzzTests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  Status = CreateUnitTestSuite (&BenchmarkTests, Framework, "SmmPolicyGateLib Benchmark", "SmmPolicyGateLib.Benchmark", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for BenchmarkTests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  //
+  // --------------Suite-----------Description--------------Name----------Function--------Pre---Post-------------------Context-----------
+  //
+  AddTestCase (FuzzTests, "Policy gate should match reference model on random policies", "DiffRandom", PolicyGateDifferentialOnRandomPolicies, SeedFuzzTest, ClearFuzzPolicy, &FuzzContext);
+  AddTestCase (FuzzTests, "Policy gate should match reference model on large policies", "DiffLarge", PolicyGateDifferentialOnLargePolicy, CreateLargeFuzzPolicy, ClearFuzzPolicy, &FuzzContext);
+  AddTestCase (BenchmarkTests, "Policy gate lookup rate on large policies", "Lookups", PolicyGateLookupBenchmark, CreateLargeFuzzPolicy, ClearFuzzPolicy, &FuzzContext);
+
+  //
+  // Execute the tests.
+  //
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+/**
+  Standard POSIX C entry point for host based unit test execution. An optional
+  first argument overrides the fuzzing seed.
+**/
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  if (argc > 1) {
+    mFuzzSeed = strtoull (argv[1], NULL, 0);
+  }
+
+  return UnitTestingEntry ();
+}
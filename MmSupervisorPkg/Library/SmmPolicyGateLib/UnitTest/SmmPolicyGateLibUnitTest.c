@@ -498,6 +498,71 @@ PolicyGateMatchEntryOnDenyInsList (
   return UNIT_TEST_PASSED;
 }
 
+/**
+  Unit test for EvaluatePolicyAccess () API of the SmmPolicyGateLib, the verdicts
+  should be identical to the ones from the verbose interfaces.
+
+  @param[in]  Context    [Optional] An optional parameter that enables:
+                         1) test-case reuse with varied parameters and
+                         2) test-case re-entry for Target tests that need a
+                         reboot.  This parameter is a VOID* and it is the
+                         responsibility of the test author to ensure that the
+                         contents are well understood by all test cases that may
+                         consume it.
+
+  @retval  UNIT_TEST_PASSED             The Unit test has completed and the test
+                                        case was successful.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  A test case assertion has failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+PolicyGateQuietEvaluationOnIoList (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  TEST_CONTEXT_POLICY  *PolicyCntx;
+  EFI_STATUS           Status;
+  UINT32               Index;
+
+  PolicyCntx = (TEST_CONTEXT_POLICY *)Context;
+
+  // Test IO read on test policy, should pass and point to the only entry
+  Status = EvaluatePolicyAccess (PolicyCntx->Policy, SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_IO, 0x72, MM_IO_UINT8, SECURE_POLICY_RESOURCE_ATTR_READ, &Index);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (Index, 0);
+
+  // Test IO write on test policy, should fail
+  Status = EvaluatePolicyAccess (PolicyCntx->Policy, SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_IO, 0x72, MM_IO_UINT8, SECURE_POLICY_RESOURCE_ATTR_WRITE, &Index);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_ACCESS_DENIED);
+
+  // Test IO read not on test policy, should fail and report no matching entry
+  Status = EvaluatePolicyAccess (PolicyCntx->Policy, SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_IO, 0x71, MM_IO_UINT8, SECURE_POLICY_RESOURCE_ATTR_READ, &Index);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_ACCESS_DENIED);
+  UT_ASSERT_EQUAL (Index, 1);
+
+  // Test uint32 IO overflow read on test policy
+  Status = EvaluatePolicyAccess (PolicyCntx->Policy, SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_IO, 0xFFFD, MM_IO_UINT32, SECURE_POLICY_RESOURCE_ATTR_READ, NULL);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_INVALID_PARAMETER);
+
+  // Test lookups against policy roots that do not exist
+  Status = EvaluatePolicyAccess (PolicyCntx->Policy, SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_MSR, 0xC0000080, 0, SECURE_POLICY_RESOURCE_ATTR_READ, NULL);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_ACCESS_DENIED);
+
+  Status = EvaluatePolicyAccess (PolicyCntx->Policy, SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_INSTRUCTION, SECURE_POLICY_INSTRUCTION_CLI, 0, 0, NULL);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_ACCESS_DENIED);
+
+  // Change the root access attribute to deny list, verdicts should flip
+  ((SMM_SUPV_POLICY_ROOT_V1 *)(PolicyCntx->Policy + 1))->AccessAttr = SMM_SUPV_ACCESS_ATTR_DENY;
+
+  Status = EvaluatePolicyAccess (PolicyCntx->Policy, SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_IO, 0x72, MM_IO_UINT8, SECURE_POLICY_RESOURCE_ATTR_READ, NULL);
+  UT_ASSERT_STATUS_EQUAL (Status, IsIoReadWriteAllowed (PolicyCntx->Policy, 0x72, MM_IO_UINT8, SECURE_POLICY_RESOURCE_ATTR_READ));
+
+  Status = EvaluatePolicyAccess (PolicyCntx->Policy, SMM_SUPV_SECURE_POLICY_DESCRIPTOR_TYPE_IO, 0x71, MM_IO_UINT8, SECURE_POLICY_RESOURCE_ATTR_READ, NULL);
+  UT_ASSERT_STATUS_EQUAL (Status, IsIoReadWriteAllowed (PolicyCntx->Policy, 0x71, MM_IO_UINT8, SECURE_POLICY_RESOURCE_ATTR_READ));
+
+  return UNIT_TEST_PASSED;
+}
+
 /**
   Initialize the unit test framework, suite, and unit tests for the
   SmmPolicyGateLib and run the SmmPolicyGateLib unit test.
@@ -552,6 +617,7 @@ UnitTestingEntry (
   AddTestCase (PolicyGateTests, "Policy gate should catch requests listed on deny MSR policy", "DenyMsr", PolicyGateMatchEntryOnDenyMsrList, CreateSingleMsrPolicy, ClearTestPolicy, &PolicyContext);
   AddTestCase (PolicyGateTests, "Policy gate should catch requests listed on allow Instruction policy", "AllowIns", PolicyGateMatchEntryOnAllowInsList, CreateSingleInsPolicy, ClearTestPolicy, &PolicyContext);
   AddTestCase (PolicyGateTests, "Policy gate should catch requests listed on deny Instruction policy", "DenyIns", PolicyGateMatchEntryOnDenyInsList, CreateSingleInsPolicy, ClearTestPolicy, &PolicyContext);
+  AddTestCase (PolicyGateTests, "Quiet policy evaluation should match the verbose interfaces", "QuietIO", PolicyGateQuietEvaluationOnIoList, CreateSingleIoPolicy, ClearTestPolicy, &PolicyContext);
 
   //
   // Execute the tests.
@@ -12,15 +12,75 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <PiMm.h>
 
 #include <Library/HobLib.h>
+#include <Library/BaseLib.h>
 #include <Library/DebugLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/SysCallLib.h>
+#include <Library/MmHobIndexLib.h>
 
 //
 // Cache copy of HobList pointer.
 //
 STATIC VOID  *gHobList = NULL;
 
+//
+// Cache copy of the read only HOB index published by supervisor, NULL if not available.
+//
+STATIC MM_HOB_INDEX  *gHobIndex = NULL;
+
+/**
+  Query the HOB index from supervisor and validate it against the cached HOB list.
+
+  The index is only used when it describes the same HOB list this library has
+  cached, otherwise lookups fall back to walking the HOB list.
+
+**/
+STATIC
+VOID
+LoadHobIndex (
+  VOID
+  )
+{
+  MM_HOB_INDEX  *HobIndex;
+
+  HobIndex = (MM_HOB_INDEX *)(UINTN)SysCall (SMM_QRY_HOB_INDEX, 0, 0, 0);
+  if ((HobIndex != NULL) &&
+      (HobIndex->Signature == MM_HOB_INDEX_SIGNATURE) &&
+      (gHobList != NULL) &&
+      (HobIndex->HobListStart == (EFI_PHYSICAL_ADDRESS)(UINTN)gHobList))
+  {
+    gHobIndex = HobIndex;
+  } else {
+    gHobIndex = NULL;
+  }
+}
+
+/**
+  Binary search the HOB index for the first GUID HOB named Guid at or after HobStart.
+
+  @param  Guid          The GUID to match with in the HOB list.
+  @param  HobStart      The starting HOB pointer, must be within the indexed HOB list.
+
+  @return The matched GUID HOB, or NULL if there is no such HOB.
+
+**/
+STATIC
+VOID *
+LookupGuidHobIndex (
+  IN CONST EFI_GUID  *Guid,
+  IN CONST VOID      *HobStart
+  )
+{
+  CONST MM_HOB_INDEX_GUID_ENTRY  *GuidEntry;
+
+  GuidEntry = MmHobIndexFindGuid (gHobIndex, Guid, (UINT64)((UINTN)HobStart - (UINTN)gHobIndex->HobListStart));
+  if (GuidEntry == NULL) {
+    return NULL;
+  }
+
+  return (VOID *)(UINTN)(gHobIndex->HobListStart + GuidEntry->HobOffset);
+}
+
 /**
   The constructor function caches the pointer to HOB list.
 
@@ -42,6 +102,7 @@ HobLibConstructor (
   )
 {
   gHobList = (VOID *)SysCall (SMM_QRY_HOB, 0, 0, 0);
+  LoadHobIndex ();
   return EFI_SUCCESS;
 }
 
@@ -62,6 +123,7 @@ GetHobList (
 {
   if (gHobList == NULL) {
     gHobList = (VOID *)SysCall (SMM_QRY_HOB, 0, 0, 0);
+    LoadHobIndex ();
   }
 
   ASSERT (gHobList != NULL);
@@ -133,6 +195,14 @@ GetFirstHob (
   VOID  *HobList;
 
   HobList = GetHobList ();
+  if ((gHobIndex != NULL) && (Type < MM_HOB_INDEX_TYPE_COUNT)) {
+    if (gHobIndex->FirstHobOffset[Type] == MM_HOB_INDEX_NO_HOB) {
+      return NULL;
+    }
+
+    return (UINT8 *)HobList + gHobIndex->FirstHobOffset[Type];
+  }
+
   return GetNextHob (Type, HobList);
 }
 
@@ -167,6 +237,13 @@ GetNextGuidHob (
 {
   EFI_PEI_HOB_POINTERS  GuidHob;
 
+  if ((gHobIndex != NULL) &&
+      ((UINTN)HobStart >= (UINTN)gHobIndex->HobListStart) &&
+      ((UINTN)HobStart - (UINTN)gHobIndex->HobListStart < gHobIndex->HobListSize))
+  {
+    return LookupGuidHobIndex (Guid, HobStart);
+  }
+
   GuidHob.Raw = (UINT8 *)HobStart;
   while ((GuidHob.Raw = GetNextHob (EFI_HOB_TYPE_GUID_EXTENSION, GuidHob.Raw)) != NULL) {
     if (CompareGuid (Guid, &GuidHob.Guid->Name)) {
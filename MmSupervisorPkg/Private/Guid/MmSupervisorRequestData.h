@@ -62,6 +62,87 @@ typedef struct _COMM_UPDATE_BUFFER {
   MM_SUPERVISOR_UNBLOCK_MEMORY_PARAMS    NewCommBuffers[MM_OPEN_BUFFER_CNT];
 } MM_SUPERVISOR_COMM_UPDATE_BUFFER;
 
+/**
+  This structure describes one syscall recorded in the per-CPU syscall trace rings.
+
+**/
+typedef struct _SYSCALL_TRACE_ENTRY {
+  UINT64    Tsc;          // Time stamp counter value upon syscall entry
+  UINT32    CallIndex;
+  UINT32    CpuIndex;
+  UINT64    Arg1;
+  UINT64    Arg2;
+  UINT64    Arg3;
+  UINT64    CallerAddr;
+  UINT64    Status;       // Dispatcher status, cast to EFI_STATUS before usage
+  UINT64    Cycles;       // Time stamp counter ticks spent in the dispatcher
+} MM_SUPERVISOR_SYSCALL_TRACE_ENTRY;
+
+/**
+  This structure is used to drain the syscall trace rings from MM environment. Upon a
+  successful request, EntryCount MM_SUPERVISOR_SYSCALL_TRACE_ENTRY records follow this
+  structure, grouped by CPU and in chronological order per CPU. The requester should keep
+  issuing this request until RemainingCount reaches 0.
+
+**/
+typedef struct _SYSCALL_TRACE_BUFFER {
+  UINT32    NumberOfCpus;
+  UINT32    EntriesPerCpu;
+  UINT64    EntryCount;       // Number of entries returned following this structure
+  UINT64    DroppedCount;     // Number of entries overwritten before being drained
+  UINT64    RemainingCount;   // Number of entries left in the rings after this request
+} MM_SUPERVISOR_SYSCALL_TRACE_BUFFER;
+
+/**
+  This structure is used to fetch the per-descriptor hit counters of the IO and MSR policy
+  roots. Upon a successful request, it is followed by IoDescriptorCount + 1 UINT32 counters
+  for the IO policy root and then MsrDescriptorCount + 1 UINT32 counters for the MSR policy
+  root. Counter N of a root is the number of requests decided by its descriptor N, the last
+  counter of a root is the number of requests that did not match any of its descriptors.
+
+**/
+typedef struct _POLICY_PROFILE_BUFFER {
+  UINT32    IoDescriptorCount;    // Number of IO descriptors in the policy in effect
+  UINT32    MsrDescriptorCount;   // Number of MSR descriptors in the policy in effect
+} MM_SUPERVISOR_POLICY_PROFILE_BUFFER;
+
+/**
+  This structure is used to fetch the usage of the page table pools. Page table pages are never
+  returned to the pools, so the used page counts are also their high-water marks. The split pool
+  serves the page tables created when large pages are broken into 4KB pages after the initial
+  page tables are built, it cannot grow.
+
+**/
+typedef struct _PAGE_TABLE_USAGE_BUFFER {
+  UINT64    EstimatedPages;         // Pages estimated for the initial page tables
+  UINT64    ReservedPages;          // Pages of all page table pools, including their headers
+  UINT64    UsedPages;              // Pages used from the page table pools
+  UINT32    PoolCount;              // Number of page table pools, more than 1 when the estimate fell short
+  UINT32    Reserved;
+  UINT64    SplitEstimatedPages;    // Pages estimated for splitting large pages
+  UINT64    SplitReservedPages;     // Pages of the split pool
+  UINT64    SplitUsedPages;         // Pages used from the split pool
+  UINT64    SplitFailedRequests;    // Allocations the split pool could not satisfy
+} MM_SUPERVISOR_PAGE_TABLE_USAGE_BUFFER;
+
+/**
+  This structure is used to select how later demotions enter and leave CPL3 routines, so that
+  the SYSRET path and the call gate path can be compared in one build. It is only served when
+  PcdMmSupervisorTestEnable is set. The call gate path is taken whenever SYSRET demotion is
+  disabled at build time or its trampoline is not registered.
+
+**/
+typedef struct _DEMOTION_PATH_BUFFER {
+  UINT32    RequestedPath;          // MM_SUPERVISOR_DEMOTION_PATH_* to select, or MM_SUPERVISOR_DEMOTION_PATH_QUERY
+  UINT32    SelectedPath;           // MM_SUPERVISOR_DEMOTION_PATH_* selected, upon return
+  UINT32    ActivePath;             // MM_SUPERVISOR_DEMOTION_PATH_* later demotions take, upon return
+  UINT32    Reserved;
+} MM_SUPERVISOR_DEMOTION_PATH_BUFFER;
+
+#define MM_SUPERVISOR_DEMOTION_PATH_CALL_GATE  0
+#define MM_SUPERVISOR_DEMOTION_PATH_SYSRET     1
+#define MM_SUPERVISOR_DEMOTION_PATH_QUERY      MAX_UINT32
+
 #pragma pack(pop)
 
 /**
@@ -96,12 +177,40 @@ typedef struct _COMM_UPDATE_BUFFER {
  **/
 #define   MM_SUPERVISOR_REQUEST_COMM_UPDATE  0x0004
 
+/**
+  @retval EFI_UNSUPPORTED            If syscall tracing is not enabled in this supervisor
+  @retval EFI_SECURITY_VIOLATION     If communication buffer is not pointing to designated supervisor buffer
+  @retval EFI_BUFFER_TOO_SMALL       If communication buffer cannot hold a single trace entry
+ **/
+#define   MM_SUPERVISOR_REQUEST_SYSCALL_TRACE  0x0005
+
+/**
+  @retval EFI_UNSUPPORTED            If policy profiling is not enabled in this supervisor
+  @retval EFI_SECURITY_VIOLATION     If communication buffer is not pointing to designated supervisor buffer
+  @retval EFI_BUFFER_TOO_SMALL       If communication buffer cannot hold all the hit counters
+ **/
+#define   MM_SUPERVISOR_REQUEST_POLICY_PROFILE  0x0006
+
+/**
+  @retval EFI_SECURITY_VIOLATION     If communication buffer is not pointing to designated supervisor buffer
+  @retval EFI_ACCESS_DENIED          If request occurs before MM foundation is setup
+ **/
+#define   MM_SUPERVISOR_REQUEST_PAGE_TABLE_USAGE  0x0007
+
+/**
+  @retval EFI_UNSUPPORTED            If supervisor is not built with PcdMmSupervisorTestEnable
+  @retval EFI_INVALID_PARAMETER      If the requested demotion path is unknown
+  @retval EFI_SECURITY_VIOLATION     If communication buffer is not pointing to designated supervisor buffer
+  @retval EFI_ACCESS_DENIED          If request occurs before MM foundation is setup
+ **/
+#define   MM_SUPERVISOR_REQUEST_DEMOTION_PATH  0x0008
+
 /**
   Maximal request index supported by supervisor. When supported, the value of this definition
   will be populated in the MaxSupervisorRequestLevel of VERSION_INFO_BUFFER upon a successful query
   to supervisor.
 
  **/
-#define   MM_SUPERVISOR_REQUEST_MAX_SUPPORTED  MM_SUPERVISOR_REQUEST_COMM_UPDATE
+#define   MM_SUPERVISOR_REQUEST_MAX_SUPPORTED  MM_SUPERVISOR_REQUEST_DEMOTION_PATH
 
 #endif // _MM_SUPV_REQUEST_DATA_H_
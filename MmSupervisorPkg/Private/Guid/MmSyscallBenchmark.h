@@ -0,0 +1,73 @@
+/** @file
+  Shared definitions between the syscall benchmark MM driver and the UEFI shell application
+  that drives it through MM communicate protocol.
+
+  Copyright (c) Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef MM_SYSCALL_BENCHMARK_H_
+#define MM_SYSCALL_BENCHMARK_H_
+
+#define MM_SYSCALL_BENCHMARK_SIGNATURE  SIGNATURE_32('M', 'S', 'B', 'M')
+#define MM_SYSCALL_BENCHMARK_REVISION   3
+
+//
+// Index of each measurement in MM_SYSCALL_BENCHMARK_PARAMETERS.Results
+//
+#define MM_SYSCALL_BENCHMARK_NULL             0x00    // SMM_SC_NULL, full syscall path
+#define MM_SYSCALL_BENCHMARK_NULL_FAST        0x01    // SMM_SC_NULL_FAST, register only syscall path
+#define MM_SYSCALL_BENCHMARK_NULL_ENTRY       0x02    // CPL3 to CPL0 leg of SMM_SC_NULL
+#define MM_SYSCALL_BENCHMARK_NULL_EXIT        0x03    // CPL0 to CPL3 leg of SMM_SC_NULL, the SYSRET demotion
+#define MM_SYSCALL_BENCHMARK_IO_READ          0x04    // SMM_SC_IO_READ on the requested port
+#define MM_SYSCALL_BENCHMARK_MSR_READ         0x05    // SMM_SC_RDMSR on the requested MSR
+#define MM_SYSCALL_BENCHMARK_POOL_ALLOC       0x06    // MmAllocatePool and MmFreePool pair
+#define MM_SYSCALL_BENCHMARK_PAGE_ALLOC       0x07    // MmAllocatePages and MmFreePages pair
+#define MM_SYSCALL_BENCHMARK_SAVE_STATE_READ  0x08    // ReadSaveState of the processor ID
+#define MM_SYSCALL_BENCHMARK_HASH_SERIAL      0x09    // CRC32 of every page of a 1MB buffer on one CPU
+#define MM_SYSCALL_BENCHMARK_HASH_PARALLEL    0x0A    // Same as above through MmParallelFor on all CPUs
+#define MM_SYSCALL_BENCHMARK_AP_PROCEDURE     0x0B    // Empty procedure on one AP, one CPL3 demotion per sample (SYSRET or call gate)
+#define MM_SYSCALL_BENCHMARK_COUNT            0x0C
+
+//
+// Flags of MM_SYSCALL_BENCHMARK_PARAMETERS. Policy gated measurements are only run when the caller
+// has verified the target against the active policy, a policy violation is fatal in MM.
+//
+#define MM_SYSCALL_BENCHMARK_FLAG_IO_READ   BIT0
+#define MM_SYSCALL_BENCHMARK_FLAG_MSR_READ  BIT1
+
+#pragma pack(push, 1)
+
+typedef struct {
+  UINT64    Status;         // EFI_STATUS of this measurement, EFI_NOT_STARTED if it is skipped
+  UINT64    Iterations;
+  UINT64    MinCycles;
+  UINT64    MaxCycles;
+  UINT64    TotalCycles;
+} MM_SYSCALL_BENCHMARK_RESULT;
+
+/**
+  Communicate buffer of gMmSyscallBenchmarkMmiHandlerGuid. When Iterations is 0, the handler only
+  stamps the TSC upon entry and exit so that the caller can break down the MMI round trip.
+
+**/
+typedef struct {
+  UINT32                         Signature;
+  UINT32                         Revision;
+  UINT32                         Flags;
+  UINT32                         Iterations;
+  UINT32                         IoPort;
+  UINT32                         IoWidth; // EFI_MM_IO_WIDTH
+  UINT32                         MsrIndex;
+  UINT32                         CpuIndex;
+  UINT64                         HandlerEntryTsc;
+  UINT64                         HandlerExitTsc;
+  MM_SYSCALL_BENCHMARK_RESULT    Results[MM_SYSCALL_BENCHMARK_COUNT];
+} MM_SYSCALL_BENCHMARK_PARAMETERS;
+
+#pragma pack(pop)
+
+extern EFI_GUID  gMmSyscallBenchmarkMmiHandlerGuid;
+
+#endif // MM_SYSCALL_BENCHMARK_H_
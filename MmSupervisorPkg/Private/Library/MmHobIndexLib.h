@@ -0,0 +1,70 @@
+/** @file
+  Ordering and lookup of the read-only HOB index, shared by the MM supervisor that
+  sorts the index and the HOB library of user modules that searches it, so that both
+  always agree on the order of the GUID entries.
+
+Copyright (c), Microsoft Corporation.
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef _MM_HOB_INDEX_LIB_H_
+#define _MM_HOB_INDEX_LIB_H_
+
+#include <MmHobIndex.h>
+
+/**
+  Order 2 GUIDs as a pair of 64-bit integers, lower half first.
+
+  @param[in]  Guid1     Pointer to the first GUID.
+  @param[in]  Guid2     Pointer to the second GUID.
+
+  @retval <0            Guid1 is ordered before Guid2.
+  @retval 0             The GUIDs are identical.
+  @retval >0            Guid1 is ordered after Guid2.
+
+**/
+INTN
+EFIAPI
+MmHobIndexCompareGuid (
+  IN CONST EFI_GUID  *Guid1,
+  IN CONST EFI_GUID  *Guid2
+  );
+
+/**
+  Sort callback ordering GUID HOB index entries by GUID name and then by HOB offset.
+
+  @param[in]  Buffer1   Pointer to the first MM_HOB_INDEX_GUID_ENTRY.
+  @param[in]  Buffer2   Pointer to the second MM_HOB_INDEX_GUID_ENTRY.
+
+  @retval <0            Buffer1 is ordered before Buffer2.
+  @retval 0             The entries are identical.
+  @retval >0            Buffer1 is ordered after Buffer2.
+
+**/
+INTN
+EFIAPI
+MmHobIndexCompareGuidEntry (
+  IN CONST VOID  *Buffer1,
+  IN CONST VOID  *Buffer2
+  );
+
+/**
+  Binary search the HOB index for the first GUID HOB named Guid at or after StartOffset.
+
+  @param[in]  HobIndex      The HOB index, followed by its sorted GUID entries.
+  @param[in]  Guid          The GUID to match with.
+  @param[in]  StartOffset   Offset from the start of the HOB list to search from.
+
+  @return The matched GUID entry, or NULL if there is no such GUID HOB.
+
+**/
+CONST MM_HOB_INDEX_GUID_ENTRY *
+EFIAPI
+MmHobIndexFindGuid (
+  IN CONST MM_HOB_INDEX  *HobIndex,
+  IN CONST EFI_GUID      *Guid,
+  IN UINT64              StartOffset
+  );
+
+#endif // _MM_HOB_INDEX_LIB_H_
@@ -0,0 +1,49 @@
+/** @file
+  Definitions of the read-only HOB index built by MM supervisor over the HOB list
+  published to MM environment. The index is queried through SMM_QRY_HOB_INDEX syscall
+  and consumed by the HOB library of user modules.
+
+Copyright (c), Microsoft Corporation.
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef _MM_HOB_INDEX_H_
+#define _MM_HOB_INDEX_H_
+
+#define MM_HOB_INDEX_SIGNATURE  SIGNATURE_32('M', 'H', 'I', 'X')
+
+///
+/// HOB types below this value have their first instance recorded in the index.
+///
+#define MM_HOB_INDEX_TYPE_COUNT  0x10
+
+///
+/// Value of FirstHobOffset entries for HOB types not present in the HOB list.
+///
+#define MM_HOB_INDEX_NO_HOB  MAX_UINT32
+
+#pragma pack(push, 1)
+
+typedef struct {
+  EFI_GUID    Name;
+  UINT64      HobOffset;      // Offset of this GUID HOB from the start of the HOB list
+} MM_HOB_INDEX_GUID_ENTRY;
+
+/**
+  Header of the HOB index. It is followed by GuidEntryCount MM_HOB_INDEX_GUID_ENTRY
+  entries of all GUID extension HOBs, sorted by the GUID name and then by HobOffset.
+  GUIDs are ordered as a pair of 64-bit integers, lower half first.
+
+**/
+typedef struct {
+  UINT32    Signature;
+  UINT32    GuidEntryCount;
+  UINT64    HobListStart;
+  UINT64    HobListSize;
+  UINT32    FirstHobOffset[MM_HOB_INDEX_TYPE_COUNT];
+} MM_HOB_INDEX;
+
+#pragma pack(pop)
+
+#endif // _MM_HOB_INDEX_H_
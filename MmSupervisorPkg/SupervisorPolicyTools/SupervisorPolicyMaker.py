@@ -151,7 +151,7 @@ class SupervisorPolicyMaker(IUefiHelperPlugin):
       obj.Register("MakeSupervisorPolicy", SupervisorPolicyMaker.MakeSupervisorPolicy, fp)
 
     @staticmethod
-    def MakeSupervisorPolicy(output_version=Supervisor_Policy.FLEXBILE_STRUCTURE_VERSION, input_bin=None, xml_file_path=None, output_binary_path=None) -> int:
+    def MakeSupervisorPolicy(output_version=Supervisor_Policy.FLEXBILE_STRUCTURE_VERSION, input_bin=None, xml_file_path=None, output_binary_path=None, optimize=False, profile_path=None) -> int:
 
         Policy = Supervisor_Policy(output_version)  # create a new one
 
@@ -160,9 +160,25 @@ class SupervisorPolicyMaker(IUefiHelperPlugin):
             with open(input_bin, "rb") as f:
                 Policy.Decode(f.read())
 
+        if profile_path is not None:
+            # the hit counters are indexed by the descriptors of the input binary
+            Profile = PolicyProfile()
+            with open(profile_path, "rb") as f:
+                Profile.Decode(f.read())
+            for (policy_type, before, after) in Policy.ApplyProfile(Profile):
+                logging.critical(
+                    f"Reordered {POLICY_TYPE(policy_type).name} policy: expected probe depth {before:.2f} -> {after:.2f}")
+
         # if xml file append new entries
         if xml_file_path is not None:
             ParseXmlAndAddToPolicy(xml_file_path, Policy)
+            # appended entries are in the order given by the xml file
+            Policy.Flags &= ~PolicyFlags.SORTED_DESCRIPTORS
+
+        if optimize:
+            for (policy_type, before, after) in Policy.Optimize():
+                logging.critical(
+                    f"Optimized {POLICY_TYPE(policy_type).name} policy: {before} -> {after} descriptors")
 
             # print out our policy
         logging.debug("=================================================")
@@ -198,6 +214,12 @@ def main() -> int:
     parser.add_argument("-v", "--OutputVersion", "--outputversion", dest="output_version",
                         default=Supervisor_Policy.FLEXBILE_STRUCTURE_VERSION, help="Output binary version in UINT32 format, default will output v1.0",
                         type=int)
+    parser.add_argument("-p", "--Optimize", "--optimize", dest="optimize", action="store_true", default=False,
+                        help="Sort, merge and drop shadowed IO/MSR descriptors without changing any access verdict")
+    parser.add_argument("-r", "--Profile", "--profile", dest="profile_path", default=None,
+                        help="Path to policy profile fetched from a supervisor running the input binary. "
+                             "IO/MSR descriptors will be reordered hottest first without changing any access verdict",
+                        type=str)
     args = parser.parse_args()
 
     logging.info("Log Started: " + datetime.datetime.strftime(
@@ -215,10 +237,20 @@ def main() -> int:
         logging.critical("Invalid output version specified")
         return -3
 
+    if args.profile_path is not None:
+        if not os.path.isfile(args.profile_path) or args.input_bin is None:
+            logging.critical("Policy profile requires a valid profile file and the profiled input binary")
+            return -4
+        if args.optimize:
+            logging.critical("Policy profile cannot be combined with optimize, which sorts the descriptors by address")
+            return -5
+
     return SupervisorPolicyMaker.MakeSupervisorPolicy(output_version=args.output_version,
                                                       input_bin=args.input_bin,
                                                       xml_file_path=args.xml_file_path,
-                                                      output_binary_path=args.output_binary_path)
+                                                      output_binary_path=args.output_binary_path,
+                                                      optimize=args.optimize,
+                                                      profile_path=args.profile_path)
 
 
 if __name__ == "__main__":
@@ -279,6 +279,96 @@ class PolicyRoot(object):
         self.AccessAttr = AccessAttribute(aa)
         return Buffer[self._StructSize:]
 
+    def Optimize(self) -> None:
+        ''' Canonicalize the descriptors of this root without changing the verdict of any access.
+        IO and MSR descriptors are sorted by address, merged where adjacent or overlapping with
+        identical attributes and stripped of shadowed entries.  Other types are left untouched.
+        '''
+        if self.Type == POLICY_TYPE.IO:
+            self.PolicyEntries = _OptimizeIoEntries(self.PolicyEntries)
+        elif self.Type == POLICY_TYPE.MSR:
+            self.PolicyEntries = _OptimizeMsrEntries(self.PolicyEntries)
+        self.Count = len(self.PolicyEntries)
+
+    def Reorder(self, HitCounts: list) -> list:
+        ''' Move the hottest IO or MSR descriptors towards the front of this root.  A descriptor is
+        only moved ahead of another one if no access could tell the two orders apart and the
+        supervisor overlap checks accept either order, a cold
+        descriptor that has to stay ahead of a hot one is pulled forward together with it.
+        HitCounts: number of requests decided by each descriptor, in the current order.
+        return the hit counts in the new order
+        '''
+        if len(HitCounts) != len(self.PolicyEntries):
+            raise Exception("Profile does not match policy")
+        if self.Type not in (POLICY_TYPE.IO, POLICY_TYPE.MSR):
+            return HitCounts
+
+        count = len(self.PolicyEntries)
+        blockers = [0] * count
+        followers = [[] for _ in range(count)]
+        for i in range(count):
+            for j in range(i + 1, count):
+                if _EntriesConflict(self.PolicyEntries[i], self.PolicyEntries[j]):
+                    blockers[j] += 1
+                    followers[i].append(j)
+
+        # Rank each descriptor by the hottest descriptor it has to precede, including itself
+        rank = list(HitCounts)
+        for i in reversed(range(count)):
+            for j in followers[i]:
+                rank[i] = max(rank[i], rank[j])
+
+        order = []
+        ready = [i for i in range(count) if blockers[i] == 0]
+        while ready:
+            pick = max(ready, key=lambda i: (rank[i], HitCounts[i], -i))
+            ready.remove(pick)
+            order.append(pick)
+            for j in followers[pick]:
+                blockers[j] -= 1
+                if blockers[j] == 0:
+                    ready.append(j)
+
+        self.PolicyEntries = [self.PolicyEntries[i] for i in order]
+        return [HitCounts[i] for i in order]
+
+    def IsSorted(self) -> bool:
+        ''' Check the descriptors of this root against the layout advertised by
+        PolicyFlags.SORTED_DESCRIPTORS: IO strict width descriptors first, then range
+        descriptors sorted by address and not overlapping each other.
+        '''
+        if self.Type == POLICY_TYPE.IO:
+            ranges = []
+            for pe in self.PolicyEntries:
+                if pe.Attributes.value & AccessType.STRICT_WIDTH_INHERITED:
+                    if ranges:
+                        return False
+                else:
+                    ranges.append((pe.IoAddress, pe.IoAddress + pe.Size))
+        elif self.Type == POLICY_TYPE.MSR:
+            ranges = [(pe.MsrAddress, pe.MsrAddress + pe.Size) for pe in self.PolicyEntries]
+        else:
+            return True
+
+        for (prev, cur) in zip(ranges, ranges[1:]):
+            if prev[1] > cur[0]:
+                return False
+        return True
+
+    def IsAccessRejected(self, Address: int, AccessMask: int, Size: int = 1) -> bool:
+        ''' Evaluate an IO or MSR access against this root the same way SmmPolicyGateLib does.
+        Size is the IO access width in bytes and is ignored for MSR.
+        '''
+        if self.Type == POLICY_TYPE.IO:
+            attr = _FirstIoMatch(self.PolicyEntries, Address, Size)
+        elif self.Type == POLICY_TYPE.MSR:
+            attr = _FirstMsrMatch(self.PolicyEntries, Address)
+        else:
+            raise NotImplementedError(f"Can't evaluate policy of type {self.Type}")
+
+        found = attr is not None and (attr & AccessMask) != 0
+        return found == (self.AccessAttr.value == AccessAttribute.ACCESS_ATTR_DENY)
+
     def GetSize(self) -> int:
         return self.PolicyRootSize
 
@@ -636,6 +726,261 @@ class SaveStatePolicyEntry(PolicyEntry):
         outfs.write(f"{prefix}  AccessCondition: {ALLOWED_SAVE_STATE_ACCESS_CONDITION(self.AccessCondition).name}\n")
 
 
+class PolicyFlags(object):
+    ''' Flag bits of the v1.0 policy header, see SMM_SUPV_SECURE_POLICY_FLAG_* in SmmSecurePolicy.h
+    '''
+    SORTED_DESCRIPTORS      = 1     # BIT0
+
+    bits = ["SORTED DESCRIPTORS"]
+
+
+# Only the read and write attributes take part in IO and MSR policy evaluation
+_IO_MSR_EVAL_MASK = AccessType.READ_INHERITED | AccessType.WRITE_INHERITED
+# IO accesses supported by the policy gate are 1, 2 or 4 bytes wide
+_IO_ACCESS_WIDTHS = (1, 2, 4)
+_UINT16_MAX = 0xFFFF
+_UINT32_MAX = 0xFFFFFFFF
+
+
+def _IoEntryMatch(pe, IoAddress: int, IoSize: int) -> bool:
+    ''' Mirror of the descriptor match in IoPolicyLookup of SmmPolicyGateLib '''
+    if pe.Attributes.value & AccessType.STRICT_WIDTH_INHERITED:
+        return IoAddress == pe.IoAddress and IoSize == pe.Size
+    # Either the first or the last port of the access falls in the descriptor
+    end = pe.IoAddress + pe.Size
+    return (pe.IoAddress <= IoAddress < end) or (pe.IoAddress < IoAddress + IoSize <= end)
+
+
+def _MsrEntryMatch(pe, MsrAddress: int) -> bool:
+    ''' Mirror of the descriptor match in MsrPolicyLookup of SmmPolicyGateLib, including UINT32 wrap '''
+    return pe.MsrAddress <= MsrAddress < ((pe.MsrAddress + pe.Size) & _UINT32_MAX)
+
+
+def _FirstIoMatch(entries: list, IoAddress: int, IoSize: int):
+    ''' Return the attributes of the first IO descriptor covering the access, None if there is none '''
+    for pe in entries:
+        if _IoEntryMatch(pe, IoAddress, IoSize):
+            return pe.Attributes.value
+    return None
+
+
+def _FirstMsrMatch(entries: list, MsrAddress: int):
+    ''' Return the attributes of the first MSR descriptor covering the MSR, None if there is none '''
+    for pe in entries:
+        if _MsrEntryMatch(pe, MsrAddress):
+            return pe.Attributes.value
+    return None
+
+
+def _EvalBits(attr) -> int:
+    ''' Reduce a first match result to the bits the policy gate actually tests '''
+    return 0 if attr is None else (attr & _IO_MSR_EVAL_MASK)
+
+
+def _FlattenRanges(ranges: list) -> list:
+    ''' Resolve a list of first-match (start, end, attributes) ranges into sorted, non-overlapping
+    (start, end, attributes) segments.  Every address resolves to the attributes of the first range
+    covering it, adjacent segments with identical attributes are merged, and segments whose attributes
+    carry neither read nor write are dropped, as they can never produce a match.
+    '''
+    bounds = sorted(set([r[0] for r in ranges] + [r[1] for r in ranges]))
+    segments = []
+    for lo, hi in zip(bounds, bounds[1:]):
+        attr = None
+        for (start, end, a) in ranges:
+            if start <= lo < end:
+                attr = a
+                break
+        if attr is None or (attr & _IO_MSR_EVAL_MASK) == 0:
+            continue
+        if segments and segments[-1][1] == lo and segments[-1][2] == attr:
+            segments[-1] = (segments[-1][0], hi, attr)
+        else:
+            segments.append((lo, hi, attr))
+    return segments
+
+
+def _SplitSegments(segments: list, points: set) -> list:
+    ''' Split segments at the given points and into chunks that fit a UINT16 length field '''
+    result = []
+    for (start, end, attr) in segments:
+        cuts = sorted(p for p in points if start < p < end)
+        for (lo, hi) in zip([start] + cuts, cuts + [end]):
+            while hi - lo > _UINT16_MAX:
+                result.append((lo, lo + _UINT16_MAX, attr))
+                lo += _UINT16_MAX
+            result.append((lo, hi, attr))
+    return result
+
+
+def _OptimizeIoEntries(entries: list) -> list:
+    ''' Canonicalize IO descriptors without changing the verdict of any 1, 2 or 4 byte access.
+
+    Strict width descriptors are placed first, widest first so that no strict width descriptor is
+    shadowed by a later superset, followed by the range descriptors sorted by address.  An access that
+    straddles two range segments is matched by the lower one after sorting, so every straddling access
+    whose verdict would change is pinned with a strict width descriptor carrying its original result.
+    Returns the original list if the canonical form cannot be expressed.
+    '''
+    ranges = []
+    for pe in entries:
+        if (pe.Attributes.value & AccessType.STRICT_WIDTH_INHERITED) == 0 and pe.Size != 0:
+            ranges.append((pe.IoAddress, pe.IoAddress + pe.Size, pe.Attributes.value))
+    segments = _FlattenRanges(ranges)
+
+    # Keep the strict width descriptors that are the first match of their own access
+    stricts = {}
+    for index, pe in enumerate(entries):
+        if (pe.Attributes.value & AccessType.STRICT_WIDTH_INHERITED) == 0 or pe.Size not in _IO_ACCESS_WIDTHS:
+            continue
+        if not any(_IoEntryMatch(r, pe.IoAddress, pe.Size) for r in entries[:index]):
+            stricts[(pe.IoAddress, pe.Size)] = pe.Attributes.value
+
+    def Build(stricts, segments):
+        result = []
+        for (address, size) in sorted(stricts, key=lambda k: (-k[1], k[0])):
+            result.append(IoPolicyEntry(address, size, stricts[(address, size)]))
+        for (start, end, attr) in segments:
+            result.append(IoPolicyEntry(start, end - start, attr))
+        return result
+
+    def Mismatches(candidate):
+        bounds = set()
+        for pe in entries + candidate:
+            if (pe.Attributes.value & AccessType.STRICT_WIDTH_INHERITED) == 0:
+                bounds.update((pe.IoAddress, pe.IoAddress + pe.Size))
+        accesses = set((pe.IoAddress, pe.Size) for pe in entries + candidate
+                       if (pe.Attributes.value & AccessType.STRICT_WIDTH_INHERITED) and pe.Size in _IO_ACCESS_WIDTHS)
+        for b in bounds:
+            for width in _IO_ACCESS_WIDTHS[1:]:
+                # Every access with a descriptor boundary strictly inside of it
+                for address in range(max(b - width + 1, 0), min(b, _UINT16_MAX + 1)):
+                    accesses.add((address, width))
+        result = {}
+        for (address, width) in sorted(accesses):
+            expected = _FirstIoMatch(entries, address, width)
+            if _EvalBits(expected) != _EvalBits(_FirstIoMatch(candidate, address, width)):
+                result[(address, width)] = (0 if expected is None else expected) | AccessType.STRICT_WIDTH_INHERITED
+        return result
+
+    stricts.update(Mismatches(Build(stricts, segments)))
+
+    # The supervisor rejects a policy where a strict width descriptor is followed by its superset,
+    # cut the range segments so none of them fully contains a strict width descriptor
+    points = set(address + 1 for (address, size) in stricts if size > 1)
+    segments = _SplitSegments(segments, points)
+    if any(start > _UINT16_MAX for (start, _, _) in segments):
+        return entries
+
+    result = Build(stricts, segments)
+    if Mismatches(result):
+        return entries
+    return result
+
+
+def _OptimizeMsrEntries(entries: list) -> list:
+    ''' Canonicalize MSR descriptors into sorted, non-overlapping ranges.  MSR lookup is a plain
+    first match on a single address, so the flattened segments are equivalent by construction.
+    '''
+    ranges = []
+    for pe in entries:
+        end = (pe.MsrAddress + pe.Size) & _UINT32_MAX
+        if end > pe.MsrAddress:
+            ranges.append((pe.MsrAddress, end, pe.Attributes.value))
+    return [MsrPolicyEntry(start, end - start, attr) for (start, end, attr) in _SplitSegments(_FlattenRanges(ranges), set())]
+
+
+class PolicyProfile(object):
+    '''
+    Per descriptor hit counters fetched through MM_SUPERVISOR_REQUEST_POLICY_PROFILE
+
+    UINT32 IoDescriptorCount;               // Number of IO descriptors in the policy in effect
+    UINT32 MsrDescriptorCount;              // Number of MSR descriptors in the policy in effect
+    UINT32 IoHitCounts[IoDescriptorCount + 1];
+    UINT32 MsrHitCounts[MsrDescriptorCount + 1];
+
+    The last counter of each group counts the requests that did not match any descriptor.
+    '''
+    _StructFormat = '<II'
+    _StructSize = struct.calcsize(_StructFormat)
+
+    def __init__(self):
+        self.HitCounts = {POLICY_TYPE.IO: [], POLICY_TYPE.MSR: []}
+        self.MissCounts = {POLICY_TYPE.IO: 0, POLICY_TYPE.MSR: 0}
+
+    def Decode(self, Buffer: bytes) -> bytes:
+        ''' Update self to match the data found in Buffer.
+        return any remaining data not part of self
+        '''
+        (ioc, msrc) = struct.unpack_from(self._StructFormat, Buffer)
+        Buffer = Buffer[self._StructSize:]
+        for (tp, count) in ((POLICY_TYPE.IO, ioc), (POLICY_TYPE.MSR, msrc)):
+            counters = list(struct.unpack_from(f'<{count + 1}I', Buffer))
+            self.HitCounts[tp] = counters[:count]
+            self.MissCounts[tp] = counters[count]
+            Buffer = Buffer[(count + 1) * 4:]
+        return Buffer
+
+
+def _IoEntriesOrdered(a, b) -> bool:
+    ''' Check whether the supervisor IO overlap check depends on the relative order of two IO
+    descriptors, whatever their attributes.  It accepts a strict width descriptor partially
+    overlapped by a following one but not by a preceding non strict width one, rejects a
+    following descriptor covering it, and only accepts a zero sized descriptor ahead of every
+    non strict width descriptor, or as the last one when it is not strict width itself.
+    '''
+    a_strict = (a.Attributes.value & AccessType.STRICT_WIDTH_INHERITED) != 0
+    b_strict = (b.Attributes.value & AccessType.STRICT_WIDTH_INHERITED) != 0
+    a_end = a.IoAddress + a.Size
+    b_end = b.IoAddress + b.Size
+    if a.Size == 0 or b.Size == 0:
+        if not (a_strict and b_strict):
+            return True
+        # Covering a zero sized strict width descriptor includes ending at its address
+        return (a.IoAddress <= b.IoAddress and a_end >= b_end) or (b.IoAddress <= a.IoAddress and b_end >= a_end)
+    return a.IoAddress < b_end and b.IoAddress < a_end
+
+
+def _EntriesConflict(a, b) -> bool:
+    ''' Check whether the relative order of two IO or MSR descriptors can change the verdict
+    of any access, i.e. some access is matched by both and they do not grant the same bits,
+    or whether the supervisor would reject one of the orders.
+    The IO check is conservative, any two ranges closer than the widest access conflict.
+    '''
+    if a.GetType() == POLICY_TYPE.IO and _IoEntriesOrdered(a, b):
+        return True
+
+    if (a.Attributes.value & _IO_MSR_EVAL_MASK) == (b.Attributes.value & _IO_MSR_EVAL_MASK):
+        return False
+
+    if a.GetType() == POLICY_TYPE.MSR:
+        a_end = (a.MsrAddress + a.Size) & _UINT32_MAX
+        b_end = (b.MsrAddress + b.Size) & _UINT32_MAX
+        return a.MsrAddress < b_end and b.MsrAddress < a_end
+
+    a_strict = (a.Attributes.value & AccessType.STRICT_WIDTH_INHERITED) != 0
+    b_strict = (b.Attributes.value & AccessType.STRICT_WIDTH_INHERITED) != 0
+    if a_strict and b_strict:
+        return a.IoAddress == b.IoAddress and a.Size == b.Size
+    if a_strict:
+        return _IoEntryMatch(b, a.IoAddress, a.Size)
+    if b_strict:
+        return _IoEntryMatch(a, b.IoAddress, b.Size)
+    reach = _IO_ACCESS_WIDTHS[-1] - 1
+    return a.IoAddress < b.IoAddress + b.Size + reach and b.IoAddress < a.IoAddress + a.Size + reach
+
+
+def ExpectedProbeDepth(HitCounts: list, MissCount: int = 0) -> float:
+    ''' Average number of descriptors walked per request, given the hit count of each descriptor
+    position and the number of requests that walked the whole root without a match.
+    '''
+    total = sum(HitCounts) + MissCount
+    if total == 0:
+        return 0.0
+    walked = sum((index + 1) * hits for index, hits in enumerate(HitCounts)) + MissCount * len(HitCounts)
+    return walked / total
+
+
 class PolicyDataCommonHeader(object):
     _StructFormat = '<IIII'
     _StructSize = struct.calcsize(_StructFormat)
@@ -655,6 +1000,7 @@ class Supervisor_Policy(object):
 
     def __init__(self, version: int = FLEXBILE_STRUCTURE_VERSION):
         self.Version = version
+        self.Flags = 0
         self.PolicyRoots = []
 
     def AddPolicyRoot(self, policyroot: Type[PolicyRoot]) -> None:
@@ -777,19 +1123,53 @@ class Supervisor_Policy(object):
 
             memory_offset = offset if memory_count != 0 else 0  # counter for offset
 
+            if (self.Flags & PolicyFlags.SORTED_DESCRIPTORS) and not all(pr.IsSorted() for pr in self.PolicyRoots):
+                raise Exception("Invalid Flags")
+
             header = struct.pack(self._StructFormat_v1_0,
                                 self.Version & 0xFFFF,
                                 (self.Version >> 16) & 0xFFFF,
                                 self.GetSize(),
                                 memory_offset,
                                 memory_count,
-                                0, 0, 0,
+                                self.Flags,
+                                0, 0,
                                 pr_offset,
                                 len(self.PolicyRoots)
                                 )
 
             return header + root + body + memory_entries
 
+    def Optimize(self) -> list:
+        ''' Canonicalize every policy root, see PolicyRoot.Optimize, and advertise the sorted
+        descriptor layout in the header flags.
+        return a list of (type, count before, count after) for each policy root
+        '''
+        report = []
+        for pr in self.PolicyRoots:
+            before = len(pr.PolicyEntries)
+            pr.Optimize()
+            report.append((pr.GetType(), before, len(pr.PolicyEntries)))
+        self.Flags |= PolicyFlags.SORTED_DESCRIPTORS
+        return report
+
+    def ApplyProfile(self, profile: Type[PolicyProfile]) -> list:
+        ''' Reorder the IO and MSR descriptors hottest first, see PolicyRoot.Reorder.  The
+        profile has to be taken from a supervisor running exactly this policy.
+        return a list of (type, expected probe depth before, expected probe depth after)
+        '''
+        report = []
+        for pr in self.PolicyRoots:
+            if pr.GetType() not in (POLICY_TYPE.IO, POLICY_TYPE.MSR):
+                continue
+            before = list(profile.HitCounts[pr.GetType()])
+            miss = profile.MissCounts[pr.GetType()]
+            after = pr.Reorder(before)
+            report.append((pr.GetType(), ExpectedProbeDepth(before, miss), ExpectedProbeDepth(after, miss)))
+            if not pr.IsSorted():
+                self.Flags &= ~PolicyFlags.SORTED_DESCRIPTORS
+        return report
+
     def GetSize(self) -> int:
         ''' Calculate the size of the output binary encoded policy'''
         if self.Version < Supervisor_Policy.FLEXBILE_STRUCTURE_VERSION:
@@ -888,6 +1268,8 @@ class Supervisor_Policy(object):
             if prc == 0:
                 raise Exception("Invalid PolicyRootCount")
 
+            self.Flags = fg
+
             ReturnBuffer = Buffer[s:]  # return this buffer
 
             PolicyBuffer = Buffer[:s]  #
@@ -960,6 +1342,7 @@ class Supervisor_Policy(object):
         outfs.write(f"{prefix}Supervisor Policy Object\n")
         outfs.write(f"{prefix}  Version: {self.Version}\n")
         outfs.write(f"{prefix}  Size: {self.GetSize()}\n")
+        outfs.write(f"{prefix}  Flags: 0x{self.Flags:08X}\n")
         outfs.write(f"{prefix}  Policy Roots: {len(self.PolicyRoots)}\n")
         for pr in self.PolicyRoots:
             pr.DumpInfo(prefix=prefix + "    ", short=short, outfs=outfs)
@@ -251,5 +251,137 @@ class TestSupervisorPolicy(unittest.TestCase):
         ret = a.Encode()
         self.assertEqual(ret, bytes.fromhex(self.VALID_POLICY))
 
+class TestPolicyOptimize(unittest.TestCase):
+
+    RW = AccessType.READ_INHERITED + AccessType.WRITE_INHERITED
+    STRICT = AccessType.STRICT_WIDTH_INHERITED
+
+    def assertSameVerdicts(self, before, after, addresses, widths):
+        ''' Every access must be rejected by the optimized root exactly when it was rejected before '''
+        for access_attr in (AccessAttribute.ACCESS_ATTR_ALLOW, AccessAttribute.ACCESS_ATTR_DENY):
+            before.AccessAttr = AccessAttribute(access_attr)
+            after.AccessAttr = AccessAttribute(access_attr)
+            for address in addresses:
+                for width in widths:
+                    for mask in (AccessType.READ_INHERITED, AccessType.WRITE_INHERITED):
+                        self.assertEqual(before.IsAccessRejected(address, mask, width),
+                                         after.IsAccessRejected(address, mask, width),
+                                         f"address 0x{address:X} width {width} mask {mask}")
+
+    def assertIoOverlapAccepted(self, root):
+        ''' Apply the IO overlap rules of CheckIoPolicyOverlap in the supervisor to every pair of descriptors '''
+        entries = root.PolicyEntries
+        strict = [(pe.Attributes.value & self.STRICT) != 0 for pe in entries]
+        non_strict = [i for i in range(len(entries)) if not strict[i]]
+        for (i, pe) in enumerate(entries):
+            if pe.Size == 0 and len(entries) > 1:
+                self.assertFalse(non_strict and non_strict[0] < i, f"IO policy {i} has zero size")
+                self.assertFalse(not strict[i] and i < len(entries) - 1, f"IO policy {i} has zero size")
+
+        for i in range(len(entries)):
+            for j in range(i + 1, len(entries)):
+                (a, b) = (entries[i], entries[j])
+                a_end = a.IoAddress + a.Size
+                b_end = b.IoAddress + b.Size
+                if strict[i]:
+                    # A following descriptor may overlap a strict width one, but not cover it
+                    self.assertFalse(b.IoAddress <= a.IoAddress and b_end >= a_end,
+                                     f"IO policy {j} covers strict width policy {i}")
+                elif a.Size != 0 and b.Size != 0:
+                    self.assertFalse(a.IoAddress < b_end and b.IoAddress < a_end, f"IO policy {i} overlaps {j}")
+
+    def make_roots(self, type, entries):
+        before = PolicyRoot(Type=type, AccessAttr=AccessAttribute.ACCESS_ATTR_DENY)
+        after = PolicyRoot(Type=type, AccessAttr=AccessAttribute.ACCESS_ATTR_DENY)
+        for e in entries:
+            before.AddPolicy(e())
+            after.AddPolicy(e())
+        after.Optimize()
+        self.assertTrue(after.IsSorted())
+        self.assertEqual(after.Count, len(after.PolicyEntries))
+        return (before, after)
+
+    def test_optimize_io_policy(self):
+        entries = [
+            lambda: IoPolicyEntry(0x70, 2, self.RW),
+            lambda: IoPolicyEntry(0x60, 4, AccessType.WRITE_INHERITED),
+            lambda: IoPolicyEntry(0x64, 4, AccessType.WRITE_INHERITED),    # adjacent, same attributes
+            lambda: IoPolicyEntry(0x62, 4, AccessType.WRITE_INHERITED),    # overlapping, same attributes
+            lambda: IoPolicyEntry(0x71, 1, AccessType.READ_INHERITED),     # shadowed by the first entry
+            lambda: IoPolicyEntry(0xCF8, 4, AccessType.WRITE_INHERITED + self.STRICT),
+            lambda: IoPolicyEntry(0xCF8, 4, AccessType.READ_INHERITED + self.STRICT),  # duplicated strict width
+            lambda: IoPolicyEntry(0x61, 2, self.RW + self.STRICT),        # shadowed by an earlier range
+            lambda: IoPolicyEntry(0xCFC, 4, AccessType.READ_INHERITED),
+            lambda: IoPolicyEntry(0x6A, 2, self.RW),                       # straddled against the range below
+            lambda: IoPolicyEntry(0x68, 2, AccessType.READ_INHERITED),
+            lambda: IoPolicyEntry(0x80, 4, AccessType.INHERITED),          # never produces a match
+        ]
+        (before, after) = self.make_roots(POLICY_TYPE.IO, entries)
+        self.assertLess(after.Count, before.Count)
+        addresses = list(range(0x58, 0x90)) + list(range(0xCF0, 0xD08))
+        self.assertSameVerdicts(before, after, addresses, (1, 2, 4))
+
+    def test_optimize_msr_policy(self):
+        entries = [
+            lambda: MsrPolicyEntry(0xC0000084, 4, AccessType.WRITE_INHERITED),
+            lambda: MsrPolicyEntry(0xC0000080, 4, AccessType.WRITE_INHERITED),
+            lambda: MsrPolicyEntry(0xC0000082, 1, self.RW),                # shadowed by the second entry
+            lambda: MsrPolicyEntry(0xC0000086, 4, self.RW),                # overlapping, different attributes
+            lambda: MsrPolicyEntry(0xC0000100, 0x10, AccessType.READ_INHERITED),
+            lambda: MsrPolicyEntry(0xC0000100, 0x10, AccessType.READ_INHERITED),
+            lambda: MsrPolicyEntry(0xFFFFFFF0, 0x20, self.RW),             # wraps around, never matches
+        ]
+        (before, after) = self.make_roots(POLICY_TYPE.MSR, entries)
+        self.assertEqual(after.Count, 3)
+        addresses = list(range(0xC0000078, 0xC0000118)) + list(range(0xFFFFFFE0, 0x100000000))
+        self.assertSameVerdicts(before, after, addresses, (1,))
+
+    def test_reorder_by_profile(self):
+        entries = [
+            lambda: IoPolicyEntry(0x60, 4, AccessType.WRITE_INHERITED),
+            lambda: IoPolicyEntry(0x70, 2, self.RW),
+            lambda: IoPolicyEntry(0xCF8, 4, self.RW + self.STRICT),
+            lambda: IoPolicyEntry(0xCFA, 4, self.RW),                      # partially overlaps the strict entry
+            lambda: IoPolicyEntry(0xCFE, 2, self.RW),
+        ]
+        before = PolicyRoot(Type=POLICY_TYPE.IO, AccessAttr=AccessAttribute.ACCESS_ATTR_DENY)
+        after = PolicyRoot(Type=POLICY_TYPE.IO, AccessAttr=AccessAttribute.ACCESS_ATTR_DENY)
+        for e in entries:
+            before.AddPolicy(e())
+            after.AddPolicy(e())
+        self.assertIoOverlapAccepted(before)
+
+        profile = PolicyProfile()
+        counters = [1, 10, 0, 100, 50, 3]
+        profile.Decode(struct.pack('<II', len(entries), 0) + struct.pack(f'<{len(counters)}I', *counters) + struct.pack('<I', 0))
+
+        hits = after.Reorder(profile.HitCounts[POLICY_TYPE.IO])
+        self.assertEqual(sorted(hits), sorted(counters[:-1]))
+        # The hot overlapping entry must stay behind the strict width entry, even with the same attributes
+        self.assertEqual([pe.IoAddress for pe in after.PolicyEntries], [0xCF8, 0xCFA, 0xCFE, 0x70, 0x60])
+        self.assertIoOverlapAccepted(after)
+        self.assertLess(ExpectedProbeDepth(hits, 3), ExpectedProbeDepth(counters[:-1], 3))
+        self.assertSameVerdicts(before, after, list(range(0x58, 0x80)) + list(range(0xCF0, 0xD08)), (1, 2, 4))
+
+    def test_optimize_sets_sorted_flag(self):
+        a = Supervisor_Policy()
+        a.Decode(bytes.fromhex(TestSupervisorPolicy.VALID_POLICY))
+        self.assertEqual(a.Flags, 0)
+        a.Optimize()
+        self.assertEqual(a.Flags, PolicyFlags.SORTED_DESCRIPTORS)
+
+        b = Supervisor_Policy()
+        b.Decode(a.Encode())
+        self.assertEqual(b.Flags, PolicyFlags.SORTED_DESCRIPTORS)
+
+        # Appending out of order entries breaks the advertised layout
+        for pr in b.PolicyRoots:
+            if pr.GetType() == POLICY_TYPE.MSR:
+                pr.AddPolicy(MsrPolicyEntry(0x10, 1, AccessType.READ_INHERITED))
+        with self.assertRaises(Exception) as context:
+            b.Encode()
+        self.assertTrue(str(context.exception).startswith("Invalid Flags"))
+
+
 if __name__ == '__main__':
     unittest.main()
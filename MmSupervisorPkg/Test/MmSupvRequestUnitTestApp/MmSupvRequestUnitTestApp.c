@@ -21,6 +21,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Library/UefiLib.h>
 #include <Library/DebugLib.h>
 #include <Library/PrintLib.h>
+#include <Library/ShellLib.h>
 #include <Library/UefiApplicationEntryPoint.h>
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/UnitTestLib.h>
@@ -35,9 +36,14 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 
 #define UNDEFINED_LEVEL  MAX_UINT32
 
+#define SYSCALL_TRACE_FILE_NAME   L"SyscallTrace.dat"
+#define POLICY_PROFILE_FILE_NAME  L"PolicyProfile.dat"
+
 MM_SUPERVISOR_COMMUNICATION_PROTOCOL  *SupvCommunication              = NULL;
 VOID                                  *mMmSupvCommonCommBufferAddress = NULL;
 UINTN                                 mMmSupvCommonCommBufferSize;
+UINT32                                mOriginalDemotionPath = MM_SUPERVISOR_DEMOTION_PATH_QUERY;
+MM_SUPERVISOR_SYSCALL_TRACE_BUFFER    *mSyscallTraceLog     = NULL;
 
 /*
 MSRs level 20
@@ -313,6 +319,58 @@ Done:
   return SecurityPolicy;
 }
 
+/*
+  Helper function to select or query the demotion path of supervisor
+
+  @param[in]  Path        MM_SUPERVISOR_DEMOTION_PATH_* to select, or MM_SUPERVISOR_DEMOTION_PATH_QUERY.
+  @param[out] PathBuffer  Supervisor reply, valid when the returned status is not an error.
+
+  @retval     The communication status if it failed, otherwise the status of the request handler.
+*/
+STATIC
+EFI_STATUS
+SendDemotionPathRequest (
+  IN  UINT32                              Path,
+  OUT MM_SUPERVISOR_DEMOTION_PATH_BUFFER  **PathBuffer
+  )
+{
+  EFI_STATUS                    Status;
+  MM_SUPERVISOR_REQUEST_HEADER  *CommBuffer;
+
+  // Grab the CommBuffer and fill it in for this request
+  Status = MmSupvRequestGetCommBuffer (&CommBuffer);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  CommBuffer->Signature = MM_SUPERVISOR_REQUEST_SIG;
+  CommBuffer->Revision  = MM_SUPERVISOR_REQUEST_REVISION;
+  CommBuffer->Request   = MM_SUPERVISOR_REQUEST_DEMOTION_PATH;
+  CommBuffer->Result    = EFI_SUCCESS;
+
+  *PathBuffer                  = (MM_SUPERVISOR_DEMOTION_PATH_BUFFER *)(CommBuffer + 1);
+  (*PathBuffer)->RequestedPath = Path;
+  (*PathBuffer)->SelectedPath  = MAX_UINT32;
+  (*PathBuffer)->ActivePath    = MAX_UINT32;
+
+  ((EFI_MM_COMMUNICATE_HEADER *)mMmSupvCommonCommBufferAddress)->MessageLength = sizeof (MM_SUPERVISOR_REQUEST_HEADER) +
+                                                                                sizeof (MM_SUPERVISOR_DEMOTION_PATH_BUFFER);
+
+  Status = MmSupvRequestDxeToMmCommunicate ();
+  if (EFI_ERROR (Status)) {
+    // We encountered some errors on our way switching the demotion path.
+    UT_LOG_ERROR ("Supervisor did not successfully process demotion path request %r.\n", Status);
+    return Status;
+  }
+
+  // Get the real handler status code
+  if ((UINTN)CommBuffer->Result != 0) {
+    Status = ENCODE_ERROR ((UINTN)CommBuffer->Result);
+  }
+
+  return Status;
+}
+
 /*
   Helper function to check possible policy level on the MSR block
 */
@@ -622,6 +680,46 @@ LocateMmCommonCommBuffer (
 /// ================================================================================================
 /// ================================================================================================
 
+/*
+  Cleanup function to release the syscall trace log, no matter where the syscall trace test stopped.
+*/
+VOID
+EFIAPI
+FreeSyscallTraceLog (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  if (mSyscallTraceLog != NULL) {
+    FreePool (mSyscallTraceLog);
+    mSyscallTraceLog = NULL;
+  }
+}
+
+/*
+  Cleanup function to select the demotion path that was in use before the demotion path test,
+  no matter where that test stopped.
+*/
+VOID
+EFIAPI
+RestoreDemotionPath (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS                          Status;
+  MM_SUPERVISOR_DEMOTION_PATH_BUFFER  *PathBuffer;
+
+  if (mOriginalDemotionPath == MM_SUPERVISOR_DEMOTION_PATH_QUERY) {
+    return;
+  }
+
+  Status = SendDemotionPathRequest (mOriginalDemotionPath, &PathBuffer);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "[%a] - Failed to restore demotion path %d - %r\n", __FUNCTION__, mOriginalDemotionPath, Status));
+  }
+
+  mOriginalDemotionPath = MM_SUPERVISOR_DEMOTION_PATH_QUERY;
+}
+
 /// ================================================================================================
 /// ================================================================================================
 ///
@@ -918,6 +1016,310 @@ RequestUpdateCommBuffer (
   return UNIT_TEST_PASSED;
 }
 
+/*
+  Test case to drain syscall trace entries from supervisor. The drained entries are written to
+  SyscallTrace.dat in the current working directory for SyscallTraceDecoder.py to consume. The
+  log is released by FreeSyscallTraceLog.
+*/
+UNIT_TEST_STATUS
+EFIAPI
+RequestSyscallTrace (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS                          Status;
+  MM_SUPERVISOR_REQUEST_HEADER        *CommBuffer;
+  MM_SUPERVISOR_SYSCALL_TRACE_BUFFER  *TraceBuffer;
+  MM_SUPERVISOR_SYSCALL_TRACE_BUFFER  *TraceLog;
+  MM_SUPERVISOR_SYSCALL_TRACE_ENTRY   *Entries;
+  MM_SUPERVISOR_SYSCALL_TRACE_ENTRY   *LogEntries;
+  UINT64                              Capacity;
+  UINT64                              Index;
+  UINTN                               TraceLogSize;
+  SHELL_FILE_HANDLE                   FileHandle;
+
+  TraceLog = NULL;
+  Capacity = 0;
+
+  do {
+    // Grab the CommBuffer and fill it in for this test
+    Status = MmSupvRequestGetCommBuffer (&CommBuffer);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+
+    CommBuffer->Signature = MM_SUPERVISOR_REQUEST_SIG;
+    CommBuffer->Revision  = MM_SUPERVISOR_REQUEST_REVISION;
+    CommBuffer->Request   = MM_SUPERVISOR_REQUEST_SYSCALL_TRACE;
+    CommBuffer->Result    = EFI_SUCCESS;
+
+    // Offer the entire communication buffer so that each round trip drains as much as possible
+    ((EFI_MM_COMMUNICATE_HEADER *)mMmSupvCommonCommBufferAddress)->MessageLength = mMmSupvCommonCommBufferSize -
+                                                                                  OFFSET_OF (EFI_MM_COMMUNICATE_HEADER, Data);
+
+    Status = MmSupvRequestDxeToMmCommunicate ();
+
+    if (EFI_ERROR (Status)) {
+      // We encountered some errors on our way draining syscall trace.
+      UT_LOG_ERROR ("Supervisor did not successfully process syscall trace request %r.\n", Status);
+      UT_ASSERT_NOT_EFI_ERROR (Status);
+    }
+
+    if (CommBuffer->Result == EFI_UNSUPPORTED) {
+      UT_LOG_WARNING ("Syscall tracing is not enabled in this supervisor.\n");
+      return UNIT_TEST_SKIPPED;
+    }
+
+    // Get the real handler status code
+    if ((UINTN)CommBuffer->Result != 0) {
+      Status = ENCODE_ERROR ((UINTN)CommBuffer->Result);
+    }
+
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+
+    TraceBuffer = (MM_SUPERVISOR_SYSCALL_TRACE_BUFFER *)(CommBuffer + 1);
+    Entries     = (MM_SUPERVISOR_SYSCALL_TRACE_ENTRY *)(TraceBuffer + 1);
+    UT_ASSERT_NOT_EQUAL (TraceBuffer->NumberOfCpus, 0);
+    UT_ASSERT_NOT_EQUAL (TraceBuffer->EntriesPerCpu, 0);
+
+    if (TraceLog == NULL) {
+      // Whatever is in the rings upon the first request is bounded by the ring capacity
+      Capacity = MultU64x32 (TraceBuffer->NumberOfCpus, TraceBuffer->EntriesPerCpu);
+      TraceLog = AllocateZeroPool (sizeof (MM_SUPERVISOR_SYSCALL_TRACE_BUFFER) + (UINTN)Capacity * sizeof (MM_SUPERVISOR_SYSCALL_TRACE_ENTRY));
+      UT_ASSERT_NOT_NULL (TraceLog);
+      mSyscallTraceLog        = TraceLog;
+      TraceLog->NumberOfCpus  = TraceBuffer->NumberOfCpus;
+      TraceLog->EntriesPerCpu = TraceBuffer->EntriesPerCpu;
+    }
+
+    LogEntries = (MM_SUPERVISOR_SYSCALL_TRACE_ENTRY *)(TraceLog + 1);
+    for (Index = 0; (Index < TraceBuffer->EntryCount) && (TraceLog->EntryCount < Capacity); Index++) {
+      UT_ASSERT_TRUE (Entries[Index].CpuIndex < TraceBuffer->NumberOfCpus);
+      CopyMem (&LogEntries[TraceLog->EntryCount], &Entries[Index], sizeof (MM_SUPERVISOR_SYSCALL_TRACE_ENTRY));
+      TraceLog->EntryCount++;
+    }
+
+    TraceLog->DroppedCount  += TraceBuffer->DroppedCount;
+    TraceLog->RemainingCount = TraceBuffer->RemainingCount;
+  } while ((TraceBuffer->RemainingCount != 0) && (TraceBuffer->EntryCount != 0) && (TraceLog->EntryCount < Capacity));
+
+  UT_LOG_INFO ("Drained %ld syscall trace entries, %ld dropped.\n", TraceLog->EntryCount, TraceLog->DroppedCount);
+
+  // Failing to persist the log does not make the supervisor wrong, just complain about it
+  TraceLogSize = sizeof (MM_SUPERVISOR_SYSCALL_TRACE_BUFFER) + (UINTN)TraceLog->EntryCount * sizeof (MM_SUPERVISOR_SYSCALL_TRACE_ENTRY);
+  Status       = ShellOpenFileByName (
+                   SYSCALL_TRACE_FILE_NAME,
+                   &FileHandle,
+                   EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE | EFI_FILE_MODE_CREATE,
+                   0
+                   );
+  if (!EFI_ERROR (Status)) {
+    Status = ShellWriteFile (FileHandle, &TraceLogSize, TraceLog);
+    ShellCloseFile (&FileHandle);
+  }
+
+  if (EFI_ERROR (Status)) {
+    UT_LOG_WARNING ("Failed to write %s - %r.\n", SYSCALL_TRACE_FILE_NAME, Status);
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/*
+  Test case to fetch the IO and MSR policy hit counters from supervisor. The counters are written to
+  PolicyProfile.dat in the current working directory for SupervisorPolicyMaker.py to consume.
+*/
+UNIT_TEST_STATUS
+EFIAPI
+RequestPolicyProfile (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS                           Status;
+  MM_SUPERVISOR_REQUEST_HEADER         *CommBuffer;
+  MM_SUPERVISOR_POLICY_PROFILE_BUFFER  *ProfileBuffer;
+  UINTN                                ProfileSize;
+  SHELL_FILE_HANDLE                    FileHandle;
+
+  // Grab the CommBuffer and fill it in for this test
+  Status = MmSupvRequestGetCommBuffer (&CommBuffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  CommBuffer->Signature = MM_SUPERVISOR_REQUEST_SIG;
+  CommBuffer->Revision  = MM_SUPERVISOR_REQUEST_REVISION;
+  CommBuffer->Request   = MM_SUPERVISOR_REQUEST_POLICY_PROFILE;
+  CommBuffer->Result    = EFI_SUCCESS;
+
+  // Offer the entire communication buffer to hold the hit counters
+  ((EFI_MM_COMMUNICATE_HEADER *)mMmSupvCommonCommBufferAddress)->MessageLength = mMmSupvCommonCommBufferSize -
+                                                                                OFFSET_OF (EFI_MM_COMMUNICATE_HEADER, Data);
+
+  Status = MmSupvRequestDxeToMmCommunicate ();
+
+  if (EFI_ERROR (Status)) {
+    // We encountered some errors on our way fetching policy profile.
+    UT_LOG_ERROR ("Supervisor did not successfully process policy profile request %r.\n", Status);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+  }
+
+  if (CommBuffer->Result == EFI_UNSUPPORTED) {
+    UT_LOG_WARNING ("Policy profiling is not enabled in this supervisor.\n");
+    return UNIT_TEST_SKIPPED;
+  }
+
+  // Get the real handler status code
+  if ((UINTN)CommBuffer->Result != 0) {
+    Status = ENCODE_ERROR ((UINTN)CommBuffer->Result);
+  }
+
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  ProfileBuffer = (MM_SUPERVISOR_POLICY_PROFILE_BUFFER *)(CommBuffer + 1);
+  ProfileSize   = sizeof (MM_SUPERVISOR_POLICY_PROFILE_BUFFER) +
+                  ((UINTN)ProfileBuffer->IoDescriptorCount + ProfileBuffer->MsrDescriptorCount + 2) * sizeof (UINT32);
+  UT_ASSERT_TRUE (sizeof (MM_SUPERVISOR_REQUEST_HEADER) + ProfileSize <= mMmSupvCommonCommBufferSize);
+
+  UT_LOG_INFO (
+    "Fetched hit counters of %d IO and %d MSR descriptors.\n",
+    ProfileBuffer->IoDescriptorCount,
+    ProfileBuffer->MsrDescriptorCount
+    );
+
+  // Failing to persist the profile does not make the supervisor wrong, just complain about it
+  Status = ShellOpenFileByName (
+             POLICY_PROFILE_FILE_NAME,
+             &FileHandle,
+             EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE | EFI_FILE_MODE_CREATE,
+             0
+             );
+  if (!EFI_ERROR (Status)) {
+    Status = ShellWriteFile (FileHandle, &ProfileSize, ProfileBuffer);
+    ShellCloseFile (&FileHandle);
+  }
+
+  if (EFI_ERROR (Status)) {
+    UT_LOG_WARNING ("Failed to write %s - %r.\n", POLICY_PROFILE_FILE_NAME, Status);
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/*
+  Test case to fetch the page table pool usage from supervisor. The page tables built during
+  initialization are expected to fit in the pool reserved for them up front.
+*/
+UNIT_TEST_STATUS
+EFIAPI
+RequestPageTableUsage (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS                             Status;
+  MM_SUPERVISOR_REQUEST_HEADER           *CommBuffer;
+  MM_SUPERVISOR_PAGE_TABLE_USAGE_BUFFER  *UsageBuffer;
+
+  // Grab the CommBuffer and fill it in for this test
+  Status = MmSupvRequestGetCommBuffer (&CommBuffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  CommBuffer->Signature = MM_SUPERVISOR_REQUEST_SIG;
+  CommBuffer->Revision  = MM_SUPERVISOR_REQUEST_REVISION;
+  CommBuffer->Request   = MM_SUPERVISOR_REQUEST_PAGE_TABLE_USAGE;
+  CommBuffer->Result    = EFI_SUCCESS;
+
+  ((EFI_MM_COMMUNICATE_HEADER *)mMmSupvCommonCommBufferAddress)->MessageLength = sizeof (MM_SUPERVISOR_REQUEST_HEADER) +
+                                                                                sizeof (MM_SUPERVISOR_PAGE_TABLE_USAGE_BUFFER);
+
+  Status = MmSupvRequestDxeToMmCommunicate ();
+
+  if (EFI_ERROR (Status)) {
+    // We encountered some errors on our way fetching page table usage.
+    UT_LOG_ERROR ("Supervisor did not successfully process page table usage request %r.\n", Status);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+  }
+
+  // Get the real handler status code
+  if ((UINTN)CommBuffer->Result != 0) {
+    Status = ENCODE_ERROR ((UINTN)CommBuffer->Result);
+  }
+
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  UsageBuffer = (MM_SUPERVISOR_PAGE_TABLE_USAGE_BUFFER *)(CommBuffer + 1);
+  UT_LOG_INFO (
+    "Page table pools: 0x%lx of 0x%lx pages used in %d pool(s), 0x%lx pages estimated.\n",
+    UsageBuffer->UsedPages,
+    UsageBuffer->ReservedPages,
+    UsageBuffer->PoolCount,
+    UsageBuffer->EstimatedPages
+    );
+  UT_LOG_INFO (
+    "Split pool: 0x%lx of 0x%lx pages used, 0x%lx pages estimated, %ld failed requests.\n",
+    UsageBuffer->SplitUsedPages,
+    UsageBuffer->SplitReservedPages,
+    UsageBuffer->SplitEstimatedPages,
+    UsageBuffer->SplitFailedRequests
+    );
+
+  UT_ASSERT_TRUE (UsageBuffer->PoolCount >= 1);
+  UT_ASSERT_TRUE (UsageBuffer->UsedPages < UsageBuffer->ReservedPages);
+  UT_ASSERT_TRUE (UsageBuffer->SplitUsedPages <= UsageBuffer->SplitReservedPages);
+  UT_ASSERT_EQUAL (UsageBuffer->SplitFailedRequests, 0);
+
+  if (UsageBuffer->PoolCount > 1) {
+    UT_LOG_WARNING ("Page table pool grew beyond its estimate, %d pools are in use.\n", UsageBuffer->PoolCount);
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/*
+  Test case to switch the demotion path of supervisor. The call gate path can always be selected
+  and an unknown path is rejected. The path in use beforehand is restored by RestoreDemotionPath.
+*/
+UNIT_TEST_STATUS
+EFIAPI
+RequestDemotionPath (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS                          Status;
+  MM_SUPERVISOR_DEMOTION_PATH_BUFFER  *PathBuffer;
+  UINT32                              Paths[] = {
+    MM_SUPERVISOR_DEMOTION_PATH_CALL_GATE,
+    MM_SUPERVISOR_DEMOTION_PATH_SYSRET + 1,
+    MM_SUPERVISOR_DEMOTION_PATH_SYSRET
+  };
+  UINTN                               Index;
+
+  // Record the selected path first, so that the cleanup can put it back.
+  Status = SendDemotionPathRequest (MM_SUPERVISOR_DEMOTION_PATH_QUERY, &PathBuffer);
+  if (Status == EFI_UNSUPPORTED) {
+    UT_LOG_WARNING ("Demotion path switch is only served by test builds of the supervisor.\n");
+    return UNIT_TEST_SKIPPED;
+  }
+
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  mOriginalDemotionPath = PathBuffer->SelectedPath;
+
+  for (Index = 0; Index < ARRAY_SIZE (Paths); Index++) {
+    Status = SendDemotionPathRequest (Paths[Index], &PathBuffer);
+
+    if (Paths[Index] > MM_SUPERVISOR_DEMOTION_PATH_SYSRET) {
+      UT_ASSERT_STATUS_EQUAL (Status, EFI_INVALID_PARAMETER);
+      continue;
+    }
+
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+    UT_ASSERT_EQUAL (PathBuffer->SelectedPath, Paths[Index]);
+    if (Paths[Index] == MM_SUPERVISOR_DEMOTION_PATH_CALL_GATE) {
+      UT_ASSERT_EQUAL (PathBuffer->ActivePath, MM_SUPERVISOR_DEMOTION_PATH_CALL_GATE);
+    } else if (PathBuffer->ActivePath != MM_SUPERVISOR_DEMOTION_PATH_SYSRET) {
+      UT_LOG_WARNING ("SYSRET demotion is not available, demotions go through the call gate.\n");
+    }
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
 /// ================================================================================================
 /// ================================================================================================
 ///
@@ -1012,6 +1414,42 @@ MmSupvRequestUnitTestAppEntryPoint (
     NULL,
     NULL
     );
+  AddTestCase (
+    Misc,
+    "Syscall trace drain test",
+    "MmSupv.Miscellaneous.MmSupvSyscallTrace",
+    RequestSyscallTrace,
+    LocateMmCommonCommBuffer,
+    FreeSyscallTraceLog,
+    NULL
+    );
+  AddTestCase (
+    Misc,
+    "Policy profile fetch test",
+    "MmSupv.Miscellaneous.MmSupvPolicyProfile",
+    RequestPolicyProfile,
+    LocateMmCommonCommBuffer,
+    NULL,
+    NULL
+    );
+  AddTestCase (
+    Misc,
+    "Page table usage fetch test",
+    "MmSupv.Miscellaneous.MmSupvPageTableUsage",
+    RequestPageTableUsage,
+    LocateMmCommonCommBuffer,
+    NULL,
+    NULL
+    );
+  AddTestCase (
+    Misc,
+    "Demotion path switch test",
+    "MmSupv.Miscellaneous.MmSupvDemotionPath",
+    RequestDemotionPath,
+    LocateMmCommonCommBuffer,
+    RestoreDemotionPath,
+    NULL
+    );
 
   //
   // Execute the tests.
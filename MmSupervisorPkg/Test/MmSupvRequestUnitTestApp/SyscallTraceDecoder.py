@@ -0,0 +1,216 @@
+# @file
+# Decode a syscall trace drained from the MM supervisor into frequency and latency summaries.
+#  The input file is the SyscallTrace.dat written by MmSupvRequestUnitTestApp, which is a
+#  MM_SUPERVISOR_SYSCALL_TRACE_BUFFER header followed by MM_SUPERVISOR_SYSCALL_TRACE_ENTRY
+#  records, see Private/Guid/MmSupervisorRequestData.h.
+#
+# Copyright (c) Microsoft Corporation
+#
+# SPDX-License-Identifier: BSD-2-Clause-Patent
+##
+
+import csv
+import logging
+import os
+import struct
+import sys
+from argparse import ArgumentParser
+from collections import namedtuple
+
+# MM_SUPERVISOR_SYSCALL_TRACE_BUFFER
+TRACE_HEADER_FORMAT = "<IIQQQ"
+TRACE_HEADER_SIZE = struct.calcsize(TRACE_HEADER_FORMAT)
+
+# MM_SUPERVISOR_SYSCALL_TRACE_ENTRY
+TRACE_ENTRY_FORMAT = "<QIIQQQQQQ"
+TRACE_ENTRY_SIZE = struct.calcsize(TRACE_ENTRY_FORMAT)
+
+TraceHeader = namedtuple("TraceHeader", "NumberOfCpus EntriesPerCpu EntryCount DroppedCount RemainingCount")
+TraceEntry = namedtuple("TraceEntry", "Tsc CallIndex CpuIndex Arg1 Arg2 Arg3 CallerAddr Status Cycles")
+
+# Keep in sync with SMM_SYS_CALL in Include/Library/SysCallLib.h
+SYSCALL_NAMES = {
+    0x0000: "SMM_SC_RDMSR",
+    0x0001: "SMM_SC_WRMSR",
+    0x0002: "SMM_SC_CLI",
+    0x0003: "SMM_SC_IO_READ",
+    0x0004: "SMM_SC_IO_WRITE",
+    0x0005: "SMM_SC_WBINVD",
+    0x0006: "SMM_SC_HLT",
+    0x0007: "SMM_SC_SVST_READ",
+    0x0008: "SMM_SC_PROC_READ",
+    0x0009: "SMM_SC_PROC_WRITE",
+    0x10000: "SMM_REG_HDL_JMP",
+    0x10001: "SMM_INST_CONF_T",
+    0x10002: "SMM_ALOC_POOL",
+    0x10003: "SMM_FREE_POOL",
+    0x10004: "SMM_ALOC_PAGE",
+    0x10005: "SMM_FREE_PAGE",
+    0x10006: "SMM_START_AP_PROC",
+    0x10007: "SMM_REG_HNDL",
+    0x10018: "SMM_UNREG_HNDL",
+    0x10019: "SMM_SET_CPL3_TBL",
+    0x1001A: "SMM_INST_PROT",
+    0x1001B: "SMM_QRY_HOB",
+    0x1001C: "SMM_ERR_RPT_JMP",
+    0x1001D: "SMM_MM_HDL_REG_1",
+    0x1001E: "SMM_MM_HDL_REG_2",
+    0x1001F: "SMM_MM_HDL_UNREG_1",
+    0x10020: "SMM_MM_HDL_UNREG_2",
+    0x10021: "SMM_SC_SVST_READ_2",
+    0x10022: "SMM_MM_UNBLOCKED",
+    0x10023: "SMM_MM_IS_COMM_BUFF",
+    0x10024: "SMM_SC_NULL_FAST",
+    0x10025: "SMM_SC_NULL",
+    0x10026: "SMM_QRY_HOB_INDEX",
+    0x10027: "SMM_START_ALL_AP_PROC",
+    0x10028: "SMM_SC_DEMOTED_RETURN",
+}
+
+MSR_SYSCALLS = (0x0000, 0x0001)
+IO_SYSCALLS = (0x0003, 0x0004)
+
+# EFI_MM_IO_WIDTH
+IO_WIDTH_NAMES = {0: "UINT8", 1: "UINT16", 2: "UINT32", 3: "UINT64"}
+
+
+def ParseTraceFile(fileName):
+    ''' Parse a drained syscall trace file into its header and the list of entries'''
+    with open(fileName, "rb") as file:
+        data = file.read()
+
+    if len(data) < TRACE_HEADER_SIZE:
+        raise ValueError(f"{fileName} is too small to hold a syscall trace header")
+
+    header = TraceHeader._make(struct.unpack_from(TRACE_HEADER_FORMAT, data, 0))
+    available = (len(data) - TRACE_HEADER_SIZE) // TRACE_ENTRY_SIZE
+    if available < header.EntryCount:
+        logging.warning(f"Header claims {header.EntryCount} entries, only {available} present")
+
+    entries = []
+    for index in range(min(available, header.EntryCount)):
+        entries.append(TraceEntry._make(struct.unpack_from(TRACE_ENTRY_FORMAT, data, TRACE_HEADER_SIZE + index * TRACE_ENTRY_SIZE)))
+
+    logging.debug(f"{len(entries)} entries found in file {fileName}")
+    return header, entries
+
+
+class LatencySummary(object):
+    ''' Accumulates the frequency and latency in TSC ticks of one group of syscalls'''
+
+    def __init__(self, key):
+        self.Key = key
+        self.Samples = []
+        self.Errors = 0
+
+    def Add(self, entry):
+        self.Samples.append(entry.Cycles)
+        if entry.Status != 0:
+            self.Errors += 1
+
+    def Percentile(self, percent):
+        ordered = sorted(self.Samples)
+        return ordered[min(len(ordered) - 1, (len(ordered) * percent) // 100)]
+
+    def Row(self):
+        return [self.Key, len(self.Samples), self.Errors,
+                min(self.Samples), sum(self.Samples) // len(self.Samples),
+                self.Percentile(50), self.Percentile(99), max(self.Samples),
+                sum(self.Samples)]
+
+
+SUMMARY_COLUMNS = ["Key", "Count", "Errors", "Min", "Avg", "P50", "P99", "Max", "Total"]
+
+
+def Summarize(entries, keyFunction):
+    ''' Group the entries using keyFunction, entries mapped to None are skipped'''
+    summaries = {}
+    for entry in entries:
+        key = keyFunction(entry)
+        if key is None:
+            continue
+        summaries.setdefault(key, LatencySummary(key)).Add(entry)
+    # Most frequent first, then most expensive
+    return sorted(summaries.values(), key=lambda s: (-len(s.Samples), -sum(s.Samples)))
+
+
+def SyscallKey(entry):
+    return SYSCALL_NAMES.get(entry.CallIndex, f"0x{entry.CallIndex:X}")
+
+
+def MsrKey(entry):
+    if entry.CallIndex not in MSR_SYSCALLS:
+        return None
+    return f"{SyscallKey(entry)} 0x{entry.Arg1:08X}"
+
+
+def IoKey(entry):
+    if entry.CallIndex not in IO_SYSCALLS:
+        return None
+    return f"{SyscallKey(entry)} 0x{entry.Arg1:04X} {IO_WIDTH_NAMES.get(entry.Arg2, str(entry.Arg2))}"
+
+
+def PrintTable(title, summaries, stream):
+    stream.write(f"\n{title}\n")
+    if len(summaries) == 0:
+        stream.write("  (none)\n")
+        return
+    rows = [SUMMARY_COLUMNS] + [[str(value) for value in s.Row()] for s in summaries]
+    widths = [max(len(row[column]) for row in rows) for column in range(len(SUMMARY_COLUMNS))]
+    for row in rows:
+        stream.write("  " + "  ".join(value.ljust(widths[column]) if column == 0 else value.rjust(widths[column])
+                                      for column, value in enumerate(row)) + "\n")
+
+
+def WriteCsv(fileName, tables):
+    with open(fileName, "w", newline="") as file:
+        writer = csv.writer(file)
+        writer.writerow(["Table"] + SUMMARY_COLUMNS)
+        for title, summaries in tables:
+            for s in summaries:
+                writer.writerow([title] + s.Row())
+    logging.critical(f"Summary written to: {os.path.abspath(fileName)}")
+
+
+def main() -> int:
+    # Arg Parse
+    parser = ArgumentParser(
+        description='Tool to summarize a syscall trace drained from the MM supervisor')
+    parser.add_argument("-i", "--InputFile", "--inputfile", dest="input_file", required=True,
+                        help="Path to the SyscallTrace.dat to decode", type=str)
+    parser.add_argument("-c", "--CsvFile", "--csvfile", dest="csv_file", default=None,
+                        help="Optional path to write all summaries as csv", type=str)
+    args = parser.parse_args()
+
+    if not os.path.isfile(args.input_file):
+        logging.critical("Invalid input file")
+        return -1
+
+    header, entries = ParseTraceFile(args.input_file)
+
+    sys.stdout.write(f"CPUs: {header.NumberOfCpus}, ring entries per CPU: {header.EntriesPerCpu}\n")
+    sys.stdout.write(f"Entries: {len(entries)}, dropped: {header.DroppedCount}, left in rings: {header.RemainingCount}\n")
+    sys.stdout.write("Latencies are in TSC ticks spent in the syscall dispatcher.\n")
+
+    tables = [("Syscall", Summarize(entries, SyscallKey)),
+              ("MSR", Summarize(entries, MsrKey)),
+              ("IO", Summarize(entries, IoKey)),
+              ("CPU", Summarize(entries, lambda e: f"CPU {e.CpuIndex}"))]
+    for title, summaries in tables:
+        PrintTable(f"Per {title} summary:", summaries, sys.stdout)
+
+    if args.csv_file is not None:
+        WriteCsv(args.csv_file, tables)
+
+    return 0
+
+
+if __name__ == "__main__":
+    # setup main console as logger
+    logger = logging.getLogger('')
+    logger.setLevel(logging.NOTSET)
+    console = logging.StreamHandler()
+    logger.addHandler(console)
+    console.setLevel(logging.WARNING)
+
+    sys.exit(main())
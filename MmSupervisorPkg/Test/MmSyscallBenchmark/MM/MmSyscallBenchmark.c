@@ -0,0 +1,496 @@
+/** @file -- MmSyscallBenchmark.c
+
+This MM driver measures the cycle cost of the privilege transitions between the user
+MM drivers and the MM supervisor, upon requests from MmSyscallBenchmarkApp.
+
+Copyright (C) Microsoft Corporation. All rights reserved.
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <PiMm.h>
+
+#include <Protocol/MmCpu.h>
+#include <Guid/MmSyscallBenchmark.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/MmParallelForLib.h>
+#include <Library/MmServicesTableLib.h>
+#include <Library/SysCallLib.h>
+
+#define POOL_ALLOC_SIZE  0x40
+
+#define HASH_BUFFER_SIZE     SIZE_1MB
+#define HASH_CHUNK_SIZE      SIZE_4KB
+#define HASH_CHUNK_COUNT     (HASH_BUFFER_SIZE / HASH_CHUNK_SIZE)
+#define HASH_ITERATIONS_MAX  16
+
+MM_SYSCALL_BENCHMARK_PARAMETERS  mBenchmarkParameters;
+EFI_MM_CPU_PROTOCOL              *mMmCpu = NULL;
+UINT8                            *mHashBuffer = NULL;
+UINT32                           mSerialDigests[HASH_CHUNK_COUNT];
+UINT32                           mParallelDigests[HASH_CHUNK_COUNT];
+volatile UINT32                  mApProcedureDone;
+
+/**
+  Accumulate one sample into the result of a measurement.
+
+  @param[in, out] Result    Result of the measurement.
+  @param[in]      Cycles    TSC ticks taken by this sample.
+
+**/
+STATIC
+VOID
+RecordSample (
+  IN OUT MM_SYSCALL_BENCHMARK_RESULT  *Result,
+  IN     UINT64                       Cycles
+  )
+{
+  if ((Result->Iterations == 0) || (Cycles < Result->MinCycles)) {
+    Result->MinCycles = Cycles;
+  }
+
+  if (Cycles > Result->MaxCycles) {
+    Result->MaxCycles = Cycles;
+  }
+
+  Result->TotalCycles += Cycles;
+  Result->Iterations++;
+}
+
+/**
+  Measure the null syscalls. The full path null syscall returns the CPL0 TSC, which splits
+  its round trip into the entry leg and the SYSRET demotion leg.
+
+  @param[in, out] Parameters  Benchmark parameters to fill the results in.
+
+**/
+STATIC
+VOID
+MeasureNullSyscalls (
+  IN OUT MM_SYSCALL_BENCHMARK_PARAMETERS  *Parameters
+  )
+{
+  UINT32  Index;
+  UINT64  Start;
+  UINT64  Middle;
+  UINT64  End;
+
+  for (Index = 0; Index < Parameters->Iterations; Index++) {
+    Start  = AsmReadTsc ();
+    Middle = SysCall (SMM_SC_NULL, 0, 0, 0);
+    End    = AsmReadTsc ();
+    RecordSample (&Parameters->Results[MM_SYSCALL_BENCHMARK_NULL], End - Start);
+    RecordSample (&Parameters->Results[MM_SYSCALL_BENCHMARK_NULL_ENTRY], Middle - Start);
+    RecordSample (&Parameters->Results[MM_SYSCALL_BENCHMARK_NULL_EXIT], End - Middle);
+  }
+
+  for (Index = 0; Index < Parameters->Iterations; Index++) {
+    Start = AsmReadTsc ();
+    SysCall (SMM_SC_NULL_FAST, 0, 0, 0);
+    End = AsmReadTsc ();
+    RecordSample (&Parameters->Results[MM_SYSCALL_BENCHMARK_NULL_FAST], End - Start);
+  }
+
+  Parameters->Results[MM_SYSCALL_BENCHMARK_NULL].Status       = EFI_SUCCESS;
+  Parameters->Results[MM_SYSCALL_BENCHMARK_NULL_ENTRY].Status = EFI_SUCCESS;
+  Parameters->Results[MM_SYSCALL_BENCHMARK_NULL_EXIT].Status  = EFI_SUCCESS;
+  Parameters->Results[MM_SYSCALL_BENCHMARK_NULL_FAST].Status  = EFI_SUCCESS;
+}
+
+/**
+  Measure the policy gated IO and MSR read syscalls on the targets supplied by the caller.
+  Any policy violation is fatal, so only targets flagged as verified by the caller are read.
+
+  @param[in, out] Parameters  Benchmark parameters to fill the results in.
+
+**/
+STATIC
+VOID
+MeasurePolicyGatedSyscalls (
+  IN OUT MM_SYSCALL_BENCHMARK_PARAMETERS  *Parameters
+  )
+{
+  UINT32                       Index;
+  UINT64                       Start;
+  MM_SYSCALL_BENCHMARK_RESULT  *Result;
+
+  Result = &Parameters->Results[MM_SYSCALL_BENCHMARK_IO_READ];
+  if ((Parameters->Flags & MM_SYSCALL_BENCHMARK_FLAG_IO_READ) == 0) {
+    Result->Status = EFI_NOT_STARTED;
+  } else if ((Parameters->IoWidth != MM_IO_UINT8) &&
+             (Parameters->IoWidth != MM_IO_UINT16) &&
+             (Parameters->IoWidth != MM_IO_UINT32))
+  {
+    Result->Status = EFI_INVALID_PARAMETER;
+  } else {
+    for (Index = 0; Index < Parameters->Iterations; Index++) {
+      Start = AsmReadTsc ();
+      SysCall (SMM_SC_IO_READ, Parameters->IoPort, Parameters->IoWidth, 0);
+      RecordSample (Result, AsmReadTsc () - Start);
+    }
+
+    Result->Status = EFI_SUCCESS;
+  }
+
+  Result = &Parameters->Results[MM_SYSCALL_BENCHMARK_MSR_READ];
+  if ((Parameters->Flags & MM_SYSCALL_BENCHMARK_FLAG_MSR_READ) == 0) {
+    Result->Status = EFI_NOT_STARTED;
+  } else {
+    for (Index = 0; Index < Parameters->Iterations; Index++) {
+      Start = AsmReadTsc ();
+      SysCall (SMM_SC_RDMSR, Parameters->MsrIndex, 0, 0);
+      RecordSample (Result, AsmReadTsc () - Start);
+    }
+
+    Result->Status = EFI_SUCCESS;
+  }
+}
+
+/**
+  Measure the memory services of user MM drivers. Pool services are served by the ring 3
+  broker, page services have to go through the MM supervisor.
+
+  @param[in, out] Parameters  Benchmark parameters to fill the results in.
+
+**/
+STATIC
+VOID
+MeasureMemoryServices (
+  IN OUT MM_SYSCALL_BENCHMARK_PARAMETERS  *Parameters
+  )
+{
+  EFI_STATUS                   Status;
+  UINT32                       Index;
+  UINT64                       Start;
+  VOID                         *Buffer;
+  EFI_PHYSICAL_ADDRESS         Address;
+  MM_SYSCALL_BENCHMARK_RESULT  *Result;
+
+  Result = &Parameters->Results[MM_SYSCALL_BENCHMARK_POOL_ALLOC];
+  Status = EFI_SUCCESS;
+  for (Index = 0; Index < Parameters->Iterations; Index++) {
+    Start  = AsmReadTsc ();
+    Status = gMmst->MmAllocatePool (EfiRuntimeServicesData, POOL_ALLOC_SIZE, &Buffer);
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    gMmst->MmFreePool (Buffer);
+    RecordSample (Result, AsmReadTsc () - Start);
+  }
+
+  Result->Status = Status;
+
+  Result = &Parameters->Results[MM_SYSCALL_BENCHMARK_PAGE_ALLOC];
+  Status = EFI_SUCCESS;
+  for (Index = 0; Index < Parameters->Iterations; Index++) {
+    Start  = AsmReadTsc ();
+    Status = gMmst->MmAllocatePages (AllocateAnyPages, EfiRuntimeServicesData, 1, &Address);
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    gMmst->MmFreePages (Address, 1);
+    RecordSample (Result, AsmReadTsc () - Start);
+  }
+
+  Result->Status = Status;
+}
+
+/**
+  Measure the save state read of the processor ID on the current CPU, which is always
+  allowed by the policy gate.
+
+  @param[in, out] Parameters  Benchmark parameters to fill the results in.
+
+**/
+STATIC
+VOID
+MeasureSaveStateRead (
+  IN OUT MM_SYSCALL_BENCHMARK_PARAMETERS  *Parameters
+  )
+{
+  EFI_STATUS                   Status;
+  UINT32                       Index;
+  UINT64                       Start;
+  UINT64                       ProcessorId;
+  MM_SYSCALL_BENCHMARK_RESULT  *Result;
+
+  Result = &Parameters->Results[MM_SYSCALL_BENCHMARK_SAVE_STATE_READ];
+  if (mMmCpu == NULL) {
+    Status = gMmst->MmLocateProtocol (&gEfiMmCpuProtocolGuid, NULL, (VOID **)&mMmCpu);
+    if (EFI_ERROR (Status)) {
+      Result->Status = Status;
+      return;
+    }
+  }
+
+  Status = EFI_SUCCESS;
+  for (Index = 0; Index < Parameters->Iterations; Index++) {
+    Start  = AsmReadTsc ();
+    Status = mMmCpu->ReadSaveState (
+                       mMmCpu,
+                       sizeof (ProcessorId),
+                       EFI_MM_SAVE_STATE_REGISTER_PROCESSOR_ID,
+                       Parameters->CpuIndex,
+                       &ProcessorId
+                       );
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    RecordSample (Result, AsmReadTsc () - Start);
+  }
+
+  Result->Status = Status;
+}
+
+/**
+  Hash a range of chunks of the hash buffer, as the body of MmParallelFor.
+
+  @param[in]  Context   Digest array to fill in.
+  @param[in]  Begin     First chunk to hash.
+  @param[in]  End       One past the last chunk to hash.
+
+**/
+STATIC
+VOID
+EFIAPI
+HashChunks (
+  IN VOID   *Context,
+  IN UINTN  Begin,
+  IN UINTN  End
+  )
+{
+  UINT32  *Digests;
+  UINTN   Index;
+
+  Digests = (UINT32 *)Context;
+  for (Index = Begin; Index < End; Index++) {
+    Digests[Index] = CalculateCrc32 (mHashBuffer + Index * HASH_CHUNK_SIZE, HASH_CHUNK_SIZE);
+  }
+}
+
+/**
+  Measure the CRC32 of every chunk of a large buffer, first on the current CPU, then spread
+  over all CPUs with MmParallelFor. The parallel digests have to match the serial ones.
+
+  @param[in, out] Parameters  Benchmark parameters to fill the results in.
+
+**/
+STATIC
+VOID
+MeasureParallelHash (
+  IN OUT MM_SYSCALL_BENCHMARK_PARAMETERS  *Parameters
+  )
+{
+  EFI_STATUS  Status;
+  UINT32      Iterations;
+  UINT32      Index;
+  UINT64      Start;
+
+  if (mHashBuffer == NULL) {
+    mHashBuffer = AllocatePages (EFI_SIZE_TO_PAGES (HASH_BUFFER_SIZE));
+    if (mHashBuffer == NULL) {
+      Parameters->Results[MM_SYSCALL_BENCHMARK_HASH_SERIAL].Status   = EFI_OUT_OF_RESOURCES;
+      Parameters->Results[MM_SYSCALL_BENCHMARK_HASH_PARALLEL].Status = EFI_OUT_OF_RESOURCES;
+      return;
+    }
+
+    for (Index = 0; Index < HASH_BUFFER_SIZE / sizeof (UINT32); Index++) {
+      ((UINT32 *)mHashBuffer)[Index] = Index * 0x9E3779B9;
+    }
+  }
+
+  // Each iteration hashes the whole buffer, keep the SMI short
+  Iterations = MIN (Parameters->Iterations, HASH_ITERATIONS_MAX);
+
+  for (Index = 0; Index < Iterations; Index++) {
+    Start = AsmReadTsc ();
+    HashChunks (mSerialDigests, 0, HASH_CHUNK_COUNT);
+    RecordSample (&Parameters->Results[MM_SYSCALL_BENCHMARK_HASH_SERIAL], AsmReadTsc () - Start);
+  }
+
+  Parameters->Results[MM_SYSCALL_BENCHMARK_HASH_SERIAL].Status = EFI_SUCCESS;
+
+  Status = EFI_SUCCESS;
+  for (Index = 0; Index < Iterations; Index++) {
+    ZeroMem (mParallelDigests, sizeof (mParallelDigests));
+    Start  = AsmReadTsc ();
+    Status = MmParallelFor (HASH_CHUNK_COUNT, 1, HashChunks, mParallelDigests);
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    RecordSample (&Parameters->Results[MM_SYSCALL_BENCHMARK_HASH_PARALLEL], AsmReadTsc () - Start);
+    if (CompareMem (mParallelDigests, mSerialDigests, sizeof (mSerialDigests)) != 0) {
+      DEBUG ((DEBUG_ERROR, "%a Parallel digests do not match the serial ones\n", __FUNCTION__));
+      Status = EFI_CRC_ERROR;
+      break;
+    }
+  }
+
+  Parameters->Results[MM_SYSCALL_BENCHMARK_HASH_PARALLEL].Status = Status;
+}
+
+/**
+  Empty AP procedure, only signals its completion.
+
+  @param[in]  ProcedureArgument   Not used.
+
+**/
+STATIC
+VOID
+EFIAPI
+EmptyApProcedure (
+  IN VOID  *ProcedureArgument
+  )
+{
+  mApProcedureDone = 1;
+}
+
+/**
+  Measure an empty procedure on the first available AP. Every sample demotes the AP to CPL3
+  once, the first sample of the SMI also installs the syscall MSR context of the AP.
+
+  @param[in, out] Parameters  Benchmark parameters to fill the results in.
+
+**/
+STATIC
+VOID
+MeasureApProcedure (
+  IN OUT MM_SYSCALL_BENCHMARK_PARAMETERS  *Parameters
+  )
+{
+  EFI_STATUS                   Status;
+  UINTN                        CpuIndex;
+  UINT32                       Index;
+  UINT64                       Start;
+  MM_SYSCALL_BENCHMARK_RESULT  *Result;
+
+  Result = &Parameters->Results[MM_SYSCALL_BENCHMARK_AP_PROCEDURE];
+  Status = EFI_NOT_STARTED;
+  for (CpuIndex = 0; CpuIndex < gMmst->NumberOfCpus; CpuIndex++) {
+    if (CpuIndex == gMmst->CurrentlyExecutingCpu) {
+      continue;
+    }
+
+    for (Index = 0; Index < Parameters->Iterations; Index++) {
+      mApProcedureDone = 0;
+      Start            = AsmReadTsc ();
+      Status           = gMmst->MmStartupThisAp (EmptyApProcedure, CpuIndex, NULL);
+      if (EFI_ERROR (Status)) {
+        break;
+      }
+
+      while (mApProcedureDone == 0) {
+        CpuPause ();
+      }
+
+      RecordSample (Result, AsmReadTsc () - Start);
+    }
+
+    // An AP that is not in MM fails the very first request, try the next one
+    if (!EFI_ERROR (Status) || (Result->Iterations != 0)) {
+      break;
+    }
+  }
+
+  Result->Status = Status;
+}
+
+/**
+  MMI handler of syscall benchmark requests.
+
+  @param  DispatchHandle  The unique handle assigned to this handler by MmiHandlerRegister().
+  @param  Context         Points to an optional handler context which was specified when the
+                          handler was registered.
+  @param  CommBuffer      A pointer to a collection of data in memory that will
+                          be conveyed from a non-MM environment into an MM environment.
+  @param  CommBufferSize  The size of the CommBuffer.
+
+  @retval EFI_SUCCESS     The request is processed, results are in CommBuffer.
+  @retval Others          The request is malformed.
+
+**/
+EFI_STATUS
+EFIAPI
+MmSyscallBenchmarkHandler (
+  IN     EFI_HANDLE  DispatchHandle,
+  IN     CONST VOID  *Context         OPTIONAL,
+  IN OUT VOID        *CommBuffer      OPTIONAL,
+  IN OUT UINTN       *CommBufferSize  OPTIONAL
+  )
+{
+  UINT64  EntryTsc;
+
+  EntryTsc = AsmReadTsc ();
+
+  if ((CommBuffer == NULL) || (CommBufferSize == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (*CommBufferSize != sizeof (MM_SYSCALL_BENCHMARK_PARAMETERS)) {
+    DEBUG ((DEBUG_ERROR, "%a Unexpected buffer size 0x%x\n", __FUNCTION__, *CommBufferSize));
+    return EFI_INVALID_PARAMETER;
+  }
+
+  // Work on a copy, the measurements should not touch the buffer shared with non-MM environment
+  CopyMem (&mBenchmarkParameters, CommBuffer, sizeof (mBenchmarkParameters));
+  if ((mBenchmarkParameters.Signature != MM_SYSCALL_BENCHMARK_SIGNATURE) ||
+      (mBenchmarkParameters.Revision != MM_SYSCALL_BENCHMARK_REVISION))
+  {
+    DEBUG ((DEBUG_ERROR, "%a Unrecognized request 0x%x rev 0x%x\n", __FUNCTION__, mBenchmarkParameters.Signature, mBenchmarkParameters.Revision));
+    return EFI_INVALID_PARAMETER;
+  }
+
+  mBenchmarkParameters.CpuIndex        = (UINT32)gMmst->CurrentlyExecutingCpu;
+  mBenchmarkParameters.HandlerEntryTsc = EntryTsc;
+  ZeroMem (mBenchmarkParameters.Results, sizeof (mBenchmarkParameters.Results));
+
+  if (mBenchmarkParameters.Iterations != 0) {
+    MeasureNullSyscalls (&mBenchmarkParameters);
+    MeasurePolicyGatedSyscalls (&mBenchmarkParameters);
+    MeasureMemoryServices (&mBenchmarkParameters);
+    MeasureSaveStateRead (&mBenchmarkParameters);
+    MeasureParallelHash (&mBenchmarkParameters);
+    MeasureApProcedure (&mBenchmarkParameters);
+  }
+
+  mBenchmarkParameters.HandlerExitTsc = AsmReadTsc ();
+  CopyMem (CommBuffer, &mBenchmarkParameters, sizeof (mBenchmarkParameters));
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Entry point of syscall benchmark driver, registers the benchmark MMI handler.
+
+  @param  ImageHandle     The image handle of this driver.
+  @param  MmSystemTable   A pointer to the MM System Table.
+
+  @retval EFI_SUCCESS     The handler is registered.
+  @retval Others          Failed to register the handler.
+
+**/
+EFI_STATUS
+EFIAPI
+MmSyscallBenchmarkEntry (
+  IN EFI_HANDLE           ImageHandle,
+  IN EFI_MM_SYSTEM_TABLE  *MmSystemTable
+  )
+{
+  EFI_STATUS  Status;
+  EFI_HANDLE  DispatchHandle;
+
+  Status = gMmst->MmiHandlerRegister (MmSyscallBenchmarkHandler, &gMmSyscallBenchmarkMmiHandlerGuid, &DispatchHandle);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a Failed to register benchmark handler - %r\n", __FUNCTION__, Status));
+  }
+
+  return Status;
+}
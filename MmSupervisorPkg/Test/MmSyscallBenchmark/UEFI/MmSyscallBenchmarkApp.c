@@ -0,0 +1,1297 @@
+/** @file -- MmSyscallBenchmarkApp.c
+
+Benchmark of the privilege transitions of MM supervisor. Measures the cycle cost of
+full MMI round trips from DXE, the demotion into user MM handlers and the syscalls
+issued by user MM drivers, through MmSyscallBenchmark MM driver. A batch of variable
+reads from the variable MM driver is timed both as separate and as vectored MMIs, and
+the user MMI round trip is timed over both the SYSRET and the call gate demotion paths.
+
+The results are written to SyscallBenchmark.csv in the current working directory.
+
+Copyright (C) Microsoft Corporation. All rights reserved.
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <SmmSecurePolicy.h>
+
+#include <Register/Intel/ArchitecturalMsr.h>
+
+#include <Guid/GlobalVariable.h>
+#include <Guid/PiSmmCommunicationRegionTable.h>
+#include <Guid/SmmVariableCommon.h>
+#include <Guid/MmSupervisorRequestData.h>
+#include <Guid/MmSyscallBenchmark.h>
+#include <Guid/MmVectoredCommunicate.h>
+
+#include <Protocol/MmCommunication2.h>
+#include <Protocol/MmSupervisorCommunication.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/UefiLib.h>
+#include <Library/DebugLib.h>
+#include <Library/PrintLib.h>
+#include <Library/ShellLib.h>
+#include <Library/SmmPolicyGateLib.h>
+#include <Library/UefiApplicationEntryPoint.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UnitTestLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#define UNIT_TEST_APP_NAME     "MM Syscall Benchmark"
+#define UNIT_TEST_APP_VERSION  "1.0"
+
+#define BENCHMARK_REPORT_FILE_NAME  L"SyscallBenchmark.csv"
+#define BENCHMARK_REPORT_LINE_SIZE  0x100
+
+#define MMI_ROUND_TRIP_ITERATIONS  100
+#define SYSCALL_ITERATIONS         1000
+#define VECTORED_MESSAGE_COUNT     8
+
+//
+// Room for the name and the data of each variable read, larger variables report EFI_BUFFER_TOO_SMALL
+//
+#define VARIABLE_READ_NAME_SIZE  0x40
+#define VARIABLE_READ_DATA_SIZE  0x100
+#define VARIABLE_READ_MESSAGE_SIZE                                           \
+  (SMM_VARIABLE_COMMUNICATE_HEADER_SIZE +                                    \
+   OFFSET_OF (SMM_VARIABLE_COMMUNICATE_ACCESS_VARIABLE, Name) +              \
+   VARIABLE_READ_NAME_SIZE + VARIABLE_READ_DATA_SIZE)
+
+//
+// Index of the DXE side measurements, which follow the MM side ones in the report
+//
+#define BENCHMARK_SUPV_MMI_ROUND_TRIP  (MM_SYSCALL_BENCHMARK_COUNT + 0)
+#define BENCHMARK_USER_MMI_ROUND_TRIP  (MM_SYSCALL_BENCHMARK_COUNT + 1)
+#define BENCHMARK_USER_MMI_ENTRY       (MM_SYSCALL_BENCHMARK_COUNT + 2)
+#define BENCHMARK_USER_MMI_EXIT        (MM_SYSCALL_BENCHMARK_COUNT + 3)
+#define BENCHMARK_USER_MMI_VECTORED    (MM_SYSCALL_BENCHMARK_COUNT + 4)
+#define BENCHMARK_VARIABLE_SEPARATE    (MM_SYSCALL_BENCHMARK_COUNT + 5)
+#define BENCHMARK_VARIABLE_VECTORED    (MM_SYSCALL_BENCHMARK_COUNT + 6)
+#define BENCHMARK_DEMOTION_SYSRET      (MM_SYSCALL_BENCHMARK_COUNT + 7)
+#define BENCHMARK_DEMOTION_CALL_GATE   (MM_SYSCALL_BENCHMARK_COUNT + 8)
+#define BENCHMARK_REPORT_COUNT         (MM_SYSCALL_BENCHMARK_COUNT + 9)
+
+typedef struct {
+  UINT32             IoPort;
+  EFI_MM_IO_WIDTH    IoWidth;
+} BENCHMARK_IO_CANDIDATE;
+
+//
+// Harmless read targets, the first one allowed by the active policy is benchmarked
+//
+CONST BENCHMARK_IO_CANDIDATE  mIoCandidates[] = {
+  { 0x80,  MM_IO_UINT8  },   // POST code
+  { 0x61,  MM_IO_UINT8  },   // NMI status and control
+  { 0xCF8, MM_IO_UINT32 },   // PCI configuration address
+};
+
+CONST UINT32  mMsrCandidates[] = {
+  MSR_IA32_TIME_STAMP_COUNTER,
+  MSR_IA32_APIC_BASE,
+  MSR_IA32_PAT,
+  MSR_IA32_MISC_ENABLE,
+};
+
+//
+// Global variables read in one batch, a missing one still costs a full lookup in MM
+//
+CONST CHAR16  *mVariableNames[VECTORED_MESSAGE_COUNT] = {
+  EFI_BOOT_ORDER_VARIABLE_NAME,
+  EFI_BOOT_CURRENT_VARIABLE_NAME,
+  EFI_TIME_OUT_VARIABLE_NAME,
+  EFI_PLATFORM_LANG_VARIABLE_NAME,
+  EFI_PLATFORM_LANG_CODES_VARIABLE_NAME,
+  EFI_CON_IN_VARIABLE_NAME,
+  EFI_CON_OUT_VARIABLE_NAME,
+  EFI_ERR_OUT_VARIABLE_NAME,
+};
+
+CONST CHAR8  *mReportNames[BENCHMARK_REPORT_COUNT] = {
+  "Syscall.Null",
+  "Syscall.NullFast",
+  "Syscall.NullEntry",
+  "Syscall.NullExit",
+  "Syscall.IoRead",
+  "Syscall.MsrRead",
+  "Syscall.PoolAlloc",
+  "Syscall.PageAlloc",
+  "Syscall.SaveStateRead",
+  "Hash.Serial",
+  "Hash.Parallel",
+  "Ap.Procedure",
+  "Mmi.SupervisorRoundTrip",
+  "Mmi.UserRoundTrip",
+  "Mmi.UserEntry",
+  "Mmi.UserExit",
+  "Mmi.UserVectored",
+  "Variable.ReadSeparate",
+  "Variable.ReadVectored",
+  "Demotion.Sysret",
+  "Demotion.CallGate",
+};
+
+MM_SUPERVISOR_COMMUNICATION_PROTOCOL  *SupvCommunication              = NULL;
+VOID                                  *mMmSupvCommonCommBufferAddress = NULL;
+UINTN                                 mMmSupvCommonCommBufferSize;
+EFI_MM_COMMUNICATION2_PROTOCOL        *mMmCommunication2              = NULL;
+VOID                                  *mPiSmmCommonCommBufferAddress  = NULL;
+UINTN                                 mPiSmmCommonCommBufferSize;
+
+MM_SYSCALL_BENCHMARK_RESULT  mReport[BENCHMARK_REPORT_COUNT];
+
+/**
+  Accumulate one sample into the result of a measurement.
+
+  @param[in, out] Result    Result of the measurement.
+  @param[in]      Cycles    TSC ticks taken by this sample.
+
+**/
+STATIC
+VOID
+RecordSample (
+  IN OUT MM_SYSCALL_BENCHMARK_RESULT  *Result,
+  IN     UINT64                       Cycles
+  )
+{
+  if ((Result->Iterations == 0) || (Cycles < Result->MinCycles)) {
+    Result->MinCycles = Cycles;
+  }
+
+  if (Cycles > Result->MaxCycles) {
+    Result->MaxCycles = Cycles;
+  }
+
+  Result->TotalCycles += Cycles;
+  Result->Iterations++;
+}
+
+/**
+  This helper function prepares a supervisor request in the supervisor communication buffer.
+
+  @param[in]  Request       The supervisor request to prepare.
+  @param[out] CommBuffer    Returns a pointer to the request header.
+
+  @retval     EFI_SUCCESS         CommBuffer initialized and ready to use.
+  @retval     EFI_ABORTED         Some error occurred.
+
+**/
+STATIC
+EFI_STATUS
+PrepareSupvRequest (
+  IN  UINT32                        Request,
+  OUT MM_SUPERVISOR_REQUEST_HEADER  **CommBuffer
+  )
+{
+  EFI_MM_COMMUNICATE_HEADER  *CommHeader;
+
+  if ((mMmSupvCommonCommBufferAddress == NULL) ||
+      (mMmSupvCommonCommBufferSize < sizeof (MM_SUPERVISOR_REQUEST_HEADER) + OFFSET_OF (EFI_MM_COMMUNICATE_HEADER, Data)))
+  {
+    DEBUG ((DEBUG_ERROR, "[%a] - Supervisor communication buffer is not usable!\n", __FUNCTION__));
+    return EFI_ABORTED;
+  }
+
+  CommHeader = (EFI_MM_COMMUNICATE_HEADER *)mMmSupvCommonCommBufferAddress;
+  ZeroMem (CommHeader, sizeof (MM_SUPERVISOR_REQUEST_HEADER) + OFFSET_OF (EFI_MM_COMMUNICATE_HEADER, Data));
+
+  // Offer the entire communication buffer, the policy could be large
+  CopyGuid (&CommHeader->HeaderGuid, &gMmSupervisorRequestHandlerGuid);
+  CommHeader->MessageLength = mMmSupvCommonCommBufferSize - OFFSET_OF (EFI_MM_COMMUNICATE_HEADER, Data);
+
+  *CommBuffer              = (MM_SUPERVISOR_REQUEST_HEADER *)CommHeader->Data;
+  (*CommBuffer)->Signature = MM_SUPERVISOR_REQUEST_SIG;
+  (*CommBuffer)->Revision  = MM_SUPERVISOR_REQUEST_REVISION;
+  (*CommBuffer)->Request   = Request;
+  (*CommBuffer)->Result    = EFI_SUCCESS;
+
+  return EFI_SUCCESS;
+}
+
+/**
+  This helper function sends the prepared supervisor request to MM.
+
+  @param[in]  CommBuffer    The prepared request header.
+
+  @retval     EFI_SUCCESS   The request is successfully processed by supervisor.
+  @retval     Others        Some error occurred.
+
+**/
+STATIC
+EFI_STATUS
+SupvCommunicate (
+  IN MM_SUPERVISOR_REQUEST_HEADER  *CommBuffer
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       CommBufferSize;
+
+  CommBufferSize = mMmSupvCommonCommBufferSize;
+  Status         = SupvCommunication->Communicate (SupvCommunication, mMmSupvCommonCommBufferAddress, &CommBufferSize);
+  if (!EFI_ERROR (Status) && ((UINTN)CommBuffer->Result != 0)) {
+    Status = ENCODE_ERROR ((UINTN)CommBuffer->Result);
+  }
+
+  return Status;
+}
+
+/**
+  This helper function selects how supervisor demotes into user MM handlers from now on.
+
+  @param[in]  Path          The MM_SUPERVISOR_DEMOTION_PATH_* to select, or MM_SUPERVISOR_DEMOTION_PATH_QUERY.
+  @param[out] SelectedPath  The MM_SUPERVISOR_DEMOTION_PATH_* selected.
+  @param[out] ActivePath    The MM_SUPERVISOR_DEMOTION_PATH_* later demotions take.
+
+  @retval     EFI_SUCCESS   The request is successfully processed by supervisor.
+  @retval     Others        Some error occurred.
+
+**/
+STATIC
+EFI_STATUS
+SelectDemotionPath (
+  IN  UINT32  Path,
+  OUT UINT32  *SelectedPath,
+  OUT UINT32  *ActivePath
+  )
+{
+  EFI_STATUS                          Status;
+  MM_SUPERVISOR_REQUEST_HEADER        *CommBuffer;
+  MM_SUPERVISOR_DEMOTION_PATH_BUFFER  *PathBuffer;
+
+  Status = PrepareSupvRequest (MM_SUPERVISOR_REQUEST_DEMOTION_PATH, &CommBuffer);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  PathBuffer                = (MM_SUPERVISOR_DEMOTION_PATH_BUFFER *)(CommBuffer + 1);
+  PathBuffer->RequestedPath = Path;
+  PathBuffer->SelectedPath  = MM_SUPERVISOR_DEMOTION_PATH_CALL_GATE;
+  PathBuffer->ActivePath    = MM_SUPERVISOR_DEMOTION_PATH_CALL_GATE;
+
+  Status = SupvCommunicate (CommBuffer);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  *SelectedPath = PathBuffer->SelectedPath;
+  *ActivePath   = PathBuffer->ActivePath;
+
+  return EFI_SUCCESS;
+}
+
+/**
+  This helper function sends a request to the benchmark MM driver and waits for its results.
+
+  @param[in, out] Parameters    The benchmark request, overwritten by the results upon return.
+
+  @retval     EFI_SUCCESS   The request is successfully processed by the benchmark driver.
+  @retval     Others        Some error occurred.
+
+**/
+STATIC
+EFI_STATUS
+BenchmarkCommunicate (
+  IN OUT MM_SYSCALL_BENCHMARK_PARAMETERS  *Parameters
+  )
+{
+  EFI_STATUS                 Status;
+  EFI_MM_COMMUNICATE_HEADER  *CommHeader;
+  UINTN                      CommBufferSize;
+
+  CommBufferSize = OFFSET_OF (EFI_MM_COMMUNICATE_HEADER, Data) + sizeof (MM_SYSCALL_BENCHMARK_PARAMETERS);
+  if ((mPiSmmCommonCommBufferAddress == NULL) || (mPiSmmCommonCommBufferSize < CommBufferSize)) {
+    DEBUG ((DEBUG_ERROR, "[%a] - Communication buffer is not usable!\n", __FUNCTION__));
+    return EFI_ABORTED;
+  }
+
+  CommHeader = (EFI_MM_COMMUNICATE_HEADER *)mPiSmmCommonCommBufferAddress;
+  CopyGuid (&CommHeader->HeaderGuid, &gMmSyscallBenchmarkMmiHandlerGuid);
+  CommHeader->MessageLength = sizeof (MM_SYSCALL_BENCHMARK_PARAMETERS);
+  CopyMem (CommHeader->Data, Parameters, sizeof (MM_SYSCALL_BENCHMARK_PARAMETERS));
+
+  Status = mMmCommunication2->Communicate (mMmCommunication2, CommHeader, CommHeader, &CommBufferSize);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "[%a] - Communicate() = %r\n", __FUNCTION__, Status));
+    return Status;
+  }
+
+  CopyMem (Parameters, CommHeader->Data, sizeof (MM_SYSCALL_BENCHMARK_PARAMETERS));
+  if (Parameters->Signature != MM_SYSCALL_BENCHMARK_SIGNATURE) {
+    // Nobody answered the request, the benchmark driver is likely not dispatched
+    return EFI_NOT_FOUND;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  This helper function sends several requests to the benchmark MM driver in a single vectored
+  MMI and waits for their results.
+
+  @param[in, out] Parameters    The benchmark requests, overwritten by the results upon return.
+  @param[in]      Count         Number of requests in Parameters.
+
+  @retval     EFI_SUCCESS   All requests are successfully processed by the benchmark driver.
+  @retval     Others        Some error occurred.
+
+**/
+STATIC
+EFI_STATUS
+BenchmarkVectoredCommunicate (
+  IN OUT MM_SYSCALL_BENCHMARK_PARAMETERS  *Parameters,
+  IN     UINTN                            Count
+  )
+{
+  EFI_STATUS                      Status;
+  EFI_MM_COMMUNICATE_HEADER       *CommHeader;
+  MM_VECTORED_COMMUNICATE_HEADER  *VectorHeader;
+  MM_VECTORED_COMMUNICATE_ENTRY   *Entry;
+  UINTN                           EntrySize;
+  UINTN                           CommBufferSize;
+  UINTN                           Index;
+
+  EntrySize      = MM_VECTORED_COMMUNICATE_ENTRY_SIZE (sizeof (MM_SYSCALL_BENCHMARK_PARAMETERS));
+  CommBufferSize = OFFSET_OF (EFI_MM_COMMUNICATE_HEADER, Data) +
+                   ALIGN_VALUE (sizeof (MM_VECTORED_COMMUNICATE_HEADER), 8) +
+                   Count * EntrySize;
+  if ((mPiSmmCommonCommBufferAddress == NULL) || (mPiSmmCommonCommBufferSize < CommBufferSize) ||
+      (Count > MM_VECTORED_COMMUNICATE_MAX_MESSAGES))
+  {
+    DEBUG ((DEBUG_ERROR, "[%a] - Communication buffer is not usable!\n", __FUNCTION__));
+    return EFI_ABORTED;
+  }
+
+  CommHeader = (EFI_MM_COMMUNICATE_HEADER *)mPiSmmCommonCommBufferAddress;
+  ZeroMem (CommHeader, CommBufferSize);
+  CopyGuid (&CommHeader->HeaderGuid, &gMmVectoredCommunicateGuid);
+  CommHeader->MessageLength = CommBufferSize - OFFSET_OF (EFI_MM_COMMUNICATE_HEADER, Data);
+
+  VectorHeader               = (MM_VECTORED_COMMUNICATE_HEADER *)CommHeader->Data;
+  VectorHeader->Signature    = MM_VECTORED_COMMUNICATE_SIGNATURE;
+  VectorHeader->MessageCount = (UINT32)Count;
+
+  Entry = (MM_VECTORED_COMMUNICATE_ENTRY *)((UINT8 *)VectorHeader + ALIGN_VALUE (sizeof (MM_VECTORED_COMMUNICATE_HEADER), 8));
+  for (Index = 0; Index < Count; Index++) {
+    Entry->EntrySize    = (UINT32)EntrySize;
+    Entry->ReturnStatus = EFI_NOT_STARTED;
+    CopyGuid (&Entry->Message.HeaderGuid, &gMmSyscallBenchmarkMmiHandlerGuid);
+    Entry->Message.MessageLength = sizeof (MM_SYSCALL_BENCHMARK_PARAMETERS);
+    CopyMem (Entry->Message.Data, &Parameters[Index], sizeof (MM_SYSCALL_BENCHMARK_PARAMETERS));
+    Entry = (MM_VECTORED_COMMUNICATE_ENTRY *)((UINT8 *)Entry + EntrySize);
+  }
+
+  Status = mMmCommunication2->Communicate (mMmCommunication2, CommHeader, CommHeader, &CommBufferSize);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "[%a] - Communicate() = %r\n", __FUNCTION__, Status));
+    return Status;
+  }
+
+  Entry = (MM_VECTORED_COMMUNICATE_ENTRY *)((UINT8 *)VectorHeader + ALIGN_VALUE (sizeof (MM_VECTORED_COMMUNICATE_HEADER), 8));
+  for (Index = 0; Index < Count; Index++) {
+    if (Entry->ReturnStatus != EFI_SUCCESS) {
+      DEBUG ((DEBUG_ERROR, "[%a] - Message %d returned %r\n", __FUNCTION__, Index, (EFI_STATUS)Entry->ReturnStatus));
+      return (Entry->ReturnStatus == EFI_NOT_FOUND) ? EFI_NOT_FOUND : EFI_DEVICE_ERROR;
+    }
+
+    CopyMem (&Parameters[Index], Entry->Message.Data, sizeof (MM_SYSCALL_BENCHMARK_PARAMETERS));
+    if (Parameters[Index].Signature != MM_SYSCALL_BENCHMARK_SIGNATURE) {
+      return EFI_NOT_FOUND;
+    }
+
+    Entry = (MM_VECTORED_COMMUNICATE_ENTRY *)((UINT8 *)Entry + EntrySize);
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  This helper function prepares a GetVariable request to the variable MM driver.
+
+  @param[out] Message   The message to fill, with room for VARIABLE_READ_MESSAGE_SIZE bytes of data.
+  @param[in]  Name      Name of the global variable to read.
+
+**/
+STATIC
+VOID
+PrepareVariableRead (
+  OUT EFI_MM_COMMUNICATE_HEADER  *Message,
+  IN  CONST CHAR16               *Name
+  )
+{
+  SMM_VARIABLE_COMMUNICATE_HEADER           *VariableHeader;
+  SMM_VARIABLE_COMMUNICATE_ACCESS_VARIABLE  *AccessVariable;
+  UINTN                                     NameSize;
+
+  NameSize = StrSize (Name);
+  ASSERT (NameSize <= VARIABLE_READ_NAME_SIZE);
+
+  CopyGuid (&Message->HeaderGuid, &gEfiSmmVariableProtocolGuid);
+  Message->MessageLength = SMM_VARIABLE_COMMUNICATE_HEADER_SIZE +
+                           OFFSET_OF (SMM_VARIABLE_COMMUNICATE_ACCESS_VARIABLE, Name) +
+                           NameSize + VARIABLE_READ_DATA_SIZE;
+
+  // The variable driver overwrites the status, so that an unserved request stands out
+  VariableHeader               = (SMM_VARIABLE_COMMUNICATE_HEADER *)Message->Data;
+  VariableHeader->Function     = SMM_VARIABLE_FUNCTION_GET_VARIABLE;
+  VariableHeader->ReturnStatus = EFI_NOT_STARTED;
+
+  AccessVariable = (SMM_VARIABLE_COMMUNICATE_ACCESS_VARIABLE *)VariableHeader->Data;
+  CopyGuid (&AccessVariable->Guid, &gEfiGlobalVariableGuid);
+  AccessVariable->DataSize   = VARIABLE_READ_DATA_SIZE;
+  AccessVariable->NameSize   = NameSize;
+  AccessVariable->Attributes = 0;
+  CopyMem (AccessVariable->Name, Name, NameSize);
+}
+
+/**
+  This helper function retrieves the result of a GetVariable request served by the variable MM driver.
+
+  @param[in]  Message     The message returned by MM.
+  @param[out] ReadStatus  Status of the variable read.
+  @param[out] DataSize    Data size reported for the variable.
+
+  @retval     EFI_SUCCESS     The request is served, whether the variable exists or not.
+  @retval     EFI_NOT_FOUND   The variable MM driver did not serve the request.
+
+**/
+STATIC
+EFI_STATUS
+GetVariableReadResult (
+  IN  CONST EFI_MM_COMMUNICATE_HEADER  *Message,
+  OUT EFI_STATUS                       *ReadStatus,
+  OUT UINTN                            *DataSize
+  )
+{
+  SMM_VARIABLE_COMMUNICATE_HEADER           *VariableHeader;
+  SMM_VARIABLE_COMMUNICATE_ACCESS_VARIABLE  *AccessVariable;
+
+  VariableHeader = (SMM_VARIABLE_COMMUNICATE_HEADER *)Message->Data;
+  AccessVariable = (SMM_VARIABLE_COMMUNICATE_ACCESS_VARIABLE *)VariableHeader->Data;
+  *ReadStatus    = VariableHeader->ReturnStatus;
+  *DataSize      = AccessVariable->DataSize;
+
+  return (*ReadStatus == EFI_NOT_STARTED) ? EFI_NOT_FOUND : EFI_SUCCESS;
+}
+
+/**
+  This helper function reads the batch of global variables from the variable MM driver, one MMI
+  per variable.
+
+  @param[out] ReadStatus  Status of each variable read, VECTORED_MESSAGE_COUNT entries.
+  @param[out] DataSize    Data size reported for each variable, VECTORED_MESSAGE_COUNT entries.
+
+  @retval     EFI_SUCCESS   All reads are served by the variable MM driver.
+  @retval     Others        Some error occurred.
+
+**/
+STATIC
+EFI_STATUS
+ReadVariablesSeparately (
+  OUT EFI_STATUS  *ReadStatus,
+  OUT UINTN       *DataSize
+  )
+{
+  EFI_STATUS                 Status;
+  EFI_MM_COMMUNICATE_HEADER  *CommHeader;
+  UINTN                      CommBufferSize;
+  UINTN                      Index;
+
+  if ((mPiSmmCommonCommBufferAddress == NULL) ||
+      (mPiSmmCommonCommBufferSize < OFFSET_OF (EFI_MM_COMMUNICATE_HEADER, Data) + VARIABLE_READ_MESSAGE_SIZE))
+  {
+    DEBUG ((DEBUG_ERROR, "[%a] - Communication buffer is not usable!\n", __FUNCTION__));
+    return EFI_ABORTED;
+  }
+
+  CommHeader = (EFI_MM_COMMUNICATE_HEADER *)mPiSmmCommonCommBufferAddress;
+  for (Index = 0; Index < VECTORED_MESSAGE_COUNT; Index++) {
+    PrepareVariableRead (CommHeader, mVariableNames[Index]);
+    CommBufferSize = OFFSET_OF (EFI_MM_COMMUNICATE_HEADER, Data) + CommHeader->MessageLength;
+
+    Status = mMmCommunication2->Communicate (mMmCommunication2, CommHeader, CommHeader, &CommBufferSize);
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_ERROR, "[%a] - Communicate() = %r\n", __FUNCTION__, Status));
+      return Status;
+    }
+
+    Status = GetVariableReadResult (CommHeader, &ReadStatus[Index], &DataSize[Index]);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  This helper function reads the batch of global variables from the variable MM driver in a
+  single vectored MMI.
+
+  @param[out] ReadStatus  Status of each variable read, VECTORED_MESSAGE_COUNT entries.
+  @param[out] DataSize    Data size reported for each variable, VECTORED_MESSAGE_COUNT entries.
+
+  @retval     EFI_SUCCESS   All reads are served by the variable MM driver.
+  @retval     Others        Some error occurred.
+
+**/
+STATIC
+EFI_STATUS
+ReadVariablesVectored (
+  OUT EFI_STATUS  *ReadStatus,
+  OUT UINTN       *DataSize
+  )
+{
+  EFI_STATUS                      Status;
+  EFI_MM_COMMUNICATE_HEADER       *CommHeader;
+  MM_VECTORED_COMMUNICATE_HEADER  *VectorHeader;
+  MM_VECTORED_COMMUNICATE_ENTRY   *Entry;
+  UINTN                           EntrySize;
+  UINTN                           CommBufferSize;
+  UINTN                           Index;
+
+  EntrySize      = MM_VECTORED_COMMUNICATE_ENTRY_SIZE (VARIABLE_READ_MESSAGE_SIZE);
+  CommBufferSize = OFFSET_OF (EFI_MM_COMMUNICATE_HEADER, Data) +
+                   ALIGN_VALUE (sizeof (MM_VECTORED_COMMUNICATE_HEADER), 8) +
+                   VECTORED_MESSAGE_COUNT * EntrySize;
+  if ((mPiSmmCommonCommBufferAddress == NULL) || (mPiSmmCommonCommBufferSize < CommBufferSize)) {
+    DEBUG ((DEBUG_ERROR, "[%a] - Communication buffer is not usable!\n", __FUNCTION__));
+    return EFI_ABORTED;
+  }
+
+  CommHeader = (EFI_MM_COMMUNICATE_HEADER *)mPiSmmCommonCommBufferAddress;
+  ZeroMem (CommHeader, CommBufferSize);
+  CopyGuid (&CommHeader->HeaderGuid, &gMmVectoredCommunicateGuid);
+  CommHeader->MessageLength = CommBufferSize - OFFSET_OF (EFI_MM_COMMUNICATE_HEADER, Data);
+
+  VectorHeader               = (MM_VECTORED_COMMUNICATE_HEADER *)CommHeader->Data;
+  VectorHeader->Signature    = MM_VECTORED_COMMUNICATE_SIGNATURE;
+  VectorHeader->MessageCount = VECTORED_MESSAGE_COUNT;
+
+  Entry = (MM_VECTORED_COMMUNICATE_ENTRY *)((UINT8 *)VectorHeader + ALIGN_VALUE (sizeof (MM_VECTORED_COMMUNICATE_HEADER), 8));
+  for (Index = 0; Index < VECTORED_MESSAGE_COUNT; Index++) {
+    Entry->EntrySize    = (UINT32)EntrySize;
+    Entry->ReturnStatus = EFI_NOT_STARTED;
+    PrepareVariableRead (&Entry->Message, mVariableNames[Index]);
+    Entry = (MM_VECTORED_COMMUNICATE_ENTRY *)((UINT8 *)Entry + EntrySize);
+  }
+
+  Status = mMmCommunication2->Communicate (mMmCommunication2, CommHeader, CommHeader, &CommBufferSize);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "[%a] - Communicate() = %r\n", __FUNCTION__, Status));
+    return Status;
+  }
+
+  Entry = (MM_VECTORED_COMMUNICATE_ENTRY *)((UINT8 *)VectorHeader + ALIGN_VALUE (sizeof (MM_VECTORED_COMMUNICATE_HEADER), 8));
+  for (Index = 0; Index < VECTORED_MESSAGE_COUNT; Index++) {
+    if (Entry->ReturnStatus != EFI_SUCCESS) {
+      DEBUG ((DEBUG_ERROR, "[%a] - Message %d returned %r\n", __FUNCTION__, Index, (EFI_STATUS)Entry->ReturnStatus));
+      return (Entry->ReturnStatus == EFI_NOT_FOUND) ? EFI_NOT_FOUND : EFI_DEVICE_ERROR;
+    }
+
+    Status = GetVariableReadResult (&Entry->Message, &ReadStatus[Index], &DataSize[Index]);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    Entry = (MM_VECTORED_COMMUNICATE_ENTRY *)((UINT8 *)Entry + EntrySize);
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Fetch the active security policy from supervisor and pick the IO port and MSR that are
+  allowed to read, so that the policy gated syscalls can be benchmarked without tripping
+  a policy violation.
+
+  @param[in, out] Parameters    The benchmark request to fill the targets in.
+
+  @retval     EFI_SUCCESS   The policy is evaluated, Parameters->Flags indicates usable targets.
+  @retval     Others        Failed to fetch the policy.
+
+**/
+STATIC
+EFI_STATUS
+SelectPolicyGatedTargets (
+  IN OUT MM_SYSCALL_BENCHMARK_PARAMETERS  *Parameters
+  )
+{
+  EFI_STATUS                        Status;
+  MM_SUPERVISOR_REQUEST_HEADER      *CommBuffer;
+  SMM_SUPV_SECURE_POLICY_DATA_V1_0  *SecurityPolicy;
+  UINTN                             Index;
+
+  Status = PrepareSupvRequest (MM_SUPERVISOR_REQUEST_FETCH_POLICY, &CommBuffer);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = SupvCommunicate (CommBuffer);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  // The policy gate does not need anything beyond the policy blob
+  SecurityPolicy = AllocateCopyPool (
+                     ((SMM_SUPV_SECURE_POLICY_DATA_V1_0 *)(CommBuffer + 1))->Size,
+                     CommBuffer + 1
+                     );
+  if (SecurityPolicy == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  for (Index = 0; Index < ARRAY_SIZE (mIoCandidates); Index++) {
+    if (!EFI_ERROR (IsIoReadWriteAllowed (SecurityPolicy, mIoCandidates[Index].IoPort, mIoCandidates[Index].IoWidth, SECURE_POLICY_RESOURCE_ATTR_READ))) {
+      Parameters->IoPort  = mIoCandidates[Index].IoPort;
+      Parameters->IoWidth = mIoCandidates[Index].IoWidth;
+      Parameters->Flags  |= MM_SYSCALL_BENCHMARK_FLAG_IO_READ;
+      break;
+    }
+  }
+
+  for (Index = 0; Index < ARRAY_SIZE (mMsrCandidates); Index++) {
+    if (!EFI_ERROR (IsMsrReadWriteAllowed (SecurityPolicy, mMsrCandidates[Index], SECURE_POLICY_RESOURCE_ATTR_READ))) {
+      Parameters->MsrIndex = mMsrCandidates[Index];
+      Parameters->Flags   |= MM_SYSCALL_BENCHMARK_FLAG_MSR_READ;
+      break;
+    }
+  }
+
+  FreePool (SecurityPolicy);
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Write all measurements to the report file as comma separated values.
+
+  @retval     EFI_SUCCESS   The report is written.
+  @retval     Others        Failed to write the report.
+
+**/
+STATIC
+EFI_STATUS
+WriteBenchmarkReport (
+  VOID
+  )
+{
+  EFI_STATUS         Status;
+  SHELL_FILE_HANDLE  FileHandle;
+  CHAR8              Line[BENCHMARK_REPORT_LINE_SIZE];
+  UINTN              LineSize;
+  UINTN              Index;
+  UINT64             Average;
+
+  // Drop whatever was left by the previous run
+  Status = ShellOpenFileByName (BENCHMARK_REPORT_FILE_NAME, &FileHandle, EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, 0);
+  if (!EFI_ERROR (Status)) {
+    ShellDeleteFile (&FileHandle);
+  }
+
+  Status = ShellOpenFileByName (
+             BENCHMARK_REPORT_FILE_NAME,
+             &FileHandle,
+             EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE | EFI_FILE_MODE_CREATE,
+             0
+             );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  LineSize = AsciiSPrint (Line, sizeof (Line), "Name,Status,Iterations,MinCycles,AvgCycles,MaxCycles,TotalCycles\n");
+  Status   = ShellWriteFile (FileHandle, &LineSize, Line);
+
+  for (Index = 0; (Index < BENCHMARK_REPORT_COUNT) && !EFI_ERROR (Status); Index++) {
+    Average = 0;
+    if (mReport[Index].Iterations != 0) {
+      Average = DivU64x64Remainder (mReport[Index].TotalCycles, mReport[Index].Iterations, NULL);
+    }
+
+    LineSize = AsciiSPrint (
+                 Line,
+                 sizeof (Line),
+                 "%a,%r,%ld,%ld,%ld,%ld,%ld\n",
+                 mReportNames[Index],
+                 (EFI_STATUS)mReport[Index].Status,
+                 mReport[Index].Iterations,
+                 mReport[Index].MinCycles,
+                 Average,
+                 mReport[Index].MaxCycles,
+                 mReport[Index].TotalCycles
+                 );
+    Status = ShellWriteFile (FileHandle, &LineSize, Line);
+  }
+
+  ShellCloseFile (&FileHandle);
+
+  return Status;
+}
+
+/// ================================================================================================
+/// ================================================================================================
+///
+/// PRE REQ FUNCTIONS
+///
+/// ================================================================================================
+/// ================================================================================================
+
+UNIT_TEST_STATUS
+EFIAPI
+LocateCommBuffers (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS                               Status;
+  EDKII_PI_SMM_COMMUNICATION_REGION_TABLE  *PiSmmCommunicationRegionTable;
+  EFI_MEMORY_DESCRIPTOR                    *SmmCommMemRegion;
+  UINTN                                    Index;
+
+  if (mMmSupvCommonCommBufferAddress == NULL) {
+    Status = gBS->LocateProtocol (&gMmSupervisorCommunicationProtocolGuid, NULL, (VOID **)&SupvCommunication);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+
+    // Use virtual start will be identical to physical start till translate event
+    mMmSupvCommonCommBufferAddress = (VOID *)SupvCommunication->CommunicationRegion.VirtualStart;
+    mMmSupvCommonCommBufferSize    = EFI_PAGES_TO_SIZE (SupvCommunication->CommunicationRegion.NumberOfPages);
+  }
+
+  if (mPiSmmCommonCommBufferAddress == NULL) {
+    Status = gBS->LocateProtocol (&gEfiMmCommunication2ProtocolGuid, NULL, (VOID **)&mMmCommunication2);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+
+    Status = EfiGetSystemConfigurationTable (&gEdkiiPiSmmCommunicationRegionTableGuid, (VOID **)&PiSmmCommunicationRegionTable);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+
+    SmmCommMemRegion = (EFI_MEMORY_DESCRIPTOR *)(PiSmmCommunicationRegionTable + 1);
+    for (Index = 0; Index < PiSmmCommunicationRegionTable->NumberOfEntries; Index++) {
+      if (SmmCommMemRegion->Type == EfiConventionalMemory) {
+        mPiSmmCommonCommBufferAddress = (VOID *)(UINTN)SmmCommMemRegion->PhysicalStart;
+        mPiSmmCommonCommBufferSize    = EFI_PAGES_TO_SIZE ((UINTN)SmmCommMemRegion->NumberOfPages);
+        break;
+      }
+
+      SmmCommMemRegion = (EFI_MEMORY_DESCRIPTOR *)((UINT8 *)SmmCommMemRegion + PiSmmCommunicationRegionTable->DescriptorSize);
+    }
+
+    UT_ASSERT_NOT_NULL (mPiSmmCommonCommBufferAddress);
+  }
+
+  return UNIT_TEST_PASSED;
+} // LocateCommBuffers()
+
+/// ================================================================================================
+/// ================================================================================================
+///
+/// TEST CASES
+///
+/// ================================================================================================
+/// ================================================================================================
+
+/*
+  Benchmark the MMI round trip of a request served by the supervisor alone, which is the
+  baseline cost of entering MM from DXE without any demotion.
+*/
+UNIT_TEST_STATUS
+EFIAPI
+BenchmarkSupvMmiRoundTrip (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS                    Status;
+  MM_SUPERVISOR_REQUEST_HEADER  *CommBuffer;
+  UINTN                         Index;
+  UINT64                        Start;
+  UINT64                        End;
+
+  mReport[BENCHMARK_SUPV_MMI_ROUND_TRIP].Status = EFI_NOT_STARTED;
+
+  for (Index = 0; Index < MMI_ROUND_TRIP_ITERATIONS; Index++) {
+    Status = PrepareSupvRequest (MM_SUPERVISOR_REQUEST_VERSION_INFO, &CommBuffer);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+
+    Start  = AsmReadTsc ();
+    Status = SupvCommunicate (CommBuffer);
+    End    = AsmReadTsc ();
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+
+    RecordSample (&mReport[BENCHMARK_SUPV_MMI_ROUND_TRIP], End - Start);
+  }
+
+  mReport[BENCHMARK_SUPV_MMI_ROUND_TRIP].Status = EFI_SUCCESS;
+
+  return UNIT_TEST_PASSED;
+}
+
+/*
+  Benchmark the MMI round trip of a request served by a user MM handler. The handler stamps
+  the TSC upon entry and exit, which splits the round trip into the leg from DXE into the
+  demoted handler and the leg from the handler back to DXE.
+*/
+UNIT_TEST_STATUS
+EFIAPI
+BenchmarkUserMmiRoundTrip (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS                       Status;
+  MM_SYSCALL_BENCHMARK_PARAMETERS  Parameters;
+  UINTN                            Index;
+  UINT64                           Start;
+  UINT64                           End;
+
+  mReport[BENCHMARK_USER_MMI_ROUND_TRIP].Status = EFI_NOT_STARTED;
+  mReport[BENCHMARK_USER_MMI_ENTRY].Status      = EFI_NOT_STARTED;
+  mReport[BENCHMARK_USER_MMI_EXIT].Status       = EFI_NOT_STARTED;
+
+  for (Index = 0; Index < MMI_ROUND_TRIP_ITERATIONS; Index++) {
+    ZeroMem (&Parameters, sizeof (Parameters));
+    Parameters.Signature = MM_SYSCALL_BENCHMARK_SIGNATURE;
+    Parameters.Revision  = MM_SYSCALL_BENCHMARK_REVISION;
+
+    Start  = AsmReadTsc ();
+    Status = BenchmarkCommunicate (&Parameters);
+    End    = AsmReadTsc ();
+    if (Status == EFI_NOT_FOUND) {
+      UT_LOG_WARNING ("Benchmark MM driver did not respond, is it included in the platform?\n");
+      return UNIT_TEST_SKIPPED;
+    }
+
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+    UT_ASSERT_TRUE (Start <= Parameters.HandlerEntryTsc);
+    UT_ASSERT_TRUE (Parameters.HandlerEntryTsc <= Parameters.HandlerExitTsc);
+    UT_ASSERT_TRUE (Parameters.HandlerExitTsc <= End);
+
+    RecordSample (&mReport[BENCHMARK_USER_MMI_ROUND_TRIP], End - Start);
+    RecordSample (&mReport[BENCHMARK_USER_MMI_ENTRY], Parameters.HandlerEntryTsc - Start);
+    RecordSample (&mReport[BENCHMARK_USER_MMI_EXIT], End - Parameters.HandlerExitTsc);
+  }
+
+  mReport[BENCHMARK_USER_MMI_ROUND_TRIP].Status = EFI_SUCCESS;
+  mReport[BENCHMARK_USER_MMI_ENTRY].Status      = EFI_SUCCESS;
+  mReport[BENCHMARK_USER_MMI_EXIT].Status       = EFI_SUCCESS;
+
+  return UNIT_TEST_PASSED;
+}
+
+/*
+  Benchmark a vectored MMI carrying several requests to a user MM handler, so that its cost per
+  request can be compared with the user MMI round trip above. The handler stamps the TSC of each
+  request, which also checks that the requests are served in order.
+*/
+UNIT_TEST_STATUS
+EFIAPI
+BenchmarkUserMmiVectored (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS                       Status;
+  MM_SYSCALL_BENCHMARK_PARAMETERS  Parameters[VECTORED_MESSAGE_COUNT];
+  UINTN                            Index;
+  UINTN                            Message;
+  UINT64                           Start;
+  UINT64                           End;
+
+  mReport[BENCHMARK_USER_MMI_VECTORED].Status = EFI_NOT_STARTED;
+
+  for (Index = 0; Index < MMI_ROUND_TRIP_ITERATIONS; Index++) {
+    ZeroMem (Parameters, sizeof (Parameters));
+    for (Message = 0; Message < VECTORED_MESSAGE_COUNT; Message++) {
+      Parameters[Message].Signature = MM_SYSCALL_BENCHMARK_SIGNATURE;
+      Parameters[Message].Revision  = MM_SYSCALL_BENCHMARK_REVISION;
+    }
+
+    Start  = AsmReadTsc ();
+    Status = BenchmarkVectoredCommunicate (Parameters, VECTORED_MESSAGE_COUNT);
+    End    = AsmReadTsc ();
+    if (Status == EFI_NOT_FOUND) {
+      UT_LOG_WARNING ("Benchmark MM driver or vectored communicate did not respond, are they included in the platform?\n");
+      return UNIT_TEST_SKIPPED;
+    }
+
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+    UT_ASSERT_TRUE (Start <= Parameters[0].HandlerEntryTsc);
+    for (Message = 1; Message < VECTORED_MESSAGE_COUNT; Message++) {
+      UT_ASSERT_TRUE (Parameters[Message - 1].HandlerExitTsc <= Parameters[Message].HandlerEntryTsc);
+    }
+
+    UT_ASSERT_TRUE (Parameters[VECTORED_MESSAGE_COUNT - 1].HandlerExitTsc <= End);
+
+    RecordSample (&mReport[BENCHMARK_USER_MMI_VECTORED], End - Start);
+  }
+
+  mReport[BENCHMARK_USER_MMI_VECTORED].Status = EFI_SUCCESS;
+
+  if (mReport[BENCHMARK_USER_MMI_ROUND_TRIP].Iterations != 0) {
+    UT_LOG_INFO (
+      "%d requests: %ld cycles in one vectored MMI, %ld cycles in separate MMIs on average.\n",
+      VECTORED_MESSAGE_COUNT,
+      DivU64x64Remainder (mReport[BENCHMARK_USER_MMI_VECTORED].TotalCycles, mReport[BENCHMARK_USER_MMI_VECTORED].Iterations, NULL),
+      MultU64x32 (
+        DivU64x64Remainder (mReport[BENCHMARK_USER_MMI_ROUND_TRIP].TotalCycles, mReport[BENCHMARK_USER_MMI_ROUND_TRIP].Iterations, NULL),
+        VECTORED_MESSAGE_COUNT
+        )
+      );
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/*
+  Benchmark a batch of variable reads served by the variable MM driver, once with one MMI per
+  variable and once in a single vectored MMI. Both ways must report the same variables.
+*/
+UNIT_TEST_STATUS
+EFIAPI
+BenchmarkVariableReadBatch (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS  Status;
+  EFI_STATUS  SeparateStatus[VECTORED_MESSAGE_COUNT];
+  UINTN       SeparateSize[VECTORED_MESSAGE_COUNT];
+  EFI_STATUS  VectoredStatus[VECTORED_MESSAGE_COUNT];
+  UINTN       VectoredSize[VECTORED_MESSAGE_COUNT];
+  UINTN       Index;
+  UINTN       Variable;
+  UINT64      Start;
+  UINT64      End;
+
+  mReport[BENCHMARK_VARIABLE_SEPARATE].Status = EFI_NOT_STARTED;
+  mReport[BENCHMARK_VARIABLE_VECTORED].Status = EFI_NOT_STARTED;
+
+  for (Index = 0; Index < MMI_ROUND_TRIP_ITERATIONS; Index++) {
+    Start  = AsmReadTsc ();
+    Status = ReadVariablesSeparately (SeparateStatus, SeparateSize);
+    End    = AsmReadTsc ();
+    if (Status == EFI_NOT_FOUND) {
+      UT_LOG_WARNING ("Variable MM driver did not respond, is it included in the platform?\n");
+      return UNIT_TEST_SKIPPED;
+    }
+
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+    RecordSample (&mReport[BENCHMARK_VARIABLE_SEPARATE], End - Start);
+
+    Start  = AsmReadTsc ();
+    Status = ReadVariablesVectored (VectoredStatus, VectoredSize);
+    End    = AsmReadTsc ();
+    if (Status == EFI_NOT_FOUND) {
+      UT_LOG_WARNING ("Vectored communicate did not respond, is it included in the platform?\n");
+      return UNIT_TEST_SKIPPED;
+    }
+
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+    RecordSample (&mReport[BENCHMARK_VARIABLE_VECTORED], End - Start);
+
+    for (Variable = 0; Variable < VECTORED_MESSAGE_COUNT; Variable++) {
+      UT_ASSERT_STATUS_EQUAL (VectoredStatus[Variable], SeparateStatus[Variable]);
+      UT_ASSERT_EQUAL (VectoredSize[Variable], SeparateSize[Variable]);
+    }
+  }
+
+  mReport[BENCHMARK_VARIABLE_SEPARATE].Status = EFI_SUCCESS;
+  mReport[BENCHMARK_VARIABLE_VECTORED].Status = EFI_SUCCESS;
+
+  UT_LOG_INFO (
+    "%d variable reads: %ld cycles in one vectored MMI, %ld cycles in separate MMIs on average.\n",
+    VECTORED_MESSAGE_COUNT,
+    DivU64x64Remainder (mReport[BENCHMARK_VARIABLE_VECTORED].TotalCycles, mReport[BENCHMARK_VARIABLE_VECTORED].Iterations, NULL),
+    DivU64x64Remainder (mReport[BENCHMARK_VARIABLE_SEPARATE].TotalCycles, mReport[BENCHMARK_VARIABLE_SEPARATE].Iterations, NULL)
+    );
+
+  return UNIT_TEST_PASSED;
+}
+
+/*
+  Benchmark the user MMI round trip once over the SYSRET demotion path and once over the call
+  gate fallback, switching between them at runtime. The path selected beforehand is restored
+  once done.
+*/
+UNIT_TEST_STATUS
+EFIAPI
+BenchmarkDemotionPaths (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS                       Status;
+  MM_SYSCALL_BENCHMARK_PARAMETERS  Parameters;
+  UINT32                           OriginalPath;
+  UINT32                           SelectedPath;
+  UINT32                           ActivePath;
+  UINTN                            Path;
+  UINTN                            Index;
+  UINT64                           Start;
+  UINT64                           End;
+
+  mReport[BENCHMARK_DEMOTION_SYSRET].Status    = EFI_NOT_STARTED;
+  mReport[BENCHMARK_DEMOTION_CALL_GATE].Status = EFI_NOT_STARTED;
+
+  Status = SelectDemotionPath (MM_SUPERVISOR_DEMOTION_PATH_QUERY, &OriginalPath, &ActivePath);
+  if (Status == EFI_UNSUPPORTED) {
+    UT_LOG_WARNING ("Supervisor cannot switch the demotion path, it is not a test build.\n");
+    return UNIT_TEST_SKIPPED;
+  }
+
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  Status = SelectDemotionPath (MM_SUPERVISOR_DEMOTION_PATH_SYSRET, &SelectedPath, &ActivePath);
+  if (EFI_ERROR (Status) || (ActivePath != MM_SUPERVISOR_DEMOTION_PATH_SYSRET)) {
+    SelectDemotionPath (OriginalPath, &SelectedPath, &ActivePath);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+    UT_LOG_WARNING ("SYSRET demotion is not available, only the call gate path is in use.\n");
+    return UNIT_TEST_SKIPPED;
+  }
+
+  for (Path = BENCHMARK_DEMOTION_SYSRET; Path <= BENCHMARK_DEMOTION_CALL_GATE; Path++) {
+    Status = SelectDemotionPath (
+               (Path == BENCHMARK_DEMOTION_SYSRET) ? MM_SUPERVISOR_DEMOTION_PATH_SYSRET : MM_SUPERVISOR_DEMOTION_PATH_CALL_GATE,
+               &SelectedPath,
+               &ActivePath
+               );
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    for (Index = 0; Index < MMI_ROUND_TRIP_ITERATIONS; Index++) {
+      ZeroMem (&Parameters, sizeof (Parameters));
+      Parameters.Signature = MM_SYSCALL_BENCHMARK_SIGNATURE;
+      Parameters.Revision  = MM_SYSCALL_BENCHMARK_REVISION;
+
+      Start  = AsmReadTsc ();
+      Status = BenchmarkCommunicate (&Parameters);
+      End    = AsmReadTsc ();
+      if (EFI_ERROR (Status)) {
+        break;
+      }
+
+      RecordSample (&mReport[Path], End - Start);
+    }
+
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    mReport[Path].Status = EFI_SUCCESS;
+  }
+
+  // Leave the supervisor on the path it was on before, whatever happened above
+  UT_ASSERT_NOT_EFI_ERROR (SelectDemotionPath (OriginalPath, &SelectedPath, &ActivePath));
+
+  if (Status == EFI_NOT_FOUND) {
+    UT_LOG_WARNING ("Benchmark MM driver did not respond, is it included in the platform?\n");
+    return UNIT_TEST_SKIPPED;
+  }
+
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  UT_LOG_INFO (
+    "User MMI round trip: %ld cycles demoted through SYSRET, %ld cycles through the call gate on average.\n",
+    DivU64x64Remainder (mReport[BENCHMARK_DEMOTION_SYSRET].TotalCycles, mReport[BENCHMARK_DEMOTION_SYSRET].Iterations, NULL),
+    DivU64x64Remainder (mReport[BENCHMARK_DEMOTION_CALL_GATE].TotalCycles, mReport[BENCHMARK_DEMOTION_CALL_GATE].Iterations, NULL)
+    );
+
+  return UNIT_TEST_PASSED;
+}
+
+/*
+  Benchmark the syscalls issued by a user MM driver.
+*/
+UNIT_TEST_STATUS
+EFIAPI
+BenchmarkSyscalls (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_STATUS                       Status;
+  MM_SYSCALL_BENCHMARK_PARAMETERS  Parameters;
+  UINTN                            Index;
+
+  for (Index = 0; Index < MM_SYSCALL_BENCHMARK_COUNT; Index++) {
+    mReport[Index].Status = EFI_NOT_STARTED;
+  }
+
+  ZeroMem (&Parameters, sizeof (Parameters));
+  Parameters.Signature  = MM_SYSCALL_BENCHMARK_SIGNATURE;
+  Parameters.Revision   = MM_SYSCALL_BENCHMARK_REVISION;
+  Parameters.Iterations = SYSCALL_ITERATIONS;
+
+  Status = SelectPolicyGatedTargets (&Parameters);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  if ((Parameters.Flags & MM_SYSCALL_BENCHMARK_FLAG_IO_READ) == 0) {
+    UT_LOG_WARNING ("No candidate IO port is readable under the active policy, skipping IO read.\n");
+  }
+
+  if ((Parameters.Flags & MM_SYSCALL_BENCHMARK_FLAG_MSR_READ) == 0) {
+    UT_LOG_WARNING ("No candidate MSR is readable under the active policy, skipping MSR read.\n");
+  }
+
+  Status = BenchmarkCommunicate (&Parameters);
+  if (Status == EFI_NOT_FOUND) {
+    UT_LOG_WARNING ("Benchmark MM driver did not respond, is it included in the platform?\n");
+    return UNIT_TEST_SKIPPED;
+  }
+
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  CopyMem (mReport, Parameters.Results, sizeof (Parameters.Results));
+
+  UT_ASSERT_NOT_EFI_ERROR ((EFI_STATUS)mReport[MM_SYSCALL_BENCHMARK_NULL].Status);
+  UT_ASSERT_NOT_EFI_ERROR ((EFI_STATUS)mReport[MM_SYSCALL_BENCHMARK_NULL_FAST].Status);
+  UT_ASSERT_EQUAL (mReport[MM_SYSCALL_BENCHMARK_NULL].Iterations, SYSCALL_ITERATIONS);
+
+  UT_LOG_INFO (
+    "CPU %d: null syscall %ld cycles, fast null syscall %ld cycles on average.\n",
+    Parameters.CpuIndex,
+    DivU64x64Remainder (mReport[MM_SYSCALL_BENCHMARK_NULL].TotalCycles, SYSCALL_ITERATIONS, NULL),
+    DivU64x64Remainder (mReport[MM_SYSCALL_BENCHMARK_NULL_FAST].TotalCycles, SYSCALL_ITERATIONS, NULL)
+    );
+
+  // The parallel digests are checked against the serial ones by the MM driver
+  UT_ASSERT_NOT_EFI_ERROR ((EFI_STATUS)mReport[MM_SYSCALL_BENCHMARK_HASH_SERIAL].Status);
+  UT_ASSERT_NOT_EFI_ERROR ((EFI_STATUS)mReport[MM_SYSCALL_BENCHMARK_HASH_PARALLEL].Status);
+  UT_LOG_INFO (
+    "Buffer hash %ld cycles on one CPU, %ld cycles on all CPUs at best.\n",
+    mReport[MM_SYSCALL_BENCHMARK_HASH_SERIAL].MinCycles,
+    mReport[MM_SYSCALL_BENCHMARK_HASH_PARALLEL].MinCycles
+    );
+
+  // Single CPU systems have no AP to demote
+  if (mReport[MM_SYSCALL_BENCHMARK_AP_PROCEDURE].Iterations != 0) {
+    UT_LOG_INFO (
+      "Empty AP procedure %ld cycles at best, %ld cycles on average.\n",
+      mReport[MM_SYSCALL_BENCHMARK_AP_PROCEDURE].MinCycles,
+      DivU64x64Remainder (
+        mReport[MM_SYSCALL_BENCHMARK_AP_PROCEDURE].TotalCycles,
+        mReport[MM_SYSCALL_BENCHMARK_AP_PROCEDURE].Iterations,
+        NULL
+        )
+      );
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/// ================================================================================================
+/// ================================================================================================
+///
+/// TEST ENGINE
+///
+/// ================================================================================================
+/// ================================================================================================
+
+/**
+  MmSyscallBenchmarkAppEntryPoint
+
+  @param[in] ImageHandle              The firmware allocated handle for the EFI image.
+  @param[in] SystemTable              A pointer to the EFI System Table.
+
+  @retval EFI_SUCCESS                 The entry point executed successfully.
+  @retval other                       Some error occurred when executing this entry point.
+
+**/
+EFI_STATUS
+EFIAPI
+MmSyscallBenchmarkAppEntryPoint (
+  IN EFI_HANDLE        ImageHandle,
+  IN EFI_SYSTEM_TABLE  *SystemTable
+  )
+{
+  EFI_STATUS                  Status    = EFI_ABORTED;
+  UNIT_TEST_FRAMEWORK_HANDLE  Fw        = NULL;
+  UNIT_TEST_SUITE_HANDLE      Benchmark = NULL;
+  UINTN                       Index;
+
+  DEBUG ((DEBUG_ERROR, "%a %a v%a\n", __FUNCTION__, UNIT_TEST_APP_NAME, UNIT_TEST_APP_VERSION));
+
+  for (Index = 0; Index < BENCHMARK_REPORT_COUNT; Index++) {
+    mReport[Index].Status = EFI_NOT_STARTED;
+  }
+
+  // Start setting up the test framework for running the tests.
+  Status = InitUnitTestFramework (&Fw, UNIT_TEST_APP_NAME, gEfiCallerBaseName, UNIT_TEST_APP_VERSION);
+  if (EFI_ERROR (Status) != FALSE) {
+    DEBUG ((DEBUG_ERROR, "%a Failed in InitUnitTestFramework. Status = %r\n", __FUNCTION__, Status));
+    goto Cleanup;
+  }
+
+  CreateUnitTestSuite (&Benchmark, Fw, "MM Supervisor privilege transition benchmark", "MmSupv.Benchmark", NULL, NULL);
+
+  if (Benchmark == NULL) {
+    DEBUG ((DEBUG_ERROR, "%a Failed in CreateUnitTestSuite for TestSuite\n", __FUNCTION__));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Cleanup;
+  }
+
+  AddTestCase (
+    Benchmark,
+    "Supervisor MMI round trip",
+    "MmSupv.Benchmark.SupvMmiRoundTrip",
+    BenchmarkSupvMmiRoundTrip,
+    LocateCommBuffers,
+    NULL,
+    NULL
+    );
+  AddTestCase (
+    Benchmark,
+    "User MMI round trip",
+    "MmSupv.Benchmark.UserMmiRoundTrip",
+    BenchmarkUserMmiRoundTrip,
+    LocateCommBuffers,
+    NULL,
+    NULL
+    );
+  AddTestCase (
+    Benchmark,
+    "User vectored MMI",
+    "MmSupv.Benchmark.UserMmiVectored",
+    BenchmarkUserMmiVectored,
+    LocateCommBuffers,
+    NULL,
+    NULL
+    );
+  AddTestCase (
+    Benchmark,
+    "Demotion paths",
+    "MmSupv.Benchmark.DemotionPaths",
+    BenchmarkDemotionPaths,
+    LocateCommBuffers,
+    NULL,
+    NULL
+    );
+  AddTestCase (
+    Benchmark,
+    "Variable read batch",
+    "MmSupv.Benchmark.VariableReadBatch",
+    BenchmarkVariableReadBatch,
+    LocateCommBuffers,
+    NULL,
+    NULL
+    );
+  AddTestCase (
+    Benchmark,
+    "User syscalls",
+    "MmSupv.Benchmark.Syscalls",
+    BenchmarkSyscalls,
+    LocateCommBuffers,
+    NULL,
+    NULL
+    );
+
+  //
+  // Execute the tests.
+  //
+  Status = RunAllTestSuites (Fw);
+
+  // Failing to persist the report does not make the benchmark wrong, just complain about it
+  if (EFI_ERROR (WriteBenchmarkReport ())) {
+    DEBUG ((DEBUG_ERROR, "%a Failed to write %s\n", __FUNCTION__, BENCHMARK_REPORT_FILE_NAME));
+  }
+
+Cleanup:
+  if (Fw) {
+    FreeUnitTestFramework (Fw);
+  }
+
+  return Status;
+} // MmSyscallBenchmarkAppEntryPoint()